@@ -0,0 +1,269 @@
+// Copyright 2023 Morse Micro
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include <algorithm>
+#include <cctype>
+#include <iterator>
+#include <random>
+
+#include "authenticator.h"
+#include "hashes.h"
+
+
+const char Authenticator::REALM[] = "ONVIF";
+
+// Our Digest nonces are when they were issued and a MAC of that, both in hex.
+static const size_t NONCE_ISSUED_LENGTH = 16;
+static const size_t NONCE_MAC_BYTES = 8;
+
+
+ReplayCache::ReplayCache(size_t slots) : evicted_until(0) {
+	size_t size = PROBES;
+	while (size < slots) {
+		size *= 2;
+	}
+	this->slots.assign(size, {0, 0});
+}
+
+
+bool ReplayCache::insert(uint64_t key, time_t expiry, time_t now) {
+	if (key == 0) {
+		key = 1;
+	}
+	if (expiry <= evicted_until) {
+		return false;
+	}
+	size_t mask = slots.size() - 1;
+	Slot *free_slot = nullptr;
+	Slot *victim = nullptr;
+	for (size_t i = 0; i < PROBES; ++i) {
+		Slot &slot = slots[(key + i) & mask];
+		bool live = slot.key != 0 && slot.expiry > now;
+		if (live && slot.key == key) {
+			return false;
+		}
+		if (!live) {
+			free_slot = free_slot == nullptr ? &slot : free_slot;
+		} else if (victim == nullptr || slot.expiry < victim->expiry) {
+			victim = &slot;
+		}
+	}
+	if (free_slot == nullptr) {
+		evicted_until = std::max(evicted_until, victim->expiry);
+		free_slot = victim;
+	}
+	*free_slot = {key, expiry};
+	return true;
+}
+
+
+// The first 8 bytes of a digest we've just checked, which is as good a key as any.
+static uint64_t replay_key(const uint8_t *digest) {
+	uint64_t key;
+	memcpy(&key, digest, sizeof(key));
+	return key;
+}
+
+
+Authenticator::Authenticator(size_t replay_slots) : replays(replay_slots) {
+	std::random_device random;
+	for (int i = 0; i < 4; ++i) {
+		uint32_t bits = random();
+		secret.append(reinterpret_cast<const char *>(&bits), sizeof(bits));
+	}
+}
+
+
+void Authenticator::setUsers(const std::vector<User> &new_users) {
+	users.clear();
+	for (auto &user : new_users) {
+		auto ha1 = Md5().update(user.username).update(":").update(REALM).update(":").update(user.password).finish();
+		users[user.username] = {user.password, to_hex(ha1), user.level};
+	}
+}
+
+
+Authenticator::Level Authenticator::verifyUsernameToken(const std::string &username, const std::string &digest, const std::string &nonce,
+                                                        const std::string &created, time_t created_time, time_t now) {
+	auto it = users.find(username);
+	if (it == users.end() || created_time < now - WINDOW_SECONDS || created_time > now + WINDOW_SECONDS) {
+		return Level::Anonymous;
+	}
+	std::string nonce_bytes;
+	std::string digest_bytes;
+	if (!base64_decode(nonce, &nonce_bytes) || !base64_decode(digest, &digest_bytes)) {
+		return Level::Anonymous;
+	}
+	auto expected = Sha1().update(nonce_bytes).update(created).update(it->second.password).finish();
+	if (!constant_time_equal(std::string(expected.begin(), expected.end()), digest_bytes)) {
+		return Level::Anonymous;
+	}
+	// Once it's too old, it's refused regardless.
+	if (!replays.insert(replay_key(expected.data()), created_time + WINDOW_SECONDS, now)) {
+		return Level::Anonymous;
+	}
+	return it->second.level;
+}
+
+
+std::string Authenticator::nonceMac(const std::string &issued) {
+	auto mac = Sha1().update(secret).update(issued).finish();
+	return to_hex(mac.data(), NONCE_MAC_BYTES);
+}
+
+
+std::string Authenticator::digestChallenge(time_t now, bool stale) {
+	char issued[NONCE_ISSUED_LENGTH + 1];
+	snprintf(issued, sizeof(issued), "%016llx", static_cast<unsigned long long>(now));
+	return std::string("Digest realm=\"") + REALM + "\", qop=\"auth\", algorithm=MD5, nonce=\"" + issued + nonceMac(issued) + "\""
+		+ (stale ? ", stale=true" : "");
+}
+
+
+struct DigestParameters {
+	std::string username;
+	std::string realm;
+	std::string nonce;
+	std::string uri;
+	std::string response;
+	std::string algorithm;
+	std::string qop;
+	std::string nc;
+	std::string cnonce;
+};
+
+
+// key=value or key="quoted value", separated by commas (RFC 7616).
+static bool parse_digest(const std::string &text, DigestParameters *parameters) {
+	size_t i = 0;
+	while (i < text.size()) {
+		while (i < text.size() && (isspace(static_cast<unsigned char>(text[i])) || text[i] == ',')) {
+			++i;
+		}
+		size_t equals = text.find('=', i);
+		if (equals == std::string::npos) {
+			break;
+		}
+		std::string key = text.substr(i, equals - i);
+		while (!key.empty() && isspace(static_cast<unsigned char>(key.back()))) {
+			key.pop_back();
+		}
+		i = equals + 1;
+		while (i < text.size() && isspace(static_cast<unsigned char>(text[i]))) {
+			++i;
+		}
+		std::string value;
+		if (i < text.size() && text[i] == '"') {
+			for (++i; i < text.size() && text[i] != '"'; ++i) {
+				if (text[i] == '\\' && i + 1 < text.size()) {
+					++i;
+				}
+				value += text[i];
+			}
+			if (i == text.size()) {
+				return false;  // Unterminated.
+			}
+			++i;
+		} else {
+			size_t end = text.find(',', i);
+			value = text.substr(i, end == std::string::npos ? std::string::npos : end - i);
+			while (!value.empty() && isspace(static_cast<unsigned char>(value.back()))) {
+				value.pop_back();
+			}
+			i = end == std::string::npos ? text.size() : end;
+		}
+
+		if (strcasecmp(key.c_str(), "username") == 0) {
+			parameters->username = value;
+		} else if (strcasecmp(key.c_str(), "realm") == 0) {
+			parameters->realm = value;
+		} else if (strcasecmp(key.c_str(), "nonce") == 0) {
+			parameters->nonce = value;
+		} else if (strcasecmp(key.c_str(), "uri") == 0) {
+			parameters->uri = value;
+		} else if (strcasecmp(key.c_str(), "response") == 0) {
+			parameters->response = value;
+		} else if (strcasecmp(key.c_str(), "algorithm") == 0) {
+			parameters->algorithm = value;
+		} else if (strcasecmp(key.c_str(), "qop") == 0) {
+			parameters->qop = value;
+		} else if (strcasecmp(key.c_str(), "nc") == 0) {
+			parameters->nc = value;
+		} else if (strcasecmp(key.c_str(), "cnonce") == 0) {
+			parameters->cnonce = value;
+		}
+	}
+	return true;
+}
+
+
+Authenticator::Level Authenticator::verifyDigest(const std::string &authorization, const std::string &uri, time_t now, bool *stale) {
+	*stale = false;
+	DigestParameters parameters;
+	if (!parse_digest(authorization, &parameters)) {
+		return Level::Anonymous;
+	}
+	auto it = users.find(parameters.username);
+	// We only ever offer qop=auth, so anything else (e.g. RFC 2069's none) isn't in answer to us.
+	if (it == users.end() || parameters.realm != REALM || parameters.uri != uri || parameters.qop != "auth"
+			|| (!parameters.algorithm.empty() && strcasecmp(parameters.algorithm.c_str(), "MD5") != 0)
+			|| parameters.nc.empty() || parameters.cnonce.empty()
+			|| parameters.nonce.size() != NONCE_ISSUED_LENGTH + 2 * NONCE_MAC_BYTES) {
+		return Level::Anonymous;
+	}
+	std::string issued_hex = parameters.nonce.substr(0, NONCE_ISSUED_LENGTH);
+	if (!constant_time_equal(nonceMac(issued_hex), parameters.nonce.substr(NONCE_ISSUED_LENGTH))) {
+		return Level::Anonymous;
+	}
+
+	auto ha2 = Md5().update("POST:").update(uri).finish();
+	auto expected = Md5().update(it->second.ha1).update(":").update(parameters.nonce).update(":").update(parameters.nc)
+		.update(":").update(parameters.cnonce).update(":").update(parameters.qop).update(":").update(to_hex(ha2)).finish();
+	std::transform(parameters.response.begin(), parameters.response.end(), parameters.response.begin(), ::tolower);
+	if (!constant_time_equal(to_hex(expected), parameters.response)) {
+		return Level::Anonymous;
+	}
+
+	time_t issued = static_cast<time_t>(strtoull(issued_hex.c_str(), nullptr, 16));
+	if (issued > now || now - issued > WINDOW_SECONDS) {
+		*stale = true;
+		return Level::Anonymous;
+	}
+	// nc and cnonce are in the response, so a replay is the same response.
+	if (!replays.insert(replay_key(expected.data()), issued + WINDOW_SECONDS, now)) {
+		return Level::Anonymous;
+	}
+	return it->second.level;
+}
+
+
+Authenticator::Level Authenticator::requiredLevel(const std::string &service, const std::string &operation) {
+	// PRE_AUTH: what a client needs to find out how to talk to us (and what time it is, for UsernameToken).
+	static const char *const pre_auth[] = {
+		"GetWsdlUrl", "GetServices", "GetServiceCapabilities", "GetCapabilities",
+		"GetHostname", "GetSystemDateAndTime", "GetEndpointReference",
+	};
+	// READ_SYSTEM_SECRET and WRITE_SYSTEM_SECRET.
+	static const char *const secrets[] = {
+		"GetUsers", "CreateUsers", "DeleteUsers", "SetUser", "GetRemoteUser", "SetRemoteUser",
+	};
+	auto in = [&operation] (const char *const *names, size_t count) {
+		return std::find(names, names + count, operation) != names + count;
+	};
+
+	if (service == "tdn" || (service == "tds" && in(pre_auth, std::size(pre_auth))) || operation == "GetServiceCapabilities") {
+		return Level::Anonymous;
+	}
+	bool read = operation.compare(0, 3, "Get") == 0;
+	if (service == "tds") {
+		// Otherwise READ_SYSTEM, or WRITE_SYSTEM (which is the administrator's).
+		return in(secrets, std::size(secrets)) || !read ? Level::Administrator : Level::User;
+	}
+	// READ_MEDIA (which includes events), or ACTUATE.
+	return read || service == "tev" || service == "wsnt" ? Level::User : Level::Operator;
+}
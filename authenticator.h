@@ -0,0 +1,110 @@
+/*
+ * Copyright 2023 Morse Micro
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <time.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+/* Every (verified) token seen until it would have been refused as too old anyway,
+ * in a fixed-size table: a lookup only ever probes PROBES slots.
+ *
+ * When those are all still live, the one that expires soonest is dropped, and from then
+ * on anything that would expire by the time it would have is refused (we can't tell
+ * whether it's a replay). So under a flood of genuine requests old-ish tokens start
+ * to be refused, rather than replays being let through.
+ */
+class ReplayCache {
+	public:
+		static const size_t DEFAULT_SLOTS = 4096;
+		static const size_t PROBES = 8;
+
+	private:
+		struct Slot {
+			uint64_t key;  // 0 if empty.
+			time_t expiry;
+		};
+
+		std::vector<Slot> slots;
+		time_t evicted_until;
+
+	public:
+		/* slots is rounded up to a power of two. */
+		explicit ReplayCache(size_t slots = DEFAULT_SLOTS);
+
+		/* Remembers key until expiry, returning false if it's been seen (or might have been). */
+		bool insert(uint64_t key, time_t expiry, time_t now);
+};
+
+
+/* Who's allowed to do what, checked against WS-UsernameToken (PasswordDigest) or HTTP Digest.
+ *
+ * Each user's credentials are worked out when the users are set (e.g. the Digest HA1), so
+ * verifying a request is a hash or two plus a lookup in the ReplayCache. Not thread-safe:
+ * it's used under the Camera's lock.
+ */
+class Authenticator {
+	public:
+		// In order: each can do everything the one before it can.
+		enum class Level { Anonymous, User, Operator, Administrator };
+
+		struct User {
+			std::string username;
+			std::string password;
+			Level level;
+		};
+
+		static const char REALM[];
+		// How far a UsernameToken's Created can be from now, and how long our Digest nonces last.
+		static const time_t WINDOW_SECONDS = 300;
+
+	private:
+		struct Credentials {
+			std::string password;  // UsernameToken's digest needs it as is.
+			std::string ha1;  // MD5(username:realm:password), in hex.
+			Level level;
+		};
+
+		std::unordered_map<std::string, Credentials> users;
+		ReplayCache replays;
+		std::string secret;  // For our Digest nonces, so we know they're ours without keeping them.
+
+		std::string nonceMac(const std::string &issued);
+
+	public:
+		explicit Authenticator(size_t replay_slots = ReplayCache::DEFAULT_SLOTS);
+
+		void setUsers(const std::vector<User> &users);
+
+		/* Without any, everything's allowed (i.e. ONVIF's factory default state). */
+		bool hasUsers() const {
+			return !users.empty();
+		}
+
+		/* The user's level if digest is Base64(SHA-1(nonce + created + password)), with created
+		 * (whose text is what was hashed) close enough to now and the token not seen before.
+		 * Otherwise Anonymous.
+		 */
+		Level verifyUsernameToken(const std::string &username, const std::string &digest, const std::string &nonce,
+		                          const std::string &created, time_t created_time, time_t now);
+
+		/* The same for an Authorization: Digest header (its parameters, after "Digest ") on a POST to uri.
+		 * stale is set if it was right, but with a nonce we'd stopped accepting.
+		 */
+		Level verifyDigest(const std::string &authorization, const std::string &uri, time_t now, bool *stale);
+
+		/* What a 401 should have in WWW-Authenticate, with a fresh nonce. */
+		std::string digestChallenge(time_t now, bool stale);
+
+		/* The least level that can call operation (e.g. GetUsers) in the service whose
+		 * namespace prefix is service (e.g. tds), after ONVIF's access classes.
+		 */
+		static Level requiredLevel(const std::string &service, const std::string &operation);
+};
@@ -0,0 +1,85 @@
+// Copyright 2023 Morse Micro
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include "bitratecontroller.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+
+// Below this fraction of the target, the link is what's limiting the stream.
+static const double FELL_SHORT = 0.8;
+// And from this, it kept up.
+static const double KEPT_UP = 0.95;
+// Backs off to this fraction of what got through, so any backlog drains.
+static const double BACK_OFF = 0.85;
+static const int PROBE_AFTER_SAMPLES = 3;
+static const double PROBE_STEP = 1.15;
+
+
+bool NetDevThroughputSource::getSentBytes(uint64_t *bytes) {
+	std::ifstream in(path);
+	std::string line;
+	while (std::getline(in, line)) {
+		// e.g. "  wlan0: 1234 5 0 0 0 0 0 0 5678 6 0 0 0 0 0 0"; the first two lines are headings.
+		size_t colon = line.find(':');
+		if (colon == std::string::npos) {
+			continue;
+		}
+		size_t start = line.find_first_not_of(' ');
+		if (line.compare(start, colon - start, interface) != 0) {
+			continue;
+		}
+		std::istringstream fields(line.substr(colon + 1));
+		uint64_t value;
+		// Receive bytes, packets, errs, drop, fifo, frame, compressed and multicast come first.
+		for (int i = 0; i < 9; ++i) {
+			if (!(fields >> value)) {
+				return false;
+			}
+		}
+		*bytes = value;
+		return true;
+	}
+	return false;
+}
+
+
+BitrateController::BitrateController(int min_bitrate, int max_bitrate)
+		: min_bitrate(min_bitrate) {
+	reset(max_bitrate);
+}
+
+
+void BitrateController::reset(int max_bitrate) {
+	this->max_bitrate = std::max(min_bitrate, max_bitrate);
+	target = previous_target = this->max_bitrate;
+	kept_up = previous_kept_up = 0;
+}
+
+
+int BitrateController::update(double throughput) {
+	previous_target = target;
+	previous_kept_up = kept_up;
+	if (throughput < target * FELL_SHORT) {
+		target = std::max(min_bitrate, static_cast<int>(throughput * BACK_OFF));
+		kept_up = 0;
+	} else if (throughput >= target * KEPT_UP && target < max_bitrate) {
+		if (++kept_up >= PROBE_AFTER_SAMPLES) {
+			target = std::min(max_bitrate, static_cast<int>(std::ceil(target * PROBE_STEP)));
+			kept_up = 0;
+		}
+	} else {
+		// In between, so leave it where it is.
+		kept_up = 0;
+	}
+	return target;
+}
+
+
+void BitrateController::undo() {
+	target = previous_target;
+	kept_up = previous_kept_up;
+}
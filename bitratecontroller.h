@@ -0,0 +1,74 @@
+/*
+ * Copyright 2023 Morse Micro
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <string>
+
+
+/* How many bytes have gone out on the link the stream is sent over, so far. */
+class ThroughputSource {
+	public:
+		virtual ~ThroughputSource() {}
+
+		/* false if it can't tell right now. */
+		virtual bool getSentBytes(uint64_t *bytes) = 0;
+};
+
+
+/* An interface's transmit counter in /proc/net/dev (or anything in the same format). */
+class NetDevThroughputSource : public ThroughputSource {
+	private:
+		std::string interface;
+		std::string path;
+
+	public:
+		explicit NetDevThroughputSource(std::string interface, std::string path = "/proc/net/dev")
+			: interface(interface), path(path) {}
+
+		virtual bool getSentBytes(uint64_t *bytes);
+};
+
+
+/* Picks the bitrate to encode at (<AdaptiveBitrate> in the properties) from the
+ * throughput each viewer actually got, so that a degrading link gets less video
+ * rather than a stalled stream.
+ *
+ * Falling short of the target means the link can't keep up, so it backs off
+ * to below what got through straight away. Only after several samples that kept
+ * up does it probe upwards again, a step at a time, which is the hysteresis that
+ * stops it flapping. This assumes the encoder roughly fills its bitrate (as CBR
+ * does); otherwise a quiet scene looks like a slow link.
+ */
+class BitrateController {
+	private:
+		int min_bitrate;  // kbit/s
+		int max_bitrate;  // kbit/s, i.e. the BitrateLimit that was configured.
+		int target;
+		int kept_up;  // Samples in a row.
+		// From before the last update, for undo.
+		int previous_target;
+		int previous_kept_up;
+
+	public:
+		BitrateController(int min_bitrate, int max_bitrate);
+
+		/* Starts again from max_bitrate (e.g. as the encoder was just reconfigured). */
+		void reset(int max_bitrate);
+
+		int getTarget() const {
+			return target;
+		}
+
+		/* Given the kbit/s a viewer got over the last interval, returns the new target. */
+		int update(double throughput);
+
+		/* Forgets the last update (e.g. as the encoder couldn't be given its target),
+		 * so that the next one comes to the same decision given the same throughput.
+		 */
+		void undo();
+};
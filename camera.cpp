@@ -4,26 +4,41 @@
 #include "soaplib/soapH.h"
 
 #include "camera.h"
+#include "datafile.h"
+#include "scopes.h"
 #include "utils.h"
 
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
 #include <string>
 #include <algorithm>
 #include <map>
+#include <set>
+#include <iterator>
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <exception>
+#include <functional>
+#include <memory>
+
+
+// Once the journal is this big, config.xml is rewritten (in the background).
+static const size_t JOURNAL_COMPACTION_THRESHOLD = 16 * 1024;
 
 
-static const struct Namespace datafile_namespaces[] = { 
-	{ "tt", "http://www.onvif.org/ver10/schema", nullptr, nullptr },
-	{ "xsi", "http://www.w3.org/2001/XMLSchema-instance", "http://www.w3.org/*/XMLSchema-instance", nullptr },
-	{ nullptr, nullptr, nullptr, nullptr}
-};
+// 0 if it doesn't say.
+static int configured_bitrate(const tt__VideoEncoderConfiguration *vec) {
+	return vec->RateControl != nullptr ? vec->RateControl->BitrateLimit : 0;
+}
 
 
 Camera::Camera(std::string onvif_url, std::string ip, std::string properties_filename, std::string config_filename, RtspServer *rtsp_server)
-		: onvif_url(onvif_url), ip(ip), config_filename(config_filename), rtsp_server(rtsp_server)
+		: onvif_url(onvif_url), ip(ip), properties_filename(properties_filename), config_filename(config_filename),
+		  rtsp_server(rtsp_server), discovery_version(1), network_state(nullptr), rtsp_ready(false),
+		  multicast_requested(false), multicast_only(false), multicast_policy_warned(false),
+		  last_sent_bytes(0), bitrate_sampled(false), bitrate_failed(false), encoder_idle(false), idle_unsupported(false), reloadable(false)
 {
 	struct soap *soap = soap_new1(SOAP_XML_DEFAULTNS | SOAP_XML_STRICT);
 	soap_set_namespaces(soap, datafile_namespaces);
@@ -32,21 +47,29 @@ Camera::Camera(std::string onvif_url, std::string ip, std::string properties_fil
 	std::ifstream config_file(config_filename);
 	soap->is = &config_file;
 	SoapError::ifNotOk(soap, "Reading " + config_filename, soap_read__tt__CameraConfiguration(soap, config));
-	config_file.close();
 	config = config->soap_dup();
 
 	properties = soap_new__tt__CameraProperties(soap);
 	std::ifstream properties_file(properties_filename);
 	soap->is = &properties_file;
-	SoapError::ifNotOk(soap, "Reading " + config_filename, soap_read__tt__CameraProperties(soap, properties));
-	properties_file.close();
+	SoapError::ifNotOk(soap, "Reading " + properties_filename, soap_read__tt__CameraProperties(soap, properties));
 	properties = properties->soap_dup();
 
+	// Older config files won't have this.
+	if (config->DeviceManagementService == nullptr) {
+		config->DeviceManagementService = soap_new_tt__DeviceManagementServiceConfiguration(nullptr);
+	}
+	updateFixedScopes();
+	updateAuthenticator();
+	validator.reset(new ConfigValidator(properties));
+	encoder_budget.reset(new EncoderBudget(properties));
+
 	if (!rtsp_server) {
 		switch (properties->RTSPStream->Type) {
 			case tt__RTSPServerType::mediaMtxRpi:
 				if (properties->RTSPStream->API == nullptr) throw InvalidConfigError("mediaMtxRpi requires <RTSPStream><API> section in properties file");
-				this->rtsp_server = new RtspServerMediaMtxRpi(std::string("http://localhost:") + properties->RTSPStream->API->Port, properties->RTSPStream->Path);
+				this->rtsp_server = new RtspServerMediaMtxRpi(std::string("http://localhost:") + properties->RTSPStream->API->Port, properties->RTSPStream->Path,
+					properties->RTSPStream->SuspendAfterIdle != nullptr ? *properties->RTSPStream->SuspendAfterIdle : -1);
 				break;
 			case tt__RTSPServerType::nvtrtspd:
 				if (properties->RTSPStream->Executable == nullptr) throw InvalidConfigError("nvtrtsped requires <RTSPStream><Executable> section in properties file");
@@ -62,14 +85,44 @@ Camera::Camera(std::string onvif_url, std::string ip, std::string properties_fil
 				break;
 		}
 	}
+	auto *adaptive = properties->RTSPStream->AdaptiveBitrate;
+	if (adaptive != nullptr && !this->rtsp_server->supportsSetBitrate()) {
+		LOG_WARNING("Not adapting the bitrate, as the RTSP server can't change it on the fly");
+	} else if (adaptive != nullptr) {
+		throughput_source.reset(adaptive->Statistics != nullptr
+			? new NetDevThroughputSource(adaptive->Interface, *adaptive->Statistics)
+			: new NetDevThroughputSource(adaptive->Interface));
+		bitrate_controller.reset(new BitrateController(adaptive->MinBitrate, configured_bitrate(getCurrentVideoEncoderConfiguration())));
+	}
 
 	soap_destroy(soap);
 	soap_end(soap);
 	soap_free(soap);
+
+	if (properties->RTSPStream->Type != tt__RTSPServerType::dummy) {
+		// Changes made since config.xml was last written. journal isn't set until
+		// afterwards, so replaying them doesn't record them again.
+		std::unique_ptr<ConfigJournal> replayed(new ConfigJournal(config_filename + ".journal"));
+		bool interrupted;
+		auto records = replayed->replay(&interrupted);
+		for (auto &record : records) {
+			if (!replay(record)) {
+				LOG_WARNING("Ignoring a config change in " << config_filename << ".journal that no longer applies");
+			}
+		}
+		journal = std::move(replayed);
+		if (interrupted) {
+			// Finish what the last compaction started before another one can.
+			saveConfiguration();
+		}
+	}
 }
 
 
 Camera::~Camera() {
+	if (compaction_thread.joinable()) {
+		compaction_thread.join();
+	}
 	properties->soap_del();
 	delete properties;
 	config->soap_del();
@@ -83,9 +136,239 @@ void Camera::saveConfiguration() {
 		return;
 	}
 
-	std::ofstream camera_config_file(config_filename);
-	saveConfiguration(camera_config_file);
-	camera_config_file.close();
+	// A compaction in progress is writing an older config, so it mustn't finish after us.
+	if (compaction_thread.joinable()) {
+		compaction_thread.join();
+	}
+
+	if (!write_file_atomically(config_filename, serialiseConfiguration())) {
+		return;
+	}
+	if (journal) {
+		journal->clear();
+	}
+	if (reloadable) {
+		config_on_disk = config_sections(config);
+	}
+}
+
+
+std::string Camera::serialiseConfiguration() {
+	std::ostringstream output;
+	saveConfiguration(output);
+	return output.str();
+}
+
+
+static std::string join_scopes(const std::vector<std::string> &scopes) {
+	std::string joined;
+	for (auto &scope : scopes) {
+		joined += scope + "\n";
+	}
+	return joined;
+}
+
+
+// The parts of a config, hashed (so they can be compared without keeping the XML,
+// passwords and all, for as long as we run), by what they are.
+static std::map<std::string, uint64_t> config_sections(_tt__CameraConfiguration *config) {
+	std::map<std::string, uint64_t> sections;
+	for (auto *vec : config->MediaService->VideoEncoderConfiguration) {
+		sections["VideoEncoderConfiguration " + vec->token] = deep_hash(vec);
+	}
+	for (auto *vsc : config->MediaService->VideoSourceConfiguration) {
+		sections["VideoSourceConfiguration " + vsc->token] = deep_hash(vsc);
+	}
+	for (auto *ivs : config->ImagingService->ImagingVideoSource) {
+		sections["ImagingSettings " + ivs->VideoSourceToken] = deep_hash(ivs->ImagingSettings);
+	}
+	for (auto *profile : config->MediaService->Profile) {
+		sections["Profile " + profile->ProfileToken] = deep_hash(profile);
+	}
+	for (auto *h265 : config->MediaService->H265Configuration) {
+		sections["H265Configuration " + h265->token] = deep_hash(h265);
+	}
+	sections["CurrentProfile"] = hash_xml(config->MediaService->CurrentProfile);
+	sections["Scopes"] = hash_xml(config->DeviceManagementService ? join_scopes(config->DeviceManagementService->Scope) : "");
+	if (config->DeviceManagementService != nullptr) {
+		for (auto *user : config->DeviceManagementService->User) {
+			sections["User " + user->Username] = deep_hash(user);
+		}
+	}
+	return sections;
+}
+
+
+static std::string read_file(const std::string &filename) {
+	std::ifstream file(filename);
+	return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+
+void Camera::record(ConfigJournal::Operation operation, const std::string &token, const std::string &value) {
+	publishChange(operation, token);
+	if (!journal) {
+		return;
+	}
+	if (!journal->append({operation, token, value})) {
+		// Better slow than lost.
+		saveConfiguration();
+		return;
+	}
+	if (journal->liveSize() > JOURNAL_COMPACTION_THRESHOLD) {
+		compactInBackground();
+	}
+}
+
+
+void Camera::publishChange(ConfigJournal::Operation operation, const std::string &token) {
+	Event event{time(nullptr), "", {}, {}};
+	switch (operation) {
+		case ConfigJournal::Operation::SetVideoEncoderConfiguration:
+		case ConfigJournal::Operation::SetH265Configuration:
+		case ConfigJournal::Operation::SetVideoEncoder:
+			event.topic = "tns1:Media/ConfigurationChanged";
+			event.source = {{"Token", token}};
+			event.data = {{"Type", "VideoEncoder"}};
+			break;
+		case ConfigJournal::Operation::SetVideoSourceConfiguration:
+			event.topic = "tns1:Media/ConfigurationChanged";
+			event.source = {{"Token", token}};
+			event.data = {{"Type", "VideoSource"}};
+			break;
+		case ConfigJournal::Operation::SetImagingSettings:
+			event.topic = "tns1:VideoSource/ImagingSettingsChanged";
+			event.source = {{"VideoSourceToken", token}};
+			break;
+		case ConfigJournal::Operation::SetCurrentProfile:
+		case ConfigJournal::Operation::SetProfile:
+		case ConfigJournal::Operation::DeleteProfile:
+			event.topic = "tns1:Media/ProfileChanged";
+			event.source = {{"Token", token}};
+			break;
+		case ConfigJournal::Operation::SetScopes:
+			// Discovery's Hello already announces these.
+			return;
+		case ConfigJournal::Operation::SetUser:
+		case ConfigJournal::Operation::DeleteUser:
+			// Not something to tell every subscriber about.
+			return;
+	}
+	events.publish(event);
+}
+
+
+void Camera::publishStreamRestarted() {
+	events.publish({time(nullptr), "tns1:Media/StreamRestarted", {{"Token", config->MediaService->CurrentProfile}}, {}});
+}
+
+
+void Camera::compactInBackground() {
+	if (journal->isCompacting()) {
+		// The last one's still writing; the live journal will just be a bit bigger than usual.
+		return;
+	}
+	if (compaction_thread.joinable()) {
+		compaction_thread.join();
+	}
+
+	// Serialised now (under the lock), so the thread only does the slow part.
+	std::string config_xml = serialiseConfiguration();
+	if (!journal->rotate()) {
+		return;
+	}
+	if (reloadable) {
+		config_on_disk = config_sections(config);
+	}
+
+	compaction_thread = std::thread([this, config_xml] {
+		// If this fails the compacting journal stays, and is replayed (then saved) at startup.
+		if (!write_file_atomically(config_filename, config_xml)) {
+			return;
+		}
+		journal->finishCompaction();
+	});
+}
+
+
+bool Camera::replay(const ConfigJournal::Record &record) {
+	switch (record.operation) {
+		case ConfigJournal::Operation::SetVideoEncoderConfiguration:
+			return parse_datafile(record.value, [this] (struct soap *soap) {
+				auto *vec = soap_new_tt__VideoEncoderConfiguration(soap);
+				return soap_read_tt__VideoEncoderConfiguration(soap, vec) == SOAP_OK && setVideoEncoderConfiguration(vec);
+			});
+		case ConfigJournal::Operation::SetVideoSourceConfiguration:
+			return parse_datafile(record.value, [this] (struct soap *soap) {
+				auto *vsc = soap_new_tt__VideoSourceConfiguration(soap);
+				return soap_read_tt__VideoSourceConfiguration(soap, vsc) == SOAP_OK && setVideoSourceConfiguration(vsc);
+			});
+		case ConfigJournal::Operation::SetImagingSettings:
+			return parse_datafile(record.value, [this, &record] (struct soap *soap) {
+				auto *imaging_settings = soap_new_tt__ImagingSettings20(soap);
+				return soap_read_tt__ImagingSettings20(soap, imaging_settings) == SOAP_OK && setImagingSettings(record.token, imaging_settings);
+			});
+		case ConfigJournal::Operation::SetScopes: {
+			std::vector<std::string> scopes;
+			std::istringstream input(record.value);
+			for (std::string scope; std::getline(input, scope); ) {
+				scopes.push_back(scope);
+			}
+			setConfigurableScopes(scopes);
+			return true;
+		}
+		case ConfigJournal::Operation::SetCurrentProfile: {
+			std::string token = record.token;
+			return setCurrentProfile(token);
+		}
+		case ConfigJournal::Operation::SetProfile:
+			return parse_datafile(record.value, [this] (struct soap *soap) {
+				auto *profile = soap_new_tt__MinimumProfile(soap);
+				return soap_read_tt__MinimumProfile(soap, profile) == SOAP_OK && setProfile(profile);
+			});
+		case ConfigJournal::Operation::DeleteProfile:
+			return deleteProfile(record.token);
+		case ConfigJournal::Operation::SetH265Configuration:
+			if (record.value.empty()) {
+				return setH265Configuration(record.token, nullptr);
+			}
+			return parse_datafile(record.value, [this, &record] (struct soap *soap) {
+				auto *h265 = soap_new_tt__H265Configuration(soap);
+				return soap_read_tt__H265Configuration(soap, h265) == SOAP_OK && setH265Configuration(record.token, h265);
+			});
+		case ConfigJournal::Operation::SetUser:
+			return parse_datafile(record.value, [this] (struct soap *soap) {
+				auto *user = soap_new_tt__User(soap);
+				if (soap_read_tt__User(soap, user) != SOAP_OK) {
+					return false;
+				}
+				setUser(user);
+				return true;
+			});
+		case ConfigJournal::Operation::DeleteUser:
+			return deleteUser(record.token);
+		case ConfigJournal::Operation::SetVideoEncoder: {
+			size_t end = record.value.find('\0');
+			if (end == std::string::npos) {
+				return false;
+			}
+			std::string h265_xml = record.value.substr(end + 1);
+			return parse_datafile(record.value.substr(0, end), [this, &h265_xml] (struct soap *soap) {
+				auto *vec = soap_new_tt__VideoEncoderConfiguration(soap);
+				if (soap_read_tt__VideoEncoderConfiguration(soap, vec) != SOAP_OK) {
+					return false;
+				}
+				if (h265_xml.empty()) {
+					return setVideoEncoder(vec, nullptr);
+				}
+				return parse_datafile(h265_xml, [this, vec] (struct soap *h265_soap) {
+					auto *h265 = soap_new_tt__H265Configuration(h265_soap);
+					return soap_read_tt__H265Configuration(h265_soap, h265) == SOAP_OK && setVideoEncoder(vec, h265);
+				});
+			});
+		}
+	}
+	return false;
 }
 	
 
@@ -100,36 +383,743 @@ void Camera::saveConfiguration(std::ostream &camera_config_output) {
 }
 
 
+void Camera::setConfigurableScopes(const std::vector<std::string> &scopes) {
+	if (scopes == config->DeviceManagementService->Scope) {
+		// Not worth a Hello.
+		return;
+	}
+	config->DeviceManagementService->Scope = scopes;
+	record(ConfigJournal::Operation::SetScopes, "", join_scopes(scopes));
+	++discovery_version;
+}
+
+
+void Camera::setUser(const tt__User *new_user) {
+	auto *user = new_user->soap_dup();
+	auto &users = config->DeviceManagementService->User;
+	auto user_it = std::find_if(users.begin(), users.end(),
+		[user] (tt__User *u) { return u->Username == user->Username; });
+	if (user_it != users.end() && user->Password == nullptr && (*user_it)->Password != nullptr) {
+		user->Password = new std::string(*(*user_it)->Password);
+	}
+	std::string user_xml = canonical_xml(user);
+	if (user_it == users.end()) {
+		users.push_back(user);
+	} else if (canonical_xml(*user_it) == user_xml) {
+		user->soap_del();
+		delete user;
+		return;
+	} else {
+		(*user_it)->soap_del();
+		delete *user_it;
+		*user_it = user;
+	}
+
+	record(ConfigJournal::Operation::SetUser, user->Username, user_xml);
+	updateAuthenticator();
+}
+
+
+bool Camera::deleteUser(const std::string &username) {
+	auto &users = config->DeviceManagementService->User;
+	auto user_it = std::find_if(users.begin(), users.end(),
+		[&username] (tt__User *user) { return user->Username == username; });
+	if (user_it == users.end()) {
+		return false;
+	}
+	(*user_it)->soap_del();
+	delete *user_it;
+	users.erase(user_it);
+
+	record(ConfigJournal::Operation::DeleteUser, username, "");
+	updateAuthenticator();
+	return true;
+}
+
+
+void Camera::updateAuthenticator() {
+	std::vector<Authenticator::User> users;
+	for (auto *user : config->DeviceManagementService->User) {
+		Authenticator::Level level;
+		switch (user->UserLevel) {
+			case tt__UserLevel::Administrator:
+				level = Authenticator::Level::Administrator;
+				break;
+			case tt__UserLevel::Operator:
+				level = Authenticator::Level::Operator;
+				break;
+			case tt__UserLevel::User:
+				level = Authenticator::Level::User;
+				break;
+			default:
+				// i.e. they can log in, but it's no better than not.
+				level = Authenticator::Level::Anonymous;
+				break;
+		}
+		users.push_back({user->Username, user->Password != nullptr ? *user->Password : "", level});
+	}
+	authenticator.setUsers(users);
+}
+
+
+bool Camera::setCurrentProfile(std::string &token) {
+	auto *profile = getMinimumProfile(token);
+	if (profile == nullptr || profile->VideoEncoderConfigurationToken == nullptr || profile->VideoSourceConfigurationToken == nullptr) {
+		return false;
+	}
+	if (token != config->MediaService->CurrentProfile) {
+		config->MediaService->CurrentProfile = token;
+		record(ConfigJournal::Operation::SetCurrentProfile, token, "");
+		if (rtsp_ready) {
+			reapplyMulticast();
+		}
+	}
+	return true;
+}
+
+
+void Camera::reapplyMulticast() {
+	// StartMulticastStreaming was for the old profile, so only AutoStart carries over;
+	// the policy's is about the viewers, so it does too, as long as there's a group.
+	bool was_multicasting = isMulticasting();
+	auto *multicast = getCurrentVideoEncoderConfiguration()->Multicast;
+	bool can_multicast = checkMulticast(config->MediaService->CurrentProfile).empty();
+	multicast_requested = can_multicast && multicast != nullptr && multicast->AutoStart;
+	multicast_only = can_multicast && multicast_only;
+	multicast_policy_warned = false;
+	if (was_multicasting || isMulticasting()) {
+		applyMulticast();
+	}
+}
+
+
+static bool same_token(const tt__ReferenceToken *a, const tt__ReferenceToken *b) {
+	return a == b || (a != nullptr && b != nullptr && *a == *b);
+}
+
+
+bool Camera::setProfile(const tt__MinimumProfile *new_profile) {
+	if ((new_profile->VideoEncoderConfigurationToken != nullptr && getVideoEncoderConfiguration(*new_profile->VideoEncoderConfigurationToken) == nullptr)
+			|| (new_profile->VideoSourceConfigurationToken != nullptr && getVideoSourceConfiguration(*new_profile->VideoSourceConfigurationToken) == nullptr)) {
+		return false;
+	}
+
+	auto &profiles = config->MediaService->Profile;
+	auto profile_it = std::find_if(profiles.begin(), profiles.end(),
+		[new_profile] (tt__MinimumProfile *p) { return p->ProfileToken == new_profile->ProfileToken; });
+	std::string new_profile_xml = canonical_xml(new_profile);
+	if (profile_it == profiles.end()) {
+		profiles.push_back(new_profile->soap_dup());
+	} else {
+		auto *existing_profile = *profile_it;
+		if (canonical_xml(existing_profile) == new_profile_xml) {
+			return true;
+		}
+		bool current = existing_profile->ProfileToken == config->MediaService->CurrentProfile;
+		if (current && (new_profile->VideoEncoderConfigurationToken == nullptr || new_profile->VideoSourceConfigurationToken == nullptr)) {
+			// It's what's being streamed.
+			return false;
+		}
+		bool vec_changed = !same_token(existing_profile->VideoEncoderConfigurationToken, new_profile->VideoEncoderConfigurationToken);
+		bool vsc_changed = !same_token(existing_profile->VideoSourceConfigurationToken, new_profile->VideoSourceConfigurationToken);
+		*profile_it = new_profile->soap_dup();
+		existing_profile->soap_del();
+		delete existing_profile;
+
+		if (rtsp_ready && current && vsc_changed) {
+			rtsp_server->setVideoSourceConfiguration(getCurrentVideoSourceConfiguration());
+		}
+		if (rtsp_ready && current && vec_changed) {
+			rtsp_server->setVideoEncoderConfiguration(getCurrentVideoEncoderConfiguration(), getEncodedH265(getCurrentVideoEncoderConfiguration()));
+			resetAdaptiveBitrate();
+		}
+		if (rtsp_ready && current && (vsc_changed || vec_changed)) {
+			publishStreamRestarted();
+		}
+	}
+
+	record(ConfigJournal::Operation::SetProfile, new_profile->ProfileToken, new_profile_xml);
+	return true;
+}
+
+
+bool Camera::deleteProfile(const std::string &token) {
+	auto &profiles = config->MediaService->Profile;
+	auto profile_it = std::find_if(profiles.begin(), profiles.end(),
+		[&token] (tt__MinimumProfile *p) { return p->ProfileToken == token; });
+	if (profile_it == profiles.end() || token == config->MediaService->CurrentProfile) {
+		return false;
+	}
+	(*profile_it)->soap_del();
+	delete *profile_it;
+	profiles.erase(profile_it);
+
+	record(ConfigJournal::Operation::DeleteProfile, token, "");
+	return true;
+}
+
+
+std::string Camera::checkEncoderBudget(const tt__VideoEncoderConfiguration *vec, const std::string &profile_token) {
+	// Every configuration that's in a profile, once.
+	std::set<std::string> in_profiles;
+	if (!profile_token.empty()) {
+		in_profiles.insert(vec->token);
+	}
+	for (auto *profile : config->MediaService->Profile) {
+		if (profile->ProfileToken != profile_token && profile->VideoEncoderConfigurationToken != nullptr) {
+			in_profiles.insert(*profile->VideoEncoderConfigurationToken);
+		}
+	}
+
+	std::vector<const tt__VideoEncoderConfiguration *> vecs;
+	for (auto &token : in_profiles) {
+		const tt__VideoEncoderConfiguration *in_use = token == vec->token ? vec : getVideoEncoderConfiguration(token);
+		if (in_use != nullptr) {
+			vecs.push_back(in_use);
+		}
+	}
+	return encoder_budget->admit(vecs);
+}
+
+
+bool Camera::updateFixedScopes() {
+	std::vector<std::string> scopes = {
+		"onvif://www.onvif.org/type/video_encoder",
+		"onvif://www.onvif.org/hardware/" + scope_encode(properties->DeviceManagementService->DeviceInformation->Model),
+	};
+	if (scopes == fixed_scopes) {
+		return false;
+	}
+	fixed_scopes = scopes;
+	return true;
+}
+
+
+void Camera::enableReload() {
+	// Whatever's only in the journal would look like it had been edited out.
+	saveConfiguration();
+	config_on_disk = config_sections(config);
+	reloadable = true;
+}
+
+
+void Camera::reload(const std::string &filename) {
+	if (filename == properties_filename) {
+		reloadProperties();
+	} else if (filename == config_filename) {
+		reloadConfiguration();
+	}
+}
+
+
+void Camera::reloadProperties() {
+	_tt__CameraProperties *on_disk = nullptr;
+	parse_datafile(read_file(properties_filename), [this, &on_disk] (struct soap *soap) {
+		auto *edited = soap_new__tt__CameraProperties(soap);
+		if (soap_read__tt__CameraProperties(soap, edited) != SOAP_OK) {
+			LOG_WARNING("Not reloading " << properties_filename << ": " << soap_fault_string(soap));
+			return false;
+		}
+		on_disk = edited->soap_dup();
+		return true;
+	}, SOAP_XML_STRICT);
+	if (on_disk == nullptr) {
+		return;
+	}
+
+	if (!deep_equal(on_disk->RTSPStream, properties->RTSPStream)) {
+		// The RTSP server was created from these.
+		LOG_WARNING("Restart to apply the RTSPStream changes in " << properties_filename);
+		std::swap(on_disk->RTSPStream, properties->RTSPStream);
+	}
+
+	auto serialise = [] (_tt__CameraProperties *p) {
+		return serialise_datafile([p] (struct soap *soap) { return soap_write__tt__CameraProperties(soap, p); });
+	};
+	if (serialise(on_disk) == serialise(properties)) {
+		on_disk->soap_del();
+		delete on_disk;
+		return;
+	}
+
+	// Nothing keeps pointers into these between requests, so they can just be replaced.
+	properties->soap_del();
+	delete properties;
+	properties = on_disk;
+	validator.reset(new ConfigValidator(properties));
+	encoder_budget.reset(new EncoderBudget(properties));
+	LOG_INFO("Reloaded " << properties_filename);
+	if (updateFixedScopes()) {
+		++discovery_version;
+	}
+}
+
+
+void Camera::reloadConfiguration() {
+	parse_datafile(read_file(config_filename), [this] (struct soap *soap) {
+		auto *on_disk = soap_new__tt__CameraConfiguration(soap);
+		if (soap_read__tt__CameraConfiguration(soap, on_disk) != SOAP_OK) {
+			LOG_WARNING("Not reloading " << config_filename << ": " << soap_fault_string(soap));
+			return false;
+		}
+		applyEditedConfiguration(on_disk);
+		return true;
+	}, SOAP_XML_STRICT);
+}
+
+
+void Camera::applyEditedConfiguration(_tt__CameraConfiguration *on_disk) {
+	auto sections = config_sections(on_disk);
+	std::set<std::string> edited;
+	for (auto &section : sections) {
+		auto before = config_on_disk.find(section.first);
+		if (before == config_on_disk.end() || before->second != section.second) {
+			edited.insert(section.first);
+		}
+	}
+	for (auto &section : config_on_disk) {
+		if (sections.count(section.first) == 0) {
+			edited.insert(section.first);
+		}
+	}
+	// Either way, it's what's there now (so a change we can't apply isn't retried until it's edited again).
+	config_on_disk = sections;
+	if (edited.empty()) {
+		// e.g. we wrote it.
+		return;
+	}
+
+	// Through the same setters as the ONVIF requests, so the RTSP server only hears about what's changed.
+	// The profiles go first, as they decide what the RTSP server is currently using.
+	std::set<std::string> applied, refused;
+	auto apply = [&edited, &applied, &refused, this] (const std::string &section, const std::string &invalid, const std::function<bool ()> &set) {
+		if (edited.count(section) == 0) {
+			return;
+		}
+		if (!invalid.empty()) {
+			LOG_WARNING("Not applying the change to " << section << " in " << config_filename << ": " << invalid);
+			refused.insert(section);
+		} else if (set()) {
+			applied.insert(section);
+		}
+	};
+	for (auto *profile : on_disk->MediaService->Profile) {
+		auto *vec = profile->VideoEncoderConfigurationToken ? getVideoEncoderConfiguration(*profile->VideoEncoderConfigurationToken) : nullptr;
+		apply("Profile " + profile->ProfileToken, vec ? checkEncoderBudget(vec, profile->ProfileToken) : "",
+			[this, profile] { return setProfile(profile); });
+	}
+	apply("CurrentProfile", "", [this, on_disk] { return setCurrentProfile(on_disk->MediaService->CurrentProfile); });
+	// Now that the one being streamed might be another.
+	for (auto &section : edited) {
+		const std::string prefix = "Profile ";
+		if (section.compare(0, prefix.size(), prefix) == 0 && sections.count(section) == 0) {
+			std::string token = section.substr(prefix.size());
+			apply(section, "", [this, token] { return deleteProfile(token); });
+		}
+	}
+	for (auto *vsc : on_disk->MediaService->VideoSourceConfiguration) {
+		apply("VideoSourceConfiguration " + vsc->token, validator->check(vsc, getVideoSourceConfiguration(vsc->token)),
+			[this, vsc] { return setVideoSourceConfiguration(vsc); });
+	}
+	for (auto *vec : on_disk->MediaService->VideoEncoderConfiguration) {
+		std::string invalid = validator->check(vec, getVideoEncoderConfiguration(vec->token));
+		apply("VideoEncoderConfiguration " + vec->token, invalid.empty() ? checkEncoderBudget(vec) : invalid,
+			[this, vec] { return setVideoEncoderConfiguration(vec); });
+	}
+	for (auto *h265 : on_disk->MediaService->H265Configuration) {
+		apply("H265Configuration " + h265->token, validator->check(h265, getH265Configuration(h265->token)),
+			[this, h265] { return setH265Configuration(h265->token, h265); });
+	}
+	for (auto &section : edited) {
+		const std::string prefix = "H265Configuration ";
+		if (section.compare(0, prefix.size(), prefix) == 0 && sections.count(section) == 0) {
+			std::string token = section.substr(prefix.size());
+			apply(section, "", [this, token] { return setH265Configuration(token, nullptr); });
+		}
+	}
+	for (auto *ivs : on_disk->ImagingService->ImagingVideoSource) {
+		apply("ImagingSettings " + ivs->VideoSourceToken,
+			validator->check(ivs->VideoSourceToken, ivs->ImagingSettings, getImagingSettings(ivs->VideoSourceToken)),
+			[this, ivs] { return setImagingSettings(ivs->VideoSourceToken, ivs->ImagingSettings); });
+	}
+	apply("Scopes", "", [this, on_disk] {
+		setConfigurableScopes(on_disk->DeviceManagementService ? on_disk->DeviceManagementService->Scope : std::vector<std::string>());
+		return true;
+	});
+	if (on_disk->DeviceManagementService != nullptr) {
+		for (auto *user : on_disk->DeviceManagementService->User) {
+			apply("User " + user->Username, "", [this, user] {
+				setUser(user);
+				return true;
+			});
+		}
+	}
+	for (auto &section : edited) {
+		const std::string prefix = "User ";
+		if (section.compare(0, prefix.size(), prefix) == 0 && sections.count(section) == 0) {
+			std::string username = section.substr(prefix.size());
+			apply(section, "", [this, username] { return deleteUser(username); });
+		}
+	}
+
+	LOG_INFO("Applied " << applied.size() << " change(s) from " << config_filename);
+	for (auto &section : edited) {
+		if (applied.count(section) == 0 && refused.count(section) == 0) {
+			// i.e. a configuration added or removed.
+			LOG_WARNING("Restart to apply the change to " << section << " in " << config_filename);
+		}
+	}
+}
+
+
+void Camera::setAddress(const std::string &ip, const std::string &onvif_url) {
+	this->ip = ip;
+	this->onvif_url = onvif_url;
+	++discovery_version;
+}
+
+
 std::string Camera::getStreamUri() {
 	return "rtsp://" + ip + ":" + properties->RTSPStream->Port + "/" + properties->RTSPStream->Path;
 }
 
 
-void Camera::initialiseRtspServer() {
-	rtsp_server->initialise(getCurrentVideoEncoderConfiguration(), getCurrentImagingSettings(), getCurrentVideoSourceConfiguration());
+bool Camera::initialiseRtspServer() {
+	try {
+		rtsp_server->initialise(getCurrentVideoEncoderConfiguration(), getEncodedH265(getCurrentVideoEncoderConfiguration()),
+		                        getCurrentImagingSettings(), getCurrentVideoSourceConfiguration());
+	} catch (std::runtime_error &e) {
+		LOG_WARNING("Unable to initialise RTSP server: " << e.what());
+		return false;
+	}
+	rtsp_ready = true;
+	resetAdaptiveBitrate();
+	publishStreamRestarted();
+	last_watched = std::chrono::steady_clock::now();
+
+	auto *multicast = getCurrentVideoEncoderConfiguration()->Multicast;
+	if (multicast != nullptr && multicast->AutoStart && checkMulticast(config->MediaService->CurrentProfile).empty()) {
+		multicast_requested = true;
+	}
+	if (isMulticasting()) {
+		// The stream's up regardless.
+		applyMulticast();
+	}
+	return true;
+}
+
+
+std::string Camera::checkMulticast(std::string &profile_token) {
+	auto *profile = getMinimumProfile(profile_token);
+	if (profile == nullptr) {
+		return "No such profile: " + profile_token;
+	}
+	if (!supportsMulticast()) {
+		return "The RTSP server doesn't support multicast";
+	}
+	if (profile_token != config->MediaService->CurrentProfile) {
+		return "Only the profile being streamed can be multicast";
+	}
+	auto *multicast = getCurrentVideoEncoderConfiguration()->Multicast;
+	struct in_addr group;
+	if (multicast == nullptr || multicast->Address == nullptr || multicast->Address->IPv4Address == nullptr
+			|| inet_pton(AF_INET, multicast->Address->IPv4Address->c_str(), &group) != 1 || !IN_MULTICAST(ntohl(group.s_addr))) {
+		return "The video encoder configuration has no IPv4 multicast group";
+	}
+	if (multicast->Port <= 0 || multicast->Port > 65534) {
+		return "The video encoder configuration has no multicast port";
+	}
+	return "";
+}
+
+
+bool Camera::applyMulticast() {
+	try {
+		rtsp_server->setMulticast(isMulticasting() ? getCurrentVideoEncoderConfiguration()->Multicast : nullptr, multicast_only);
+	} catch (std::runtime_error &e) {
+		LOG_WARNING("Unable to " << (isMulticasting() ? "start" : "stop") << " multicast: " << e.what());
+		return false;
+	}
+	return true;
+}
+
+
+bool Camera::startMulticastStreaming(std::string &profile_token) {
+	if (!checkMulticast(profile_token).empty()) {
+		return false;
+	}
+	bool was_multicasting = isMulticasting();
+	multicast_requested = true;
+	if (rtsp_ready && !was_multicasting && !applyMulticast()) {
+		multicast_requested = false;
+		return false;
+	}
+	return true;
+}
+
+
+bool Camera::stopMulticastStreaming(std::string &profile_token) {
+	if (getMinimumProfile(profile_token) == nullptr) {
+		return false;
+	}
+	if (!isMulticasting()) {
+		return true;
+	}
+	// Including the policy's, until there are enough viewers again.
+	multicast_requested = multicast_only = false;
+	return !rtsp_ready || applyMulticast();
+}
+
+
+void Camera::applyMulticastPolicy(const RtspServer::Readers &readers) {
+	int threshold = *properties->RTSPStream->MulticastAboveViewers;
+	if (!multicast_only && readers.unicast > threshold) {
+		std::string reason = checkMulticast(config->MediaService->CurrentProfile);
+		if (!reason.empty()) {
+			if (!multicast_policy_warned) {
+				LOG_WARNING("Not switching to multicast for " << readers.unicast << " viewers: " << reason);
+				multicast_policy_warned = true;
+			}
+			return;
+		}
+		LOG_INFO("Switching to multicast only, as there are " << readers.unicast << " unicast viewers");
+		multicast_only = true;
+		if (!applyMulticast()) {
+			multicast_only = false;
+		}
+	} else if (multicast_only && readers.unicast + readers.multicast == 0) {
+		LOG_INFO("Allowing unicast again, as nobody is watching");
+		multicast_only = false;
+		multicast_policy_warned = false;
+		applyMulticast();
+	}
+}
+
+
+bool Camera::applyIdlePolicy(const RtspServer::Readers &readers) {
+	auto now = std::chrono::steady_clock::now();
+	if (readers.unicast + readers.multicast > 0) {
+		last_watched = now;
+		bool was_idle = encoder_idle;
+		encoder_idle = false;
+		if (rtsp_server->resumesItself()) {
+			// It's started the encoder for this viewer already (or is starting it).
+			if (was_idle) {
+				LOG_INFO("The RTSP server resumed the encoder for " << readers.unicast + readers.multicast << " viewers");
+			}
+			return was_idle;
+		}
+		if (rtsp_server->resume()) {
+			LOG_INFO("Resumed the encoder for " << readers.unicast + readers.multicast << " viewers");
+			return true;
+		}
+		return false;
+	}
+
+	if (idle_unsupported || now - last_watched < std::chrono::seconds(*properties->RTSPStream->SuspendAfterIdle)) {
+		return false;
+	}
+	// Every time, as the RTSP server may have been restarted (which resumes it) since.
+	if (!rtsp_server->suspend()) {
+		LOG_WARNING("Not suspending the encoder, as the RTSP server can't");
+		idle_unsupported = true;
+	} else if (!encoder_idle) {
+		LOG_INFO("Suspended the encoder, as nobody has watched for " << *properties->RTSPStream->SuspendAfterIdle << "s");
+		encoder_idle = true;
+	}
+	return false;
+}
+
+
+bool Camera::monitorStream(const RtspServer::Readers &readers) {
+	if (!rtsp_ready) {
+		return false;
+	}
+	if (hasMulticastPolicy()) {
+		applyMulticastPolicy(readers);
+	}
+	return hasIdlePolicy() && applyIdlePolicy(readers);
+}
+
+
+void Camera::resetAdaptiveBitrate() {
+	if (bitrate_controller != nullptr) {
+		bitrate_controller->reset(configured_bitrate(getCurrentVideoEncoderConfiguration()));
+		bitrate_sampled = false;
+	}
+}
+
+
+void Camera::adaptBitrate() {
+	if (!rtsp_ready || bitrate_controller == nullptr || configured_bitrate(getCurrentVideoEncoderConfiguration()) == 0) {
+		return;
+	}
+	uint64_t sent_bytes;
+	if (!throughput_source->getSentBytes(&sent_bytes)) {
+		bitrate_sampled = false;
+		return;
+	}
+	auto now = std::chrono::steady_clock::now();
+	double seconds = std::chrono::duration<double>(now - last_sample).count();
+	bool first = !bitrate_sampled || sent_bytes < last_sent_bytes || seconds <= 0;
+	uint64_t sent = sent_bytes - last_sent_bytes;
+	last_sent_bytes = sent_bytes;
+	last_sample = now;
+	bitrate_sampled = true;
+	if (first) {
+		// Or the counter was reset (e.g. the interface went down).
+		return;
+	}
+
+	// Every unicast viewer gets their own copy, and the multicast group one between them.
+	int streams = 1;
+	RtspServer::Readers readers;
+	if (rtsp_server->getReaders(&readers)) {
+		streams = readers.unicast + (readers.multicast > 0 ? 1 : 0);
+		if (streams == 0) {
+			// Nothing's being sent, so there's nothing to learn.
+			return;
+		}
+	}
+
+	int previous = bitrate_controller->getTarget();
+	int target = bitrate_controller->update(sent * 8 / 1000.0 / seconds / streams);
+	if (target == previous) {
+		return;
+	}
+	if (!rtsp_server->setBitrate(target)) {
+		// So the controller doesn't think the stream's at target, and tries again next time.
+		if (!bitrate_failed) {
+			LOG_WARNING("Unable to adapt the bitrate to " << target << "kbit/s; will keep trying");
+			bitrate_failed = true;
+		}
+		bitrate_controller->undo();
+		return;
+	}
+	bitrate_failed = false;
+	LOG_INFO("Adapted the bitrate to " << target << "kbit/s");
+}
+
+
+void Camera::stop() {
+	events.stop();
+	saveConfiguration();
+	rtsp_server->stop();
 }
 
 
 bool Camera::setVideoEncoderConfiguration(const tt__VideoEncoderConfiguration *new_vec) {
+	if (getVideoEncoderConfiguration(new_vec->token) == nullptr) {
+		return false;
+	}
+	std::string new_vec_xml;
+	if (replaceVideoEncoderConfiguration(new_vec, &new_vec_xml)) {
+		record(ConfigJournal::Operation::SetVideoEncoderConfiguration, new_vec->token, new_vec_xml);
+		restartEncoder(new_vec, true);
+	}
+	return true;
+}
+
+
+const tt__H265Configuration *Camera::getEncodedH265(const tt__VideoEncoderConfiguration *vec) {
+	return vec->Encoding == tt__VideoEncoding::H264 ? getH265Configuration(vec->token) : nullptr;
+}
+
+
+bool Camera::setH265Configuration(const std::string &vec_token, const tt__H265Configuration *new_h265) {
+	if (getVideoEncoderConfiguration(vec_token) == nullptr || (new_h265 != nullptr && !rtsp_server->supportsH265())) {
+		return false;
+	}
+	std::string new_h265_xml;
+	if (replaceH265Configuration(vec_token, new_h265, &new_h265_xml)) {
+		record(ConfigJournal::Operation::SetH265Configuration, vec_token, new_h265_xml);
+		restartEncoder(getVideoEncoderConfiguration(vec_token), false);
+	}
+	return true;
+}
+
+
+bool Camera::setVideoEncoder(const tt__VideoEncoderConfiguration *new_vec, const tt__H265Configuration *new_h265) {
+	// Checked up front, so it's all or nothing.
+	if (getVideoEncoderConfiguration(new_vec->token) == nullptr || (new_h265 != nullptr && !rtsp_server->supportsH265())) {
+		return false;
+	}
+	std::string new_vec_xml, new_h265_xml;
+	bool vec_changed = replaceVideoEncoderConfiguration(new_vec, &new_vec_xml);
+	bool h265_changed = replaceH265Configuration(new_vec->token, new_h265, &new_h265_xml);
+	if (vec_changed || h265_changed) {
+		record(ConfigJournal::Operation::SetVideoEncoder, new_vec->token, new_vec_xml + '\0' + new_h265_xml);
+		restartEncoder(new_vec, vec_changed);
+	}
+	return true;
+}
+
+
+bool Camera::replaceVideoEncoderConfiguration(const tt__VideoEncoderConfiguration *new_vec, std::string *new_vec_xml) {
 	auto &vecs = config->MediaService->VideoEncoderConfiguration;
 	auto vecs_it = std::find_if(vecs.begin(), vecs.end(),
 		[new_vec] (tt__VideoEncoderConfiguration *vec) { return vec->token == new_vec->token; });
-	if (vecs_it == vecs.end()) {
+	// Many clients send everything back whenever anything changes; don't restart the stream for that.
+	*new_vec_xml = canonical_xml(new_vec);
+	if (canonical_xml(*vecs_it) == *new_vec_xml) {
 		return false;
 	}
 	(*vecs_it)->soap_del();
 	delete *vecs_it;
 	*vecs_it = new_vec->soap_dup();
+	return true;
+}
 
-	saveConfiguration();
 
-	if (new_vec->token == *(getCurrentMinimumProfile()->VideoEncoderConfigurationToken)) {
-		rtsp_server->setVideoEncoderConfiguration(new_vec);
+bool Camera::replaceH265Configuration(const std::string &vec_token, const tt__H265Configuration *new_h265, std::string *new_h265_xml) {
+	auto &h265s = config->MediaService->H265Configuration;
+	auto h265_it = std::find_if(h265s.begin(), h265s.end(),
+		[&vec_token] (tt__H265Configuration *h265) { return h265->token == vec_token; });
+	new_h265_xml->clear();
+	if (new_h265 != nullptr) {
+		auto *h265 = new_h265->soap_dup();
+		h265->token = vec_token;
+		*new_h265_xml = canonical_xml(h265);
+		h265->soap_del();
+		delete h265;
+	}
+	if ((h265_it == h265s.end() ? "" : canonical_xml(*h265_it)) == *new_h265_xml) {
+		return false;
+	}
+	if (h265_it != h265s.end()) {
+		(*h265_it)->soap_del();
+		delete *h265_it;
+		h265s.erase(h265_it);
+	}
+	if (new_h265 != nullptr) {
+		h265s.push_back(new_h265->soap_dup());
+		h265s.back()->token = vec_token;
 	}
 	return true;
 }
 
 
+void Camera::restartEncoder(const tt__VideoEncoderConfiguration *vec, bool vec_changed) {
+	if (!rtsp_ready || vec->token != *(getCurrentMinimumProfile()->VideoEncoderConfigurationToken)) {
+		return;
+	}
+	// Only H264 ones are encoded as H.265, so nothing else notices a change to that alone.
+	if (!vec_changed && vec->Encoding != tt__VideoEncoding::H264) {
+		return;
+	}
+	rtsp_server->setVideoEncoderConfiguration(vec, getEncodedH265(vec));
+	resetAdaptiveBitrate();
+	publishStreamRestarted();
+	if (vec_changed && isMulticasting()) {
+		// The group may have changed, or gone.
+		if (!checkMulticast(config->MediaService->CurrentProfile).empty()) {
+			multicast_requested = multicast_only = false;
+		}
+		applyMulticast();
+	}
+}
+
+
 bool Camera::setImagingSettings(const std::string &vs_token, const tt__ImagingSettings20 *new_imaging_settings) {
 	auto &sources = config->ImagingService->ImagingVideoSource;
 	auto sources_it = std::find_if(sources.begin(), sources.end(),
@@ -137,15 +1127,20 @@ bool Camera::setImagingSettings(const std::string &vs_token, const tt__ImagingSe
 	if (sources_it == sources.end()) {
 		return false;
 	}
+	// e.g. every slider release sends all of them.
+	std::string new_imaging_settings_xml = canonical_xml(new_imaging_settings);
+	if (canonical_xml((*sources_it)->ImagingSettings) == new_imaging_settings_xml) {
+		return true;
+	}
 	(*sources_it)->ImagingSettings->soap_del();
 	delete (*sources_it)->ImagingSettings;
 	(*sources_it)->ImagingSettings = new_imaging_settings->soap_dup();
 
-	saveConfiguration();
+	record(ConfigJournal::Operation::SetImagingSettings, vs_token, new_imaging_settings_xml);
 
 	getVideoSourceConfiguration(*(getCurrentMinimumProfile()->VideoSourceConfigurationToken));
 
-	if (vs_token == getCurrentVideoSourceConfiguration()->SourceToken) {
+	if (rtsp_ready && vs_token == getCurrentVideoSourceConfiguration()->SourceToken) {
 		rtsp_server->setImagingSettings(new_imaging_settings);
 	}
 	return true;
@@ -170,7 +1165,11 @@ bool Camera::setVideoSourceConfiguration(const tt__VideoSourceConfiguration *new
 		return false;
 	}
 
-	// We copy only the mutable fields across to the existing object.
+	// We copy only the mutable fields across to the existing object (so only they can make it a change).
+	if (existing_vsc->Name == new_vsc->Name && deep_equal(existing_vsc->Bounds, new_vsc->Bounds)
+			&& deep_equal(existing_vsc->Extension, new_vsc->Extension)) {
+		return true;
+	}
 
 	existing_vsc->Name = new_vsc->Name;
 	existing_vsc->Bounds->soap_del();
@@ -180,15 +1179,17 @@ bool Camera::setVideoSourceConfiguration(const tt__VideoSourceConfiguration *new
 	if (existing_vsc->Extension != nullptr) {
 		existing_vsc->Extension->soap_del();
 		delete existing_vsc->Extension;
+		existing_vsc->Extension = nullptr;
 	}
 	if (new_vsc->Extension) {
 		existing_vsc->Extension = new_vsc->Extension->soap_dup();
 	}
 
-	saveConfiguration();
+	record(ConfigJournal::Operation::SetVideoSourceConfiguration, new_vsc->token, canonical_xml(new_vsc));
 
-	if (new_vsc->token == getCurrentVideoSourceConfiguration()->token) {
+	if (rtsp_ready && new_vsc->token == getCurrentVideoSourceConfiguration()->token) {
 		rtsp_server->setVideoSourceConfiguration(new_vsc);
+		publishStreamRestarted();
 	}
 
 	return true;
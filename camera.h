@@ -7,12 +7,25 @@
 
 #include "soaplib/soapH.h"
 
+#include "authenticator.h"
+#include "bitratecontroller.h"
+#include "configjournal.h"
+#include "configvalidator.h"
+#include "encoderbudget.h"
+#include "eventbroker.h"
+#include "netstate.h"
 #include "rtspserver.h"
 #include "rtspserver_process.h"
 #include "rtspserver_mediamtxrpi.h"
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <cassert>
 
 
@@ -22,30 +35,264 @@ class Camera {
 		std::string ip;
 		_tt__CameraProperties *properties;
 		_tt__CameraConfiguration *config;
+		std::unique_ptr<ConfigValidator> validator;  // From the properties.
+		std::unique_ptr<EncoderBudget> encoder_budget;  // Likewise.
+		std::string properties_filename;
 		std::string config_filename;
 		RtspServer *rtsp_server;
+		std::mutex mutex;
+		std::vector<std::string> fixed_scopes;
+		std::atomic<unsigned int> discovery_version;
+		const NetworkState *network_state;
+		// Until this is set, changes are only saved (initialise picks them up).
+		// Atomic for getReaders, which is called without the lock.
+		std::atomic<bool> rtsp_ready;
+		// By StartMulticastStreaming (or AutoStart), and by the policy (see monitorStream) respectively.
+		bool multicast_requested;
+		bool multicast_only;
+		bool multicast_policy_warned;
+		// From <AdaptiveBitrate> (null without, or if the RTSP server can't change the bitrate),
+		// and when it was last sampled.
+		std::unique_ptr<ThroughputSource> throughput_source;
+		std::unique_ptr<BitrateController> bitrate_controller;
+		uint64_t last_sent_bytes;
+		std::chrono::steady_clock::time_point last_sample;
+		bool bitrate_sampled;
+		bool bitrate_failed;  // Since it last worked, so we only warn once.
+		// For <SuspendAfterIdle>.
+		std::chrono::steady_clock::time_point last_watched;
+		bool encoder_idle;
+		bool idle_unsupported;
+		// Null for the dummy server (which never saves), and while we replay it.
+		std::unique_ptr<ConfigJournal> journal;
+		std::thread compaction_thread;
+		// Every change that's recorded, and every stream restart, for the Events service (events.cpp).
+		EventBroker events;
+		// From the config's users.
+		Authenticator authenticator;
+
+		std::string serialiseConfiguration();
+		void record(ConfigJournal::Operation operation, const std::string &token, const std::string &value);
+		void publishChange(ConfigJournal::Operation operation, const std::string &token);
+		// Whenever the RTSP server's been sent a changed encoder or source configuration (or started).
+		void publishStreamRestarted();
+		void compactInBackground();
+		bool replay(const ConfigJournal::Record &record);
+		// What config_filename last had in it (see config_sections), while reloadable.
+		bool reloadable;
+		std::map<std::string, uint64_t> config_on_disk;
+
+		bool updateFixedScopes();
+		void updateAuthenticator();
+		void reloadProperties();
+		void reloadConfiguration();
+		void applyEditedConfiguration(_tt__CameraConfiguration *on_disk);
+		bool applyMulticast();
+		// After the current profile changes: its group (if it has one) is the one to use now.
+		void reapplyMulticast();
+		void applyMulticastPolicy(const RtspServer::Readers &readers);
+		bool applyIdlePolicy(const RtspServer::Readers &readers);
+		// Whenever the RTSP server's sent the whole encoder configuration again.
+		void resetAdaptiveBitrate();
+		// What the RTSP server encodes vec as H.265 with (null if it's H.264).
+		const tt__H265Configuration *getEncodedH265(const tt__VideoEncoderConfiguration *vec);
+		// Each returns whether it changed anything, with the new XML (empty for no H.265) to record.
+		// The configuration has to exist already.
+		bool replaceVideoEncoderConfiguration(const tt__VideoEncoderConfiguration *new_vec, std::string *new_vec_xml);
+		bool replaceH265Configuration(const std::string &vec_token, const tt__H265Configuration *new_h265, std::string *new_h265_xml);
+		// Tells the RTSP server about vec's changes, if it's the one being streamed.
+		void restartEncoder(const tt__VideoEncoderConfiguration *vec, bool vec_changed);
 
 	public:
+		// Changes are appended to config_filename + ".journal" (see configjournal.h), and
+		// config_filename is only rewritten (in the background) once that's grown.
 		explicit Camera(std::string onvif_url, std::string ip, std::string properties_filename, std::string config_filename, RtspServer *rtsp_server=nullptr);
 		~Camera();
 
-		void initialiseRtspServer();
+		// Returns false (having logged why) if the RTSP server isn't available yet,
+		// e.g. MediaMTX's API isn't up; just try again later.
+		bool initialiseRtspServer();
 
+		bool isRtspReady() {
+			return rtsp_ready;
+		}
+
+		// Why the profile can't be multicast (e.g. its encoder configuration has no group), or "" if it can.
+		// Only the current profile can be, as that's the one the RTSP server streams.
+		std::string checkMulticast(std::string &profile_token);
+
+		bool startMulticastStreaming(std::string &profile_token);
+		bool stopMulticastStreaming(std::string &profile_token);
+
+		bool supportsMulticast() {
+			return rtsp_server->supportsMulticast();
+		}
+
+		bool supportsH265() {
+			return rtsp_server->supportsH265();
+		}
+
+		bool isMulticasting() {
+			return multicast_requested || multicast_only;
+		}
+
+		// With <MulticastAboveViewers> or <SuspendAfterIdle>, monitorStream should be called
+		// every so often (see StreamMonitor).
+		bool hasMulticastPolicy() {
+			return properties->RTSPStream->MulticastAboveViewers != nullptr;
+		}
+
+		bool hasIdlePolicy() {
+			return properties->RTSPStream->SuspendAfterIdle != nullptr;
+		}
+
+		// Whether a new viewer waits for monitorStream to resume the encoder, so it should
+		// be called often, rather than the RTSP server resuming it by itself.
+		bool needsPromptMonitoring() {
+			return hasIdlePolicy() && !rtsp_server->resumesItself();
+		}
+
+		// For monitorStream. Doesn't need the lock (asking the RTSP server can be slow),
+		// and is false until the RTSP server's initialised.
+		bool getReaders(RtspServer::Readers *readers) {
+			return rtsp_ready && rtsp_server->getReaders(readers);
+		}
+
+		// Switches the stream to multicast only once there are more unicast viewers than the
+		// policy allows, and back again once nobody is watching. Suspends the encoder once
+		// nobody has watched for a while, returning true when it resumes (or the RTSP server
+		// resumed it) for a new viewer.
+		bool monitorStream(const RtspServer::Readers &readers);
+
+		// With <AdaptiveBitrate>, adaptBitrate should be called every getAdaptiveBitrateInterval ms.
+		bool hasAdaptiveBitrate() {
+			return bitrate_controller != nullptr;
+		}
+
+		int getAdaptiveBitrateInterval() {
+			auto *interval = properties->RTSPStream->AdaptiveBitrate->Interval;
+			return interval != nullptr ? *interval : 2000;
+		}
+
+		// Samples the link, and changes the stream's bitrate (but not the configured BitrateLimit)
+		// if the controller (see bitratecontroller.h) decides it should.
+		void adaptBitrate();
+
+		// On the way out: completes any parked PullMessages, writes the config one last time
+		// and stops the RTSP server.
+		void stop();
+
+		// Writes everything to config_filename now (and empties the journal).
 		void saveConfiguration();
 		void saveConfiguration(std::ostream &camera_config_output);
 
+		// From then on, reload picks up edits to the data files. Brings config_filename up to date
+		// first, as edits are compared with what was in it before.
+		void enableReload();
+
+		// Applies what's changed in filename (the properties or config) through the usual setters,
+		// so that the RTSP server only restarts what it has to. Changes that can't be made
+		// at runtime (e.g. to RTSPStream, or adding a configuration) are logged as needing a restart.
+		void reload(const std::string &filename);
+
 		std::string getStreamUri();
 
+		EventBroker &getEventBroker() {
+			return events;
+		}
+
+		// Held by anything that touches the camera from another thread
+		// (e.g. each ONVIF listener while it dispatches a request).
+		std::mutex &getMutex() {
+			return mutex;
+		}
+
 		// Simple accessors.
 
 		std::string getOnvifURL() {
 			return this->onvif_url;
 		}
 
+		std::string getIP() {
+			return this->ip;
+		}
+
+		// When the host's address changes (e.g. a DHCP renewal) so that we're reachable
+		// somewhere else. Re-announced via WS-Discovery.
+		void setAddress(const std::string &ip, const std::string &onvif_url);
+
+		// Where the network configuration we report comes from (null if unavailable).
+		void setNetworkState(const NetworkState *network_state) {
+			this->network_state = network_state;
+		}
+
+		const NetworkState *getNetworkState() {
+			return network_state;
+		}
+
+		// What Sets are checked against before they're applied (the setters themselves don't).
+		const ConfigValidator &getValidator() {
+			return *validator;
+		}
+
+		const EncoderBudget &getEncoderBudget() {
+			return *encoder_budget;
+		}
+
+		// Why the budget wouldn't allow vec (replacing the config with its token, and if profile_token
+		// is given, in that profile too), or "" if it would. Like the validator, the setters don't check.
+		std::string checkEncoderBudget(const tt__VideoEncoderConfiguration *vec, const std::string &profile_token = "");
+
 		tt__DeviceInformation *getDeviceInformation() {
 			return properties->DeviceManagementService->DeviceInformation;
 		}
 
+		// Bumped whenever anything we advertise via WS-Discovery changes
+		// (so it doubles as the MetadataVersion). Doesn't need the lock.
+		unsigned int getDiscoveryVersion() {
+			return discovery_version;
+		}
+
+		// Derived from the properties, so clients can't change them.
+		const std::vector<std::string> &getFixedScopes() {
+			return fixed_scopes;
+		}
+
+		const std::vector<std::string> &getConfigurableScopes() {
+			return config->DeviceManagementService->Scope;
+		}
+
+		std::vector<std::string> getScopes() {
+			std::vector<std::string> scopes = fixed_scopes;
+			scopes.insert(scopes.end(), getConfigurableScopes().begin(), getConfigurableScopes().end());
+			return scopes;
+		}
+
+		void setConfigurableScopes(const std::vector<std::string> &scopes);
+
+		// Checks each request (see server.cpp). Kept up to date with the users.
+		Authenticator &getAuthenticator() {
+			return authenticator;
+		}
+
+		// With their passwords, which is what WS-UsernameToken needs to check against.
+		const std::vector<tt__User *> &getUsers() {
+			return config->DeviceManagementService->User;
+		}
+
+		tt__User *getUser(const std::string &username) {
+			auto &users = config->DeviceManagementService->User;
+			auto user_it = std::find_if(users.begin(), users.end(),
+				[&username] (tt__User *user) { return user->Username == username; });
+			return user_it == users.end() ? nullptr : *user_it;
+		}
+
+		// Creates or replaces the user with user's Username (keeping their password if user has none).
+		// Like the other setters, it doesn't check the level or lengths.
+		void setUser(const tt__User *user);
+
+		bool deleteUser(const std::string &username);
+
 		tt__HTMLWebServer *getHTMLWebServerSettings() {
 			return properties->HTMLWebServer;
 		}
@@ -67,14 +314,15 @@ class Camera {
 			return mp;
 		}
 
-		bool setCurrentProfile(std::string &token) {
-			auto *mp = getMinimumProfile(token);
-			if (mp != nullptr) {
-				config->MediaService->CurrentProfile = token;
-			}
+		// Only to a profile with both configurations (i.e. something to stream).
+		bool setCurrentProfile(std::string &token);
 
-			return mp != nullptr;
-		}
+		// Creates or replaces the profile with profile's token. Its configurations have to exist,
+		// and the current profile can't lose either of them.
+		bool setProfile(const tt__MinimumProfile *profile);
+
+		// Any but the current profile.
+		bool deleteProfile(const std::string &token);
 
 		const std::vector<tt__VideoEncoderConfiguration *> getVideoEncoderConfigurations() {
 			return config->MediaService->VideoEncoderConfiguration;
@@ -89,6 +337,22 @@ class Camera {
 
 		bool setVideoEncoderConfiguration(const tt__VideoEncoderConfiguration *new_vec);
 
+		// Media1 can't express H.265, so an H264 configuration is encoded as H.265 instead
+		// while it has one of these (with the same token).
+		tt__H265Configuration *getH265Configuration(const std::string &vec_token) {
+			auto &h265s = config->MediaService->H265Configuration;
+			auto h265_it = std::find_if(h265s.begin(), h265s.end(),
+				[vec_token] (tt__H265Configuration *h265) { return h265->token == vec_token; });
+			return h265_it == h265s.end() ? nullptr : *h265_it;
+		}
+
+		// Back to H.264 if h265 is null. Not if the RTSP server can't encode H.265.
+		bool setH265Configuration(const std::string &vec_token, const tt__H265Configuration *h265);
+
+		// Both at once (h265 as for setH265Configuration), as Media2 sees them as one
+		// configuration: one journal record and one restart, and nothing changed if it fails.
+		bool setVideoEncoder(const tt__VideoEncoderConfiguration *new_vec, const tt__H265Configuration *h265);
+
 		const tt__VideoEncoderConfiguration *getCurrentVideoEncoderConfiguration() {
 			auto *vec = getVideoEncoderConfiguration(*(getCurrentMinimumProfile()->VideoEncoderConfigurationToken));
 			assert(vec != nullptr);
@@ -99,6 +363,11 @@ class Camera {
 			return properties->MediaService->VideoEncoderConfigurationOptions;
 		}
 
+		// Empty if the encoder can't do H.265 (see getH265Configuration).
+		const std::vector<tt__VideoEncodingProfiles> &getH265ProfilesSupported() {
+			return properties->MediaService->H265ProfilesSupported;
+		}
+
 		std::vector<tt__VideoSource *> getVideoSources() {
 			return properties->MediaService->VideoSource;
 		}
@@ -0,0 +1,197 @@
+// Copyright 2023 Morse Micro
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <iterator>
+
+#include "configjournal.h"
+#include "log.h"
+
+
+namespace {
+	struct RecordHeader {
+		uint32_t length;  // Of the payload: operation, token, NUL, value.
+		uint32_t checksum;  // Of the payload.
+	};
+}
+
+
+// FNV-1a: this is only about torn writes, not tampering.
+static uint32_t checksum(const char *data, size_t length) {
+	uint32_t hash = 0x811c9dc5;
+	for (size_t i = 0; i < length; ++i) {
+		hash = (hash ^ static_cast<unsigned char>(data[i])) * 0x01000193;
+	}
+	return hash;
+}
+
+
+static std::string read_file(const std::string &path, bool *exists) {
+	std::ifstream in(path, std::ios::binary);
+	*exists = in.is_open();
+	return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+
+ConfigJournal::ConfigJournal(const std::string &path)
+		: path(path), compacting_path(path + ".compacting"), fd(-1), size(0), compacting(false) {
+	openLive();
+}
+
+
+ConfigJournal::~ConfigJournal() {
+	if (fd != -1) {
+		close(fd);
+	}
+}
+
+
+bool ConfigJournal::openLive() {
+	// Only ours to read, as it has passwords in it (see write_file_atomically).
+	fd = open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0600);
+	struct stat st;
+	if (fd == -1 || fchmod(fd, 0600) != 0 || fstat(fd, &st) != 0) {
+		LOG_ERROR("Unable to open config journal " << path << ": " << strerror(errno));
+		return false;
+	}
+	size = st.st_size;
+	return true;
+}
+
+
+std::string ConfigJournal::encode(const Record &record) {
+	std::string payload;
+	payload += static_cast<char>(record.operation);
+	payload += record.token;
+	payload += '\0';
+	payload += record.value;
+
+	RecordHeader header = {static_cast<uint32_t>(payload.size()), checksum(payload.data(), payload.size())};
+	return std::string(reinterpret_cast<const char *>(&header), sizeof(header)) + payload;
+}
+
+
+size_t ConfigJournal::decode(const char *data, size_t length, Record *record) {
+	RecordHeader header;
+	if (length < sizeof(header)) {
+		return 0;
+	}
+	memcpy(&header, data, sizeof(header));
+	const char *payload = data + sizeof(header);
+	if (header.length < 2 || header.length > length - sizeof(header) || header.checksum != checksum(payload, header.length)) {
+		return 0;
+	}
+
+	uint8_t operation = payload[0];
+	const char *token_end = static_cast<const char *>(memchr(payload + 1, '\0', header.length - 1));
+	if (operation < static_cast<uint8_t>(Operation::SetVideoEncoderConfiguration)
+			|| operation > static_cast<uint8_t>(Operation::SetVideoEncoder) || token_end == nullptr) {
+		return 0;
+	}
+	record->operation = static_cast<Operation>(operation);
+	record->token.assign(payload + 1, token_end);
+	record->value.assign(token_end + 1, payload + header.length);
+	return sizeof(header) + header.length;
+}
+
+
+std::vector<ConfigJournal::Record> ConfigJournal::replay(bool *interrupted) {
+	std::vector<Record> records;
+	Record record;
+
+	std::string compacting_data = read_file(compacting_path, interrupted);
+	for (size_t offset = 0, length; (length = decode(&compacting_data[offset], compacting_data.size() - offset, &record)) != 0; offset += length) {
+		records.push_back(record);
+	}
+
+	bool exists;
+	std::string live_data = read_file(path, &exists);
+	size_t offset = 0;
+	for (size_t length; (length = decode(&live_data[offset], live_data.size() - offset, &record)) != 0; offset += length) {
+		records.push_back(record);
+	}
+	if (offset != live_data.size()) {
+		// Otherwise the next append would land after the garbage, and be lost on the next replay too.
+		LOG_WARNING("Dropping " << live_data.size() - offset << " bytes of incomplete changes from " << path);
+		if (fd == -1 || ftruncate(fd, offset) != 0) {
+			LOG_ERROR("Unable to truncate config journal " << path << ": " << strerror(errno));
+		}
+		size = offset;
+	}
+
+	return records;
+}
+
+
+bool ConfigJournal::append(const Record &record) {
+	if (fd == -1) {
+		return false;
+	}
+
+	std::string encoded = encode(record);
+	const char *data = encoded.data();
+	size_t remaining = encoded.size();
+	while (remaining > 0) {
+		ssize_t written = write(fd, data, remaining);
+		if (written == -1) {
+			if (errno == EINTR) {
+				continue;
+			}
+			LOG_ERROR("Unable to append to config journal " << path << ": " << strerror(errno));
+			return false;
+		}
+		data += written;
+		remaining -= written;
+	}
+	size += encoded.size();
+
+	if (fdatasync(fd) != 0) {
+		LOG_ERROR("Unable to sync config journal " << path << ": " << strerror(errno));
+		return false;
+	}
+	return true;
+}
+
+
+bool ConfigJournal::rotate() {
+	if (compacting) {
+		return false;
+	}
+
+	if (fd != -1) {
+		close(fd);
+		fd = -1;
+	}
+	bool rotated = rename(path.c_str(), compacting_path.c_str()) == 0;
+	if (!rotated) {
+		LOG_ERROR("Unable to rotate config journal " << path << ": " << strerror(errno));
+	}
+	openLive();
+	compacting = rotated;
+	return rotated;
+}
+
+
+void ConfigJournal::finishCompaction() {
+	if (unlink(compacting_path.c_str()) != 0 && errno != ENOENT) {
+		LOG_ERROR("Unable to remove " << compacting_path << ": " << strerror(errno));
+	}
+	compacting = false;
+}
+
+
+void ConfigJournal::clear() {
+	finishCompaction();
+	if (fd == -1 || ftruncate(fd, 0) != 0) {
+		LOG_ERROR("Unable to truncate config journal " << path << ": " << strerror(errno));
+		return;
+	}
+	size = 0;
+}
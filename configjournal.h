@@ -0,0 +1,101 @@
+/*
+ * Copyright 2023 Morse Micro
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+
+/* Changes to the config since config.xml was last written, so that each change
+ * costs one small append rather than rewriting the whole file.
+ *
+ * Every record sets something to a complete new value, so replaying a record
+ * that's already reflected in config.xml is harmless. That lets compaction be:
+ * rotate() (the live journal becomes path.compacting and appends start afresh),
+ * write config.xml, then finishCompaction(). A crash at any point replays
+ * whatever is left over the config.xml that made it to disk.
+ *
+ * Records are length-prefixed and checksummed, so a torn append (i.e. a crash
+ * mid-write) is detected and dropped on replay.
+ */
+class ConfigJournal {
+	public:
+		enum class Operation : uint8_t {
+			SetVideoEncoderConfiguration = 1,  // token, XML
+			SetVideoSourceConfiguration = 2,  // token, XML
+			SetImagingSettings = 3,  // video source token, XML
+			SetScopes = 4,  // value is newline-separated
+			SetCurrentProfile = 5,  // token
+			SetProfile = 6,  // token, XML (creating it if need be)
+			DeleteProfile = 7,  // token
+			SetH265Configuration = 8,  // video encoder configuration token, XML (empty to remove it)
+			SetUser = 9,  // username, XML (creating the user if need be)
+			DeleteUser = 10,  // username
+			SetVideoEncoder = 11,  // token, XML, NUL, H.265 XML (empty without one)
+		};
+
+		struct Record {
+			Operation operation;
+			std::string token;
+			std::string value;
+		};
+
+	private:
+		std::string path;
+		std::string compacting_path;
+		int fd;
+		size_t size;
+		std::atomic<bool> compacting;
+
+		bool openLive();
+
+	public:
+		explicit ConfigJournal(const std::string &path);
+		~ConfigJournal();
+
+		ConfigJournal(const ConfigJournal &) = delete;
+		ConfigJournal &operator=(const ConfigJournal &) = delete;
+
+		/* Every intact record, oldest first (i.e. the compacting journal's, then the live one's).
+		 * Drops a torn record from the end of the live journal. Sets *interrupted if a
+		 * compaction didn't finish.
+		 */
+		std::vector<Record> replay(bool *interrupted);
+
+		/* Appends and syncs record. Returns false if it might not have made it to disk. */
+		bool append(const Record &record);
+
+		/* Bytes in the live journal. */
+		size_t liveSize() const {
+			return size;
+		}
+
+		bool isCompacting() const {
+			return compacting;
+		}
+
+		/* Starts a compaction (returning false if one is already in progress). Call once
+		 * the config that's going to be written includes everything appended so far.
+		 */
+		bool rotate();
+
+		/* Once config.xml from before rotate() is safely on disk. Can be called from another thread. */
+		void finishCompaction();
+
+		/* Once config.xml includes everything (e.g. written synchronously with nothing in progress). */
+		void clear();
+
+		static std::string encode(const Record &record);
+
+		/* Decodes the record at data (of up to length bytes), returning its encoded length
+		 * or 0 if there isn't an intact one.
+		 */
+		static size_t decode(const char *data, size_t length, Record *record);
+};
@@ -0,0 +1,259 @@
+// Copyright 2023 Morse Micro
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include "configvalidator.h"
+
+#include <sstream>
+
+
+template <typename Range, typename OptionsRange>
+static void limit(Range *range, const OptionsRange *options) {
+	if (options != nullptr) {
+		range->set(options->Min, options->Max);
+	}
+}
+
+
+// What every encoding's Options have in common.
+template <typename Limits, typename Options>
+static void limit_encoder(Limits *limits, const Options *options) {
+	for (auto *resolution : options->ResolutionsAvailable) {
+		limits->resolutions.insert({resolution->Width, resolution->Height});
+	}
+	limit(&limits->frame_rate, options->FrameRateRange);
+	limit(&limits->encoding_interval, options->EncodingIntervalRange);
+}
+
+
+// A value that's already configured is allowed regardless, as what's shipped
+// doesn't always agree with its own Options; clients have to be able to send it back.
+template <typename Range>
+static std::string outside(const char *what, double value, const Range &range, bool unchanged) {
+	if (unchanged || range.allows(value)) {
+		return "";
+	}
+	std::ostringstream reason;
+	reason << what << " " << value << " is outside " << range.min << "-" << range.max;
+	return reason.str();
+}
+
+
+static bool same(const float *a, const float *b) {
+	return a != nullptr && b != nullptr && *a == *b;
+}
+
+
+ConfigValidator::ConfigValidator(const _tt__CameraProperties *properties) {
+	auto *media = properties->MediaService;
+
+	if (auto *options = media->VideoEncoderConfigurationOptions) {
+		limit(&quality, options->QualityRange);
+		auto *extension = options->Extension;
+		if (options->JPEG != nullptr) {
+			auto &limits = encoders[tt__VideoEncoding::JPEG];
+			limit_encoder(&limits, options->JPEG);
+			if (extension != nullptr && extension->JPEG != nullptr) {
+				limit(&limits.bitrate, extension->JPEG->BitrateRange);
+			}
+		}
+		if (options->MPEG4 != nullptr) {
+			auto &limits = encoders[tt__VideoEncoding::MPEG4];
+			limit_encoder(&limits, options->MPEG4);
+			limit(&limits.gov_length, options->MPEG4->GovLengthRange);
+			for (auto profile : options->MPEG4->Mpeg4ProfilesSupported) {
+				limits.profiles.insert(static_cast<int>(profile));
+			}
+			if (extension != nullptr && extension->MPEG4 != nullptr) {
+				limit(&limits.bitrate, extension->MPEG4->BitrateRange);
+			}
+		}
+		if (options->H264 != nullptr) {
+			auto &limits = encoders[tt__VideoEncoding::H264];
+			limit_encoder(&limits, options->H264);
+			limit(&limits.gov_length, options->H264->GovLengthRange);
+			for (auto profile : options->H264->H264ProfilesSupported) {
+				limits.profiles.insert(static_cast<int>(profile));
+			}
+			if (extension != nullptr && extension->H264 != nullptr) {
+				limit(&limits.bitrate, extension->H264->BitrateRange);
+			}
+		}
+	}
+
+	h265_profiles.insert(media->H265ProfilesSupported.begin(), media->H265ProfilesSupported.end());
+
+	if (auto *options = media->VideoSourceConfigurationOptions) {
+		if (auto *bounds = options->BoundsRange) {
+			limit(&bounds_x, bounds->XRange);
+			limit(&bounds_y, bounds->YRange);
+			limit(&bounds_width, bounds->WidthRange);
+			limit(&bounds_height, bounds->HeightRange);
+		}
+		video_source_tokens.insert(options->VideoSourceTokensAvailable.begin(), options->VideoSourceTokensAvailable.end());
+	}
+
+	for (auto *source : properties->ImagingService->ImagingVideoSourceOptions) {
+		auto *options = source->ImagingOptions;
+		if (options == nullptr) {
+			continue;
+		}
+		auto &limits = imaging[source->VideoSourceToken];
+		limit(&limits.brightness, options->Brightness);
+		limit(&limits.colour_saturation, options->ColorSaturation);
+		limit(&limits.contrast, options->Contrast);
+		limit(&limits.sharpness, options->Sharpness);
+		if (options->BacklightCompensation != nullptr) {
+			limit(&limits.backlight_compensation_level, options->BacklightCompensation->Level);
+		}
+		if (options->WideDynamicRange != nullptr) {
+			limit(&limits.wide_dynamic_range_level, options->WideDynamicRange->Level);
+		}
+		if (options->Exposure != nullptr) {
+			limit(&limits.exposure_time, options->Exposure->ExposureTime);
+			limit(&limits.gain, options->Exposure->Gain);
+			limit(&limits.iris, options->Exposure->Iris);
+		}
+		for (auto mode : options->IrCutFilterModes) {
+			limits.ir_cut_filter_modes.insert(static_cast<int>(mode));
+		}
+	}
+}
+
+
+std::string ConfigValidator::check(const tt__VideoEncoderConfiguration *vec, const tt__VideoEncoderConfiguration *current) const {
+	std::string reason = outside("Quality", vec->Quality, quality, current && current->Quality == vec->Quality);
+	if (!reason.empty() || encoders.empty()) {
+		return reason;
+	}
+
+	bool same_encoding = current && current->Encoding == vec->Encoding;
+	auto encoder = encoders.find(vec->Encoding);
+	if (encoder == encoders.end()) {
+		return same_encoding ? "" : "Encoding isn't supported";
+	}
+	auto &limits = encoder->second;
+	if (vec->Resolution != nullptr && !limits.resolutions.empty()
+			&& limits.resolutions.count({vec->Resolution->Width, vec->Resolution->Height}) == 0
+			&& !(same_encoding && current->Resolution && current->Resolution->Width == vec->Resolution->Width
+			     && current->Resolution->Height == vec->Resolution->Height)) {
+		return "Resolution " + std::to_string(vec->Resolution->Width) + "x" + std::to_string(vec->Resolution->Height) + " isn't available";
+	}
+	if (auto *rate_control = vec->RateControl) {
+		auto *current_rate_control = same_encoding ? current->RateControl : nullptr;
+		for (auto &r : {
+				outside("FrameRateLimit", rate_control->FrameRateLimit, limits.frame_rate,
+				        current_rate_control && current_rate_control->FrameRateLimit == rate_control->FrameRateLimit),
+				outside("EncodingInterval", rate_control->EncodingInterval, limits.encoding_interval,
+				        current_rate_control && current_rate_control->EncodingInterval == rate_control->EncodingInterval),
+				outside("BitrateLimit", rate_control->BitrateLimit, limits.bitrate,
+				        current_rate_control && current_rate_control->BitrateLimit == rate_control->BitrateLimit)}) {
+			if (!r.empty()) {
+				return r;
+			}
+		}
+	}
+
+	int gov_length, profile;
+	bool same_gov_length, same_profile;
+	if (vec->Encoding == tt__VideoEncoding::H264 && vec->H264 != nullptr) {
+		auto *current_h264 = same_encoding ? current->H264 : nullptr;
+		gov_length = vec->H264->GovLength;
+		profile = static_cast<int>(vec->H264->H264Profile);
+		same_gov_length = current_h264 && current_h264->GovLength == gov_length;
+		same_profile = current_h264 && current_h264->H264Profile == vec->H264->H264Profile;
+	} else if (vec->Encoding == tt__VideoEncoding::MPEG4 && vec->MPEG4 != nullptr) {
+		auto *current_mpeg4 = same_encoding ? current->MPEG4 : nullptr;
+		gov_length = vec->MPEG4->GovLength;
+		profile = static_cast<int>(vec->MPEG4->Mpeg4Profile);
+		same_gov_length = current_mpeg4 && current_mpeg4->GovLength == gov_length;
+		same_profile = current_mpeg4 && current_mpeg4->Mpeg4Profile == vec->MPEG4->Mpeg4Profile;
+	} else {
+		return "";
+	}
+	reason = outside("GovLength", gov_length, limits.gov_length, same_gov_length);
+	if (reason.empty() && !same_profile && !limits.profiles.empty() && limits.profiles.count(profile) == 0) {
+		reason = "Profile isn't supported";
+	}
+	return reason;
+}
+
+
+std::string ConfigValidator::check(const tt__H265Configuration *h265, const tt__H265Configuration *current) const {
+	if (current && current->H265Profile == h265->H265Profile) {
+		return "";
+	} else if (h265_profiles.empty()) {
+		return "H.265 isn't supported";
+	} else if (h265_profiles.count(h265->H265Profile) == 0) {
+		return "H265Profile isn't supported";
+	}
+	return "";
+}
+
+
+std::string ConfigValidator::check(const tt__VideoSourceConfiguration *vsc, const tt__VideoSourceConfiguration *current) const {
+	if (!video_source_tokens.empty() && video_source_tokens.count(vsc->SourceToken) == 0) {
+		return "No such video source: " + vsc->SourceToken;
+	}
+	if (auto *bounds = vsc->Bounds) {
+		auto *current_bounds = current ? current->Bounds : nullptr;
+		for (auto &r : {
+				outside("Bounds x", bounds->x, bounds_x, current_bounds && current_bounds->x == bounds->x),
+				outside("Bounds y", bounds->y, bounds_y, current_bounds && current_bounds->y == bounds->y),
+				outside("Bounds width", bounds->width, bounds_width, current_bounds && current_bounds->width == bounds->width),
+				outside("Bounds height", bounds->height, bounds_height, current_bounds && current_bounds->height == bounds->height)}) {
+			if (!r.empty()) {
+				return r;
+			}
+		}
+	}
+	return "";
+}
+
+
+std::string ConfigValidator::check(const std::string &vs_token, const tt__ImagingSettings20 *imaging_settings, const tt__ImagingSettings20 *current) const {
+	auto source = imaging.find(vs_token);
+	if (source == imaging.end()) {
+		return "";
+	}
+	auto &limits = source->second;
+
+	// Only what was sent is checked.
+	std::vector<std::string> reasons;
+	auto check_value = [&reasons] (const char *what, const float *value, const float *current_value, const Range &range) {
+		if (value != nullptr) {
+			reasons.push_back(outside(what, *value, range, same(value, current_value)));
+		}
+	};
+	check_value("Brightness", imaging_settings->Brightness, current ? current->Brightness : nullptr, limits.brightness);
+	check_value("ColorSaturation", imaging_settings->ColorSaturation, current ? current->ColorSaturation : nullptr, limits.colour_saturation);
+	check_value("Contrast", imaging_settings->Contrast, current ? current->Contrast : nullptr, limits.contrast);
+	check_value("Sharpness", imaging_settings->Sharpness, current ? current->Sharpness : nullptr, limits.sharpness);
+	if (auto *backlight_compensation = imaging_settings->BacklightCompensation) {
+		auto *current_backlight_compensation = current ? current->BacklightCompensation : nullptr;
+		check_value("BacklightCompensation Level", backlight_compensation->Level,
+		            current_backlight_compensation ? current_backlight_compensation->Level : nullptr, limits.backlight_compensation_level);
+	}
+	if (auto *wide_dynamic_range = imaging_settings->WideDynamicRange) {
+		auto *current_wide_dynamic_range = current ? current->WideDynamicRange : nullptr;
+		check_value("WideDynamicRange Level", wide_dynamic_range->Level,
+		            current_wide_dynamic_range ? current_wide_dynamic_range->Level : nullptr, limits.wide_dynamic_range_level);
+	}
+	if (auto *exposure = imaging_settings->Exposure) {
+		auto *current_exposure = current ? current->Exposure : nullptr;
+		check_value("ExposureTime", exposure->ExposureTime, current_exposure ? current_exposure->ExposureTime : nullptr, limits.exposure_time);
+		check_value("Gain", exposure->Gain, current_exposure ? current_exposure->Gain : nullptr, limits.gain);
+		check_value("Iris", exposure->Iris, current_exposure ? current_exposure->Iris : nullptr, limits.iris);
+	}
+	if (imaging_settings->IrCutFilter != nullptr && !limits.ir_cut_filter_modes.empty()
+			&& limits.ir_cut_filter_modes.count(static_cast<int>(*imaging_settings->IrCutFilter)) == 0
+			&& !(current && current->IrCutFilter && *current->IrCutFilter == *imaging_settings->IrCutFilter)) {
+		reasons.push_back("IrCutFilter mode isn't supported");
+	}
+
+	for (auto &reason : reasons) {
+		if (!reason.empty()) {
+			return reason;
+		}
+	}
+	return "";
+}
@@ -0,0 +1,81 @@
+/*
+ * Copyright 2023 Morse Micro
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#pragma once
+
+#include "soaplib/soapH.h"
+
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+/* Checks configs against the Options in the properties, so that nothing the camera
+ * doesn't support is saved or reaches the RTSP server.
+ *
+ * The Options are flattened into tables when the properties are loaded, rather
+ * than walked on every Set. Anything the Options don't mention isn't restricted
+ * (e.g. no BitrateRange means any bitrate), and nor is anything that's unchanged.
+ */
+class ConfigValidator {
+	private:
+		struct Range {
+			bool limited = false;
+			double min = 0;
+			double max = 0;
+
+			void set(double min, double max) {
+				limited = true;
+				this->min = min;
+				this->max = max;
+			}
+
+			bool allows(double v) const {
+				return !limited || (v >= min && v <= max);
+			}
+		};
+
+		struct EncoderLimits {
+			std::set<std::pair<int, int>> resolutions;  // Width, height; empty if any.
+			Range frame_rate;
+			Range encoding_interval;
+			Range gov_length;
+			Range bitrate;
+			std::set<int> profiles;  // tt__H264Profile or tt__Mpeg4Profile; empty if any.
+		};
+
+		struct ImagingLimits {
+			Range brightness;
+			Range colour_saturation;
+			Range contrast;
+			Range sharpness;
+			Range backlight_compensation_level;
+			Range wide_dynamic_range_level;
+			Range exposure_time;
+			Range gain;
+			Range iris;
+			std::set<int> ir_cut_filter_modes;  // Empty if any.
+		};
+
+		Range quality;
+		std::map<tt__VideoEncoding, EncoderLimits> encoders;  // Only those with Options.
+		Range bounds_x, bounds_y, bounds_width, bounds_height;
+		std::set<std::string> video_source_tokens;  // Empty if any.
+		std::map<std::string, ImagingLimits> imaging;  // By video source token.
+		std::set<tt__VideoEncodingProfiles> h265_profiles;  // Empty if there's no H.265.
+
+	public:
+		explicit ConfigValidator(const _tt__CameraProperties *properties);
+
+		/* Each returns why the config isn't allowed, or "" if it is. Values that are
+		 * the same as current's (i.e. what's configured now, if anything) are allowed.
+		 */
+		std::string check(const tt__VideoEncoderConfiguration *vec, const tt__VideoEncoderConfiguration *current) const;
+		std::string check(const tt__H265Configuration *h265, const tt__H265Configuration *current) const;
+		std::string check(const tt__VideoSourceConfiguration *vsc, const tt__VideoSourceConfiguration *current) const;
+		std::string check(const std::string &vs_token, const tt__ImagingSettings20 *imaging_settings, const tt__ImagingSettings20 *current) const;
+};
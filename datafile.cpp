@@ -0,0 +1,65 @@
+// Copyright 2023 Morse Micro
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include "datafile.h"
+#include "utils.h"
+
+#include <sstream>
+
+
+const struct Namespace datafile_namespaces[] = {
+	{ "tt", "http://www.onvif.org/ver10/schema", nullptr, nullptr },
+	{ "xsi", "http://www.w3.org/2001/XMLSchema-instance", "http://www.w3.org/*/XMLSchema-instance", nullptr },
+	{ nullptr, nullptr, nullptr, nullptr}
+};
+
+
+std::string serialise_datafile(const std::function<int (struct soap *)> &write) {
+	std::ostringstream output;
+	struct soap *soap = soap_new1(SOAP_XML_DEFAULTNS);
+	soap_set_namespaces(soap, datafile_namespaces);
+	soap->os = &output;
+	SoapError::ifNotOk(soap, "Serialising config", write(soap));
+	soap_destroy(soap);
+	soap_end(soap);
+	soap_free(soap);
+	return output.str();
+}
+
+
+bool parse_datafile(const std::string &xml, const std::function<bool (struct soap *)> &parse, soap_mode mode) {
+	std::istringstream input(xml);
+	struct soap *soap = soap_new1(SOAP_XML_DEFAULTNS | mode);
+	soap_set_namespaces(soap, datafile_namespaces);
+	soap->is = &input;
+	bool parsed = parse(soap);
+	soap_destroy(soap);
+	soap_end(soap);
+	soap_free(soap);
+	return parsed;
+}
+
+
+#define CANONICAL_XML(type) \
+	std::string canonical_xml(const type *value) { \
+		return serialise_datafile([value] (struct soap *soap) { return soap_write_##type(soap, value); }); \
+	}
+
+CANONICAL_XML(tt__VideoEncoderConfiguration)
+CANONICAL_XML(tt__VideoSourceConfiguration)
+CANONICAL_XML(tt__VideoSourceConfigurationExtension)
+CANONICAL_XML(tt__IntRectangle)
+CANONICAL_XML(tt__ImagingSettings20)
+CANONICAL_XML(tt__MinimumProfile)
+CANONICAL_XML(tt__H265Configuration)
+CANONICAL_XML(tt__RTSPStream)
+CANONICAL_XML(tt__User)
+
+
+uint64_t hash_xml(const std::string &xml) {
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	for (unsigned char c : xml) {
+		hash = (hash ^ c) * 0x100000001b3ULL;
+	}
+	return hash;
+}
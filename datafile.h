@@ -0,0 +1,53 @@
+/*
+ * Copyright 2023 Morse Micro
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#pragma once
+
+#include "soaplib/soapH.h"
+
+#include <stdint.h>
+
+#include <functional>
+#include <string>
+
+
+/* How the camera's data files, and the pieces of them that are journalled or
+ * compared, are turned into XML and back.
+ */
+extern const struct Namespace datafile_namespaces[];
+
+/* What write (e.g. soap_write_tt__X) produces, without indentation. Throws SoapError. */
+extern std::string serialise_datafile(const std::function<int (struct soap *)> &write);
+
+/* parse reads from xml in a temporary context, so it has to copy whatever it keeps. */
+extern bool parse_datafile(const std::string &xml, const std::function<bool (struct soap *)> &parse, soap_mode mode = 0);
+
+
+/* Deep equality and hashing for the config types. gsoap doesn't generate either,
+ * but it does generate a canonical serialisation, and two values are equal
+ * exactly when that is. One overload per type, all from the same macro.
+ */
+extern std::string canonical_xml(const tt__VideoEncoderConfiguration *value);
+extern std::string canonical_xml(const tt__VideoSourceConfiguration *value);
+extern std::string canonical_xml(const tt__VideoSourceConfigurationExtension *value);
+extern std::string canonical_xml(const tt__IntRectangle *value);
+extern std::string canonical_xml(const tt__ImagingSettings20 *value);
+extern std::string canonical_xml(const tt__MinimumProfile *value);
+extern std::string canonical_xml(const tt__H265Configuration *value);
+extern std::string canonical_xml(const tt__RTSPStream *value);
+extern std::string canonical_xml(const tt__User *value);
+
+/* FNV-1a of xml: stable across runs, so fine for ETags and on-disk caches. */
+extern uint64_t hash_xml(const std::string &xml);
+
+template <typename T>
+bool deep_equal(const T *a, const T *b) {
+	return a == b || (a != nullptr && b != nullptr && canonical_xml(a) == canonical_xml(b));
+}
+
+template <typename T>
+uint64_t deep_hash(const T *value) {
+	return value == nullptr ? 0 : hash_xml(canonical_xml(value));
+}
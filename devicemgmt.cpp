@@ -3,10 +3,37 @@
 
 #include <unistd.h>
 #include <limits.h>
+#include <time.h>
+
+#include <algorithm>
+#include <set>
 
 #include "soaplib/soapH.h"
 
 #include "camera.h"
+#include "scopes.h"
+#include "utils.h"
+
+
+// What we advertise in the Security capabilities, and refuse beyond.
+static const int MAX_USERS = 16;
+static const int MAX_USERNAME_LENGTH = 32;
+static const int MAX_PASSWORD_LENGTH = 64;
+// They all go in every ProbeMatches and Hello, which has to fit in a datagram.
+static const size_t MAX_CONFIGURABLE_SCOPES = 16;
+
+
+static bool *new_bool(struct soap *soap, bool value) {
+	auto *result = static_cast<bool *>(soap_malloc(soap, sizeof(bool)));
+	*result = value;
+	return result;
+}
+
+static int *new_int(struct soap *soap, int value) {
+	auto *result = static_cast<int *>(soap_malloc(soap, sizeof(int)));
+	*result = value;
+	return result;
+}
 
 
 int __tds__GetDeviceInformation(struct soap *soap, _tds__GetDeviceInformation *request, _tds__GetDeviceInformationResponse &response) {
@@ -40,6 +67,14 @@ int __tds__GetServices(struct soap *soap, _tds__GetServices *request, _tds__GetS
 	media_service->Version->Minor = 6;
 	response.Service.push_back(media_service);
 
+	auto media2_service = soap_new_tds__Service(soap);
+	media2_service->Namespace = SOAP_NAMESPACE_OF_tr2;
+	media2_service->XAddr = camera->getOnvifURL();
+	media2_service->Version = soap_new_tt__OnvifVersion(soap);
+	media2_service->Version->Major = 21;
+	media2_service->Version->Minor = 12;
+	response.Service.push_back(media2_service);
+
 	auto imaging_service = soap_new_tds__Service(soap);
 	imaging_service->Namespace = SOAP_NAMESPACE_OF_timg;
 	imaging_service->XAddr = camera->getOnvifURL();
@@ -48,6 +83,14 @@ int __tds__GetServices(struct soap *soap, _tds__GetServices *request, _tds__GetS
 	imaging_service->Version->Minor = 6;
 	response.Service.push_back(imaging_service);
 
+	auto events_service = soap_new_tds__Service(soap);
+	events_service->Namespace = SOAP_NAMESPACE_OF_tev;
+	events_service->XAddr = camera->getOnvifURL();
+	events_service->Version = soap_new_tt__OnvifVersion(soap);
+	events_service->Version->Major = 19;
+	events_service->Version->Minor = 6;
+	response.Service.push_back(events_service);
+
 	return SOAP_OK;
 }
 
@@ -75,6 +118,341 @@ int __tds__GetCapabilities(struct soap *soap, _tds__GetCapabilities *request, _t
 	response.Capabilities->Media = soap_new_tt__MediaCapabilities(soap);
 	response.Capabilities->Media->XAddr = camera->getOnvifURL();
 	response.Capabilities->Media->StreamingCapabilities = soap_new_tt__RealTimeStreamingCapabilities(soap);
+	response.Capabilities->Events = soap_new_tt__EventCapabilities(soap);
+	response.Capabilities->Events->XAddr = camera->getOnvifURL();
+
+	return SOAP_OK;
+}
+
+int __tds__GetServiceCapabilities(struct soap *soap, _tds__GetServiceCapabilities *request, _tds__GetServiceCapabilitiesResponse &response) {
+	response.Capabilities = soap_new_tds__DeviceServiceCapabilities(soap);
+	response.Capabilities->Network = soap_new_tds__NetworkCapabilities(soap);
+	response.Capabilities->System = soap_new_tds__SystemCapabilities(soap);
+	response.Capabilities->Security = soap_new_tds__SecurityCapabilities(soap);
+	response.Capabilities->Security->UsernameToken = new_bool(soap, true);
+	response.Capabilities->Security->HttpDigest = new_bool(soap, true);
+	response.Capabilities->Security->MaxUsers = new_int(soap, MAX_USERS);
+	response.Capabilities->Security->MaxUserNameLength = new_int(soap, MAX_USERNAME_LENGTH);
+	response.Capabilities->Security->MaxPasswordLength = new_int(soap, MAX_PASSWORD_LENGTH);
+
+	return SOAP_OK;
+}
+
+// Clients need this (before they've authenticated) to make a UsernameToken we'll accept.
+int __tds__GetSystemDateAndTime(struct soap *soap, _tds__GetSystemDateAndTime *request, _tds__GetSystemDateAndTimeResponse &response) {
+	time_t now = time(nullptr);
+	struct tm utc;
+	gmtime_r(&now, &utc);
+
+	response.SystemDateAndTime = soap_new_tt__SystemDateTime(soap);
+	response.SystemDateAndTime->DateTimeType = tt__SetDateTimeType::Manual;
+	response.SystemDateAndTime->DaylightSavings = false;
+	response.SystemDateAndTime->UTCDateTime = soap_new_tt__DateTime(soap);
+	response.SystemDateAndTime->UTCDateTime->Date = soap_new_tt__Date(soap);
+	response.SystemDateAndTime->UTCDateTime->Date->Year = utc.tm_year + 1900;
+	response.SystemDateAndTime->UTCDateTime->Date->Month = utc.tm_mon + 1;
+	response.SystemDateAndTime->UTCDateTime->Date->Day = utc.tm_mday;
+	response.SystemDateAndTime->UTCDateTime->Time = soap_new_tt__Time(soap);
+	response.SystemDateAndTime->UTCDateTime->Time->Hour = utc.tm_hour;
+	response.SystemDateAndTime->UTCDateTime->Time->Minute = utc.tm_min;
+	response.SystemDateAndTime->UTCDateTime->Time->Second = utc.tm_sec;
+
+	return SOAP_OK;
+}
+
+static bool contains(const std::vector<std::string> &scopes, const std::string &scope) {
+	return std::find(scopes.begin(), scopes.end(), scope) != scopes.end();
+}
+
+// Faults anything we couldn't match a probe against, or that would shadow a fixed scope,
+// and more than we have room for once they're all together.
+static int check_configurable_scopes(struct soap *soap, Camera *camera, const std::vector<xsd__anyURI> &scopes,
+                                     const std::vector<std::string> &together) {
+	DiscoveryMatcher::ParsedScope parsed;
+	for (auto &scope : scopes) {
+		if (contains(camera->getFixedScopes(), scope)) {
+			return onvif_sender_fault(soap, "ter:OperationProhibited", "ter:ScopeOverwrite", "Fixed scope: " + scope);
+		}
+		if (!DiscoveryMatcher::parseScope(scope, &parsed)) {
+			return onvif_sender_fault(soap, "ter:InvalidArgs", "ter:InvalidArgVal", "Not a scope we can match probes against: " + scope);
+		}
+	}
+	if (together.size() > MAX_CONFIGURABLE_SCOPES) {
+		return onvif_sender_fault(soap, "ter:InvalidArgVal", "ter:TooManyScopes",
+		                          "No more than " + std::to_string(MAX_CONFIGURABLE_SCOPES) + " configurable scopes are allowed");
+	}
+	return SOAP_OK;
+}
+
+int __tds__GetScopes(struct soap *soap, _tds__GetScopes *request, _tds__GetScopesResponse &response) {
+	auto *camera = static_cast<Camera *>(soap->user);
+
+	for (auto &item : camera->getFixedScopes()) {
+		auto *scope = soap_new_tt__Scope(soap);
+		scope->ScopeDef = tt__ScopeDefinition::Fixed;
+		scope->ScopeItem = item;
+		response.Scopes.push_back(scope);
+	}
+	for (auto &item : camera->getConfigurableScopes()) {
+		auto *scope = soap_new_tt__Scope(soap);
+		scope->ScopeDef = tt__ScopeDefinition::Configurable;
+		scope->ScopeItem = item;
+		response.Scopes.push_back(scope);
+	}
+
+	return SOAP_OK;
+}
+
+int __tds__SetScopes(struct soap *soap, _tds__SetScopes *request, _tds__SetScopesResponse &response) {
+	auto *camera = static_cast<Camera *>(soap->user);
+	std::vector<std::string> scopes;
+	for (auto &scope : request->Scopes) {
+		if (!contains(scopes, scope)) {
+			scopes.push_back(scope);
+		}
+	}
+	int invalid = check_configurable_scopes(soap, camera, request->Scopes, scopes);
+	if (invalid != SOAP_OK) {
+		return invalid;
+	}
+	camera->setConfigurableScopes(scopes);
+	return SOAP_OK;
+}
+
+int __tds__AddScopes(struct soap *soap, _tds__AddScopes *request, _tds__AddScopesResponse &response) {
+	auto *camera = static_cast<Camera *>(soap->user);
+	std::vector<std::string> scopes = camera->getConfigurableScopes();
+	for (auto &scope : request->ScopeItem) {
+		if (!contains(scopes, scope)) {
+			scopes.push_back(scope);
+		}
+	}
+	int invalid = check_configurable_scopes(soap, camera, request->ScopeItem, scopes);
+	if (invalid != SOAP_OK) {
+		return invalid;
+	}
+	camera->setConfigurableScopes(scopes);
+	return SOAP_OK;
+}
+
+int __tds__RemoveScopes(struct soap *soap, _tds__RemoveScopes *request, _tds__RemoveScopesResponse &response) {
+	auto *camera = static_cast<Camera *>(soap->user);
+
+	// All or nothing; in particular, fixed scopes can't be removed.
+	std::vector<std::string> scopes = camera->getConfigurableScopes();
+	for (auto &scope : request->ScopeItem) {
+		auto it = std::find(scopes.begin(), scopes.end(), scope);
+		if (it != scopes.end()) {
+			scopes.erase(it);
+			continue;
+		}
+		if (contains(camera->getFixedScopes(), scope)) {
+			return onvif_sender_fault(soap, "ter:OperationProhibited", "ter:FixedScope", "Fixed scope: " + scope);
+		}
+		return onvif_sender_fault(soap, "ter:InvalidArgVal", "ter:NoScope", "No such scope: " + scope);
+	}
+	camera->setConfigurableScopes(scopes);
+
+	response.ScopeItem = request->ScopeItem;
+	return SOAP_OK;
+}
+
+int __tds__GetUsers(struct soap *soap, _tds__GetUsers *request, _tds__GetUsersResponse &response) {
+	auto *camera = static_cast<Camera *>(soap->user);
+
+	for (auto *user : camera->getUsers()) {
+		// Never the password.
+		auto *entry = soap_new_tt__User(soap);
+		entry->Username = user->Username;
+		entry->UserLevel = user->UserLevel;
+		response.User.push_back(entry);
+	}
+
+	return SOAP_OK;
+}
+
+// A fault saying why user can't be created or set, or SOAP_OK.
+static int check_user(struct soap *soap, const tt__User *user, bool creating) {
+	if (user->Username.empty()) {
+		return onvif_sender_fault(soap, "ter:OperationProhibited", "ter:UsernameTooShort", "A username is required");
+	}
+	if (user->Username.size() > static_cast<size_t>(MAX_USERNAME_LENGTH)) {
+		return onvif_sender_fault(soap, "ter:OperationProhibited", "ter:UsernameTooLong", "Usernames are limited to " + std::to_string(MAX_USERNAME_LENGTH) + " characters");
+	}
+	if (creating && (user->Password == nullptr || user->Password->empty())) {
+		return onvif_sender_fault(soap, "ter:OperationProhibited", "ter:PasswordTooWeak", "A password is required");
+	}
+	if (user->Password != nullptr && user->Password->size() > static_cast<size_t>(MAX_PASSWORD_LENGTH)) {
+		return onvif_sender_fault(soap, "ter:OperationProhibited", "ter:PasswordTooLong", "Passwords are limited to " + std::to_string(MAX_PASSWORD_LENGTH) + " characters");
+	}
+	if (user->UserLevel != tt__UserLevel::Administrator && user->UserLevel != tt__UserLevel::Operator && user->UserLevel != tt__UserLevel::User) {
+		return onvif_sender_fault(soap, "ter:OperationProhibited", "ter:AnonymousNotAllowed", "Users must be an Administrator, Operator or User");
+	}
+	return SOAP_OK;
+}
+
+// All or nothing, like the scopes.
+int __tds__CreateUsers(struct soap *soap, _tds__CreateUsers *request, _tds__CreateUsersResponse &response) {
+	auto *camera = static_cast<Camera *>(soap->user);
+
+	std::set<std::string> usernames;
+	for (auto *user : request->User) {
+		int status = check_user(soap, user, true);
+		if (status != SOAP_OK) {
+			return status;
+		}
+		if (camera->getUser(user->Username) != nullptr || !usernames.insert(user->Username).second) {
+			return onvif_sender_fault(soap, "ter:OperationProhibited", "ter:UsernameClash", "User " + user->Username + " already exists");
+		}
+	}
+	if (camera->getUsers().size() + request->User.size() > static_cast<size_t>(MAX_USERS)) {
+		return onvif_receiver_fault(soap, "ter:Action", "ter:TooManyUsers", "No more than " + std::to_string(MAX_USERS) + " users are allowed");
+	}
+
+	for (auto *user : request->User) {
+		camera->setUser(user);
+	}
+	return SOAP_OK;
+}
+
+int __tds__SetUser(struct soap *soap, _tds__SetUser *request, _tds__SetUserResponse &response) {
+	auto *camera = static_cast<Camera *>(soap->user);
+
+	for (auto *user : request->User) {
+		if (camera->getUser(user->Username) == nullptr) {
+			return onvif_sender_fault(soap, "ter:InvalidArgVal", "ter:UsernameMissing", "No such user: " + user->Username);
+		}
+		int status = check_user(soap, user, false);
+		if (status != SOAP_OK) {
+			return status;
+		}
+	}
+
+	for (auto *user : request->User) {
+		camera->setUser(user);
+	}
+	return SOAP_OK;
+}
+
+int __tds__DeleteUsers(struct soap *soap, _tds__DeleteUsers *request, _tds__DeleteUsersResponse &response) {
+	auto *camera = static_cast<Camera *>(soap->user);
+
+	for (auto &username : request->Username) {
+		if (camera->getUser(username) == nullptr) {
+			return onvif_sender_fault(soap, "ter:InvalidArgVal", "ter:UsernameMissing", "No such user: " + username);
+		}
+	}
+
+	for (auto &username : request->Username) {
+		camera->deleteUser(username);
+	}
+	return SOAP_OK;
+}
+
+// Whichever interface we're serving from (null if we can't tell).
+static const NetworkState::Interface *our_interface(Camera *camera, const NetworkState::Snapshot &snapshot) {
+	std::string ip = camera->getIP();
+	for (auto &entry : snapshot.interfaces) {
+		for (auto &address : entry.second.ipv4) {
+			if (address.address == ip) {
+				return &entry.second;
+			}
+		}
+	}
+	return nullptr;
+}
+
+static tt__PrefixedIPv4Address *new_prefixed_address(struct soap *soap, const NetworkState::Address &address) {
+	auto *prefixed = soap_new_tt__PrefixedIPv4Address(soap);
+	prefixed->Address = address.address;
+	prefixed->PrefixLength = address.prefix_length;
+	return prefixed;
+}
+
+// All answered from NetworkState's snapshot, so no syscalls here.
+int __tds__GetNetworkInterfaces(struct soap *soap, _tds__GetNetworkInterfaces *request, _tds__GetNetworkInterfacesResponse &response) {
+	auto *camera = static_cast<Camera *>(soap->user);
+	if (camera->getNetworkState() == nullptr) {
+		return SOAP_OK;
+	}
+
+	auto snapshot = camera->getNetworkState()->get();
+	for (auto &entry : snapshot->interfaces) {
+		const NetworkState::Interface &interface = entry.second;
+		if (interface.loopback || interface.name.empty()) {
+			continue;
+		}
+
+		auto *network_interface = soap_new_tt__NetworkInterface(soap);
+		network_interface->token = interface.name;
+		network_interface->Enabled = interface.up;
+		network_interface->Info = soap_new_tt__NetworkInterfaceInfo(soap);
+		network_interface->Info->Name = soap_new_std__string(soap);
+		*network_interface->Info->Name = interface.name;
+		network_interface->Info->HwAddress = interface.hw_address;
+		network_interface->Info->MTU = new_int(soap, interface.mtu);
+
+		network_interface->IPv4 = soap_new_tt__IPv4NetworkInterface(soap);
+		network_interface->IPv4->Enabled = !interface.ipv4.empty();
+		auto *config = soap_new_tt__IPv4Configuration(soap);
+		config->DHCP = false;
+		for (auto &address : interface.ipv4) {
+			if (address.dynamic && config->FromDHCP == nullptr) {
+				config->DHCP = true;
+				config->FromDHCP = new_prefixed_address(soap, address);
+			} else {
+				config->Manual.push_back(new_prefixed_address(soap, address));
+			}
+		}
+		network_interface->IPv4->Config = config;
+
+		response.NetworkInterfaces.push_back(network_interface);
+	}
+
+	return SOAP_OK;
+}
+
+int __tds__GetDNS(struct soap *soap, _tds__GetDNS *request, _tds__GetDNSResponse &response) {
+	auto *camera = static_cast<Camera *>(soap->user);
+	response.DNSInformation = soap_new_tt__DNSInformation(soap);
+	response.DNSInformation->FromDHCP = false;
+	if (camera->getNetworkState() == nullptr) {
+		return SOAP_OK;
+	}
+
+	// resolv.conf doesn't say where its servers came from, so assume they came
+	// from DHCP if our address did.
+	auto snapshot = camera->getNetworkState()->get();
+	auto *interface = our_interface(camera, *snapshot);
+	response.DNSInformation->FromDHCP = interface != nullptr && std::any_of(interface->ipv4.begin(), interface->ipv4.end(),
+		[] (const NetworkState::Address &address) { return address.dynamic; });
+	response.DNSInformation->SearchDomain = snapshot->search_domains;
+	auto &servers = response.DNSInformation->FromDHCP ? response.DNSInformation->DNSFromDHCP : response.DNSInformation->DNSManual;
+	for (auto &nameserver : snapshot->nameservers) {
+		auto *address = soap_new_tt__IPAddress(soap);
+		address->Type = tt__IPType::IPv4;
+		address->IPv4Address = soap_new_tt__IPv4Address(soap);
+		*address->IPv4Address = nameserver;
+		servers.push_back(address);
+	}
+
+	return SOAP_OK;
+}
+
+int __tds__GetNetworkDefaultGateway(struct soap *soap, _tds__GetNetworkDefaultGateway *request, _tds__GetNetworkDefaultGatewayResponse &response) {
+	auto *camera = static_cast<Camera *>(soap->user);
+	response.NetworkGateway = soap_new_tt__NetworkGateway(soap);
+	if (camera->getNetworkState() == nullptr) {
+		return SOAP_OK;
+	}
+
+	auto snapshot = camera->getNetworkState()->get();
+	for (auto &gateway : snapshot->ipv4_gateways) {
+		auto &addresses = response.NetworkGateway->IPv4Address;
+		if (std::find(addresses.begin(), addresses.end(), gateway.address) == addresses.end()) {
+			addresses.push_back(gateway.address);
+		}
+	}
 
 	return SOAP_OK;
 }
@@ -2,117 +2,485 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 
 #include <errno.h>
-#include <signal.h>
-#include <sys/types.h>
-#include <sys/wait.h>
-#include <sys/prctl.h>
-#include <unistd.h>
+#include <inttypes.h>
 #include <string.h>
+#include <time.h>
 
-#include <sstream>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
 
 #include "soaplib/wsddapi.h"
 
+#include "camera.h"
+#include "discovery.h"
+#include "discoveryproxy.h"
+#include "log.h"
+#include "probematches.h"
+#include "scopes.h"
+#include "udpsendqueue.h"
+#include "utils.h"
 
-const char *TYPES = "tdn:NetworkVideoTransmitter";
-const char *SCOPES = "onvif://www.onvif.org/type/video_encoder";
+
+const char *TYPES = "tdn:NetworkVideoTransmitter tds:Device";
+const char *PROXY_TYPES = "wsdd:DiscoveryProxy";
 const char *MULTICAST_IP = "239.255.255.250";
 const int MULTICAST_PORT = 3702;
+// SOAP-over-UDP's retransmissions, on top of the first send.
+const int MULTICAST_UDP_REPEAT = 1;
+const int UNICAST_UDP_REPEAT = 1;
+const auto APP_MAX_DELAY = std::chrono::milliseconds(SOAP_WSDD_APP_MAX_DELAY);
+// How long the listener waits with nothing to send before checking for changes to announce.
+const auto IDLE_TIMEOUT = std::chrono::seconds(1);
+// Enough to cover a probe's retransmissions even when lots of clients are probing.
+const size_t RECENT_PROBES = 64;
+const size_t PROXY_CAPACITY = 1024;
+
+// Only set in proxy mode, and before anything can use it. The ONVIF server threads
+// use it too (managed mode clients send us their probes over HTTP).
+static DiscoveryProxyTable *proxy_table = nullptr;
+
+// For stop_wsdd_server: the listener checks wsdd_stopping every time it wakes,
+// and we wake it by shutting down its socket (which it only closes under wsdd_socket_mutex).
+static std::atomic<bool> wsdd_stopping(false);
+static std::mutex wsdd_socket_mutex;
+static int wsdd_socket = -1;
+static std::thread wsdd_thread;
+static std::future<void> wsdd_done;
 
 struct WsddConfig {
 	std::string endpoint_uuid;
-	std::string service_url;
+	std::string proxy_uuid;  // We're a separate endpoint as a discovery proxy.
+	Camera *camera;
+	struct sockaddr_in multicast_to;
+	unsigned int instance_id;
+	// Our own messages are numbered in their own sequence, as gsoap keeps
+	// the MessageNumber for everything it sends to itself.
+	std::string sequence_id;
+	unsigned int message_number;
+	// MessageIDs are this plus a counter (rather than a fresh random UUID each time).
+	std::string message_id_prefix;
+	uint64_t message_count;
+	UdpSendQueue send_queue;
+	RecentMessageIds recent_probes;
+
+	// Everything below is derived from the camera's state as of discovery_version.
+	unsigned int discovery_version;
+	std::string ip;  // Whose interface we've joined the multicast group on.
+	std::string xaddrs;
+	std::unique_ptr<DiscoveryMatcher> matcher;
+	std::unique_ptr<ProbeMatchesTemplate> probe_matches;
+
+	WsddConfig(struct soap *soap, Camera *camera)
+		: endpoint_uuid(soap_wsa_rand_uuid(soap)), proxy_uuid(soap_wsa_rand_uuid(soap)), camera(camera), instance_id(time(nullptr)),
+		  sequence_id(soap_wsa_rand_uuid(soap)), message_number(1),
+		  // i.e. urn:uuid:xxxxxxxx-xxxx-xxxx-xxxx-
+		  message_id_prefix(std::string(soap_wsa_rand_uuid(soap)).substr(0, 33)), message_count(0),
+		  send_queue(soap_random), recent_probes(RECENT_PROBES), discovery_version(0)
+	{
+		memset(&multicast_to, 0, sizeof(multicast_to));
+		multicast_to.sin_family = AF_INET;
+		multicast_to.sin_addr.s_addr = inet_addr(MULTICAST_IP);
+		multicast_to.sin_port = htons(MULTICAST_PORT);
+	}
+
+	// The camera's state may be changed by the ONVIF server threads at any time,
+	// but they bump the discovery version when it matters to us, so we only need
+	// the lock when that's changed. Returns true if it had (since the first call).
+	bool refresh(struct soap *soap) {
+		if (discovery_version != 0 && discovery_version == camera->getDiscoveryVersion()) {
+			return false;
+		}
+
+		std::vector<std::string> scopes;
+		std::string new_ip;
+		unsigned int version;
+		{
+			std::lock_guard<std::mutex> lock(camera->getMutex());
+			version = camera->getDiscoveryVersion();
+			scopes = camera->getScopes();
+			new_ip = camera->getIP();
+			xaddrs = camera->getOnvifURL();
+		}
+		if (new_ip != ip) {
+			joinMulticast(soap, new_ip);
+		}
+		matcher.reset(new DiscoveryMatcher(TYPES, scopes, soap->namespaces));
+		probe_matches.reset(new ProbeMatchesTemplate(endpoint_uuid, matcher->getTypes().c_str(), matcher->getScopes().c_str(),
+		                                             xaddrs, version, instance_id, sequence_id));
+
+		// We're one of the target services we know about.
+		if (proxy_table != nullptr) {
+			proxy_table->hello({endpoint_uuid, matcher->getTypes(), matcher->getScopes(), xaddrs, version,
+			                    instance_id, sequence_id, message_number});
+		}
+
+		bool changed = discovery_version != 0;
+		discovery_version = version;
+		return changed;
+	}
+
+	// Heavily inspired my mpromonet/ws-discovery/gsoap/wsd-server.cpp, since
+	// the official docs are terrible for server side ops.
+	// The kernel keys memberships by interface, so after a DHCP renewal on the same
+	// interface the old one can't be dropped (its address is gone) and the new one
+	// already exists; either way we're still in the group.
+	void joinMulticast(struct soap *soap, const std::string &new_ip) {
+		ip_mreq mcast;
+		mcast.imr_multiaddr.s_addr = multicast_to.sin_addr.s_addr;
+		if (!ip.empty()) {
+			mcast.imr_interface.s_addr = inet_addr(ip.c_str());
+			if (setsockopt(soap->master, IPPROTO_IP, IP_DROP_MEMBERSHIP, &mcast, sizeof(mcast)) != 0) {
+				LOG_DEBUG("Unable to leave " << MULTICAST_IP << " on " << ip << ": " << strerror(errno));
+			}
+		}
+
+		mcast.imr_interface.s_addr = inet_addr(new_ip.c_str());
+		if (setsockopt(soap->master, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mcast, sizeof(mcast)) != 0 && errno != EADDRINUSE) {
+			LOG_ERROR("Unable to become member of " << MULTICAST_IP << " on " << new_ip << ": " << strerror(errno));
+		}
+		// We send our own Hellos from this socket too.
+		setsockopt(soap->master, IPPROTO_IP, IP_MULTICAST_IF, &mcast.imr_interface, sizeof(mcast.imr_interface));
+		ip = new_ip;
+	}
+
+	bool isOurMessageId(const char *message_id) const {
+		return strncmp(message_id, message_id_prefix.c_str(), message_id_prefix.size()) == 0;
+	}
+
+	std::string nextMessageId() {
+		char message_id[64];
+		snprintf(message_id, sizeof(message_id), "%s%012" PRIx64, message_id_prefix.c_str(), ++message_count);
+		return message_id;
+	}
+
+	// Replies to whoever sent the datagram we're handling (after a random delay).
+	void queueProbeMatches(struct soap *soap, const char *relates_to) {
+		std::string datagram;
+		probe_matches->render(&datagram, nextMessageId().c_str(), relates_to, message_number++);
+		send_queue.add(UdpSendQueue::Clock::now(), std::move(datagram), &soap->peer.addr, soap->peerlen,
+		               APP_MAX_DELAY, UNICAST_UDP_REPEAT);
+	}
+
+	void queueHello() {
+		std::string datagram = serialise_hello(endpoint_uuid, matcher->getTypes().c_str(), matcher->getScopes().c_str(),
+		                                       xaddrs, discovery_version, nextMessageId().c_str(), NULL,
+		                                       instance_id, sequence_id, message_number++);
+		send_queue.add(UdpSendQueue::Clock::now(), std::move(datagram),
+		               reinterpret_cast<struct sockaddr *>(&multicast_to), sizeof(multicast_to),
+		               APP_MAX_DELAY, MULTICAST_UDP_REPEAT);
+
+		if (proxy_table != nullptr) {
+			queueProxyHello(reinterpret_cast<struct sockaddr *>(&multicast_to), sizeof(multicast_to), NULL, MULTICAST_UDP_REPEAT);
+		}
+	}
+
+	// The discovery proxy's own Hello, which points clients at the ONVIF server
+	// (which answers Probe and Resolve from the proxy table).
+	void queueProxyHello(const struct sockaddr *to, socklen_t to_length, const char *relates_to, int repeats) {
+		std::string datagram = serialise_hello(proxy_uuid, PROXY_TYPES, NULL, xaddrs, discovery_version,
+		                                       nextMessageId().c_str(), relates_to,
+		                                       instance_id, sequence_id, message_number++);
+		send_queue.add(UdpSendQueue::Clock::now(), std::move(datagram), to, to_length, APP_MAX_DELAY, repeats);
+	}
+
+	// Byes go straight out (with their repeat), since we're about to exit.
+	void queueBye() {
+		auto *to = reinterpret_cast<struct sockaddr *>(&multicast_to);
+		send_queue.add(UdpSendQueue::Clock::now(),
+		               serialise_bye(endpoint_uuid, matcher->getTypes().c_str(), matcher->getScopes().c_str(),
+		                             xaddrs, discovery_version, nextMessageId().c_str(),
+		                             instance_id, sequence_id, message_number++),
+		               to, sizeof(multicast_to), UdpSendQueue::Clock::duration::zero(), MULTICAST_UDP_REPEAT);
+		if (proxy_table != nullptr) {
+			send_queue.add(UdpSendQueue::Clock::now(),
+			               serialise_bye(proxy_uuid, PROXY_TYPES, NULL, xaddrs, discovery_version, nextMessageId().c_str(),
+			                             instance_id, sequence_id, message_number++),
+			               to, sizeof(multicast_to), UdpSendQueue::Clock::duration::zero(), MULTICAST_UDP_REPEAT);
+		}
+	}
+
+	// Asks everyone already out there to introduce themselves (their ProbeMatches come back to us).
+	void queueProbe() {
+		send_queue.add(UdpSendQueue::Clock::now(), serialise_probe(NULL, nextMessageId().c_str()),
+		               reinterpret_cast<struct sockaddr *>(&multicast_to), sizeof(multicast_to),
+		               APP_MAX_DELAY, MULTICAST_UDP_REPEAT);
+	}
 };
 
 
-static void start_wsdd_server(const char *listen_ip, const char *service_url) {
-	struct soap *soap = soap_new1(SOAP_IO_UDP);
-	WsddConfig wsdd_conf = {soap_wsa_rand_uuid(soap), service_url};
+static void free_soap(struct soap *soap) {
+	soap_destroy(soap);
+	soap_end(soap);
+	soap_free(soap);
+}
 
+
+// This is soap_wsdd_listen, except that rather than serving until it's been idle
+// for the whole timeout we only wait until we next have something to send.
+static void serve_one(struct soap *soap, UdpSendQueue::Clock::duration timeout) {
+	// Negative timeouts are in microseconds.
+	auto us = std::chrono::duration_cast<std::chrono::microseconds>(timeout).count();
+	soap->accept_timeout = soap->recv_timeout = soap->send_timeout = -std::max<int>(1, us);
+
+	if (!soap_valid_socket(soap_accept(soap)) || soap_begin_serve(soap) || soap_wsdd_serve_request(soap)) {
+		// A zero errnum is just the timeout.
+		if (soap->errnum != 0 || (soap->error != SOAP_OK && soap->error != SOAP_EOF)) {
+			// It's not clear to me how to distinguish here between terminal and non-terminal
+			// issues... cf start_server, where if soap_accept fails we abort.
+			LOG_RATELIMITED(LogLevel::Error, 1000, "Error when listening for discovery messages:\n" << soap_fault_string(soap));
+		}
+	}
+	soap_destroy(soap);
+	soap_end(soap);
+}
+
+
+static void run_wsdd_server(Camera *camera) {
+	struct soap *soap = soap_new1(SOAP_IO_UDP);
+	WsddConfig wsdd_conf(soap, camera);
+	soap_wsdd_set_InstanceId(wsdd_conf.instance_id);
 	soap->user = &wsdd_conf;
 	soap->bind_flags |= SO_REUSEADDR;
-	soap->connect_flags |= SO_BROADCAST;
-	in_addr_t multicast_addr = inet_addr(MULTICAST_IP);
-	soap->ipv4_multicast_if = reinterpret_cast<char *>(&multicast_addr);
-	soap->ipv6_multicast_if = multicast_addr;
-	soap->ipv4_multicast_ttl = 1;
-
-	std::cout << "Broadcasting hello via WS-Discovery..." << std::endl;
-	std::stringstream uri;
-	uri << "soap.udp://" << MULTICAST_IP << ":" << MULTICAST_PORT;
-	// Best effort, ignore failure here.
-	soap_wsdd_Hello(soap, SOAP_WSDD_ADHOC, uri.str().c_str(),
-					soap_wsa_rand_uuid(soap), NULL, wsdd_conf.endpoint_uuid.c_str(),
-					TYPES, SCOPES, NULL, service_url, 1);
 
 	if (!soap_valid_socket(soap_bind(soap, NULL, MULTICAST_PORT, 1000))) {
-		std::cerr << "Error binding to port 3702 for discovery." << std::endl;
-		soap_print_fault(soap, stderr);
-		soap_destroy(soap);
-		soap_end(soap);
-		soap_free(soap);
+		LOG_ERROR("Error binding to port 3702 for discovery:\n" << soap_fault_string(soap));
+		free_soap(soap);
 		return;
 	}
 
-	// Heavily inspired my mpromonet/ws-discovery/gsoap/wsd-server.cpp, since
-	// the official docs are terrible for server side ops.
-	ip_mreq mcast; 
-	mcast.imr_multiaddr.s_addr = multicast_addr;
-	mcast.imr_interface.s_addr = inet_addr(listen_ip);
-	if (setsockopt(soap->master, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mcast, sizeof(mcast)) != 0) {
-		std::cerr << "Unable to become member of " << MULTICAST_IP << ": " << strerror(errno) << std::endl;
+	unsigned char ttl = 1;
+	setsockopt(soap->master, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+
+	// Also joins the multicast group on the camera's interface.
+	wsdd_conf.refresh(soap);
+	LOG_INFO("Broadcasting hello via WS-Discovery...");
+	wsdd_conf.queueHello();
+	if (proxy_table != nullptr) {
+		LOG_INFO("Probing for target services to proxy...");
+		wsdd_conf.queueProbe();
 	}
 
-	std::cout << "Starting WS-Discovery listener..." << std::endl;
-	while (true) {
-		if (soap_wsdd_listen(soap, 0) != SOAP_OK) {
-			// It's not clear to me how to distinguish here between terminal and non-terminal
-			// issues... cf start_server, where if soap_accept fails we abort.
-			// Here, we simply busy-loop :(
-			std::cerr << "Error when listening for discovery messages: " << std::endl;
-			soap_print_fault(soap, stderr);
+	{
+		std::lock_guard<std::mutex> lock(wsdd_socket_mutex);
+		wsdd_socket = soap->master;
+	}
+
+	LOG_INFO("Starting WS-Discovery listener...");
+	auto send = [soap] (const UdpSendQueue::Datagram &datagram) {
+		if (sendto(soap->master, datagram.data.data(), datagram.data.size(), 0,
+		           reinterpret_cast<const struct sockaddr *>(&datagram.to), datagram.to_length) < 0) {
+			LOG_RATELIMITED(LogLevel::Error, 1000, "Unable to send discovery message: " << strerror(errno));
 		}
-		soap_destroy(soap);
-		soap_end(soap);
+	};
+	while (!wsdd_stopping) {
+		wsdd_conf.send_queue.sendDue(UdpSendQueue::Clock::now(), send);
+
+		// Our metadata changed (e.g. someone called SetScopes, or our address changed), so tell everyone.
+		if (wsdd_conf.refresh(soap)) {
+			LOG_INFO("Discovery metadata changed; broadcasting hello...");
+			wsdd_conf.queueHello();
+		}
+
+		serve_one(soap, wsdd_conf.send_queue.timeUntilNext(UdpSendQueue::Clock::now(), IDLE_TIMEOUT));
+	}
+
+	// Tell everyone we're going (rather than leaving clients to time us out),
+	// and forget any replies we haven't sent yet.
+	LOG_INFO("Sending WS-Discovery bye...");
+	wsdd_conf.send_queue.clear();
+	wsdd_conf.queueBye();
+	while (!wsdd_conf.send_queue.empty()) {
+		wsdd_conf.send_queue.sendDue(UdpSendQueue::Clock::now(), send);
+		std::this_thread::sleep_for(wsdd_conf.send_queue.timeUntilNext(UdpSendQueue::Clock::now(), IDLE_TIMEOUT));
 	}
 
-	// NB: Ideally we would send a 'Bye' (soap_wsdd_Bye) on exit, but we'd need to add
-	// signal handling for this...
+	std::lock_guard<std::mutex> lock(wsdd_socket_mutex);
+	wsdd_socket = -1;
+	free_soap(soap);
 }
 
-pid_t spawn_wsdd_server(const char *listen_ip, const char *service_url) {
-	pid_t parent_pid = getpid();
-	pid_t pid = fork();
+void start_wsdd_server(Camera *camera, bool proxy) {
+	if (proxy) {
+		// Lives as long as the process (it may outlive stop_wsdd_server's deadline).
+		proxy_table = new DiscoveryProxyTable(PROXY_CAPACITY, namespaces);
+	}
 
-	if (pid == -1) {
-		throw std::runtime_error("Unable to fork to start WS-Discovery server");
-	} else if (pid == 0) {
-		if (-1 == prctl(PR_SET_PDEATHSIG, SIGTERM)) {
-			std::cerr << "Failed to prctl(PR_SET_PDEATHSIG) for rtsp server: " << strerror(errno) << std::endl;
-			exit(1);
-		}
-		if (getppid() != parent_pid) { // In case parent already exited...
-			exit(1);
+	// Discovery is mostly idle, so rather than a separate process (which would
+	// have a stale copy of the camera's state) it just gets a thread.
+	std::promise<void> done;
+	wsdd_done = done.get_future();
+	wsdd_thread = std::thread([] (Camera *camera, std::promise<void> done) {
+		run_wsdd_server(camera);
+		done.set_value();
+	}, camera, std::move(done));
+}
+
+bool stop_wsdd_server(std::chrono::milliseconds deadline) {
+	wsdd_stopping = true;
+	{
+		std::lock_guard<std::mutex> lock(wsdd_socket_mutex);
+		if (wsdd_socket != -1) {
+			// Linux says ENOTCONN for an unconnected UDP socket, but wakes the reader anyway.
+			shutdown(wsdd_socket, SHUT_RD);
 		}
+	}
 
-		start_wsdd_server(listen_ip, service_url);
+	if (!wsdd_thread.joinable()) {
+		return true;
 	}
+	if (wsdd_done.wait_for(deadline) != std::future_status::ready) {
+		// The proxy table and camera outlive it anyway (i.e. we're about to exit).
+		wsdd_thread.detach();
+		return false;
+	}
+	wsdd_thread.join();
+	return true;
+}
+
+// The discovery events also arrive via the ONVIF server (i.e. over HTTP, where soap->user
+// is the Camera), which is how managed mode clients and services talk to a proxy.
+static bool is_managed(struct soap *soap) {
+	return !(soap->imode & SOAP_IO_UDP);
+}
+
 
-	return pid;
+static DiscoveryProxyTable::Announcement make_announcement(unsigned int InstanceId, const char *SequenceId, unsigned int MessageNumber,
+                                                           const char *EndpointReference, const char *Types, const char *Scopes,
+                                                           const char *XAddrs, unsigned int MetadataVersion) {
+	auto str = [] (const char *s) { return std::string(s != NULL ? s : ""); };
+	return {str(EndpointReference), str(Types), str(Scopes), str(XAddrs), MetadataVersion,
+	        InstanceId, str(SequenceId), MessageNumber};
 }
 
+
+static soap_wsdd_mode proxy_probe(struct soap *soap, const char *Types, const char *Scopes, const char *MatchBy, struct wsdd__ProbeMatchesType *ProbeMatches) {
+	// Not a proxy, so not for us (gsoap sends an empty response).
+	if (proxy_table == nullptr) {
+		return SOAP_WSDD_ADHOC;
+	}
+
+	auto matches = proxy_table->probe(Types, Scopes, MatchBy);
+	for (auto &match : matches) {
+		soap_wsdd_add_ProbeMatch(
+			soap, ProbeMatches, soap_strdup(soap, match.endpoint_reference.c_str()),
+			soap_strdup(soap, match.types.c_str()), soap_strdup(soap, match.scopes.c_str()), NULL,
+			soap_strdup(soap, match.xaddrs.c_str()), match.metadata_version);
+	}
+	LOG_RATELIMITED(LogLevel::Info, 1000, "Answering managed probe from " << soap->host << " with " << matches.size() << " matches");
+	return SOAP_WSDD_MANAGED;
+}
+
+
 soap_wsdd_mode wsdd_event_Probe(struct soap *soap, const char *MessageID, const char *ReplyTo, const char *Types, const char *Scopes, const char *MatchBy, struct wsdd__ProbeMatchesType *ProbeMatches)
 {
-	std::cout << "Responding to probe: " << MessageID << std::endl;
-	auto *wsdd_conf = static_cast<WsddConfig *>(soap->user);
 	soap_wsdd_init_ProbeMatches(soap, ProbeMatches);
+	if (is_managed(soap)) {
+		return proxy_probe(soap, Types, Scopes, MatchBy, ProbeMatches);
+	}
+
+	auto *wsdd_conf = static_cast<WsddConfig *>(soap->user);
+	const char *message_id = MessageID != NULL ? MessageID : "(no MessageID)";
+
+	// Clients repeat each probe at least once; we've already answered the first.
+	// We also hear our own (proxy) probes.
+	if (MessageID != NULL && (wsdd_conf->isOurMessageId(MessageID) || wsdd_conf->recent_probes.checkAndAdd(MessageID))) {
+		LOG_RATELIMITED(LogLevel::Debug, 1000, "Ignoring repeated probe: " << message_id);
+		return SOAP_WSDD_ADHOC;
+	}
+
+	// A proxy tells multicast clients where it is, so that they can ask it directly next time.
+	if (proxy_table != nullptr) {
+		wsdd_conf->queueProxyHello(&soap->peer.addr, soap->peerlen, MessageID, UNICAST_UDP_REPEAT);
+	}
+
+	// Stay quiet unless it's for us. Most probes on a busy network won't be.
+	// (Don't refresh here if something changed; that way the hello goes out first.)
+	if (!wsdd_conf->matcher->matches(Types, Scopes, MatchBy)) {
+		LOG_RATELIMITED(LogLevel::Debug, 1000, "Ignoring probe: " << message_id);
+		return SOAP_WSDD_ADHOC;
+	}
+	LOG_RATELIMITED(LogLevel::Info, 1000, "Responding to probe: " << message_id);
+
+	// The common case (a multicast probe wanting an anonymous reply) is answered from
+	// the template. Anything unusual still goes through gsoap (which sleeps for the
+	// random delay rather than queueing the reply).
+	bool anonymous = ReplyTo == NULL || strcmp(ReplyTo, soap_wsa_anonymousURI) == 0;
+	if (anonymous && MessageID != NULL && soap->version == 2) {
+		wsdd_conf->queueProbeMatches(soap, MessageID);
+		return SOAP_WSDD_ADHOC;
+	}
+
 	soap_wsdd_add_ProbeMatch(
 		soap, ProbeMatches, wsdd_conf->endpoint_uuid.c_str(),
-		TYPES, SCOPES, NULL, wsdd_conf->service_url.c_str(), 1);
-	soap_wsdd_ProbeMatches(soap, NULL, soap_wsa_rand_uuid(soap) , MessageID, ReplyTo, ProbeMatches);
+		wsdd_conf->matcher->getTypes().c_str(), wsdd_conf->matcher->getScopes().c_str(), NULL,
+		wsdd_conf->xaddrs.c_str(), wsdd_conf->discovery_version);
+	soap_wsdd_ProbeMatches(soap, NULL, soap_wsa_rand_uuid(soap), MessageID, ReplyTo, ProbeMatches);
 	return SOAP_WSDD_ADHOC;
 }
 
+void wsdd_event_Hello(struct soap *soap, unsigned int InstanceId, const char *SequenceId, unsigned int MessageNumber, const char *MessageID, const char *RelatesTo, const char *EndpointReference, const char *Types, const char *Scopes, const char *MatchBy, const char *XAddrs, unsigned int MetadataVersion)
+{
+	if (proxy_table != nullptr && proxy_table->hello(make_announcement(InstanceId, SequenceId, MessageNumber, EndpointReference,
+	                                                                   Types, Scopes, XAddrs, MetadataVersion))) {
+		LOG_DEBUG("Proxying for " << EndpointReference << " at " << (XAddrs != NULL ? XAddrs : "(no XAddrs)"));
+	}
+}
+
+void wsdd_event_Bye(struct soap *soap, unsigned int InstanceId, const char *SequenceId, unsigned int MessageNumber, const char *MessageID, const char *RelatesTo, const char *EndpointReference, const char *Types, const char *Scopes, const char *MatchBy, const char *XAddrs, unsigned int *MetadataVersion)
+{
+	if (proxy_table != nullptr && proxy_table->bye(EndpointReference, InstanceId, SequenceId != NULL ? SequenceId : "", MessageNumber)) {
+		LOG_DEBUG("No longer proxying for " << EndpointReference);
+	}
+}
+
+// Only proxies send probes, so these are answers to the one we sent on startup.
+void wsdd_event_ProbeMatches(struct soap *soap, unsigned int InstanceId, const char *SequenceId, unsigned int MessageNumber, const char *MessageID, const char *RelatesTo, struct wsdd__ProbeMatchesType *ProbeMatches)
+{
+	for (int i = 0; proxy_table != nullptr && i < ProbeMatches->__sizeProbeMatch; ++i) {
+		auto &match = ProbeMatches->ProbeMatch[i];
+		if (match.wsa5__EndpointReference.Address != NULL) {
+			wsdd_event_Hello(soap, InstanceId, SequenceId, MessageNumber, MessageID, RelatesTo, match.wsa5__EndpointReference.Address,
+			                 match.Types, match.Scopes != NULL ? match.Scopes->__item : NULL, NULL, match.XAddrs, match.MetadataVersion);
+		}
+	}
+}
+
+soap_wsdd_mode wsdd_event_Resolve(struct soap *soap, const char *MessageID, const char *ReplyTo, const char *EndpointReference, struct wsdd__ResolveMatchType *match)
+{
+	if (proxy_table == nullptr) {
+		return SOAP_WSDD_ADHOC;
+	}
+
+	if (!is_managed(soap)) {
+		// As for a multicast probe.
+		auto *wsdd_conf = static_cast<WsddConfig *>(soap->user);
+		if (MessageID != NULL && !wsdd_conf->isOurMessageId(MessageID) && !wsdd_conf->recent_probes.checkAndAdd(MessageID)) {
+			wsdd_conf->queueProxyHello(&soap->peer.addr, soap->peerlen, MessageID, UNICAST_UDP_REPEAT);
+		}
+		return SOAP_WSDD_ADHOC;
+	}
+
+	DiscoveryProxyTable::Announcement found;
+	if (!proxy_table->resolve(EndpointReference, &found)) {
+		return SOAP_WSDD_ADHOC;
+	}
+	match->wsa5__EndpointReference.Address = soap_strdup(soap, found.endpoint_reference.c_str());
+	match->Types = soap_strdup(soap, found.types.c_str());
+	match->Scopes = static_cast<struct wsdd__ScopesType *>(soap_malloc(soap, sizeof(struct wsdd__ScopesType)));
+	soap_default_wsdd__ScopesType(soap, match->Scopes);
+	match->Scopes->__item = soap_strdup(soap, found.scopes.c_str());
+	match->XAddrs = soap_strdup(soap, found.xaddrs.c_str());
+	match->MetadataVersion = found.metadata_version;
+	return SOAP_WSDD_MANAGED;
+}
+
+void wsdd_event_ResolveMatches(struct soap *soap, unsigned int InstanceId, const char * SequenceId, unsigned int MessageNumber, const char *MessageID, const char *RelatesTo, struct wsdd__ResolveMatchType *match)
+{ }
+
 int SOAP_ENV__Fault(struct soap *soap, char *faultcode, char *faultstring, char *faultactor, struct SOAP_ENV__Detail *detail, struct SOAP_ENV__Code *SOAP_ENV__Code, struct SOAP_ENV__Reason *SOAP_ENV__Reason, char *SOAP_ENV__Node, char *SOAP_ENV__Role, struct SOAP_ENV__Detail *SOAP_ENV__Detail)
 {
 	/* populate the fault struct from the operation arguments to print it */
@@ -5,6 +5,20 @@
 
 #pragma once
 
-#include <unistd.h>
+#include <chrono>
 
-extern pid_t spawn_wsdd_server(const char *listen_ip, const char *service_uri);
+class Camera;
+
+/* Answers WS-Discovery probes on a background thread, using the camera's current state
+ * (including its IP, so it follows the camera if that changes).
+ *
+ * As a discovery proxy it also keeps track of every other target service it hears
+ * about, and answers Probe and Resolve sent directly to the ONVIF server (managed mode)
+ * for all of them.
+ */
+extern void start_wsdd_server(Camera *camera, bool proxy);
+
+/* Stops answering, sends Bye (waiting for its repeat) and stops the thread.
+ * Returns false if that took longer than deadline (when we stop waiting).
+ */
+extern bool stop_wsdd_server(std::chrono::milliseconds deadline);
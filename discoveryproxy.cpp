@@ -0,0 +1,85 @@
+// Copyright 2023 Morse Micro
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <algorithm>
+
+#include "discoveryproxy.h"
+
+
+bool DiscoveryProxyTable::isStale(const Announcement &existing, unsigned int instance_id,
+                                  const std::string &sequence_id, unsigned int message_number) {
+	// WS-Discovery 2005/04 section 7: a larger InstanceId is a restart, and within one
+	// sequence a larger MessageNumber is newer. Messages without an AppSequence are
+	// taken as they come.
+	if (instance_id == 0 || existing.instance_id == 0 || instance_id != existing.instance_id) {
+		return instance_id != 0 && instance_id < existing.instance_id;
+	}
+	return sequence_id == existing.sequence_id && message_number <= existing.message_number;
+}
+
+
+bool DiscoveryProxyTable::hello(const Announcement &announcement) {
+	DiscoveryMatcher matcher(announcement.types, split_list(announcement.scopes.c_str()), namespaces);
+	std::lock_guard<std::mutex> lock(mutex);
+
+	auto it = entries.find(announcement.endpoint_reference);
+	if (it != entries.end()) {
+		if (isStale(it->second.announcement, announcement.instance_id, announcement.sequence_id, announcement.message_number)) {
+			return false;
+		}
+		it->second.announcement = announcement;
+		it->second.matcher = std::move(matcher);
+		it->second.last_seen = ++counter;
+		return true;
+	}
+
+	if (entries.size() >= capacity) {
+		auto oldest = std::min_element(entries.begin(), entries.end(), [] (const std::pair<const std::string, Entry> &a, const std::pair<const std::string, Entry> &b) {
+			return a.second.last_seen < b.second.last_seen;
+		});
+		entries.erase(oldest);
+	}
+	entries.emplace(announcement.endpoint_reference, Entry{announcement, std::move(matcher), ++counter});
+	return true;
+}
+
+
+bool DiscoveryProxyTable::bye(const std::string &endpoint_reference, unsigned int instance_id,
+                              const std::string &sequence_id, unsigned int message_number) {
+	std::lock_guard<std::mutex> lock(mutex);
+	auto it = entries.find(endpoint_reference);
+	if (it == entries.end() || isStale(it->second.announcement, instance_id, sequence_id, message_number)) {
+		return false;
+	}
+	entries.erase(it);
+	return true;
+}
+
+
+std::vector<DiscoveryProxyTable::Announcement> DiscoveryProxyTable::probe(const char *types, const char *scopes, const char *match_by) const {
+	std::vector<Announcement> matches;
+	std::lock_guard<std::mutex> lock(mutex);
+	for (auto &entry : entries) {
+		if (entry.second.matcher.matches(types, scopes, match_by)) {
+			matches.push_back(entry.second.announcement);
+		}
+	}
+	return matches;
+}
+
+
+bool DiscoveryProxyTable::resolve(const std::string &endpoint_reference, Announcement *announcement) const {
+	std::lock_guard<std::mutex> lock(mutex);
+	auto it = entries.find(endpoint_reference);
+	if (it == entries.end()) {
+		return false;
+	}
+	*announcement = it->second.announcement;
+	return true;
+}
+
+
+size_t DiscoveryProxyTable::size() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return entries.size();
+}
@@ -0,0 +1,75 @@
+/*
+ * Copyright 2023 Morse Micro
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "scopes.h"
+
+
+/* What a WS-Discovery proxy knows about the target services on its network.
+ *
+ * It's filled from the Hellos, Byes and ProbeMatches we hear, and used to answer
+ * probes sent straight to us (managed mode) with a single reply, without any multicast.
+ * Entries only go away on Bye, so we cap how many we keep; the least recently
+ * announced go first.
+ *
+ * Used from both the discovery thread and the ONVIF server threads.
+ */
+class DiscoveryProxyTable {
+	public:
+		struct Announcement {
+			std::string endpoint_reference;
+			std::string types;
+			std::string scopes;  // Space separated, as in the message.
+			std::string xaddrs;
+			unsigned int metadata_version;
+			// The AppSequence of the message it came from (all zero if there wasn't one).
+			unsigned int instance_id;
+			std::string sequence_id;
+			unsigned int message_number;
+		};
+
+	private:
+		struct Entry {
+			Announcement announcement;
+			DiscoveryMatcher matcher;
+			uint64_t last_seen;
+		};
+
+		mutable std::mutex mutex;
+		std::map<std::string, Entry> entries;
+		const struct Namespace *namespaces;
+		size_t capacity;
+		uint64_t counter;
+
+		// i.e. this message came before the one we already have.
+		static bool isStale(const Announcement &existing, unsigned int instance_id,
+		                    const std::string &sequence_id, unsigned int message_number);
+
+	public:
+		/* namespaces resolves the prefixes in types (i.e. soap->namespaces). */
+		DiscoveryProxyTable(size_t capacity, const struct Namespace *namespaces)
+			: namespaces(namespaces), capacity(capacity), counter(0) {}
+
+		/* Adds or updates a target service (from a Hello or ProbeMatch). Returns false if it was stale. */
+		bool hello(const Announcement &announcement);
+
+		/* Returns false if we didn't have it (or the Bye was stale). */
+		bool bye(const std::string &endpoint_reference, unsigned int instance_id,
+		         const std::string &sequence_id, unsigned int message_number);
+
+		std::vector<Announcement> probe(const char *types, const char *scopes, const char *match_by) const;
+
+		bool resolve(const std::string &endpoint_reference, Announcement *announcement) const;
+
+		size_t size() const;
+};
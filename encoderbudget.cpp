@@ -0,0 +1,145 @@
+// Copyright 2023 Morse Micro
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include "encoderbudget.h"
+
+#include <algorithm>
+#include <climits>
+#include <sstream>
+
+
+// The biggest resolution and frame rate (and bitrate, if there's a range) that options allow.
+template <typename Options>
+static EncoderBudget::Load worst_case_load(const Options *options, const tt__IntRange *bitrate_range,
+                                      long long source_pixels, double source_frame_rate) {
+	long long pixels = 0;
+	for (auto *resolution : options->ResolutionsAvailable) {
+		pixels = std::max(pixels, static_cast<long long>(resolution->Width) * resolution->Height);
+	}
+	double frame_rate = options->FrameRateRange != nullptr ? options->FrameRateRange->Max : source_frame_rate;
+	if (options->EncodingIntervalRange != nullptr && options->EncodingIntervalRange->Min > 1) {
+		frame_rate /= options->EncodingIntervalRange->Min;
+	}
+
+	EncoderBudget::Load load;
+	load.pixel_rate = static_cast<long long>((pixels > 0 ? pixels : source_pixels) * frame_rate);
+	load.bitrate = bitrate_range != nullptr ? bitrate_range->Max : 0;
+	return load;
+}
+
+
+EncoderBudget::EncoderBudget(const _tt__CameraProperties *properties)
+		: limited(false), max_profiles(0) {
+	auto *media = properties->MediaService;
+	if (auto *budget = media->EncoderBudget) {
+		limited = true;
+		capacity.pixel_rate = budget->MaxPixelRate;
+		capacity.bitrate = budget->MaxBitrate;
+		max_profiles = budget->MaxProfiles != nullptr ? *budget->MaxProfiles : 0;
+	}
+
+	// For what the Options don't say.
+	long long source_pixels = 0;
+	double source_frame_rate = 0;
+	for (auto *source : media->VideoSource) {
+		if (source->Resolution != nullptr) {
+			source_pixels = std::max(source_pixels, static_cast<long long>(source->Resolution->Width) * source->Resolution->Height);
+		}
+		source_frame_rate = std::max(source_frame_rate, static_cast<double>(source->Framerate));
+	}
+
+	auto *options = media->VideoEncoderConfigurationOptions;
+	if (options == nullptr) {
+		return;
+	}
+	auto *extension = options->Extension;
+	if (options->JPEG != nullptr) {
+		worst_case[tt__VideoEncoding::JPEG] = worst_case_load(options->JPEG,
+			extension != nullptr && extension->JPEG != nullptr ? extension->JPEG->BitrateRange : nullptr,
+			source_pixels, source_frame_rate);
+	}
+	if (options->MPEG4 != nullptr) {
+		worst_case[tt__VideoEncoding::MPEG4] = worst_case_load(options->MPEG4,
+			extension != nullptr && extension->MPEG4 != nullptr ? extension->MPEG4->BitrateRange : nullptr,
+			source_pixels, source_frame_rate);
+	}
+	if (options->H264 != nullptr) {
+		worst_case[tt__VideoEncoding::H264] = worst_case_load(options->H264,
+			extension != nullptr && extension->H264 != nullptr ? extension->H264->BitrateRange : nullptr,
+			source_pixels, source_frame_rate);
+	}
+}
+
+
+EncoderBudget::Load EncoderBudget::cost(const tt__VideoEncoderConfiguration *vec) const {
+	auto worst = worst_case.find(vec->Encoding);
+	Load load = worst != worst_case.end() ? worst->second : Load();
+	if (vec->RateControl == nullptr) {
+		// Nothing stops it using as much as the Options allow.
+		return load;
+	}
+
+	load.bitrate = vec->RateControl->BitrateLimit;
+	if (vec->Resolution != nullptr) {
+		double frame_rate = vec->RateControl->FrameRateLimit;
+		if (vec->RateControl->EncodingInterval > 1) {
+			frame_rate /= vec->RateControl->EncodingInterval;
+		}
+		load.pixel_rate = static_cast<long long>(static_cast<long long>(vec->Resolution->Width) * vec->Resolution->Height * frame_rate);
+	}
+	return load;
+}
+
+
+std::string EncoderBudget::admit(const std::vector<const tt__VideoEncoderConfiguration *> &vecs) const {
+	if (!limited) {
+		return "";
+	}
+
+	Load total;
+	for (auto *vec : vecs) {
+		Load load = cost(vec);
+		total.pixel_rate += load.pixel_rate;
+		total.bitrate += load.bitrate;
+	}
+
+	std::ostringstream reason;
+	if (total.pixel_rate > capacity.pixel_rate) {
+		reason << "Encoding " << total.pixel_rate << " pixels/s would exceed the encoder budget of " << capacity.pixel_rate;
+	} else if (total.bitrate > capacity.bitrate) {
+		reason << "Encoding " << total.bitrate << " kbit/s would exceed the encoder budget of " << capacity.bitrate;
+	}
+	return reason.str();
+}
+
+
+int EncoderBudget::guaranteed(tt__VideoEncoding encoding) const {
+	auto worst = worst_case.find(encoding);
+	if (worst == worst_case.end()) {
+		return 0;
+	}
+	if (!limited) {
+		return 1;
+	}
+
+	long long count = INT_MAX;
+	if (worst->second.pixel_rate > 0) {
+		count = std::min(count, capacity.pixel_rate / worst->second.pixel_rate);
+	}
+	if (worst->second.bitrate > 0) {
+		count = std::min(count, capacity.bitrate / worst->second.bitrate);
+	}
+	return static_cast<int>(count);
+}
+
+
+int EncoderBudget::guaranteedTotal() const {
+	if (worst_case.empty()) {
+		return limited ? 0 : 1;
+	}
+	int total = INT_MAX;
+	for (auto &worst : worst_case) {
+		total = std::min(total, guaranteed(worst.first));
+	}
+	return total;
+}
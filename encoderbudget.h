@@ -0,0 +1,57 @@
+/*
+ * Copyright 2023 Morse Micro
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#pragma once
+
+#include "soaplib/soapH.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+
+/* How much the SoC can encode at once (<EncoderBudget> in the properties), so that
+ * profiles can't ask for more than that and have the encoder drop frames instead.
+ *
+ * Every encoder configuration that's in a profile counts once, however many
+ * profiles it's in: that's what a client can stream at the same time. Without a
+ * budget anything is admitted (as before), and only one instance is guaranteed.
+ */
+class EncoderBudget {
+	public:
+		struct Load {
+			long long pixel_rate = 0;  // Pixels/second.
+			long long bitrate = 0;  // kbit/second; 0 if unknown.
+		};
+
+	private:
+		bool limited;
+		Load capacity;
+		int max_profiles;  // 0 if any.
+		// The most one encoder of each encoding can use, given the Options (for those with Options).
+		std::map<tt__VideoEncoding, Load> worst_case;
+
+	public:
+		explicit EncoderBudget(const _tt__CameraProperties *properties);
+
+		Load cost(const tt__VideoEncoderConfiguration *vec) const;
+
+		/* Why encoding all of vecs at once would be too much, or "" if it wouldn't. */
+		std::string admit(const std::vector<const tt__VideoEncoderConfiguration *> &vecs) const;
+
+		/* How many encoders of encoding are guaranteed to fit, however they're configured
+		 * (0 if the Options don't have it). total is the same, for any encoding.
+		 */
+		int guaranteed(tt__VideoEncoding encoding) const;
+		int guaranteedTotal() const;
+
+		bool allowsProfiles(size_t count) const {
+			return max_profiles == 0 || count <= static_cast<size_t>(max_profiles);
+		}
+
+		int getMaxProfiles() const {
+			return max_profiles;
+		}
+};
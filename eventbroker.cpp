@@ -0,0 +1,234 @@
+// Copyright 2023 Morse Micro
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <algorithm>
+#include <iterator>
+#include <tuple>
+
+#include "eventbroker.h"
+
+
+EventRing::EventRing(size_t capacity) : events(std::max<size_t>(capacity, 1)), head(0), count(0), dropped(0) {
+}
+
+
+void EventRing::push(const Event &event) {
+	size_t tail = (head + count) % events.size();
+	events[tail] = event;
+	if (count < events.size()) {
+		++count;
+	} else {
+		// Overwrote the oldest.
+		head = (head + 1) % events.size();
+		++dropped;
+	}
+}
+
+
+std::vector<Event> EventRing::take(size_t limit) {
+	std::vector<Event> taken;
+	taken.reserve(std::min(limit, count));
+	while (count > 0 && taken.size() < limit) {
+		taken.push_back(std::move(events[head]));
+		head = (head + 1) % events.size();
+		--count;
+	}
+	return taken;
+}
+
+
+EventBroker::EventBroker(size_t capacity, size_t max_subscriptions)
+		: capacity(capacity), max_subscriptions(max_subscriptions), next_id(1), stopping(false) {
+}
+
+
+EventBroker::~EventBroker() {
+	stop();
+}
+
+
+EventBroker::Subscription *EventBroker::find(int id) {
+	expire();
+	auto it = subscriptions.find(id);
+	return it == subscriptions.end() ? nullptr : &it->second;
+}
+
+
+void EventBroker::expire() {
+	time_t now = time(nullptr);
+	for (auto it = subscriptions.begin(); it != subscriptions.end(); ) {
+		if (it->second.termination_time < now) {
+			abandon(it->second, 0);
+			it = subscriptions.erase(it);
+		} else {
+			++it;
+		}
+	}
+}
+
+
+void EventBroker::abandon(Subscription &subscription, time_t termination_time) {
+	if (subscription.parked) {
+		subscription.parked = false;
+		abandoned.push_back({std::move(subscription.pull.completion), {}, termination_time});
+	}
+}
+
+
+int EventBroker::subscribe(time_t termination_time) {
+	std::lock_guard<std::mutex> lock(mutex);
+	expire();
+	if (subscriptions.size() >= max_subscriptions) {
+		return -1;
+	}
+	int id = next_id++;
+	subscriptions.emplace(std::piecewise_construct, std::forward_as_tuple(id), std::forward_as_tuple(capacity, termination_time));
+	return id;
+}
+
+
+bool EventBroker::renew(int id, time_t termination_time) {
+	std::lock_guard<std::mutex> lock(mutex);
+	auto *subscription = find(id);
+	if (subscription == nullptr) {
+		return false;
+	}
+	subscription->termination_time = termination_time;
+	return true;
+}
+
+
+bool EventBroker::unsubscribe(int id) {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto *subscription = find(id);
+		if (subscription == nullptr) {
+			return false;
+		}
+		abandon(*subscription, 0);
+		subscriptions.erase(id);
+	}
+	wake.notify_one();
+	return true;
+}
+
+
+time_t EventBroker::getTerminationTime(int id) {
+	std::lock_guard<std::mutex> lock(mutex);
+	auto *subscription = find(id);
+	return subscription == nullptr ? 0 : subscription->termination_time;
+}
+
+
+void EventBroker::publish(const Event &event) {
+	bool waiting = false;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		expire();
+		for (auto &entry : subscriptions) {
+			entry.second.ring.push(event);
+			waiting = waiting || entry.second.parked;
+		}
+	}
+	if (waiting) {
+		wake.notify_one();
+	}
+}
+
+
+bool EventBroker::pull(int id, size_t limit, std::vector<Event> *events) {
+	std::lock_guard<std::mutex> lock(mutex);
+	auto *subscription = find(id);
+	if (subscription == nullptr) {
+		return false;
+	}
+	*events = subscription->ring.take(limit);
+	return true;
+}
+
+
+bool EventBroker::park(int id, size_t limit, std::chrono::milliseconds timeout, Completion completion) {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto *subscription = find(id);
+		if (subscription == nullptr || stopping) {
+			return false;
+		}
+		abandon(*subscription, subscription->termination_time);
+
+		auto now = Clock::now();
+		auto until_termination = std::chrono::seconds(std::max<time_t>(subscription->termination_time - time(nullptr), 0));
+		subscription->parked = true;
+		subscription->pull = {std::move(completion), limit, now + std::min<Clock::duration>(timeout, until_termination)};
+
+		if (!thread.joinable()) {
+			thread = std::thread(&EventBroker::run, this);
+		}
+	}
+	wake.notify_one();
+	return true;
+}
+
+
+void EventBroker::run() {
+	std::unique_lock<std::mutex> lock(mutex);
+	while (!stopping) {
+		expire();
+		std::vector<Finished> finished;
+		finished.swap(abandoned);
+
+		auto now = Clock::now();
+		auto next = Clock::time_point::max();
+		for (auto &entry : subscriptions) {
+			auto &subscription = entry.second;
+			if (!subscription.parked) {
+				continue;
+			}
+			if (subscription.ring.size() > 0 || subscription.pull.deadline <= now) {
+				subscription.parked = false;
+				finished.push_back({std::move(subscription.pull.completion), subscription.ring.take(subscription.pull.limit), subscription.termination_time});
+			} else {
+				next = std::min(next, subscription.pull.deadline);
+			}
+		}
+
+		if (!finished.empty()) {
+			// Completing a pull means sending the response, which publish and park shouldn't wait for.
+			lock.unlock();
+			for (auto &pull : finished) {
+				pull.completion(std::move(pull.events), pull.termination_time);
+			}
+			lock.lock();
+		} else if (next == Clock::time_point::max()) {
+			wake.wait(lock);
+		} else {
+			wake.wait_until(lock, next);
+		}
+	}
+}
+
+
+void EventBroker::stop() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	if (thread.joinable()) {
+		thread.join();
+	}
+
+	std::vector<Finished> finished;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		finished.swap(abandoned);
+		for (auto &entry : subscriptions) {
+			abandon(entry.second, entry.second.termination_time);
+		}
+		finished.insert(finished.end(), std::make_move_iterator(abandoned.begin()), std::make_move_iterator(abandoned.end()));
+		abandoned.clear();
+	}
+	for (auto &pull : finished) {
+		pull.completion({}, pull.termination_time);
+	}
+}
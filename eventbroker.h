@@ -0,0 +1,152 @@
+/*
+ * Copyright 2023 Morse Micro
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#pragma once
+
+#include <time.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+
+/* An ONVIF notification (e.g. tns1:Media/ConfigurationChanged) and its SimpleItems. */
+struct Event {
+	using Items = std::vector<std::pair<std::string, std::string>>;
+
+	time_t utc_time;
+	std::string topic;
+	Items source;
+	Items data;
+};
+
+
+/* The newest capacity events: once it's full, each push drops the oldest. */
+class EventRing {
+	private:
+		std::vector<Event> events;
+		size_t head;  // The oldest.
+		size_t count;
+		unsigned long dropped;
+
+	public:
+		explicit EventRing(size_t capacity);
+
+		void push(const Event &event);
+
+		/* Removes (and returns) up to limit of the oldest. */
+		std::vector<Event> take(size_t limit);
+
+		size_t size() const { return count; }
+		size_t capacity() const { return events.size(); }
+
+		/* How many have been pushed out by newer events since it was created. */
+		unsigned long droppedCount() const { return dropped; }
+};
+
+
+/* The PullPoint subscriptions, each of which gets its own EventRing of everything published.
+ *
+ * A PullMessages that finds nothing waiting is parked here rather than holding the thread
+ * serving it. The broker's one thread then completes each parked pull as soon as its
+ * subscription has an event, or with nothing once its timeout is up.
+ *
+ * Subscriptions that reach their termination time without being renewed are dropped.
+ */
+class EventBroker {
+	public:
+		using Clock = std::chrono::steady_clock;
+
+		/* Called on the broker's thread (without its lock) with the events, which may be none,
+		 * and the subscription's termination time (0 if it's been unsubscribed).
+		 */
+		using Completion = std::function<void(std::vector<Event> events, time_t termination_time)>;
+
+		static const size_t DEFAULT_CAPACITY = 64;
+		static const size_t DEFAULT_MAX_SUBSCRIPTIONS = 8;
+
+	private:
+		struct Parked {
+			Completion completion;
+			size_t limit;
+			Clock::time_point deadline;
+		};
+
+		struct Subscription {
+			EventRing ring;
+			time_t termination_time;
+			bool parked;
+			Parked pull;
+
+			explicit Subscription(size_t capacity, time_t termination_time)
+				: ring(capacity), termination_time(termination_time), parked(false) {}
+		};
+
+		struct Finished {
+			Completion completion;
+			std::vector<Event> events;
+			time_t termination_time;
+		};
+
+		size_t capacity;
+		size_t max_subscriptions;
+		int next_id;
+		std::map<int, Subscription> subscriptions;
+		// Parked pulls whose subscription has gone (or been parked on again), for the thread to complete.
+		std::vector<Finished> abandoned;
+		std::mutex mutex;
+		std::condition_variable wake;
+		bool stopping;
+		std::thread thread;
+
+		// All under mutex.
+		Subscription *find(int id);
+		void expire();
+		void abandon(Subscription &subscription, time_t termination_time);
+
+		void run();
+
+	public:
+		explicit EventBroker(size_t capacity = DEFAULT_CAPACITY, size_t max_subscriptions = DEFAULT_MAX_SUBSCRIPTIONS);
+		~EventBroker();
+
+		EventBroker(const EventBroker &) = delete;
+		EventBroker &operator=(const EventBroker &) = delete;
+
+		size_t getMaxSubscriptions() const { return max_subscriptions; }
+
+		/* Returns the new subscription's id, or -1 if there are already max_subscriptions. */
+		int subscribe(time_t termination_time);
+
+		bool renew(int id, time_t termination_time);
+
+		/* Completes any pull parked on it with nothing. */
+		bool unsubscribe(int id);
+
+		/* 0 if there's no such subscription. */
+		time_t getTerminationTime(int id);
+
+		/* Queues event for every subscription, waking any pull parked on them. */
+		void publish(const Event &event);
+
+		/* Takes up to limit events without waiting. False if there's no such subscription. */
+		bool pull(int id, size_t limit, std::vector<Event> *events);
+
+		/* Has completion called with up to limit events as soon as the subscription has any,
+		 * or with none after timeout (or at its termination time, if that's sooner).
+		 * A pull already parked on it is completed with nothing first (i.e. the client gave up).
+		 * False if there's no such subscription.
+		 */
+		bool park(int id, size_t limit, std::chrono::milliseconds timeout, Completion completion);
+
+		/* Completes every parked pull with nothing and stops the thread. */
+		void stop();
+};
@@ -0,0 +1,365 @@
+// Copyright 2023 Morse Micro
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include "soaplib/soapH.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#include "camera.h"
+#include "eventbroker.h"
+#include "log.h"
+#include "utils.h"
+
+
+// The Events service: PullPoint subscriptions to what the Camera publishes (see eventbroker.h).
+// Each subscription has its own address, which the PullPointSubscriptionBinding and
+// SubscriptionManagerBinding requests are sent to.
+
+static const char SUBSCRIPTION_PATH[] = "/onvif/subscription/";
+static const char TOPIC_DIALECT[] = "http://www.onvif.org/ver10/tev/topicExpression/ConcreteSet";
+
+static const time_t DEFAULT_SUBSCRIPTION_SECONDS = 60;
+static const time_t MAX_SUBSCRIPTION_SECONDS = 3600;
+static const std::chrono::seconds MAX_PULL_TIMEOUT(60);
+
+// What Camera::publishChange and Camera::publishStreamRestarted send.
+static const char TOPIC_SET[] =
+	"<tns1:Media>"
+		"<ProfileChanged wstop:topic=\"true\">"
+			"<tt:MessageDescription IsProperty=\"false\">"
+				"<tt:Source><tt:SimpleItemDescription Name=\"Token\" Type=\"tt:ReferenceToken\"/></tt:Source>"
+			"</tt:MessageDescription>"
+		"</ProfileChanged>"
+		"<ConfigurationChanged wstop:topic=\"true\">"
+			"<tt:MessageDescription IsProperty=\"false\">"
+				"<tt:Source><tt:SimpleItemDescription Name=\"Token\" Type=\"tt:ReferenceToken\"/></tt:Source>"
+				"<tt:Data><tt:SimpleItemDescription Name=\"Type\" Type=\"xsd:string\"/></tt:Data>"
+			"</tt:MessageDescription>"
+		"</ConfigurationChanged>"
+		"<StreamRestarted wstop:topic=\"true\">"
+			"<tt:MessageDescription IsProperty=\"false\">"
+				"<tt:Source><tt:SimpleItemDescription Name=\"Token\" Type=\"tt:ReferenceToken\"/></tt:Source>"
+			"</tt:MessageDescription>"
+		"</StreamRestarted>"
+	"</tns1:Media>"
+	"<tns1:VideoSource>"
+		"<ImagingSettingsChanged wstop:topic=\"true\">"
+			"<tt:MessageDescription IsProperty=\"false\">"
+				"<tt:Source><tt:SimpleItemDescription Name=\"VideoSourceToken\" Type=\"tt:ReferenceToken\"/></tt:Source>"
+			"</tt:MessageDescription>"
+		"</ImagingSettingsChanged>"
+	"</tns1:VideoSource>";
+
+static bool *new_bool(struct soap *soap, bool value) {
+	auto *result = static_cast<bool *>(soap_malloc(soap, sizeof(bool)));
+	*result = value;
+	return result;
+}
+
+static int *new_int(struct soap *soap, int value) {
+	auto *result = static_cast<int *>(soap_malloc(soap, sizeof(int)));
+	*result = value;
+	return result;
+}
+
+// xs:duration, as far as days (months and years aren't a fixed length), e.g. PT1M30S.
+static bool parse_duration(const std::string &text, std::chrono::milliseconds *duration) {
+	const char *p = text.c_str();
+	if (*p++ != 'P') {
+		return false;
+	}
+	bool in_time = false;
+	bool any = false;
+	double ms = 0;
+	while (*p != '\0') {
+		if (*p == 'T' && !in_time) {
+			in_time = true;
+			++p;
+			continue;
+		}
+		char *end;
+		double value = strtod(p, &end);
+		if (end == p || !(value >= 0)) {
+			return false;
+		}
+		if (*end == 'D' && !in_time) {
+			ms += value * 24 * 60 * 60 * 1000;
+		} else if (*end == 'H' && in_time) {
+			ms += value * 60 * 60 * 1000;
+		} else if (*end == 'M' && in_time) {
+			ms += value * 60 * 1000;
+		} else if (*end == 'S' && in_time) {
+			ms += value * 1000;
+		} else {
+			return false;
+		}
+		any = true;
+		p = end + 1;
+	}
+	*duration = std::chrono::milliseconds(static_cast<long long>(ms));
+	return any;
+}
+
+// An InitialTerminationTime or Renew's TerminationTime, which is either a dateTime or a duration from now.
+static bool parse_termination_time(struct soap *soap, const std::string &text, time_t now, time_t *termination_time) {
+	std::chrono::milliseconds duration;
+	if (parse_duration(text, &duration)) {
+		*termination_time = now + std::chrono::duration_cast<std::chrono::seconds>(duration).count();
+		return true;
+	}
+	if (soap_s2dateTime(soap, text.c_str(), termination_time) == SOAP_OK) {
+		return true;
+	}
+	soap->error = SOAP_OK;
+	return false;
+}
+
+// Missing means the default, and we cap it rather than refuse it.
+static int termination_time(struct soap *soap, const std::string *requested, time_t now, time_t *result) {
+	if (requested == nullptr || requested->empty()) {
+		*result = now + DEFAULT_SUBSCRIPTION_SECONDS;
+		return SOAP_OK;
+	}
+	if (!parse_termination_time(soap, *requested, now, result) || *result <= now) {
+		return onvif_sender_fault(soap, "ter:InvalidArgVal", "ter:UnacceptableTerminationTime", "Unacceptable termination time: " + *requested);
+	}
+	*result = std::min(*result, now + MAX_SUBSCRIPTION_SECONDS);
+	return SOAP_OK;
+}
+
+// Which subscription the request was sent to: the path it was posted to, or failing that
+// (e.g. behind a proxy) its WS-Addressing To. -1 if neither is a subscription's address.
+static int subscription_id(struct soap *soap) {
+	const char *address = strstr(soap->path, SUBSCRIPTION_PATH);
+	if (address == nullptr && soap->header != nullptr && soap->header->wsa5__To != nullptr) {
+		address = strstr(soap->header->wsa5__To, SUBSCRIPTION_PATH);
+	}
+	if (address == nullptr) {
+		return -1;
+	}
+	address += sizeof(SUBSCRIPTION_PATH) - 1;
+	char *end;
+	long id = strtol(address, &end, 10);
+	return end == address || id <= 0 || id > INT32_MAX ? -1 : static_cast<int>(id);
+}
+
+static int no_subscription(struct soap *soap) {
+	return onvif_sender_fault(soap, "ter:InvalidArgVal", "ter:NoSubscription", "No such subscription");
+}
+
+static tt__ItemList *new_item_list(struct soap *soap, const Event::Items &items) {
+	auto *list = soap_new_tt__ItemList(soap);
+	for (auto &item : items) {
+		auto *simple_item = soap_new__tt__ItemList_SimpleItem(soap);
+		simple_item->Name = item.first;
+		simple_item->Value = item.second;
+		list->SimpleItem.push_back(*simple_item);
+	}
+	return list;
+}
+
+static wsnt__NotificationMessageHolderType *new_notification(struct soap *soap, const Event &event) {
+	auto *notification = soap_new_wsnt__NotificationMessageHolderType(soap);
+	notification->Topic = soap_new_wsnt__TopicExpressionType(soap);
+	notification->Topic->Dialect = TOPIC_DIALECT;
+	notification->Topic->__mixed = soap_strdup(soap, event.topic.c_str());
+	auto *message = soap_new__tt__Message(soap);
+	message->UtcTime = event.utc_time;
+	if (!event.source.empty()) {
+		message->Source = new_item_list(soap, event.source);
+	}
+	if (!event.data.empty()) {
+		message->Data = new_item_list(soap, event.data);
+	}
+	notification->Message.tt__Message = message;
+	return notification;
+}
+
+static void set_messages(struct soap *soap, _tev__PullMessagesResponse &response, const std::vector<Event> &events, time_t termination_time) {
+	response.CurrentTime = time(nullptr);
+	// i.e. it's been unsubscribed (or expired) while the pull was parked.
+	response.TerminationTime = termination_time != 0 ? termination_time : response.CurrentTime;
+	for (auto &event : events) {
+		response.wsnt__NotificationMessage.push_back(new_notification(soap, event));
+	}
+}
+
+// What soap_serve___tev__PullMessages does with a handler's response (see soapServer.cpp),
+// for a pull that was parked and so never got one.
+static int send_pull_messages_response(struct soap *soap, _tev__PullMessagesResponse &response) {
+	soap->encodingStyle = NULL;
+	soap_serializeheader(soap);
+	response.soap_serialize(soap);
+	if (soap_begin_count(soap)) {
+		return soap->error;
+	}
+	if (soap->mode & SOAP_IO_LENGTH) {
+		if (soap_envelope_begin_out(soap) || soap_putheader(soap) || soap_body_begin_out(soap)
+				|| response.soap_put(soap, "tev:PullMessagesResponse", "")
+				|| soap_body_end_out(soap) || soap_envelope_end_out(soap)) {
+			return soap->error;
+		}
+	}
+	if (soap_end_count(soap) || soap_response(soap, SOAP_OK) || soap_envelope_begin_out(soap)
+			|| soap_putheader(soap) || soap_body_begin_out(soap)
+			|| response.soap_put(soap, "tev:PullMessagesResponse", "")
+			|| soap_body_end_out(soap) || soap_envelope_end_out(soap) || soap_end_send(soap)) {
+		return soap->error;
+	}
+	return soap_closesock(soap);
+}
+
+// On the broker's thread: parked is the connection PullMessages handed over, which is ours to free.
+static void complete_pull(struct soap *parked, std::vector<Event> events, time_t termination_time) {
+	auto *response = soap_new__tev__PullMessagesResponse(parked);
+	set_messages(parked, *response, events, termination_time);
+	if (send_pull_messages_response(parked, *response) != SOAP_OK) {
+		LOG_DEBUG("Unable to send a parked PullMessages response (error " << parked->error << ")");
+	}
+	soap_destroy(parked);
+	soap_end(parked);
+	soap_free(parked);
+}
+
+
+int __tev__GetServiceCapabilities(struct soap *soap, _tev__GetServiceCapabilities *request, _tev__GetServiceCapabilitiesResponse &response) {
+	auto *camera = static_cast<Camera *>(soap->user);
+
+	response.Capabilities = soap_new_tev__Capabilities(soap);
+	response.Capabilities->WSSubscriptionPolicySupport = new_bool(soap, false);
+	// That's the WS-BaseNotification CreatePullPoint, not ours.
+	response.Capabilities->WSPullPointSupport = new_bool(soap, false);
+	response.Capabilities->WSPausableSubscriptionManagerInterfaceSupport = new_bool(soap, false);
+	response.Capabilities->MaxNotificationProducers = new_int(soap, 0);
+	response.Capabilities->MaxPullPoints = new_int(soap, static_cast<int>(camera->getEventBroker().getMaxSubscriptions()));
+	response.Capabilities->PersistentNotificationStorage = new_bool(soap, false);
+
+	return SOAP_OK;
+}
+
+int __tev__CreatePullPointSubscription(struct soap *soap, _tev__CreatePullPointSubscription *request, _tev__CreatePullPointSubscriptionResponse &response) {
+	auto *camera = static_cast<Camera *>(soap->user);
+
+	// Filter isn't parsed (it's xsd:any), so everything is delivered; clients filter what they get anyway.
+	time_t now = time(nullptr);
+	time_t termination;
+	if (termination_time(soap, request->InitialTerminationTime, now, &termination) != SOAP_OK) {
+		return soap->error;
+	}
+	int id = camera->getEventBroker().subscribe(termination);
+	if (id < 0) {
+		return onvif_receiver_fault(soap, "ter:Action", "ter:MaxPullPoints", "Too many subscriptions");
+	}
+
+	std::string address = camera->getOnvifURL() + SUBSCRIPTION_PATH + std::to_string(id);
+	response.SubscriptionReference.Address = soap_strdup(soap, address.c_str());
+	response.wsnt__CurrentTime = now;
+	response.wsnt__TerminationTime = termination;
+
+	return SOAP_OK;
+}
+
+int __tev__PullMessages(struct soap *soap, _tev__PullMessages *request, _tev__PullMessagesResponse &response) {
+	auto *camera = static_cast<Camera *>(soap->user);
+	auto &broker = camera->getEventBroker();
+
+	int id = subscription_id(soap);
+	std::chrono::milliseconds timeout;
+	if (!parse_duration(request->Timeout, &timeout)) {
+		return onvif_sender_fault(soap, "ter:InvalidArgVal", "ter:InvalidTimeout", "Invalid timeout: " + request->Timeout);
+	}
+	timeout = std::min<std::chrono::milliseconds>(timeout, MAX_PULL_TIMEOUT);
+	size_t limit = static_cast<size_t>(std::max(request->MessageLimit, 1));
+
+	std::vector<Event> events;
+	if (!broker.pull(id, limit, &events)) {
+		return no_subscription(soap);
+	}
+	if (!events.empty() || timeout.count() == 0 || !soap_valid_socket(soap->socket)) {
+		set_messages(soap, response, events, broker.getTerminationTime(id));
+		return SOAP_OK;
+	}
+
+	// Nothing yet: hand the connection to the broker, which answers on it once there's
+	// something (or the timeout's up), so that this thread can serve other requests meanwhile.
+	// The response closes the connection, as a request can't be read while it's pending.
+	struct soap *parked = soap_copy(soap);
+	parked->keep_alive = 0;
+#ifdef WITH_OPENSSL
+	// soap_copy doesn't copy the TLS connection (without it, the response would go out in the clear).
+	parked->ssl = soap->ssl;
+#endif
+	if (!broker.park(id, limit, timeout, [parked] (std::vector<Event> events, time_t termination_time) {
+				complete_pull(parked, std::move(events), termination_time);
+			})) {
+		// e.g. we're shutting down.
+		parked->socket = SOAP_INVALID_SOCKET;
+#ifdef WITH_OPENSSL
+		parked->ssl = nullptr;
+#endif
+		soap_free(parked);
+		set_messages(soap, response, events, broker.getTerminationTime(id));
+		return SOAP_OK;
+	}
+	// It's parked's now: don't let serve close it or read another request from it.
+	soap->socket = SOAP_INVALID_SOCKET;
+#ifdef WITH_OPENSSL
+	soap->ssl = nullptr;
+#endif
+	soap->keep_alive = 0;
+	return SOAP_STOP;
+}
+
+int __tev__SetSynchronizationPoint(struct soap *soap, _tev__SetSynchronizationPoint *request, _tev__SetSynchronizationPointResponse &response) {
+	auto *camera = static_cast<Camera *>(soap->user);
+
+	// None of our topics are properties, so there's no state to send again.
+	if (camera->getEventBroker().getTerminationTime(subscription_id(soap)) == 0) {
+		return no_subscription(soap);
+	}
+	return SOAP_OK;
+}
+
+int __tev__Unsubscribe(struct soap *soap, _wsnt__Unsubscribe *wsnt__Unsubscribe, _wsnt__UnsubscribeResponse &wsnt__UnsubscribeResponse) {
+	auto *camera = static_cast<Camera *>(soap->user);
+
+	if (!camera->getEventBroker().unsubscribe(subscription_id(soap))) {
+		return no_subscription(soap);
+	}
+	return SOAP_OK;
+}
+
+int __tev__Renew(struct soap *soap, _wsnt__Renew *request, _wsnt__RenewResponse &response) {
+	auto *camera = static_cast<Camera *>(soap->user);
+
+	time_t now = time(nullptr);
+	time_t termination;
+	if (termination_time(soap, request->TerminationTime, now, &termination) != SOAP_OK) {
+		return soap->error;
+	}
+	if (!camera->getEventBroker().renew(subscription_id(soap), termination)) {
+		return no_subscription(soap);
+	}
+	response.TerminationTime = termination;
+	response.CurrentTime = static_cast<time_t *>(soap_malloc(soap, sizeof(time_t)));
+	*response.CurrentTime = now;
+
+	return SOAP_OK;
+}
+
+int __tev__GetEventProperties(struct soap *soap, _tev__GetEventProperties *request, _tev__GetEventPropertiesResponse &response) {
+	response.TopicNamespaceLocation.push_back("http://www.onvif.org/onvif/ver10/topics/topicns.xml");
+	response.wsnt__FixedTopicSet = true;
+	response.wstop__TopicSet = soap_new_wstop__TopicSetType(soap);
+	response.wstop__TopicSet->__any = soap_strdup(soap, TOPIC_SET);
+	response.wsnt__TopicExpressionDialect.push_back(TOPIC_DIALECT);
+	response.wsnt__TopicExpressionDialect.push_back("http://docs.oasis-open.org/wsn/t-1/TopicExpression/Concrete");
+	response.MessageContentFilterDialect.push_back("http://www.onvif.org/ver10/tev/messageContentFilter/ItemFilter");
+	response.MessageContentSchemaLocation.push_back("http://www.onvif.org/onvif/ver10/schema/onvif.xsd");
+
+	return SOAP_OK;
+}
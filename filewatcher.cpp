@@ -0,0 +1,142 @@
+// Copyright 2023 Morse Micro
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+#include "filewatcher.h"
+#include "log.h"
+
+
+static std::string dir_of(const std::string &path) {
+	size_t slash = path.rfind('/');
+	return slash == std::string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+}
+
+
+static std::string name_of(const std::string &path) {
+	size_t slash = path.rfind('/');
+	return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+
+FileWatcher::FileWatcher(const std::vector<std::string> &paths, Listener listener, int settle_ms)
+		: paths(paths), listener(std::move(listener)), settle_ms(settle_ms), inotify_fd(-1), wake_pipe{-1, -1} {
+}
+
+
+FileWatcher::~FileWatcher() {
+	stop();
+	for (int fd : {inotify_fd, wake_pipe[0], wake_pipe[1]}) {
+		if (fd != -1) {
+			close(fd);
+		}
+	}
+}
+
+
+void FileWatcher::start() {
+	inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (inotify_fd == -1) {
+		throw std::runtime_error(std::string("Unable to initialise inotify: ") + strerror(errno));
+	}
+	for (auto &path : paths) {
+		// Only the final rename or close matters; the file is incomplete before then.
+		int wd = inotify_add_watch(inotify_fd, dir_of(path).c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+		if (wd == -1) {
+			throw std::runtime_error("Unable to watch " + dir_of(path) + ": " + strerror(errno));
+		}
+		watched_dirs[wd] = dir_of(path);
+	}
+	if (pipe2(wake_pipe, O_CLOEXEC) == -1) {
+		throw std::runtime_error(std::string("Unable to create pipe: ") + strerror(errno));
+	}
+
+	thread = std::thread(&FileWatcher::run, this);
+}
+
+
+void FileWatcher::stop() {
+	if (thread.joinable()) {
+		char c = 0;
+		if (write(wake_pipe[1], &c, 1) != 1) {
+			LOG_ERROR("Unable to wake file watcher thread: " << strerror(errno));
+		}
+		thread.join();
+	}
+}
+
+
+void FileWatcher::run() {
+	using clock = std::chrono::steady_clock;
+	alignas(struct inotify_event) char buffer[4096];
+	pollfd fds[] = {{inotify_fd, POLLIN, 0}, {wake_pipe[0], POLLIN, 0}};
+	std::map<std::string, clock::time_point> pending;  // Path -> when it settles.
+
+	while (true) {
+		int timeout = -1;
+		if (!pending.empty()) {
+			auto settles = std::min_element(pending.begin(), pending.end(),
+				[] (const auto &a, const auto &b) { return a.second < b.second; })->second;
+			timeout = std::max<long>(0, std::chrono::duration_cast<std::chrono::milliseconds>(settles - clock::now()).count());
+		}
+
+		int ready = poll(fds, 2, timeout);
+		if (ready == -1) {
+			if (errno == EINTR) {
+				continue;
+			}
+			LOG_ERROR("File watcher poll failed: " << strerror(errno));
+			return;
+		}
+		if (fds[1].revents) {
+			return;
+		}
+
+		if (fds[0].revents) {
+			ssize_t length = read(inotify_fd, buffer, sizeof(buffer));
+			if (length == -1 && errno != EAGAIN && errno != EINTR) {
+				LOG_ERROR("Unable to read inotify events: " << strerror(errno));
+				return;
+			}
+			for (ssize_t offset = 0; offset < length; ) {
+				auto *event = reinterpret_cast<const struct inotify_event *>(buffer + offset);
+				offset += sizeof(struct inotify_event) + event->len;
+				if (event->mask & IN_Q_OVERFLOW) {
+					// We don't know what we missed, so assume everything changed.
+					for (auto &path : paths) {
+						pending[path] = clock::now() + std::chrono::milliseconds(settle_ms);
+					}
+					continue;
+				}
+				if (event->len == 0) {
+					continue;
+				}
+				auto dir = watched_dirs.find(event->wd);
+				for (auto &path : paths) {
+					if (dir != watched_dirs.end() && dir_of(path) == dir->second && name_of(path) == event->name) {
+						pending[path] = clock::now() + std::chrono::milliseconds(settle_ms);
+					}
+				}
+			}
+		}
+
+		auto now = clock::now();
+		for (auto it = pending.begin(); it != pending.end(); ) {
+			if (it->second <= now) {
+				listener(it->first);
+				it = pending.erase(it);
+			} else {
+				++it;
+			}
+		}
+	}
+}
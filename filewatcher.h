@@ -0,0 +1,49 @@
+/*
+ * Copyright 2023 Morse Micro
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#pragma once
+
+#include <functional>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+/* Calls back (on a background thread) when any of a set of files is rewritten.
+ *
+ * Watches each file's directory rather than the file itself, as editors (and
+ * write_file_atomically) replace the file by renaming over it, which would
+ * orphan a watch on the old inode. Changes are reported once a file has been
+ * quiet for settle_ms, so a burst of writes is only reported once.
+ */
+class FileWatcher {
+	public:
+		using Listener = std::function<void(const std::string &path)>;
+
+	private:
+		std::vector<std::string> paths;
+		Listener listener;
+		int settle_ms;
+		int inotify_fd;
+		int wake_pipe[2];
+		std::map<int, std::string> watched_dirs;  // By watch descriptor.
+		std::thread thread;
+
+		void run();
+
+	public:
+		FileWatcher(const std::vector<std::string> &paths, Listener listener, int settle_ms = 200);
+		~FileWatcher();
+
+		FileWatcher(const FileWatcher &) = delete;
+		FileWatcher &operator=(const FileWatcher &) = delete;
+
+		/* Throws std::runtime_error if inotify isn't available. */
+		void start();
+
+		/* Stops the background thread (so the listener won't be called again). */
+		void stop();
+};
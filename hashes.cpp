@@ -0,0 +1,379 @@
+// Copyright 2023 Morse Micro
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <string.h>
+
+#include <algorithm>
+#include <new>
+
+#include "hashes.h"
+
+
+#ifdef WITH_OPENSSL
+
+static EVP_MD_CTX *new_digest(const EVP_MD *md) {
+	EVP_MD_CTX *ctx = EVP_MD_CTX_new();
+	if (ctx == nullptr || EVP_DigestInit_ex(ctx, md, nullptr) != 1) {
+		throw std::bad_alloc();
+	}
+	return ctx;
+}
+
+
+template <size_t N>
+static std::array<uint8_t, N> finish_digest(EVP_MD_CTX *ctx) {
+	std::array<uint8_t, N> digest;
+	unsigned int length = N;
+	EVP_DigestFinal_ex(ctx, digest.data(), &length);
+	return digest;
+}
+
+
+Sha1::Sha1() : ctx(new_digest(EVP_sha1())) {
+}
+
+
+Sha1::~Sha1() {
+	EVP_MD_CTX_free(ctx);
+}
+
+
+Sha1 &Sha1::update(const void *data, size_t length) {
+	EVP_DigestUpdate(ctx, data, length);
+	return *this;
+}
+
+
+Sha1::Digest Sha1::finish() {
+	return finish_digest<20>(ctx);
+}
+
+
+Md5::Md5() : ctx(new_digest(EVP_md5())) {
+}
+
+
+Md5::~Md5() {
+	EVP_MD_CTX_free(ctx);
+}
+
+
+Md5 &Md5::update(const void *data, size_t length) {
+	EVP_DigestUpdate(ctx, data, length);
+	return *this;
+}
+
+
+Md5::Digest Md5::finish() {
+	return finish_digest<16>(ctx);
+}
+
+#else
+
+static inline uint32_t rotl(uint32_t x, int n) {
+	return (x << n) | (x >> (32 - n));
+}
+
+
+Sha1::Sha1() : state{0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0}, block_length(0), total_length(0) {
+}
+
+
+void Sha1::compress(const uint8_t *data) {
+	uint32_t w[80];
+	for (int i = 0; i < 16; ++i) {
+		w[i] = uint32_t(data[4 * i]) << 24 | uint32_t(data[4 * i + 1]) << 16 | uint32_t(data[4 * i + 2]) << 8 | data[4 * i + 3];
+	}
+	for (int i = 16; i < 80; ++i) {
+		w[i] = rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+	}
+
+	uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+	for (int i = 0; i < 80; ++i) {
+		uint32_t f, k;
+		if (i < 20) {
+			f = (b & c) | (~b & d);
+			k = 0x5a827999;
+		} else if (i < 40) {
+			f = b ^ c ^ d;
+			k = 0x6ed9eba1;
+		} else if (i < 60) {
+			f = (b & c) | (b & d) | (c & d);
+			k = 0x8f1bbcdc;
+		} else {
+			f = b ^ c ^ d;
+			k = 0xca62c1d6;
+		}
+		uint32_t t = rotl(a, 5) + f + e + k + w[i];
+		e = d;
+		d = c;
+		c = rotl(b, 30);
+		b = a;
+		a = t;
+	}
+	state[0] += a;
+	state[1] += b;
+	state[2] += c;
+	state[3] += d;
+	state[4] += e;
+}
+
+
+Sha1 &Sha1::update(const void *data, size_t length) {
+	auto *bytes = static_cast<const uint8_t *>(data);
+	total_length += length;
+	while (length > 0) {
+		if (block_length == 0 && length >= sizeof(block)) {
+			compress(bytes);
+			bytes += sizeof(block);
+			length -= sizeof(block);
+			continue;
+		}
+		size_t n = std::min(length, sizeof(block) - block_length);
+		memcpy(block + block_length, bytes, n);
+		block_length += n;
+		bytes += n;
+		length -= n;
+		if (block_length == sizeof(block)) {
+			compress(block);
+			block_length = 0;
+		}
+	}
+	return *this;
+}
+
+
+Sha1::Digest Sha1::finish() {
+	uint64_t bits = total_length * 8;
+	uint8_t padding = 0x80;
+	update(&padding, 1);
+	padding = 0;
+	while (block_length != 56) {
+		update(&padding, 1);
+	}
+	uint8_t length[8];
+	for (int i = 0; i < 8; ++i) {
+		length[i] = uint8_t(bits >> (56 - 8 * i));
+	}
+	update(length, sizeof(length));
+
+	Digest digest;
+	for (int i = 0; i < 20; ++i) {
+		digest[i] = uint8_t(state[i / 4] >> (24 - 8 * (i % 4)));
+	}
+	return digest;
+}
+
+
+// Per-round shifts and constants (floor(abs(sin(i + 1)) * 2^32)) from RFC 1321.
+static const int MD5_SHIFTS[64] = {
+	7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
+	5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20,
+	4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+	6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21,
+};
+
+static const uint32_t MD5_CONSTANTS[64] = {
+	0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+	0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+	0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+	0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+	0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+	0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+	0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+	0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391,
+};
+
+
+Md5::Md5() : state{0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476}, block_length(0), total_length(0) {
+}
+
+
+void Md5::compress(const uint8_t *data) {
+	uint32_t m[16];
+	for (int i = 0; i < 16; ++i) {
+		m[i] = data[4 * i] | uint32_t(data[4 * i + 1]) << 8 | uint32_t(data[4 * i + 2]) << 16 | uint32_t(data[4 * i + 3]) << 24;
+	}
+
+	uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+	for (int i = 0; i < 64; ++i) {
+		uint32_t f;
+		int g;
+		if (i < 16) {
+			f = (b & c) | (~b & d);
+			g = i;
+		} else if (i < 32) {
+			f = (d & b) | (~d & c);
+			g = (5 * i + 1) % 16;
+		} else if (i < 48) {
+			f = b ^ c ^ d;
+			g = (3 * i + 5) % 16;
+		} else {
+			f = c ^ (b | ~d);
+			g = (7 * i) % 16;
+		}
+		uint32_t t = d;
+		d = c;
+		c = b;
+		b = b + rotl(a + f + MD5_CONSTANTS[i] + m[g], MD5_SHIFTS[i]);
+		a = t;
+	}
+	state[0] += a;
+	state[1] += b;
+	state[2] += c;
+	state[3] += d;
+}
+
+
+Md5 &Md5::update(const void *data, size_t length) {
+	auto *bytes = static_cast<const uint8_t *>(data);
+	total_length += length;
+	while (length > 0) {
+		if (block_length == 0 && length >= sizeof(block)) {
+			compress(bytes);
+			bytes += sizeof(block);
+			length -= sizeof(block);
+			continue;
+		}
+		size_t n = std::min(length, sizeof(block) - block_length);
+		memcpy(block + block_length, bytes, n);
+		block_length += n;
+		bytes += n;
+		length -= n;
+		if (block_length == sizeof(block)) {
+			compress(block);
+			block_length = 0;
+		}
+	}
+	return *this;
+}
+
+
+Md5::Digest Md5::finish() {
+	uint64_t bits = total_length * 8;
+	uint8_t padding = 0x80;
+	update(&padding, 1);
+	padding = 0;
+	while (block_length != 56) {
+		update(&padding, 1);
+	}
+	uint8_t length[8];
+	for (int i = 0; i < 8; ++i) {
+		length[i] = uint8_t(bits >> (8 * i));
+	}
+	update(length, sizeof(length));
+
+	Digest digest;
+	for (int i = 0; i < 16; ++i) {
+		digest[i] = uint8_t(state[i / 4] >> (8 * (i % 4)));
+	}
+	return digest;
+}
+
+#endif
+
+
+std::string to_hex(const uint8_t *data, size_t length) {
+	static const char digits[] = "0123456789abcdef";
+	std::string hex(2 * length, '\0');
+	for (size_t i = 0; i < length; ++i) {
+		hex[2 * i] = digits[data[i] >> 4];
+		hex[2 * i + 1] = digits[data[i] & 0xf];
+	}
+	return hex;
+}
+
+
+#ifdef WITH_OPENSSL
+
+std::string base64_encode(const uint8_t *data, size_t length) {
+	// Plus the NUL it adds.
+	std::string text((length + 2) / 3 * 4 + 1, '\0');
+	text.resize(EVP_EncodeBlock(reinterpret_cast<unsigned char *>(&text[0]), data, length));
+	return text;
+}
+
+#else
+
+static const char BASE64_DIGITS[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+
+std::string base64_encode(const uint8_t *data, size_t length) {
+	std::string text;
+	text.reserve((length + 2) / 3 * 4);
+	for (size_t i = 0; i < length; i += 3) {
+		uint32_t group = uint32_t(data[i]) << 16;
+		if (i + 1 < length) {
+			group |= uint32_t(data[i + 1]) << 8;
+		}
+		if (i + 2 < length) {
+			group |= data[i + 2];
+		}
+		text += BASE64_DIGITS[group >> 18];
+		text += BASE64_DIGITS[(group >> 12) & 0x3f];
+		text += i + 1 < length ? BASE64_DIGITS[(group >> 6) & 0x3f] : '=';
+		text += i + 2 < length ? BASE64_DIGITS[group & 0x3f] : '=';
+	}
+	return text;
+}
+
+#endif
+
+
+static int base64_value(char c) {
+	if (c >= 'A' && c <= 'Z') {
+		return c - 'A';
+	} else if (c >= 'a' && c <= 'z') {
+		return c - 'a' + 26;
+	} else if (c >= '0' && c <= '9') {
+		return c - '0' + 52;
+	} else if (c == '+') {
+		return 62;
+	} else if (c == '/') {
+		return 63;
+	}
+	return -1;
+}
+
+
+// Even with TLS=1: EVP_DecodeBlock neither skips whitespace in the middle nor says how much was padding.
+bool base64_decode(const std::string &text, std::string *data) {
+	data->clear();
+	data->reserve(text.size() / 4 * 3);
+	uint32_t group = 0;
+	int bits = 0;
+	bool padded = false;
+	for (char c : text) {
+		if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+			continue;
+		}
+		if (c == '=') {
+			padded = true;
+			continue;
+		}
+		int value = base64_value(c);
+		if (value < 0 || padded) {
+			return false;
+		}
+		group = (group << 6) | uint32_t(value);
+		bits += 6;
+		if (bits >= 8) {
+			bits -= 8;
+			data->push_back(char((group >> bits) & 0xff));
+		}
+	}
+	// Anything left over must be padding.
+	return bits < 6;
+}
+
+
+bool constant_time_equal(const std::string &a, const std::string &b) {
+	if (a.size() != b.size()) {
+		return false;
+	}
+	unsigned char difference = 0;
+	for (size_t i = 0; i < a.size(); ++i) {
+		difference |= static_cast<unsigned char>(a[i] ^ b[i]);
+	}
+	return difference == 0;
+}
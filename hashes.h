@@ -0,0 +1,97 @@
+/*
+ * Copyright 2023 Morse Micro
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <array>
+#include <string>
+
+#ifdef WITH_OPENSSL
+#include <openssl/evp.h>
+#endif
+
+
+/* The hashes that WS-UsernameToken (SHA-1) and HTTP Digest (MD5) are defined with.
+ * Neither is any use for anything else these days. Built with TLS=1, they're OpenSSL's
+ * (EVP); otherwise they're done here, so that verifying a request doesn't need OpenSSL.
+ */
+class Sha1 {
+	public:
+		using Digest = std::array<uint8_t, 20>;
+
+	private:
+#ifdef WITH_OPENSSL
+		EVP_MD_CTX *ctx;
+#else
+		uint32_t state[5];
+		uint8_t block[64];
+		size_t block_length;
+		uint64_t total_length;
+
+		void compress(const uint8_t *data);
+#endif
+
+	public:
+		Sha1();
+#ifdef WITH_OPENSSL
+		~Sha1();
+		Sha1(const Sha1 &) = delete;
+		Sha1 &operator=(const Sha1 &) = delete;
+#endif
+
+		Sha1 &update(const void *data, size_t length);
+		Sha1 &update(const std::string &data) { return update(data.data(), data.size()); }
+		Digest finish();
+};
+
+
+class Md5 {
+	public:
+		using Digest = std::array<uint8_t, 16>;
+
+	private:
+#ifdef WITH_OPENSSL
+		EVP_MD_CTX *ctx;
+#else
+		uint32_t state[4];
+		uint8_t block[64];
+		size_t block_length;
+		uint64_t total_length;
+
+		void compress(const uint8_t *data);
+#endif
+
+	public:
+		Md5();
+#ifdef WITH_OPENSSL
+		~Md5();
+		Md5(const Md5 &) = delete;
+		Md5 &operator=(const Md5 &) = delete;
+#endif
+
+		Md5 &update(const void *data, size_t length);
+		Md5 &update(const std::string &data) { return update(data.data(), data.size()); }
+		Digest finish();
+};
+
+
+/* Lower case, as HTTP Digest wants. */
+extern std::string to_hex(const uint8_t *data, size_t length);
+
+template <size_t N>
+std::string to_hex(const std::array<uint8_t, N> &digest) {
+	return to_hex(digest.data(), N);
+}
+
+extern std::string base64_encode(const uint8_t *data, size_t length);
+
+/* False if text isn't base64 (whitespace is skipped). */
+extern bool base64_decode(const std::string &text, std::string *data);
+
+/* Compares every byte whatever the differences, so that how long it takes says nothing. */
+extern bool constant_time_equal(const std::string &a, const std::string &b);
@@ -132,6 +132,15 @@ static int http_route_index(struct soap *soap) {
 	S("<table border=1 width=600>");
 	switch (vec->Encoding) {
 		case tt__VideoEncoding::H264:
+			// Unless it's encoded as H.265 instead (which still takes the GovLength from here).
+			if (auto *h265 = camera->getH265Configuration(vec->token)) {
+				TROW("Encoding", "H265");
+				if (vec->H264 != nullptr) {
+					TROWNUM("GovLength", vec->H264->GovLength);
+				}
+				TROW("Profile", soap_tt__VideoEncodingProfiles2s(soap, h265->H265Profile));
+				break;
+			}
 			TROW("Encoding", "H264");
 			if (vec->H264 != nullptr) {
 				TROWNUM("GovLength", vec->H264->GovLength);
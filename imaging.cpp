@@ -4,6 +4,7 @@
 #include "soaplib/soapH.h"
 
 #include "camera.h"
+#include "utils.h"
 
 
 int __timg__GetImagingSettings(struct soap *soap, _timg__GetImagingSettings *request, _timg__GetImagingSettingsResponse &response) {
@@ -30,6 +31,14 @@ int __timg__GetOptions(struct soap *soap, _timg__GetOptions *request, _timg__Get
 
 int __timg__SetImagingSettings(struct soap *soap, _timg__SetImagingSettings *request, _timg__SetImagingSettingsResponse &response) {
 	Camera *camera = static_cast<Camera *>(soap->user);
+	auto *current = camera->getImagingSettings(request->VideoSourceToken);
+	if (current == nullptr) {
+		return SOAP_ERR;
+	}
+	std::string invalid = camera->getValidator().check(request->VideoSourceToken, request->ImagingSettings, current);
+	if (!invalid.empty()) {
+		return onvif_sender_fault(soap, "ter:InvalidArgVal", "ter:SettingsInvalid", invalid);
+	}
 	if (!camera->setImagingSettings(request->VideoSourceToken, request->ImagingSettings)) {
 		return SOAP_ERR;
 	}
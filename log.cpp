@@ -0,0 +1,226 @@
+// Copyright 2023 Morse Micro
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "log.h"
+
+
+static const size_t RING_SIZE = 128;  // Must be a power of two.
+static const size_t MAX_MESSAGE_LENGTH = 480;
+static const auto DRAIN_INTERVAL = std::chrono::milliseconds(50);
+
+std::atomic<int> log_level(static_cast<int>(LogLevel::Info));
+
+namespace {
+	struct Slot {
+		std::atomic<size_t> sequence;
+		LogLevel level;
+		size_t length;
+		char text[MAX_MESSAGE_LENGTH];
+	};
+
+	// A bounded MPMC queue (Dmitry Vyukov's), used with a single consumer.
+	// Each slot's sequence number says whether it's free to write (== position)
+	// or ready to read (== position + 1) for the current lap of the ring.
+	std::array<Slot, RING_SIZE> ring;
+	std::atomic<size_t> enqueue_pos(0);
+	size_t dequeue_pos = 0;  // Only touched by the drain thread.
+	std::atomic<unsigned> dropped(0);
+
+	std::atomic<bool> running(false);
+	std::atomic<bool> drain_sleeping(false);
+	bool stopping = false;
+	std::mutex drain_mutex;
+	std::condition_variable drain_cv;
+	std::thread drain_thread;
+}
+
+
+static FILE *output_for(LogLevel level) {
+	return level <= LogLevel::Warning ? stderr : stdout;
+}
+
+
+static void write_line(LogLevel level, const char *text, size_t length) {
+	FILE *out = output_for(level);
+	fwrite(text, 1, length, out);
+	fputc('\n', out);
+}
+
+
+static bool enqueue(LogLevel level, const std::string &message, size_t *position) {
+	size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+	Slot *slot;
+	while (true) {
+		slot = &ring[pos & (RING_SIZE - 1)];
+		size_t sequence = slot->sequence.load(std::memory_order_acquire);
+		intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+		if (diff == 0) {
+			if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+				break;
+			}
+		} else if (diff < 0) {
+			return false;  // Full.
+		} else {
+			pos = enqueue_pos.load(std::memory_order_relaxed);
+		}
+	}
+
+	slot->level = level;
+	slot->length = std::min(message.size(), MAX_MESSAGE_LENGTH);
+	memcpy(slot->text, message.data(), slot->length);
+	slot->sequence.store(pos + 1, std::memory_order_release);
+	*position = pos;
+	return true;
+}
+
+
+static bool dequeue_and_write() {
+	Slot *slot = &ring[dequeue_pos & (RING_SIZE - 1)];
+	if (slot->sequence.load(std::memory_order_acquire) != dequeue_pos + 1) {
+		return false;  // Empty (or the writer hasn't finished yet).
+	}
+
+	write_line(slot->level, slot->text, slot->length);
+	slot->sequence.store(dequeue_pos + RING_SIZE, std::memory_order_release);
+	++dequeue_pos;
+	return true;
+}
+
+
+static void drain() {
+	std::unique_lock<std::mutex> lock(drain_mutex);
+	while (true) {
+		lock.unlock();
+		bool wrote = false;
+		while (dequeue_and_write()) {
+			wrote = true;
+		}
+		unsigned n_dropped = dropped.exchange(0);
+		if (n_dropped > 0) {
+			fprintf(stderr, "(dropped %u log messages)\n", n_dropped);
+			wrote = true;
+		}
+		if (wrote) {
+			fflush(stdout);
+			fflush(stderr);
+		}
+		lock.lock();
+
+		if (stopping) {
+			return;
+		}
+		drain_sleeping = true;
+		drain_cv.wait_for(lock, DRAIN_INTERVAL);
+		drain_sleeping = false;
+	}
+}
+
+
+// The drain thread doesn't survive fork, so a child falls back to writing synchronously.
+static void log_atfork_child() {
+	running = false;
+}
+
+
+void log_start() {
+	if (running) {
+		return;
+	}
+	static std::once_flag atfork_registered;
+	std::call_once(atfork_registered, [] { pthread_atfork(nullptr, nullptr, log_atfork_child); });
+
+	for (size_t i = 0; i < RING_SIZE; ++i) {
+		ring[i].sequence.store(i, std::memory_order_relaxed);
+	}
+	enqueue_pos = 0;
+	dequeue_pos = 0;
+	stopping = false;
+	drain_thread = std::thread(drain);
+	running = true;
+}
+
+
+void log_stop() {
+	if (!running) {
+		return;
+	}
+	running = false;
+	{
+		std::lock_guard<std::mutex> lock(drain_mutex);
+		stopping = true;
+	}
+	drain_cv.notify_one();
+	drain_thread.join();
+}
+
+
+void log_set_level(LogLevel level) {
+	log_level = static_cast<int>(level);
+}
+
+
+bool log_parse_level(const std::string &name, LogLevel *level) {
+	static const std::map<std::string, LogLevel> levels = {
+		{"error", LogLevel::Error},
+		{"warning", LogLevel::Warning},
+		{"info", LogLevel::Info},
+		{"debug", LogLevel::Debug},
+	};
+
+	auto it = levels.find(name);
+	if (it == levels.end()) {
+		return false;
+	}
+	*level = it->second;
+	return true;
+}
+
+
+void log_message(LogLevel level, const std::string &message) {
+	if (!running) {
+		write_line(level, message.data(), message.size());
+		fflush(output_for(level));
+		return;
+	}
+
+	size_t position = 0;
+	if (!enqueue(level, message, &position)) {
+		++dropped;
+		return;
+	}
+
+	// Errors are worth an immediate wakeup, as is a burst that's filling the ring;
+	// everything else can wait for the next drain.
+	bool burst = (position & (RING_SIZE / 2 - 1)) == 0;
+	if ((level == LogLevel::Error || burst) && drain_sleeping) {
+		drain_cv.notify_one();
+	}
+}
+
+
+bool LogRateLimit::allow(unsigned *suppressed_count) {
+	auto now = std::chrono::steady_clock::now().time_since_epoch().count();
+	auto next = next_allowed.load(std::memory_order_relaxed);
+	if (now < next || !next_allowed.compare_exchange_strong(next, now + interval.count())) {
+		++suppressed;
+		return false;
+	}
+
+	*suppressed_count = suppressed.exchange(0);
+	return true;
+}
@@ -0,0 +1,87 @@
+/*
+ * Copyright 2023 Morse Micro
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <sstream>
+#include <string>
+
+
+/* Logging that never blocks the caller on the console.
+ *
+ * Messages are formatted by the caller into a fixed-size ring buffer (lock-free for
+ * any number of writers) and written out by a background thread started by log_start().
+ * If the ring is full, messages are dropped and the drop count is reported later.
+ * Before log_start() (or in a forked child) messages are written synchronously.
+ *
+ * Errors and warnings go to stderr, everything else to stdout.
+ */
+
+enum class LogLevel {
+	Error,
+	Warning,
+	Info,
+	Debug,
+};
+
+extern std::atomic<int> log_level;
+
+extern void log_start();
+extern void log_stop();  // Drains anything pending.
+
+extern void log_set_level(LogLevel level);
+extern bool log_parse_level(const std::string &name, LogLevel *level);
+
+extern void log_message(LogLevel level, const std::string &message);
+
+inline bool log_enabled(LogLevel level) {
+	return static_cast<int>(level) <= log_level.load(std::memory_order_relaxed);
+}
+
+
+/* Allows one message per interval through; counts the rest. One per call site. */
+class LogRateLimit {
+	private:
+		const std::chrono::steady_clock::duration interval;
+		std::atomic<std::chrono::steady_clock::rep> next_allowed;
+		std::atomic<unsigned> suppressed;
+
+	public:
+		explicit LogRateLimit(std::chrono::milliseconds interval)
+			: interval(interval), next_allowed(0), suppressed(0) {}
+
+		/* If true, *suppressed_count is how many messages we dropped since the last one. */
+		bool allow(unsigned *suppressed_count);
+};
+
+
+#define LOG(level, msg) do { \
+	if (log_enabled(level)) { \
+		std::ostringstream log_ss_; \
+		log_ss_ << msg; \
+		log_message(level, log_ss_.str()); \
+	} \
+} while (0)
+
+#define LOG_ERROR(msg) LOG(LogLevel::Error, msg)
+#define LOG_WARNING(msg) LOG(LogLevel::Warning, msg)
+#define LOG_INFO(msg) LOG(LogLevel::Info, msg)
+#define LOG_DEBUG(msg) LOG(LogLevel::Debug, msg)
+
+/* For anything a client (or a broken network) can make us repeat as fast as it likes. */
+#define LOG_RATELIMITED(level, interval_ms, msg) do { \
+	static LogRateLimit log_limit_(std::chrono::milliseconds(interval_ms)); \
+	unsigned log_suppressed_; \
+	if (log_enabled(level) && log_limit_.allow(&log_suppressed_)) { \
+		std::ostringstream log_ss_; \
+		log_ss_ << msg; \
+		if (log_suppressed_ > 0) { \
+			log_ss_ << " (" << log_suppressed_ << " similar messages suppressed)"; \
+		} \
+		log_message(level, log_ss_.str()); \
+	} \
+} while (0)
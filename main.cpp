@@ -3,24 +3,58 @@
 
 #include <getopt.h>
 #include <arpa/inet.h>
+#include <pthread.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
 
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <iostream>
 #include <exception>
 
 #include "camera.h"
 #include "discovery.h"
+#include "filewatcher.h"
+#include "log.h"
+#include "netstate.h"
+#include "rtspprobe.h"
 #include "server.h"
+#include "streammonitor.h"
 #include "utils.h"
 
 #include "soaplib/DeviceBinding.nsmap"
 
 
-const char *OPTSTRING = "hp:r:c:";
+// How long shutdown waits for each part. The RTSP server gets stop_child_process's
+// grace period, and the camera lock waits at most for the ONVIF server's I/O timeout
+// (i.e. a request that missed the drain deadline).
+const auto SERVER_DRAIN_DEADLINE = std::chrono::seconds(2);
+const auto WSDD_BYE_DEADLINE = std::chrono::seconds(1);
+// Backoff between attempts to initialise the RTSP server (e.g. while MediaMTX starts).
+const auto RTSP_RETRY_MIN = std::chrono::milliseconds(250);
+const auto RTSP_RETRY_MAX = std::chrono::seconds(5);
+// A new viewer of an encoder we suspended waits for the next poll, so poll more often then.
+const int STREAM_MONITOR_INTERVAL_MS = 5000;
+const int IDLE_MONITOR_INTERVAL_MS = 250;
+const int RESUME_PROBE_TIMEOUT_MS = 10000;
+
+const char *OPTSTRING = "hp:r:c:l:v:di:wt:C:";
 const option LONGOPTS[] = {
 	{"port", required_argument, nullptr, 'p'},
+	{"listeners", required_argument, nullptr, 'l'},
+	{"log-level", required_argument, nullptr, 'v'},
 	{"properties", required_argument, nullptr, 'r'},
 	{"config", required_argument, nullptr, 'c'},
+	{"discovery-proxy", no_argument, nullptr, 'd'},
+	{"interface", required_argument, nullptr, 'i'},
+	{"watch", no_argument, nullptr, 'w'},
+	{"tls-cert", required_argument, nullptr, 't'},
+	{"tls-ciphers", required_argument, nullptr, 'C'},
 	{"help", no_argument, nullptr, 'h'},
 	{nullptr, no_argument, nullptr, 0},
 };
@@ -29,27 +63,150 @@ const option LONGOPTS[] = {
 void usage(char *cmd) {
 	std::cerr << "Usage:" << std::endl;
 	std::cerr << "  " << cmd << " 10.0.0.1 --config config.xml --properties properties.xml" << std::endl;
+	std::cerr << "  " << cmd << " --interface wlan0 --config config.xml --properties properties.xml" << std::endl;
+	std::cerr << std::endl;
+	std::cerr << "  --listeners N   serve ONVIF requests from N SO_REUSEPORT sockets/threads (default 1)" << std::endl;
+	std::cerr << "  --log-level L   error, warning, info (default) or debug" << std::endl;
+	std::cerr << "  --discovery-proxy  also act as a WS-Discovery proxy for the other cameras on the network" << std::endl;
+	std::cerr << "  --interface IF  serve from IF's IPv4 address (instead of a fixed one), following it if it changes" << std::endl;
+	std::cerr << "  --watch         apply edits to the properties/config files without restarting" << std::endl;
+	std::cerr << "  --tls-cert PEM  serve HTTPS, with the certificate (chain) and private key in PEM (needs a TLS=1 build)" << std::endl;
+	std::cerr << "  --tls-ciphers LIST  TLS 1.3 (TLS_*) and 1.2 ciphers, most preferred first (default ChaCha20-Poly1305 first)" << std::endl;
 	exit(1);
 }
 
 
+static std::string make_onvif_url(const std::string &ip, const char *port, bool https) {
+	return (https ? "https://" : "http://") + ip + ":" + port;
+}
+
+
+static long elapsed_ms(std::chrono::steady_clock::time_point since) {
+	return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - since).count();
+}
+
+
+// The RTSP server is initialised in the background, so that we're answering ONVIF
+// requests (and the backend isn't needed for most of them) while it comes up.
+static std::mutex rtsp_mutex;
+static std::condition_variable rtsp_wake;
+static bool rtsp_stopping = false;
+static std::thread rtsp_thread;
+
+static void run_rtsp_initialiser(Camera *camera) {
+	auto backoff = RTSP_RETRY_MIN;
+	for (int attempt = 1; ; ++attempt) {
+		{
+			std::lock_guard<std::mutex> lock(camera->getMutex());
+			if (camera->initialiseRtspServer()) {
+				LOG_INFO("RTSP stream ready " << uptime_ms() << "ms after startup (attempt " << attempt << "): " << camera->getStreamUri());
+				break;
+			}
+		}
+		std::unique_lock<std::mutex> lock(rtsp_mutex);
+		if (rtsp_wake.wait_for(lock, backoff, [] { return rtsp_stopping; })) {
+			return;
+		}
+		backoff = std::min<std::chrono::milliseconds>(backoff * 2, RTSP_RETRY_MAX);
+	}
+
+	// An RTSP server process gets SIGTERM when the thread that started it exits
+	// (see start_child_process), so we stay until shutdown.
+	std::unique_lock<std::mutex> lock(rtsp_mutex);
+	rtsp_wake.wait(lock, [] { return rtsp_stopping; });
+}
+
+static void stop_rtsp_initialiser() {
+	{
+		std::lock_guard<std::mutex> lock(rtsp_mutex);
+		rtsp_stopping = true;
+	}
+	rtsp_wake.notify_all();
+	if (rtsp_thread.joinable()) {
+		rtsp_thread.join();
+	}
+}
+
+
+// Stop taking requests, finish the ones we're on, say Bye, then save and stop the camera.
+// Returns true if everything finished within its deadline.
+static bool shut_down(Camera *camera) {
+	auto start = std::chrono::steady_clock::now();
+	bool clean = stop_server(SERVER_DRAIN_DEADLINE);
+	LOG_INFO("ONVIF server stopped" << (clean ? "" : " (not cleanly)") << " after " << elapsed_ms(start) << "ms");
+
+	auto wsdd_start = std::chrono::steady_clock::now();
+	clean = stop_wsdd_server(WSDD_BYE_DEADLINE) && clean;
+	LOG_INFO("WS-Discovery stopped after " << elapsed_ms(wsdd_start) << "ms");
+
+	auto camera_start = std::chrono::steady_clock::now();
+	// Waits for an attempt to initialise the RTSP server in progress, if any.
+	stop_rtsp_initialiser();
+	{
+		// i.e. after any request that missed the deadline.
+		std::lock_guard<std::mutex> lock(camera->getMutex());
+		camera->stop();
+	}
+	LOG_INFO("Camera stopped after " << elapsed_ms(camera_start) << "ms");
+
+	LOG_INFO("Shutdown took " << elapsed_ms(start) << "ms");
+	return clean;
+}
+
+
 int main(int argc, char * const argv[])
 {
 	const char *properties = "properties.xml";
 	const char *config = "config.xml";
 	const char *port = "8080";
+	int listeners = 1;
+	bool discovery_proxy = false;
+	const char *interface = nullptr;
+	bool watch = false;
+	TlsOptions tls;
 	int opt;
 	while (-1 != (opt = getopt_long(argc, argv, OPTSTRING, LONGOPTS, nullptr))) {
 		switch (opt) {
 			case 'p':
 				port = optarg;
 				break;
+			case 'l':
+				listeners = std::atoi(optarg);
+				if (listeners < 1) {
+					std::cerr << "Must have at least one listener, not: " << optarg << std::endl;
+					usage(argv[0]);
+				}
+				break;
+			case 'v': {
+				LogLevel level;
+				if (!log_parse_level(optarg, &level)) {
+					std::cerr << "Unknown log level: " << optarg << std::endl;
+					usage(argv[0]);
+				}
+				log_set_level(level);
+				break;
+			}
 			case 'c':
 				config = optarg;
 				break;
 			case 'r':
 				properties = optarg;
 				break;
+			case 'd':
+				discovery_proxy = true;
+				break;
+			case 'i':
+				interface = optarg;
+				break;
+			case 'w':
+				watch = true;
+				break;
+			case 't':
+				tls.keyfile = optarg;
+				break;
+			case 'C':
+				tls.ciphers = optarg;
+				break;
 			case 'h':
 				usage(argv[0]);
 				exit(0);
@@ -62,35 +219,161 @@ int main(int argc, char * const argv[])
 		}
 	}
 
-	if (argc == optind) {
-		std::cerr << "Must provide exactly one positional argument: host ip to serve from" << std::endl;
+	if ((argc == optind) == (interface == nullptr)) {
+		std::cerr << "Must provide either exactly one positional argument (host ip to serve from) or --interface" << std::endl;
 		usage(argv[0]);
 		exit(1);
 	}
 
-	const char *ip = argv[optind];
-	unsigned char tmpbuf[sizeof(struct in_addr)];
-	if (inet_pton(AF_INET, ip, tmpbuf) <= 0) {
-		std::cerr << "Must provide valid IPv4 address, not: " << ip << std::endl;
+	if (!tls.ciphers.empty() && tls.keyfile.empty()) {
+		std::cerr << "--tls-ciphers needs --tls-cert" << std::endl;
 		usage(argv[0]);
-		exit(1);
 	}
+	bool https = !tls.keyfile.empty();
 
-	std::string onvif_url = std::string("http://") + ip + ":" + port;
+	std::string ip;
+	if (interface == nullptr) {
+		ip = argv[optind];
+		unsigned char tmpbuf[sizeof(struct in_addr)];
+		if (inet_pton(AF_INET, ip.c_str(), tmpbuf) <= 0) {
+			std::cerr << "Must provide valid IPv4 address, not: " << ip << std::endl;
+			usage(argv[0]);
+			exit(1);
+		}
+	}
+
+	// Block these before starting any threads (which inherit the mask),
+	// so that only the sigwait below ever sees them.
+	sigset_t shutdown_signals;
+	sigemptyset(&shutdown_signals);
+	sigaddset(&shutdown_signals, SIGTERM);
+	sigaddset(&shutdown_signals, SIGINT);
+	pthread_sigmask(SIG_BLOCK, &shutdown_signals, nullptr);
+
+	log_start();
 
 	try {
-		std::cout << "Loading camera configuration..." << std::endl;
+		// Only essential if we're following an interface; otherwise it's just
+		// for reporting the network configuration.
+		NetworkState network_state;
+		bool have_network_state = true;
+		try {
+			network_state.start();
+		} catch (std::runtime_error &e) {
+			LOG_WARNING(e.what());
+			have_network_state = false;
+		}
+		if (interface != nullptr) {
+			ip = have_network_state ? network_state.get()->primaryIPv4(interface) : "";
+			if (ip.empty()) {
+				LOG_ERROR("No IPv4 address on " << interface);
+				log_stop();
+				return 1;
+			}
+		}
+
+		std::string onvif_url = make_onvif_url(ip, port, https);
+
+		LOG_INFO("Loading camera configuration...");
 		Camera camera(onvif_url, ip, properties, config);
-		std::cout << "Initialising RTSP stream: " << camera.getStreamUri() << std::endl;
-		camera.initialiseRtspServer();
-		std::cout << "Starting WS-Discovery server: " << ip << ":3702" << std::endl;
-		spawn_wsdd_server(ip, onvif_url.c_str());
-		std::cout << "Starting ONVIF server: " << onvif_url << std::endl;
-		start_server(std::atoi(port), &camera);  // should block here
-	} catch (std::exception *e) {
-		std::cerr << e->what() << std::endl;
+		LOG_INFO("Camera configuration loaded " << uptime_ms() << "ms after startup");
+		if (have_network_state) {
+			camera.setNetworkState(&network_state);
+		}
+
+		// The ONVIF server listens on every address, so only what we advertise has to change
+		// (and WS-Discovery picks that up from the camera and re-announces).
+		if (interface != nullptr) {
+			network_state.onChange([&camera, interface, port, https] (const NetworkState::Snapshot &snapshot) {
+				std::string new_ip = snapshot.primaryIPv4(interface);
+				std::lock_guard<std::mutex> lock(camera.getMutex());
+				// Until it gets a new one, we may as well keep advertising the old one.
+				if (!new_ip.empty() && new_ip != camera.getIP()) {
+					LOG_INFO("Address of " << interface << " changed to " << new_ip);
+					camera.setAddress(new_ip, make_onvif_url(new_ip, port, https));
+				}
+			});
+		}
+
+		FileWatcher watcher({properties, config}, [&camera] (const std::string &filename) {
+			std::lock_guard<std::mutex> lock(camera.getMutex());
+			camera.reload(filename);
+		});
+		if (watch) {
+			camera.enableReload();
+			try {
+				watcher.start();
+			} catch (std::runtime_error &e) {
+				LOG_WARNING(e.what());
+			}
+		}
+
+		StreamMonitor monitor([&camera] {
+			// Not under the lock, as it can be an HTTP request (MediaMTX).
+			RtspServer::Readers readers;
+			if (!camera.getReaders(&readers)) {
+				return;
+			}
+			std::string uri;
+			{
+				std::lock_guard<std::mutex> lock(camera.getMutex());
+				if (!camera.monitorStream(readers)) {
+					return;
+				}
+				uri = camera.getStreamUri();
+			}
+			// Not under the lock, as it waits for the stream.
+			long latency = rtsp_time_to_first_frame(uri, RESUME_PROBE_TIMEOUT_MS);
+			if (latency < 0) {
+				LOG_WARNING("No frames from the resumed encoder within " << RESUME_PROBE_TIMEOUT_MS << "ms");
+			} else {
+				LOG_INFO("First frame " << latency << "ms after resuming the encoder");
+			}
+		}, camera.needsPromptMonitoring() ? IDLE_MONITOR_INTERVAL_MS : STREAM_MONITOR_INTERVAL_MS);
+		if (camera.hasMulticastPolicy() || camera.hasIdlePolicy()) {
+			monitor.start();
+		}
+		StreamMonitor bitrate_monitor([&camera] {
+			std::lock_guard<std::mutex> lock(camera.getMutex());
+			camera.adaptBitrate();
+		}, camera.hasAdaptiveBitrate() ? camera.getAdaptiveBitrateInterval() : 0);
+		if (camera.hasAdaptiveBitrate()) {
+			bitrate_monitor.start();
+		}
+
+		// Listen first, so clients aren't refused while everything else starts.
+		LOG_INFO("Starting ONVIF server: " << onvif_url << " (" << listeners << " listeners)");
+		if (!start_server(std::atoi(port), &camera, listeners, https ? &tls : nullptr)) {
+			bitrate_monitor.stop();
+			monitor.stop();
+			watcher.stop();
+			network_state.stop();
+			camera.stop();
+		} else {
+			LOG_INFO("ONVIF server listening " << uptime_ms() << "ms after startup");
+			LOG_INFO("Starting WS-Discovery server: " << ip << ":3702" << (discovery_proxy ? " (proxy)" : ""));
+			start_wsdd_server(&camera, discovery_proxy);
+			LOG_INFO("Initialising RTSP stream: " << camera.getStreamUri());
+			rtsp_thread = std::thread(run_rtsp_initialiser, &camera);
+
+			int sig;
+			sigwait(&shutdown_signals, &sig);
+			LOG_INFO("Shutting down (" << strsignal(sig) << ")...");
+			// Saving the config on the way out would otherwise look like an edit.
+			bitrate_monitor.stop();
+			monitor.stop();
+			watcher.stop();
+			int status = shut_down(&camera) ? 0 : 1;
+			log_stop();
+			// Anything that missed its deadline may still be using the camera, so skip the destructors.
+			_exit(status);
+		}
+	} catch (std::exception &e) {
+		LOG_ERROR(e.what());
 	}
 
-	// We never exit happy in the normal course of events, as the server should block.
+	log_stop();
+
+	// Failed to start.
 	return 1;
 }
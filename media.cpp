@@ -4,6 +4,7 @@
 #include "soaplib/soapH.h"
 
 #include "camera.h"
+#include "utils.h"
 
 
 int __trt__GetVideoEncoderConfigurations(struct soap *soap, _trt__GetVideoEncoderConfigurations *request, _trt__GetVideoEncoderConfigurationsResponse &response) {
@@ -28,6 +29,19 @@ int __trt__GetVideoEncoderConfiguration(struct soap *soap, _trt__GetVideoEncoder
 
 int __trt__SetVideoEncoderConfiguration(struct soap *soap, _trt__SetVideoEncoderConfiguration *request, _trt__SetVideoEncoderConfigurationResponse &response) {
 	Camera *camera = static_cast<Camera *>(soap->user);
+	auto *current = camera->getVideoEncoderConfiguration(request->Configuration->token);
+	if (current == nullptr) {
+		return SOAP_ERR;
+	}
+	// Before anything's saved or the RTSP server restarted.
+	std::string invalid = camera->getValidator().check(request->Configuration, current);
+	if (!invalid.empty()) {
+		return onvif_sender_fault(soap, "ter:InvalidArgVal", "ter:ConfigModify", invalid);
+	}
+	std::string over_budget = camera->checkEncoderBudget(request->Configuration);
+	if (!over_budget.empty()) {
+		return onvif_receiver_fault(soap, "ter:Action", "ter:ConfigurationConflict", over_budget);
+	}
 	return camera->setVideoEncoderConfiguration(request->Configuration) ? SOAP_OK : SOAP_ERR;
 }
 
@@ -51,6 +65,14 @@ int __trt__GetVideoSourceConfigurations(struct soap *soap, _trt__GetVideoSourceC
 
 int __trt__SetVideoSourceConfiguration(struct soap *soap, _trt__SetVideoSourceConfiguration *request, _trt__SetVideoSourceConfigurationResponse &response) {
 	Camera *camera = static_cast<Camera *>(soap->user);
+	auto *current = camera->getVideoSourceConfiguration(request->Configuration->token);
+	if (current == nullptr) {
+		return SOAP_ERR;
+	}
+	std::string invalid = camera->getValidator().check(request->Configuration, current);
+	if (!invalid.empty()) {
+		return onvif_sender_fault(soap, "ter:InvalidArgVal", "ter:ConfigModify", invalid);
+	}
 	return camera->setVideoSourceConfiguration(request->Configuration) ? SOAP_OK : SOAP_ERR;
 }
 
@@ -60,16 +82,180 @@ int __trt__GetVideoSourceConfigurationOptions(struct soap *soap, _trt__GetVideoS
 	return SOAP_OK;
 }
 
+// The full profile, from the tokens in the config.
+static tt__Profile *new_profile(struct soap *soap, Camera *camera, const tt__MinimumProfile *mp) {
+	auto *profile = soap_new_tt__Profile(soap);
+	profile->Name = mp->Name;
+	profile->token = mp->ProfileToken;
+	// Profiles that clients create start out without either.
+	if (mp->VideoEncoderConfigurationToken != nullptr) {
+		profile->VideoEncoderConfiguration = camera->getVideoEncoderConfiguration(*mp->VideoEncoderConfigurationToken);
+	}
+	if (mp->VideoSourceConfigurationToken != nullptr) {
+		profile->VideoSourceConfiguration = camera->getVideoSourceConfiguration(*mp->VideoSourceConfigurationToken);
+	}
+	return profile;
+}
+
 int __trt__GetProfiles(struct soap *soap, _trt__GetProfiles *request, _trt__GetProfilesResponse &response) {
 	Camera *camera = static_cast<Camera *>(soap->user);
 	auto min_profiles = camera->getMinimumProfiles();
 	for (auto mp_it : min_profiles) {
-		auto *profile = soap_new_tt__Profile(soap);
-		profile->Name = mp_it->Name;
-		profile->token = mp_it->ProfileToken;
-		profile->VideoEncoderConfiguration = camera->getVideoEncoderConfiguration(*mp_it->VideoEncoderConfigurationToken);
-		profile->VideoSourceConfiguration = camera->getVideoSourceConfiguration(*mp_it->VideoSourceConfigurationToken);
-		response.Profiles.push_back(profile);
+		response.Profiles.push_back(new_profile(soap, camera, mp_it));
+	}
+	return SOAP_OK;
+}
+
+int __trt__GetProfile(struct soap *soap, _trt__GetProfile *request, _trt__GetProfileResponse &response) {
+	Camera *camera = static_cast<Camera *>(soap->user);
+	auto *mp = camera->getMinimumProfile(request->ProfileToken);
+	if (mp == nullptr) {
+		return onvif_sender_fault(soap, "ter:InvalidArgVal", "ter:NoProfile", "No such profile: " + request->ProfileToken);
+	}
+	response.Profile = new_profile(soap, camera, mp);
+	return SOAP_OK;
+}
+
+int __trt__CreateProfile(struct soap *soap, _trt__CreateProfile *request, _trt__CreateProfileResponse &response) {
+	Camera *camera = static_cast<Camera *>(soap->user);
+	std::string token;
+	if (request->Token != nullptr) {
+		token = *request->Token;
+		if (camera->getMinimumProfile(token) != nullptr) {
+			return onvif_sender_fault(soap, "ter:InvalidArgVal", "ter:ProfileExists", "Profile " + token + " already exists");
+		}
+	} else {
+		for (int i = camera->getMinimumProfiles().size(); token.empty() || camera->getMinimumProfile(token) != nullptr; ++i) {
+			token = "profile_" + std::to_string(i);
+		}
+	}
+	if (!camera->getEncoderBudget().allowsProfiles(camera->getMinimumProfiles().size() + 1)) {
+		return onvif_receiver_fault(soap, "ter:Action", "ter:MaxNVTProfiles", "No more profiles are allowed");
+	}
+
+	// Empty until configurations are added, so it costs nothing yet.
+	auto *mp = soap_new_tt__MinimumProfile(soap);
+	mp->Name = request->Name;
+	mp->ProfileToken = token;
+	if (!camera->setProfile(mp)) {
+		return SOAP_ERR;
+	}
+	response.Profile = new_profile(soap, camera, mp);
+	return SOAP_OK;
+}
+
+int __trt__DeleteProfile(struct soap *soap, _trt__DeleteProfile *request, _trt__DeleteProfileResponse &response) {
+	Camera *camera = static_cast<Camera *>(soap->user);
+	if (camera->getMinimumProfile(request->ProfileToken) == nullptr) {
+		return onvif_sender_fault(soap, "ter:InvalidArgVal", "ter:NoProfile", "No such profile: " + request->ProfileToken);
+	}
+	if (!camera->deleteProfile(request->ProfileToken)) {
+		return onvif_receiver_fault(soap, "ter:Action", "ter:DeletionOfFixedProfile", "The profile being streamed can't be deleted");
+	}
+	return SOAP_OK;
+}
+
+// Replaces the profile with a copy that has vec_token/vsc_token (as given) instead.
+static int change_profile(struct soap *soap, Camera *camera, std::string &profile_token,
+                          tt__ReferenceToken *vec_token, tt__ReferenceToken *vsc_token) {
+	auto *mp = camera->getMinimumProfile(profile_token);
+	if (mp == nullptr) {
+		return onvif_sender_fault(soap, "ter:InvalidArgVal", "ter:NoProfile", "No such profile: " + profile_token);
+	}
+	auto *changed = mp->soap_dup(soap);
+	changed->VideoEncoderConfigurationToken = vec_token;
+	changed->VideoSourceConfigurationToken = vsc_token;
+	if (!camera->setProfile(changed)) {
+		return onvif_receiver_fault(soap, "ter:Action", "ter:ConfigurationConflict", "The profile being streamed needs both configurations");
+	}
+	return SOAP_OK;
+}
+
+int __trt__AddVideoEncoderConfiguration(struct soap *soap, _trt__AddVideoEncoderConfiguration *request, _trt__AddVideoEncoderConfigurationResponse &response) {
+	Camera *camera = static_cast<Camera *>(soap->user);
+	auto *mp = camera->getMinimumProfile(request->ProfileToken);
+	auto *vec = camera->getVideoEncoderConfiguration(request->ConfigurationToken);
+	if (mp == nullptr || vec == nullptr) {
+		return onvif_sender_fault(soap, "ter:InvalidArgVal", mp == nullptr ? "ter:NoProfile" : "ter:NoConfig",
+			"No such " + (mp == nullptr ? "profile: " + request->ProfileToken : "configuration: " + request->ConfigurationToken));
+	}
+	std::string over_budget = camera->checkEncoderBudget(vec, request->ProfileToken);
+	if (!over_budget.empty()) {
+		return onvif_receiver_fault(soap, "ter:Action", "ter:ConfigurationConflict", over_budget);
+	}
+	return change_profile(soap, camera, request->ProfileToken, &request->ConfigurationToken, mp->VideoSourceConfigurationToken);
+}
+
+int __trt__RemoveVideoEncoderConfiguration(struct soap *soap, _trt__RemoveVideoEncoderConfiguration *request, _trt__RemoveVideoEncoderConfigurationResponse &response) {
+	Camera *camera = static_cast<Camera *>(soap->user);
+	auto *mp = camera->getMinimumProfile(request->ProfileToken);
+	return change_profile(soap, camera, request->ProfileToken, nullptr, mp ? mp->VideoSourceConfigurationToken : nullptr);
+}
+
+int __trt__AddVideoSourceConfiguration(struct soap *soap, _trt__AddVideoSourceConfiguration *request, _trt__AddVideoSourceConfigurationResponse &response) {
+	Camera *camera = static_cast<Camera *>(soap->user);
+	auto *mp = camera->getMinimumProfile(request->ProfileToken);
+	if (mp != nullptr && camera->getVideoSourceConfiguration(request->ConfigurationToken) == nullptr) {
+		return onvif_sender_fault(soap, "ter:InvalidArgVal", "ter:NoConfig", "No such configuration: " + request->ConfigurationToken);
+	}
+	return change_profile(soap, camera, request->ProfileToken, mp ? mp->VideoEncoderConfigurationToken : nullptr, &request->ConfigurationToken);
+}
+
+int __trt__RemoveVideoSourceConfiguration(struct soap *soap, _trt__RemoveVideoSourceConfiguration *request, _trt__RemoveVideoSourceConfigurationResponse &response) {
+	Camera *camera = static_cast<Camera *>(soap->user);
+	auto *mp = camera->getMinimumProfile(request->ProfileToken);
+	return change_profile(soap, camera, request->ProfileToken, mp ? mp->VideoEncoderConfigurationToken : nullptr, nullptr);
+}
+
+int __trt__GetGuaranteedNumberOfVideoEncoderInstances(struct soap *soap, _trt__GetGuaranteedNumberOfVideoEncoderInstances *request, _trt__GetGuaranteedNumberOfVideoEncoderInstancesResponse &response) {
+	Camera *camera = static_cast<Camera *>(soap->user);
+	if (camera->getVideoSourceConfiguration(request->ConfigurationToken) == nullptr) {
+		return onvif_sender_fault(soap, "ter:InvalidArgVal", "ter:NoConfig", "No such configuration: " + request->ConfigurationToken);
+	}
+	// We've only the one set of Options (and budget), whichever source it is.
+	auto &budget = camera->getEncoderBudget();
+	response.TotalNumber = budget.guaranteedTotal();
+	auto *options = camera->getVideoEncoderConfigurationOptions();
+	auto guaranteed = [soap, &budget] (tt__VideoEncoding encoding) {
+		auto *count = static_cast<int *>(soap_malloc(soap, sizeof(int)));
+		*count = budget.guaranteed(encoding);
+		return count;
+	};
+	if (options->JPEG != nullptr) {
+		response.JPEG = guaranteed(tt__VideoEncoding::JPEG);
+	}
+	if (options->H264 != nullptr) {
+		response.H264 = guaranteed(tt__VideoEncoding::H264);
+	}
+	if (options->MPEG4 != nullptr) {
+		response.MPEG4 = guaranteed(tt__VideoEncoding::MPEG4);
+	}
+	return SOAP_OK;
+}
+
+int __trt__StartMulticastStreaming(struct soap *soap, _trt__StartMulticastStreaming *request, _trt__StartMulticastStreamingResponse &response) {
+	Camera *camera = static_cast<Camera *>(soap->user);
+	if (camera->getMinimumProfile(request->ProfileToken) == nullptr) {
+		return onvif_sender_fault(soap, "ter:InvalidArgVal", "ter:NoProfile", "No such profile: " + request->ProfileToken);
+	}
+	std::string reason = camera->checkMulticast(request->ProfileToken);
+	if (!reason.empty()) {
+		return onvif_receiver_fault(soap, "ter:Action",
+			camera->supportsMulticast() ? "ter:IncompleteConfiguration" : "ter:ActionNotSupported", reason);
+	}
+	if (!camera->startMulticastStreaming(request->ProfileToken)) {
+		return SOAP_ERR;
+	}
+	return SOAP_OK;
+}
+
+int __trt__StopMulticastStreaming(struct soap *soap, _trt__StopMulticastStreaming *request, _trt__StopMulticastStreamingResponse &response) {
+	Camera *camera = static_cast<Camera *>(soap->user);
+	if (camera->getMinimumProfile(request->ProfileToken) == nullptr) {
+		return onvif_sender_fault(soap, "ter:InvalidArgVal", "ter:NoProfile", "No such profile: " + request->ProfileToken);
+	}
+	if (!camera->stopMulticastStreaming(request->ProfileToken)) {
+		return SOAP_ERR;
 	}
 	return SOAP_OK;
 }
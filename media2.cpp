@@ -0,0 +1,498 @@
+// Copyright 2023 Morse Micro
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include "soaplib/soapH.h"
+
+#include <cmath>
+#include <sstream>
+
+#include "camera.h"
+#include "utils.h"
+
+
+// Media2 is another view of the config that Media1 (media.cpp) changes: a Media2 video
+// encoder configuration is the Media1 one, with its H265Configuration (if any) folded in.
+
+static bool *new_bool(struct soap *soap, bool value) {
+	auto *result = static_cast<bool *>(soap_malloc(soap, sizeof(bool)));
+	*result = value;
+	return result;
+}
+
+static std::string *new_string(struct soap *soap, const std::string &value) {
+	auto *result = soap_new_std__string(soap);
+	*result = value;
+	return result;
+}
+
+// The tt:VideoEncodingMimeNames.
+static const char *encoding_name(tt__VideoEncoding encoding) {
+	switch (encoding) {
+		case tt__VideoEncoding::JPEG:
+			return "JPEG";
+		case tt__VideoEncoding::MPEG4:
+			return "MPV4-ES";
+		case tt__VideoEncoding::H264:
+			return "H264";
+	}
+	return "";
+}
+
+// Media2 names MPEG4's profiles as tt:VideoEncodingProfiles, rather than SP/ASP.
+static const char *mpeg4_profile_name(tt__Mpeg4Profile profile) {
+	return profile == tt__Mpeg4Profile::SP ? "Simple" : "AdvancedSimple";
+}
+
+static tt__VideoEncoder2Configuration *new_vec2(struct soap *soap, Camera *camera, tt__VideoEncoderConfiguration *vec) {
+	auto *vec2 = soap_new_tt__VideoEncoder2Configuration(soap);
+	vec2->Name = vec->Name;
+	vec2->UseCount = vec->UseCount;
+	vec2->token = vec->token;
+	vec2->Encoding = encoding_name(vec->Encoding);
+	vec2->Resolution = soap_new_req_tt__VideoResolution2(soap, vec->Resolution->Width, vec->Resolution->Height);
+	vec2->Quality = vec->Quality;
+	if (vec->RateControl != nullptr) {
+		vec2->RateControl = soap_new_req_tt__VideoRateControl2(soap, vec->RateControl->FrameRateLimit, vec->RateControl->BitrateLimit);
+	}
+	vec2->Multicast = vec->Multicast;
+	vec2->GuaranteedFrameRate = vec->GuaranteedFrameRate;
+	if (vec->Encoding == tt__VideoEncoding::H264 && vec->H264 != nullptr) {
+		vec2->GovLength = &vec->H264->GovLength;
+		auto *h265 = camera->getH265Configuration(vec->token);
+		if (h265 != nullptr) {
+			vec2->Encoding = "H265";
+			vec2->Profile = new_string(soap, soap_tt__VideoEncodingProfiles2s(soap, h265->H265Profile));
+		} else {
+			vec2->Profile = new_string(soap, soap_tt__H264Profile2s(soap, vec->H264->H264Profile));
+		}
+	} else if (vec->Encoding == tt__VideoEncoding::MPEG4 && vec->MPEG4 != nullptr) {
+		vec2->GovLength = &vec->MPEG4->GovLength;
+		vec2->Profile = new_string(soap, mpeg4_profile_name(vec->MPEG4->Mpeg4Profile));
+	}
+	return vec2;
+}
+
+// Puts what vec2 would be as Media1 in vec (starting from current, for what Media2 doesn't
+// have) and the H.265 that goes with it in h265 (null for anything else). Returns why it
+// can't be expressed, or "".
+static std::string from_vec2(struct soap *soap, Camera *camera, const tt__VideoEncoder2Configuration *vec2,
+                             const tt__VideoEncoderConfiguration *current, tt__VideoEncoderConfiguration **vec, tt__H265Configuration **h265) {
+	auto *result = current->soap_dup(soap);
+	*vec = result;
+	*h265 = nullptr;
+	result->Name = vec2->Name;
+	if (vec2->Resolution != nullptr) {
+		result->Resolution->Width = vec2->Resolution->Width;
+		result->Resolution->Height = vec2->Resolution->Height;
+	}
+	result->Quality = vec2->Quality;
+	if (vec2->RateControl != nullptr) {
+		if (result->RateControl == nullptr) {
+			result->RateControl = soap_new_req_tt__VideoRateControl(soap, 0, 1, 0);
+		}
+		result->RateControl->FrameRateLimit = std::lround(vec2->RateControl->FrameRateLimit);
+		result->RateControl->BitrateLimit = vec2->RateControl->BitrateLimit;
+	}
+	if (vec2->Multicast != nullptr) {
+		result->Multicast = vec2->Multicast;
+	}
+	if (vec2->GuaranteedFrameRate != nullptr) {
+		result->GuaranteedFrameRate = vec2->GuaranteedFrameRate;
+	}
+
+	std::string profile = vec2->Profile != nullptr ? *vec2->Profile : "";
+	if (vec2->Encoding == "JPEG") {
+		result->Encoding = tt__VideoEncoding::JPEG;
+	} else if (vec2->Encoding == "MPV4-ES") {
+		result->Encoding = tt__VideoEncoding::MPEG4;
+		if (result->MPEG4 == nullptr) {
+			result->MPEG4 = soap_new_tt__Mpeg4Configuration(soap);
+		}
+		if (vec2->GovLength != nullptr) {
+			result->MPEG4->GovLength = *vec2->GovLength;
+		}
+		if (profile == "Simple" || profile == "AdvancedSimple") {
+			result->MPEG4->Mpeg4Profile = profile == "Simple" ? tt__Mpeg4Profile::SP : tt__Mpeg4Profile::ASP;
+		} else if (!profile.empty()) {
+			return "Profile " + profile + " isn't supported";
+		}
+	} else if (vec2->Encoding == "H264" || vec2->Encoding == "H265") {
+		result->Encoding = tt__VideoEncoding::H264;
+		if (result->H264 == nullptr) {
+			result->H264 = soap_new_req_tt__H264Configuration(soap, 0, tt__H264Profile::Main);
+		}
+		// H.265 shares the GovLength with H.264 (see Camera::getH265Configuration).
+		if (vec2->GovLength != nullptr) {
+			result->H264->GovLength = *vec2->GovLength;
+		}
+		if (vec2->Encoding == "H265") {
+			auto *existing = camera->getH265Configuration(current->token);
+			*h265 = soap_new_req_tt__H265Configuration(soap,
+				existing != nullptr ? existing->H265Profile : tt__VideoEncodingProfiles::Main, current->token);
+			if (!profile.empty() && soap_s2tt__VideoEncodingProfiles(soap, profile.c_str(), &(*h265)->H265Profile) != SOAP_OK) {
+				soap->error = SOAP_OK;
+				return "Profile " + profile + " isn't supported";
+			}
+		} else if (!profile.empty() && soap_s2tt__H264Profile(soap, profile.c_str(), &result->H264->H264Profile) != SOAP_OK) {
+			soap->error = SOAP_OK;
+			return "Profile " + profile + " isn't supported";
+		}
+	} else {
+		return "Encoding " + vec2->Encoding + " isn't supported";
+	}
+	return "";
+}
+
+// e.g. "1 60" for a Range.
+template <typename Range>
+static std::string *new_range_list(struct soap *soap, const Range *range) {
+	if (range == nullptr) {
+		return nullptr;
+	}
+	std::ostringstream list;
+	list << range->Min << " " << range->Max;
+	return new_string(soap, list.str());
+}
+
+// Every whole frame rate in the range, highest first.
+static std::string *new_frame_rates(struct soap *soap, const tt__IntRange *range) {
+	if (range == nullptr) {
+		return nullptr;
+	}
+	std::ostringstream list;
+	for (int rate = range->Max; rate >= range->Min && rate > 0; --rate) {
+		list << (rate == range->Max ? "" : " ") << rate;
+	}
+	return new_string(soap, list.str());
+}
+
+template <typename Options>
+static tt__VideoEncoder2ConfigurationOptions *new_options2(struct soap *soap, const char *encoding,
+                                                           tt__VideoEncoderConfigurationOptions *options, const Options *encoding_options,
+                                                           const tt__IntRange *gov_length_range, tt__IntRange *bitrate_range) {
+	auto *options2 = soap_new_tt__VideoEncoder2ConfigurationOptions(soap);
+	options2->Encoding = encoding;
+	options2->QualityRange = options->QualityRange;
+	for (auto *resolution : encoding_options->ResolutionsAvailable) {
+		options2->ResolutionsAvailable.push_back(soap_new_req_tt__VideoResolution2(soap, resolution->Width, resolution->Height));
+	}
+	options2->BitrateRange = bitrate_range;
+	options2->GovLengthRange = new_range_list(soap, gov_length_range);
+	options2->FrameRatesSupported = new_frame_rates(soap, encoding_options->FrameRateRange);
+	return options2;
+}
+
+static std::vector<tt__VideoEncoder2ConfigurationOptions *> new_all_options2(struct soap *soap, Camera *camera) {
+	std::vector<tt__VideoEncoder2ConfigurationOptions *> result;
+	auto *options = camera->getVideoEncoderConfigurationOptions();
+	if (options == nullptr) {
+		return result;
+	}
+	auto *extension = options->Extension;
+	if (options->JPEG != nullptr) {
+		auto *jpeg2 = extension != nullptr ? extension->JPEG : nullptr;
+		result.push_back(new_options2(soap, "JPEG", options, options->JPEG, nullptr, jpeg2 ? jpeg2->BitrateRange : nullptr));
+	}
+	if (options->MPEG4 != nullptr) {
+		auto *mpeg42 = extension != nullptr ? extension->MPEG4 : nullptr;
+		auto *options2 = new_options2(soap, "MPV4-ES", options, options->MPEG4, options->MPEG4->GovLengthRange, mpeg42 ? mpeg42->BitrateRange : nullptr);
+		std::string profiles;
+		for (auto profile : options->MPEG4->Mpeg4ProfilesSupported) {
+			profiles += (profiles.empty() ? "" : " ") + std::string(mpeg4_profile_name(profile));
+		}
+		options2->ProfilesSupported = new_string(soap, profiles);
+		result.push_back(options2);
+	}
+	if (options->H264 != nullptr) {
+		auto *h2642 = extension != nullptr ? extension->H264 : nullptr;
+		auto *options2 = new_options2(soap, "H264", options, options->H264, options->H264->GovLengthRange, h2642 ? h2642->BitrateRange : nullptr);
+		std::string profiles;
+		for (auto profile : options->H264->H264ProfilesSupported) {
+			profiles += (profiles.empty() ? "" : " ") + std::string(soap_tt__H264Profile2s(soap, profile));
+		}
+		options2->ProfilesSupported = new_string(soap, profiles);
+		result.push_back(options2);
+
+		// Everything but the profiles is the H.264 Options' (see ConfigValidator).
+		auto &h265_profiles = camera->getH265ProfilesSupported();
+		if (!h265_profiles.empty() && camera->supportsH265()) {
+			auto *h265_options2 = options2->soap_dup(soap);
+			h265_options2->Encoding = "H265";
+			profiles.clear();
+			for (auto profile : h265_profiles) {
+				profiles += (profiles.empty() ? "" : " ") + std::string(soap_tt__VideoEncodingProfiles2s(soap, profile));
+			}
+			h265_options2->ProfilesSupported = new_string(soap, profiles);
+			result.push_back(h265_options2);
+		}
+	}
+	return result;
+}
+
+
+int __tr2__GetServiceCapabilities(struct soap *soap, _tr2__GetServiceCapabilities *request, _tr2__GetServiceCapabilitiesResponse &response) {
+	Camera *camera = static_cast<Camera *>(soap->user);
+	response.Capabilities = soap_new_tr2__Capabilities2(soap);
+	response.Capabilities->ProfileCapabilities = soap_new_tr2__ProfileCapabilities(soap);
+	int max_profiles = camera->getEncoderBudget().getMaxProfiles();
+	if (max_profiles != 0) {
+		response.Capabilities->ProfileCapabilities->MaximumNumberOfProfiles = static_cast<int *>(soap_malloc(soap, sizeof(int)));
+		*response.Capabilities->ProfileCapabilities->MaximumNumberOfProfiles = max_profiles;
+	}
+	response.Capabilities->ProfileCapabilities->ConfigurationsSupported = new_string(soap, "VideoSource VideoEncoder");
+	response.Capabilities->StreamingCapabilities = soap_new_tr2__StreamingCapabilities(soap);
+	response.Capabilities->StreamingCapabilities->RTSPStreaming = new_bool(soap, true);
+	response.Capabilities->StreamingCapabilities->RTPMulticast = new_bool(soap, camera->supportsMulticast());
+	response.Capabilities->StreamingCapabilities->RTP_USCORERTSP_USCORETCP = new_bool(soap, true);
+	return SOAP_OK;
+}
+
+int __tr2__GetProfiles(struct soap *soap, _tr2__GetProfiles *request, _tr2__GetProfilesResponse &response) {
+	Camera *camera = static_cast<Camera *>(soap->user);
+	// With Type=All, everything a client needs to set itself up comes back in one response.
+	bool video_source = false, video_encoder = false;
+	for (auto &type : request->Type) {
+		video_source = video_source || type == "All" || type == "VideoSource";
+		video_encoder = video_encoder || type == "All" || type == "VideoEncoder";
+	}
+
+	std::vector<const tt__MinimumProfile *> min_profiles;
+	if (request->Token != nullptr) {
+		auto *mp = camera->getMinimumProfile(*request->Token);
+		if (mp == nullptr) {
+			return onvif_sender_fault(soap, "ter:InvalidArgVal", "ter:NoProfile", "No such profile: " + *request->Token);
+		}
+		min_profiles.push_back(mp);
+	} else {
+		auto all = camera->getMinimumProfiles();
+		min_profiles.assign(all.begin(), all.end());
+	}
+
+	std::string current = camera->getCurrentMinimumProfile()->ProfileToken;
+	for (auto *mp : min_profiles) {
+		auto *profile = soap_new_tr2__MediaProfile(soap);
+		profile->Name = mp->Name;
+		profile->token = mp->ProfileToken;
+		// See DeleteProfile.
+		profile->fixed = new_bool(soap, mp->ProfileToken == current);
+		if (video_source || video_encoder) {
+			profile->Configurations = soap_new_tr2__ConfigurationSet(soap);
+		}
+		if (video_source && mp->VideoSourceConfigurationToken != nullptr) {
+			profile->Configurations->VideoSource = camera->getVideoSourceConfiguration(*mp->VideoSourceConfigurationToken);
+		}
+		if (video_encoder && mp->VideoEncoderConfigurationToken != nullptr) {
+			auto *vec = camera->getVideoEncoderConfiguration(*mp->VideoEncoderConfigurationToken);
+			profile->Configurations->VideoEncoder = new_vec2(soap, camera, vec);
+		}
+		response.Profiles.push_back(profile);
+	}
+	return SOAP_OK;
+}
+
+// Replaces the profile with a copy that has the configurations in refs added (or with
+// remove, taken out).
+// With name (if not null) as the profile's new name, but only if the rest is accepted.
+static int change_profile(struct soap *soap, Camera *camera, std::string profile_token,
+                          const std::vector<tr2__ConfigurationRef *> &refs, bool remove, const std::string *name = nullptr) {
+	auto *mp = camera->getMinimumProfile(profile_token);
+	if (mp == nullptr) {
+		return onvif_sender_fault(soap, "ter:InvalidArgVal", "ter:NoProfile", "No such profile: " + profile_token);
+	}
+	auto *changed = mp->soap_dup(soap);
+	if (name != nullptr) {
+		changed->Name = *name;
+	}
+	for (auto *ref : refs) {
+		bool all = ref->Type == "All";
+		if (remove) {
+			if (all || ref->Type == "VideoSource") {
+				changed->VideoSourceConfigurationToken = nullptr;
+			}
+			if (all || ref->Type == "VideoEncoder") {
+				changed->VideoEncoderConfigurationToken = nullptr;
+			}
+			continue;
+		} else if (all) {
+			continue;
+		}
+
+		// Without a token, it's up to us which.
+		if (ref->Type == "VideoSource") {
+			auto vscs = camera->getVideoSourceConfigurations();
+			auto *vsc = ref->Token != nullptr ? camera->getVideoSourceConfiguration(*ref->Token)
+				: vscs.empty() ? nullptr : vscs.front();
+			if (vsc == nullptr) {
+				return onvif_sender_fault(soap, "ter:InvalidArgVal", "ter:NoConfig", "No such video source configuration");
+			}
+			changed->VideoSourceConfigurationToken = &vsc->token;
+		} else if (ref->Type == "VideoEncoder") {
+			auto vecs = camera->getVideoEncoderConfigurations();
+			auto *vec = ref->Token != nullptr ? camera->getVideoEncoderConfiguration(*ref->Token)
+				: vecs.empty() ? nullptr : vecs.front();
+			if (vec == nullptr) {
+				return onvif_sender_fault(soap, "ter:InvalidArgVal", "ter:NoConfig", "No such video encoder configuration");
+			}
+			std::string over_budget = camera->checkEncoderBudget(vec, profile_token);
+			if (!over_budget.empty()) {
+				return onvif_receiver_fault(soap, "ter:Action", "ter:ConfigurationConflict", over_budget);
+			}
+			changed->VideoEncoderConfigurationToken = &vec->token;
+		} else {
+			return onvif_sender_fault(soap, "ter:InvalidArgVal", "ter:NoConfig", "No " + ref->Type + " configurations");
+		}
+	}
+	if (!camera->setProfile(changed)) {
+		return onvif_receiver_fault(soap, "ter:Action", "ter:ConfigurationConflict", "The profile being streamed needs both configurations");
+	}
+	return SOAP_OK;
+}
+
+int __tr2__CreateProfile(struct soap *soap, _tr2__CreateProfile *request, _tr2__CreateProfileResponse &response) {
+	Camera *camera = static_cast<Camera *>(soap->user);
+	std::string token;
+	for (int i = camera->getMinimumProfiles().size(); token.empty() || camera->getMinimumProfile(token) != nullptr; ++i) {
+		token = "profile_" + std::to_string(i);
+	}
+	if (!camera->getEncoderBudget().allowsProfiles(camera->getMinimumProfiles().size() + 1)) {
+		return onvif_receiver_fault(soap, "ter:Action", "ter:MaxProfiles", "No more profiles are allowed");
+	}
+
+	auto *mp = soap_new_tt__MinimumProfile(soap);
+	mp->Name = request->Name;
+	mp->ProfileToken = token;
+	if (!camera->setProfile(mp)) {
+		return SOAP_ERR;
+	}
+	int result = change_profile(soap, camera, token, request->Configuration, false);
+	if (result != SOAP_OK) {
+		// Not half made.
+		camera->deleteProfile(token);
+		return result;
+	}
+	response.Token = token;
+	return SOAP_OK;
+}
+
+int __tr2__DeleteProfile(struct soap *soap, _tr2__DeleteProfile *request, _tr2__DeleteProfileResponse &response) {
+	Camera *camera = static_cast<Camera *>(soap->user);
+	if (camera->getMinimumProfile(request->Token) == nullptr) {
+		return onvif_sender_fault(soap, "ter:InvalidArgVal", "ter:NoProfile", "No such profile: " + request->Token);
+	}
+	if (!camera->deleteProfile(request->Token)) {
+		return onvif_receiver_fault(soap, "ter:Action", "ter:DeletionOfFixedProfile", "The profile being streamed can't be deleted");
+	}
+	return SOAP_OK;
+}
+
+int __tr2__AddConfiguration(struct soap *soap, _tr2__AddConfiguration *request, _tr2__AddConfigurationResponse &response) {
+	Camera *camera = static_cast<Camera *>(soap->user);
+	return change_profile(soap, camera, request->ProfileToken, request->Configuration, false, request->Name);
+}
+
+int __tr2__RemoveConfiguration(struct soap *soap, _tr2__RemoveConfiguration *request, _tr2__RemoveConfigurationResponse &response) {
+	Camera *camera = static_cast<Camera *>(soap->user);
+	return change_profile(soap, camera, request->ProfileToken, request->Configuration, true);
+}
+
+int __tr2__GetVideoSourceConfigurations(struct soap *soap, tr2__GetConfiguration *request, _tr2__GetVideoSourceConfigurationsResponse &response) {
+	Camera *camera = static_cast<Camera *>(soap->user);
+	if (request->ProfileToken != nullptr && camera->getMinimumProfile(*request->ProfileToken) == nullptr) {
+		return onvif_sender_fault(soap, "ter:InvalidArgVal", "ter:NoProfile", "No such profile: " + *request->ProfileToken);
+	}
+	if (request->ConfigurationToken != nullptr) {
+		auto *vsc = camera->getVideoSourceConfiguration(*request->ConfigurationToken);
+		if (vsc == nullptr) {
+			return onvif_sender_fault(soap, "ter:InvalidArgVal", "ter:NoConfig", "No such configuration: " + *request->ConfigurationToken);
+		}
+		response.Configurations.push_back(vsc);
+	} else {
+		// Any of them can go in any profile.
+		response.Configurations = camera->getVideoSourceConfigurations();
+	}
+	return SOAP_OK;
+}
+
+int __tr2__GetVideoEncoderConfigurations(struct soap *soap, tr2__GetConfiguration *request, _tr2__GetVideoEncoderConfigurationsResponse &response) {
+	Camera *camera = static_cast<Camera *>(soap->user);
+	if (request->ProfileToken != nullptr && camera->getMinimumProfile(*request->ProfileToken) == nullptr) {
+		return onvif_sender_fault(soap, "ter:InvalidArgVal", "ter:NoProfile", "No such profile: " + *request->ProfileToken);
+	}
+	if (request->ConfigurationToken != nullptr) {
+		auto *vec = camera->getVideoEncoderConfiguration(*request->ConfigurationToken);
+		if (vec == nullptr) {
+			return onvif_sender_fault(soap, "ter:InvalidArgVal", "ter:NoConfig", "No such configuration: " + *request->ConfigurationToken);
+		}
+		response.Configurations.push_back(new_vec2(soap, camera, vec));
+	} else {
+		for (auto *vec : camera->getVideoEncoderConfigurations()) {
+			response.Configurations.push_back(new_vec2(soap, camera, vec));
+		}
+	}
+	return SOAP_OK;
+}
+
+int __tr2__SetVideoSourceConfiguration(struct soap *soap, _tr2__SetVideoSourceConfiguration *request, tr2__SetConfigurationResponse &response) {
+	Camera *camera = static_cast<Camera *>(soap->user);
+	auto *current = camera->getVideoSourceConfiguration(request->Configuration->token);
+	if (current == nullptr) {
+		return onvif_sender_fault(soap, "ter:InvalidArgVal", "ter:NoConfig", "No such configuration: " + request->Configuration->token);
+	}
+	std::string invalid = camera->getValidator().check(request->Configuration, current);
+	if (!invalid.empty()) {
+		return onvif_sender_fault(soap, "ter:InvalidArgVal", "ter:ConfigModify", invalid);
+	}
+	return camera->setVideoSourceConfiguration(request->Configuration) ? SOAP_OK : SOAP_ERR;
+}
+
+int __tr2__SetVideoEncoderConfiguration(struct soap *soap, _tr2__SetVideoEncoderConfiguration *request, tr2__SetConfigurationResponse &response) {
+	Camera *camera = static_cast<Camera *>(soap->user);
+	auto *current = camera->getVideoEncoderConfiguration(request->Configuration->token);
+	if (current == nullptr) {
+		return onvif_sender_fault(soap, "ter:InvalidArgVal", "ter:NoConfig", "No such configuration: " + request->Configuration->token);
+	}
+	tt__VideoEncoderConfiguration *vec;
+	tt__H265Configuration *h265;
+	std::string invalid = from_vec2(soap, camera, request->Configuration, current, &vec, &h265);
+	if (invalid.empty()) {
+		invalid = camera->getValidator().check(vec, current);
+	}
+	if (invalid.empty() && h265 != nullptr) {
+		invalid = camera->supportsH265() ? camera->getValidator().check(h265, camera->getH265Configuration(current->token))
+			: "The RTSP server can't encode H.265";
+	}
+	if (!invalid.empty()) {
+		return onvif_sender_fault(soap, "ter:InvalidArgVal", "ter:ConfigModify", invalid);
+	}
+	std::string over_budget = camera->checkEncoderBudget(vec);
+	if (!over_budget.empty()) {
+		return onvif_receiver_fault(soap, "ter:Action", "ter:ConfigurationConflict", over_budget);
+	}
+	return camera->setVideoEncoder(vec, h265) ? SOAP_OK : SOAP_ERR;
+}
+
+int __tr2__GetVideoSourceConfigurationOptions(struct soap *soap, tr2__GetConfiguration *request, _tr2__GetVideoSourceConfigurationOptionsResponse &response) {
+	Camera *camera = static_cast<Camera *>(soap->user);
+	response.Options = camera->getVideoSourceConfigurationOptions(request->ConfigurationToken, request->ProfileToken);
+	return SOAP_OK;
+}
+
+int __tr2__GetVideoEncoderConfigurationOptions(struct soap *soap, tr2__GetConfiguration *request, _tr2__GetVideoEncoderConfigurationOptionsResponse &response) {
+	Camera *camera = static_cast<Camera *>(soap->user);
+	// We've only the one set of Options, whichever configuration it is.
+	response.Options = new_all_options2(soap, camera);
+	return SOAP_OK;
+}
+
+int __tr2__GetStreamUri(struct soap *soap, _tr2__GetStreamUri *request, _tr2__GetStreamUriResponse &response) {
+	// As for Media1, there's only the one stream, so this switches it to the profile.
+	Camera *camera = static_cast<Camera *>(soap->user);
+	if (camera->getMinimumProfile(request->ProfileToken) == nullptr) {
+		return onvif_sender_fault(soap, "ter:InvalidArgVal", "ter:NoProfile", "No such profile: " + request->ProfileToken);
+	}
+	if (!camera->setCurrentProfile(request->ProfileToken)) {
+		return onvif_receiver_fault(soap, "ter:Action", "ter:IncompleteConfiguration", "The profile needs both configurations to be streamed");
+	}
+	response.Uri = camera->getStreamUri();
+	return SOAP_OK;
+}
@@ -0,0 +1,429 @@
+// Copyright 2023 Morse Micro
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <net/if.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include "log.h"
+#include "netstate.h"
+
+
+static const size_t NETLINK_BUFFER_SIZE = 32 * 1024;
+
+
+std::string NetworkState::Snapshot::primaryIPv4(const std::string &interface_name) const {
+	for (auto &entry : interfaces) {
+		if (entry.second.name == interface_name && !entry.second.ipv4.empty()) {
+			return entry.second.ipv4.front().address;
+		}
+	}
+	return "";
+}
+
+
+NetworkState::NetworkState(const std::string &resolv_conf_path)
+		: resolv_conf_path(resolv_conf_path), current{}, published(std::make_shared<Snapshot>()),
+		  events_socket(-1), wake_pipe{-1, -1} {
+}
+
+
+NetworkState::~NetworkState() {
+	stop();
+	for (int fd : {events_socket, wake_pipe[0], wake_pipe[1]}) {
+		if (fd != -1) {
+			close(fd);
+		}
+	}
+}
+
+
+static int open_netlink(unsigned int groups) {
+	int sock = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+	if (sock == -1) {
+		return -1;
+	}
+
+	sockaddr_nl addr = {};
+	addr.nl_family = AF_NETLINK;
+	addr.nl_groups = groups;
+	if (bind(sock, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == -1) {
+		close(sock);
+		return -1;
+	}
+	return sock;
+}
+
+
+void NetworkState::start() {
+	// Subscribe before dumping so that nothing falls between the two.
+	events_socket = open_netlink(RTMGRP_LINK | RTMGRP_IPV4_IFADDR | RTMGRP_IPV4_ROUTE);
+	if (events_socket == -1) {
+		throw std::runtime_error(std::string("Unable to open netlink socket: ") + strerror(errno));
+	}
+	if (pipe2(wake_pipe, O_CLOEXEC) == -1) {
+		throw std::runtime_error(std::string("Unable to create pipe: ") + strerror(errno));
+	}
+
+	dump();
+	thread = std::thread(&NetworkState::run, this);
+}
+
+
+void NetworkState::stop() {
+	if (thread.joinable()) {
+		char c = 0;
+		if (write(wake_pipe[1], &c, 1) != 1) {
+			LOG_ERROR("Unable to wake netlink thread: " << strerror(errno));
+		}
+		thread.join();
+	}
+}
+
+
+void NetworkState::onChange(Listener listener) {
+	std::lock_guard<std::mutex> lock(listeners_mutex);
+	listeners.push_back(std::move(listener));
+}
+
+
+void NetworkState::publish() {
+	++current.version;
+	auto snapshot = std::make_shared<const Snapshot>(current);
+	std::atomic_store(&published, snapshot);
+
+	std::vector<Listener> to_call;
+	{
+		std::lock_guard<std::mutex> lock(listeners_mutex);
+		to_call = listeners;
+	}
+	for (auto &listener : to_call) {
+		listener(*snapshot);
+	}
+}
+
+
+void NetworkState::dump() {
+	int sock = open_netlink(0);
+	if (sock == -1) {
+		throw std::runtime_error(std::string("Unable to open netlink socket: ") + strerror(errno));
+	}
+
+	// Start from scratch, since after ENOBUFS we don't know what we missed.
+	uint64_t version = current.version;
+	current = Snapshot{};
+	current.version = version;
+
+	struct {
+		uint16_t type;
+		unsigned char family;
+	} requests[] = {{RTM_GETLINK, AF_UNSPEC}, {RTM_GETADDR, AF_INET}, {RTM_GETROUTE, AF_INET}};
+
+	std::vector<char> buffer(NETLINK_BUFFER_SIZE);
+	uint32_t seq = 0;
+	for (auto &request : requests) {
+		struct {
+			nlmsghdr header;
+			rtgenmsg body;
+		} message = {};
+		message.header.nlmsg_len = sizeof(message);
+		message.header.nlmsg_type = request.type;
+		message.header.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+		message.header.nlmsg_seq = ++seq;
+		message.body.rtgen_family = request.family;
+		if (send(sock, &message, sizeof(message), 0) == -1) {
+			LOG_ERROR("Unable to request netlink dump: " << strerror(errno));
+			continue;
+		}
+
+		bool done = false;
+		while (!done) {
+			ssize_t length = recv(sock, buffer.data(), buffer.size(), 0);
+			if (length == -1) {
+				if (errno == EINTR) {
+					continue;
+				}
+				LOG_ERROR("Unable to read netlink dump: " << strerror(errno));
+				break;
+			}
+			applyMessages(buffer.data(), length, &done);
+		}
+	}
+	close(sock);
+
+	readResolvConf();
+	publish();
+}
+
+
+void NetworkState::run() {
+	std::vector<char> buffer(NETLINK_BUFFER_SIZE);
+	pollfd fds[] = {{events_socket, POLLIN, 0}, {wake_pipe[0], POLLIN, 0}};
+
+	while (true) {
+		if (poll(fds, 2, -1) == -1) {
+			if (errno == EINTR) {
+				continue;
+			}
+			LOG_ERROR("Netlink poll failed: " << strerror(errno));
+			return;
+		}
+		if (fds[1].revents) {
+			return;
+		}
+
+		ssize_t length = recv(events_socket, buffer.data(), buffer.size(), MSG_DONTWAIT);
+		if (length == -1) {
+			if (errno == ENOBUFS) {
+				LOG_WARNING("Netlink events overflowed; re-reading network state");
+				try {
+					dump();
+				} catch (std::runtime_error &e) {
+					LOG_ERROR(e.what());
+				}
+			} else if (errno != EINTR && errno != EAGAIN) {
+				LOG_ERROR("Unable to read netlink events: " << strerror(errno));
+				return;
+			}
+			continue;
+		}
+		apply(buffer.data(), length);
+	}
+}
+
+
+bool NetworkState::apply(const void *buffer, size_t length) {
+	bool done = false;
+	if (!applyMessages(buffer, length, &done)) {
+		return false;
+	}
+	publish();
+	return true;
+}
+
+
+static std::string format_ipv4(const void *data) {
+	char address[INET_ADDRSTRLEN];
+	inet_ntop(AF_INET, data, address, sizeof(address));
+	return address;
+}
+
+
+static std::string format_hw_address(const unsigned char *data, size_t length) {
+	std::string result;
+	char octet[4];
+	for (size_t i = 0; i < length; ++i) {
+		snprintf(octet, sizeof(octet), i == 0 ? "%02x" : ":%02x", data[i]);
+		result += octet;
+	}
+	return result;
+}
+
+
+template <typename T>
+static void replace_if_changed(T &target, T &&value, bool *changed) {
+	if (!(target == value)) {
+		target = std::move(value);
+		*changed = true;
+	}
+}
+
+
+bool NetworkState::applyMessages(const void *buffer, size_t length, bool *done) {
+	bool changed = false;
+	bool dns_may_have_changed = false;
+	int remaining = length;
+
+	for (auto *header = static_cast<const nlmsghdr *>(buffer); NLMSG_OK(header, remaining); header = NLMSG_NEXT(header, remaining)) {
+		switch (header->nlmsg_type) {
+		case NLMSG_DONE:
+		case NLMSG_ERROR:
+			*done = true;
+			break;
+
+		case RTM_NEWLINK:
+		case RTM_DELLINK: {
+			auto *info = static_cast<const ifinfomsg *>(NLMSG_DATA(header));
+			if (header->nlmsg_type == RTM_DELLINK) {
+				changed |= current.interfaces.erase(info->ifi_index) > 0;
+				auto &gateways = current.ipv4_gateways;
+				auto size = gateways.size();
+				gateways.erase(std::remove_if(gateways.begin(), gateways.end(),
+					[info] (const Gateway &g) { return g.interface_index == info->ifi_index; }), gateways.end());
+				changed |= gateways.size() != size;
+				break;
+			}
+
+			Interface interface = current.interfaces[info->ifi_index];
+			interface.up = info->ifi_flags & IFF_UP;
+			interface.loopback = info->ifi_flags & IFF_LOOPBACK;
+			int attr_length = IFLA_PAYLOAD(header);
+			for (auto *attr = IFLA_RTA(info); RTA_OK(attr, attr_length); attr = RTA_NEXT(attr, attr_length)) {
+				switch (attr->rta_type) {
+				case IFLA_IFNAME:
+					interface.name = static_cast<const char *>(RTA_DATA(attr));
+					break;
+				case IFLA_ADDRESS:
+					interface.hw_address = format_hw_address(static_cast<const unsigned char *>(RTA_DATA(attr)), RTA_PAYLOAD(attr));
+					break;
+				case IFLA_MTU:
+					interface.mtu = *static_cast<const uint32_t *>(RTA_DATA(attr));
+					break;
+				}
+			}
+			replace_if_changed(current.interfaces[info->ifi_index], std::move(interface), &changed);
+			break;
+		}
+
+		case RTM_NEWADDR:
+		case RTM_DELADDR: {
+			auto *info = static_cast<const ifaddrmsg *>(NLMSG_DATA(header));
+			if (info->ifa_family != AF_INET) {
+				break;
+			}
+
+			Address address = {"", info->ifa_prefixlen, false};
+			uint32_t flags = info->ifa_flags;
+			std::string local;
+			int attr_length = IFA_PAYLOAD(header);
+			for (auto *attr = IFA_RTA(info); RTA_OK(attr, attr_length); attr = RTA_NEXT(attr, attr_length)) {
+				switch (attr->rta_type) {
+				case IFA_ADDRESS:
+					address.address = format_ipv4(RTA_DATA(attr));
+					break;
+				case IFA_LOCAL:
+					// On point-to-point links IFA_ADDRESS is the peer.
+					local = format_ipv4(RTA_DATA(attr));
+					break;
+				case IFA_FLAGS:
+					flags = *static_cast<const uint32_t *>(RTA_DATA(attr));
+					break;
+				}
+			}
+			if (!local.empty()) {
+				address.address = local;
+			}
+			address.dynamic = !(flags & IFA_F_PERMANENT);
+
+			if (header->nlmsg_type == RTM_DELADDR && current.interfaces.count(info->ifa_index) == 0) {
+				break;
+			}
+			auto &addresses = current.interfaces[info->ifa_index].ipv4;
+			auto it = std::find_if(addresses.begin(), addresses.end(),
+				[&address] (const Address &a) { return a.address == address.address; });
+			if (header->nlmsg_type == RTM_DELADDR) {
+				if (it != addresses.end()) {
+					addresses.erase(it);
+					changed = true;
+				}
+			} else if (it != addresses.end()) {
+				replace_if_changed(*it, std::move(address), &changed);
+			} else {
+				addresses.push_back(std::move(address));
+				changed = true;
+			}
+			dns_may_have_changed = true;
+			break;
+		}
+
+		case RTM_NEWROUTE:
+		case RTM_DELROUTE: {
+			auto *info = static_cast<const rtmsg *>(NLMSG_DATA(header));
+			if (info->rtm_family != AF_INET || info->rtm_dst_len != 0 || info->rtm_type != RTN_UNICAST) {
+				break;
+			}
+
+			Gateway gateway = {0, ""};
+			uint32_t table = info->rtm_table;
+			int attr_length = RTM_PAYLOAD(header);
+			for (auto *attr = RTM_RTA(info); RTA_OK(attr, attr_length); attr = RTA_NEXT(attr, attr_length)) {
+				switch (attr->rta_type) {
+				case RTA_GATEWAY:
+					gateway.address = format_ipv4(RTA_DATA(attr));
+					break;
+				case RTA_OIF:
+					gateway.interface_index = *static_cast<const int *>(RTA_DATA(attr));
+					break;
+				case RTA_TABLE:
+					table = *static_cast<const uint32_t *>(RTA_DATA(attr));
+					break;
+				}
+			}
+			if (table != RT_TABLE_MAIN || gateway.address.empty()) {
+				break;
+			}
+
+			auto &gateways = current.ipv4_gateways;
+			auto it = std::find(gateways.begin(), gateways.end(), gateway);
+			if (header->nlmsg_type == RTM_DELROUTE && it != gateways.end()) {
+				gateways.erase(it);
+				changed = true;
+			} else if (header->nlmsg_type == RTM_NEWROUTE && it == gateways.end()) {
+				gateways.push_back(gateway);
+				changed = true;
+			}
+			dns_may_have_changed = true;
+			break;
+		}
+		}
+	}
+
+	if (dns_may_have_changed && !resolv_conf_path.empty()) {
+		auto nameservers = current.nameservers;
+		auto search_domains = current.search_domains;
+		readResolvConf();
+		changed |= nameservers != current.nameservers || search_domains != current.search_domains;
+	}
+
+	return changed;
+}
+
+
+void NetworkState::readResolvConf() {
+	current.nameservers.clear();
+	current.search_domains.clear();
+	if (resolv_conf_path.empty()) {
+		return;
+	}
+	std::ifstream in(resolv_conf_path);
+	parseResolvConf(in, &current.nameservers, &current.search_domains);
+}
+
+
+void NetworkState::parseResolvConf(std::istream &in, std::vector<std::string> *nameservers,
+                                   std::vector<std::string> *search_domains) {
+	std::string line;
+	while (std::getline(in, line)) {
+		std::istringstream words(line.substr(0, line.find_first_of("#;")));
+		std::string keyword, value;
+		words >> keyword;
+		if (keyword == "nameserver") {
+			if (words >> value) {
+				// We only report IPv4 DNS (as with everything else here).
+				in_addr parsed;
+				if (inet_pton(AF_INET, value.c_str(), &parsed) == 1) {
+					nameservers->push_back(value);
+				}
+			}
+		} else if (keyword == "search" || keyword == "domain") {
+			// The last of these wins.
+			search_domains->clear();
+			while (words >> value) {
+				search_domains->push_back(value);
+			}
+		}
+	}
+}
@@ -0,0 +1,121 @@
+/*
+ * Copyright 2023 Morse Micro
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+#include <functional>
+#include <istream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+/* The host's network configuration, as the kernel last told us.
+ *
+ * A background thread listens for rtnetlink link, IPv4 address and route
+ * notifications and publishes an immutable Snapshot after each batch, so that
+ * requests can read it without any syscalls. DNS isn't in netlink, so
+ * resolv.conf is re-read whenever addresses or routes change (which is
+ * when DHCP would have rewritten it).
+ */
+class NetworkState {
+	public:
+		struct Address {
+			std::string address;
+			int prefix_length;
+			bool dynamic;  // i.e. it has a lifetime, as DHCP clients set.
+
+			bool operator==(const Address &o) const {
+				return address == o.address && prefix_length == o.prefix_length && dynamic == o.dynamic;
+			}
+		};
+
+		struct Interface {
+			std::string name;
+			std::string hw_address;  // aa:bb:cc:dd:ee:ff
+			int mtu;
+			bool up;
+			bool loopback;
+			std::vector<Address> ipv4;
+
+			bool operator==(const Interface &o) const {
+				return name == o.name && hw_address == o.hw_address && mtu == o.mtu && up == o.up
+					&& loopback == o.loopback && ipv4 == o.ipv4;
+			}
+		};
+
+		struct Gateway {
+			int interface_index;
+			std::string address;
+
+			bool operator==(const Gateway &o) const {
+				return interface_index == o.interface_index && address == o.address;
+			}
+		};
+
+		struct Snapshot {
+			uint64_t version;
+			std::map<int, Interface> interfaces;  // By index.
+			std::vector<Gateway> ipv4_gateways;  // Default routes in the main table.
+			std::vector<std::string> nameservers;
+			std::vector<std::string> search_domains;
+
+			/* The first IPv4 address on the named interface ("" if none). */
+			std::string primaryIPv4(const std::string &interface_name) const;
+		};
+
+		using Listener = std::function<void(const Snapshot &snapshot)>;
+
+	private:
+		std::string resolv_conf_path;
+		Snapshot current;  // Only touched by whoever is applying messages.
+		std::shared_ptr<const Snapshot> published;
+		int events_socket;
+		int wake_pipe[2];
+		std::thread thread;
+		std::mutex listeners_mutex;
+		std::vector<Listener> listeners;
+
+		// Returns whether anything changed; sets *done on NLMSG_DONE/NLMSG_ERROR.
+		bool applyMessages(const void *buffer, size_t length, bool *done);
+		void dump();
+		void run();
+		void publish();
+		void readResolvConf();
+
+	public:
+		explicit NetworkState(const std::string &resolv_conf_path = "/etc/resolv.conf");
+		~NetworkState();
+
+		NetworkState(const NetworkState &) = delete;
+		NetworkState &operator=(const NetworkState &) = delete;
+
+		/* Subscribes to netlink and reads the current state, then keeps it up to date
+		 * on a background thread. Throws std::runtime_error if netlink isn't available.
+		 */
+		void start();
+
+		/* Stops the background thread (so listeners won't be called again). */
+		void stop();
+
+		std::shared_ptr<const Snapshot> get() const { return std::atomic_load(&published); }
+
+		/* Called on the netlink thread with every new snapshot after start. */
+		void onChange(Listener listener);
+
+		/* Updates the state from a buffer of netlink messages (as recv'd), publishing
+		 * a new snapshot if anything changed. Returns whether it did.
+		 */
+		bool apply(const void *buffer, size_t length);
+
+		static void parseResolvConf(std::istream &in, std::vector<std::string> *nameservers,
+		                            std::vector<std::string> *search_domains);
+};
@@ -0,0 +1,240 @@
+// Copyright 2023 Morse Micro
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <string.h>
+
+#include <algorithm>
+#include <memory>
+#include <sstream>
+
+#include "soaplib/wsddapi.h"
+
+#include "probematches.h"
+#include "utils.h"
+
+
+// These only have to be things that gsoap won't escape and that can't turn up anywhere
+// else in the header. The body has the scopes, which are the client's to set, so they
+// can turn up there.
+static const char *MESSAGE_ID_PLACEHOLDER = "urn:uuid:@@MessageID@@";
+static const char *RELATES_TO_PLACEHOLDER = "urn:uuid:@@RelatesTo@@";
+static const unsigned int MESSAGE_NUMBER_PLACEHOLDER = 0xdeadbeef;
+// gsoap escapes '>' in text, so the first of these is where the body really starts.
+static const char *BODY_START = ":Body>";
+
+// to_ts_URL in wsddapi.c.
+static const char *TARGET_SERVICE_TO = "urn:schemas-xmlsoap-org:ws:2005:04:discovery";
+
+
+namespace {
+	struct SoapFree {
+		void operator()(struct soap *soap) const {
+			soap_destroy(soap);
+			soap_end(soap);
+			soap_free(soap);
+		}
+	};
+}
+
+
+// This is soap_send___wsdd__X, except that it goes into a string. It frees the context
+// however it finishes, including gsoap's bad_allocs (see SOAP_NOTHROW in the Makefile).
+template <typename T>
+static std::string serialise(struct soap *soap, T *message, void (*serialise_message)(struct soap *, const T *),
+                             int (*put_message)(struct soap *, const T *, const char *, const char *), const char *tag) {
+	std::unique_ptr<struct soap, SoapFree> owned(soap);
+	std::ostringstream envelope;
+	soap->os = &envelope;
+	soap->encodingStyle = NULL;
+	soap_serializeheader(soap);
+	serialise_message(soap, message);
+	if (soap_begin_send(soap)
+			|| soap_envelope_begin_out(soap)
+			|| soap_putheader(soap)
+			|| soap_body_begin_out(soap)
+			|| put_message(soap, message, tag, "")
+			|| soap_body_end_out(soap)
+			|| soap_envelope_end_out(soap)
+			|| soap_end_send(soap)) {
+		std::ostringstream error;
+		soap_stream_fault(soap, error);
+		throw SoapError(std::string("Unable to serialise ") + tag + "\n" + error.str());
+	}
+	soap->os = NULL;
+	return envelope.str();
+}
+
+
+static void set_app_sequence(struct soap *soap, unsigned int instance_id, const std::string &sequence_id, unsigned int message_number) {
+	auto *seq = static_cast<wsdd__AppSequenceType *>(soap_malloc(soap, sizeof(wsdd__AppSequenceType)));
+	soap_default_wsdd__AppSequenceType(soap, seq);
+	seq->InstanceId = instance_id;
+	seq->SequenceId = soap_strdup(soap, sequence_id.c_str());
+	seq->MessageNumber = message_number;
+	soap->header->wsdd__AppSequence = seq;
+}
+
+
+static void append_escaped(std::string *out, const char *s) {
+	for (; *s != '\0'; ++s) {
+		switch (*s) {
+			case '&': out->append("&amp;"); break;
+			case '<': out->append("&lt;"); break;
+			case '>': out->append("&gt;"); break;
+			case '"': out->append("&quot;"); break;
+			default: out->push_back(*s);
+		}
+	}
+}
+
+
+ProbeMatchesTemplate::ProbeMatchesTemplate(const std::string &endpoint_reference, const char *types, const char *scopes,
+                                           const std::string &xaddrs, unsigned int metadata_version,
+                                           unsigned int instance_id, const std::string &sequence_id)
+	: xaddrs(xaddrs)
+{
+	// UDP mode so that we get exactly what soap_wsdd_ProbeMatches would have sent.
+	struct soap *soap = soap_new1(SOAP_IO_UDP);
+	const char *action = SOAP_NAMESPACE_OF_wsdd"/ProbeMatches";
+
+	struct wsdd__ProbeMatchesType matches;
+	soap_default_wsdd__ProbeMatchesType(soap, &matches);
+	soap_wsdd_add_ProbeMatch(soap, &matches, endpoint_reference.c_str(), types, scopes, NULL, xaddrs.c_str(), metadata_version);
+
+	soap_wsa_request(soap, MESSAGE_ID_PLACEHOLDER, NULL, action);
+	soap_wsa_add_RelatesTo(soap, RELATES_TO_PLACEHOLDER);
+	set_app_sequence(soap, instance_id, sequence_id, MESSAGE_NUMBER_PLACEHOLDER);
+
+	struct __wsdd__ProbeMatches message;
+	message.wsdd__ProbeMatches = &matches;
+	const std::string text = serialise(soap, &message, soap_serialize___wsdd__ProbeMatches, soap_put___wsdd__ProbeMatches, "-wsdd:ProbeMatches");
+
+	const std::vector<std::pair<std::string, Field>> placeholders = {
+		{MESSAGE_ID_PLACEHOLDER, Field::MessageId},
+		{RELATES_TO_PLACEHOLDER, Field::RelatesTo},
+		{std::to_string(MESSAGE_NUMBER_PLACEHOLDER), Field::MessageNumber},
+	};
+
+	// Only looking in the header, so nothing the scopes say matters.
+	size_t body = text.find(BODY_START);
+	std::vector<std::pair<size_t, size_t>> found;  // (position, index into placeholders)
+	for (size_t i = 0; i < placeholders.size(); ++i) {
+		size_t position = text.find(placeholders[i].first);
+		if (position >= body || text.find(placeholders[i].first, position + 1) < body) {
+			throw SoapError("Unable to find exactly one " + placeholders[i].first + " in the serialised ProbeMatches header");
+		}
+		found.emplace_back(position, i);
+	}
+	std::sort(found.begin(), found.end());
+
+	size_t start = 0;
+	for (auto &f : found) {
+		segments.push_back({text.substr(start, f.first - start), placeholders[f.second].second});
+		start = f.first + placeholders[f.second].first.size();
+	}
+	segments.push_back({text.substr(start), Field::None});
+
+	for (auto &segment : segments) {
+		literal_length += segment.literal.size();
+	}
+}
+
+
+void ProbeMatchesTemplate::render(std::string *datagram, const char *message_id, const char *relates_to, unsigned int message_number) const {
+	datagram->clear();
+	datagram->reserve(literal_length + strlen(message_id) + strlen(relates_to) * 2 + 10);
+
+	for (auto &segment : segments) {
+		datagram->append(segment.literal);
+		switch (segment.field) {
+			case Field::MessageId:
+				append_escaped(datagram, message_id);
+				break;
+			case Field::RelatesTo:
+				append_escaped(datagram, relates_to);
+				break;
+			case Field::MessageNumber:
+				datagram->append(std::to_string(message_number));
+				break;
+			case Field::None:
+				break;
+		}
+	}
+}
+
+
+std::string serialise_hello(const std::string &endpoint_reference, const char *types, const char *scopes,
+                            const std::string &xaddrs, unsigned int metadata_version, const char *message_id,
+                            const char *relates_to, unsigned int instance_id, const std::string &sequence_id,
+                            unsigned int message_number) {
+	struct soap *soap = soap_new1(SOAP_IO_UDP);
+	const char *action = SOAP_NAMESPACE_OF_wsdd"/Hello";
+
+	// As soap_wsdd_Hello does in ad-hoc mode.
+	soap_wsa_request(soap, message_id, TARGET_SERVICE_TO, action);
+	soap_wsa_add_RelatesTo(soap, relates_to);
+	set_app_sequence(soap, instance_id, sequence_id, message_number);
+
+	struct wsdd__HelloType hello;
+	struct wsdd__ScopesType hello_scopes;
+	soap_default_wsdd__HelloType(soap, &hello);
+	hello.wsa5__EndpointReference.Address = const_cast<char *>(endpoint_reference.c_str());
+	hello.Types = const_cast<char *>(types);
+	if (scopes != NULL) {
+		soap_default_wsdd__ScopesType(soap, &hello_scopes);
+		hello_scopes.__item = const_cast<char *>(scopes);
+		hello.Scopes = &hello_scopes;
+	}
+	hello.XAddrs = const_cast<char *>(xaddrs.c_str());
+	hello.MetadataVersion = metadata_version;
+
+	struct __wsdd__Hello message;
+	message.wsdd__Hello = &hello;
+	return serialise(soap, &message, soap_serialize___wsdd__Hello, soap_put___wsdd__Hello, "-wsdd:Hello");
+}
+
+
+
+std::string serialise_bye(const std::string &endpoint_reference, const char *types, const char *scopes,
+                          const std::string &xaddrs, unsigned int metadata_version, const char *message_id,
+                          unsigned int instance_id, const std::string &sequence_id, unsigned int message_number) {
+	struct soap *soap = soap_new1(SOAP_IO_UDP);
+	const char *action = SOAP_NAMESPACE_OF_wsdd"/Bye";
+
+	// As soap_wsdd_Bye does in ad-hoc mode.
+	soap_wsa_request(soap, message_id, TARGET_SERVICE_TO, action);
+	set_app_sequence(soap, instance_id, sequence_id, message_number);
+
+	struct wsdd__ByeType bye;
+	struct wsdd__ScopesType bye_scopes;
+	soap_default_wsdd__ByeType(soap, &bye);
+	bye.wsa5__EndpointReference.Address = const_cast<char *>(endpoint_reference.c_str());
+	bye.Types = const_cast<char *>(types);
+	if (scopes != NULL) {
+		soap_default_wsdd__ScopesType(soap, &bye_scopes);
+		bye_scopes.__item = const_cast<char *>(scopes);
+		bye.Scopes = &bye_scopes;
+	}
+	bye.XAddrs = const_cast<char *>(xaddrs.c_str());
+	bye.MetadataVersion = &metadata_version;
+
+	struct __wsdd__Bye message;
+	message.wsdd__Bye = &bye;
+	return serialise(soap, &message, soap_serialize___wsdd__Bye, soap_put___wsdd__Bye, "-wsdd:Bye");
+}
+
+std::string serialise_probe(const char *types, const char *message_id) {
+	struct soap *soap = soap_new1(SOAP_IO_UDP);
+	const char *action = SOAP_NAMESPACE_OF_wsdd"/Probe";
+
+	// As soap_wsdd_Probe does for SOAP_WSDD_TO_TS (so replies come back to the sending socket).
+	soap_wsa_request(soap, message_id, TARGET_SERVICE_TO, action);
+
+	struct wsdd__ProbeType probe;
+	soap_default_wsdd__ProbeType(soap, &probe);
+	probe.Types = const_cast<char *>(types);
+
+	struct __wsdd__Probe message;
+	message.wsdd__Probe = &probe;
+	return serialise(soap, &message, soap_serialize___wsdd__Probe, soap_put___wsdd__Probe, "-wsdd:Probe");
+}
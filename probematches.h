@@ -0,0 +1,64 @@
+/*
+ * Copyright 2023 Morse Micro
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+
+/* A WS-Discovery ProbeMatches datagram for our one target service.
+ *
+ * Everything except the MessageID, RelatesTo and AppSequence MessageNumber is the
+ * same for every probe, so gsoap serialises the envelope once and each reply is
+ * rendered by copying the literal pieces and filling in those three fields.
+ * Build a new one whenever anything in the match (e.g. XAddrs) changes.
+ */
+class ProbeMatchesTemplate {
+	private:
+		enum class Field {
+			MessageId,
+			RelatesTo,
+			MessageNumber,
+			None,
+		};
+
+		struct Segment {
+			std::string literal;
+			Field field;  // Follows literal.
+		};
+
+		std::vector<Segment> segments;
+		size_t literal_length = 0;
+		std::string xaddrs;
+
+	public:
+		/* Throws SoapError if gsoap can't serialise the message. */
+		ProbeMatchesTemplate(const std::string &endpoint_reference, const char *types, const char *scopes,
+		                     const std::string &xaddrs, unsigned int metadata_version,
+		                     unsigned int instance_id, const std::string &sequence_id);
+
+		const std::string &getXAddrs() const { return xaddrs; }
+
+		/* Replaces the contents of datagram with the complete SOAP envelope. */
+		void render(std::string *datagram, const char *message_id, const char *relates_to, unsigned int message_number) const;
+};
+
+
+/* A complete ad-hoc mode Hello (as soap_wsdd_Hello would send), for sending ourselves.
+ * relates_to is only for a discovery proxy's reply to a probe (otherwise NULL).
+ */
+extern std::string serialise_hello(const std::string &endpoint_reference, const char *types, const char *scopes,
+                                   const std::string &xaddrs, unsigned int metadata_version, const char *message_id,
+                                   const char *relates_to, unsigned int instance_id, const std::string &sequence_id,
+                                   unsigned int message_number);
+
+/* As serialise_hello, but saying we're going away. */
+extern std::string serialise_bye(const std::string &endpoint_reference, const char *types, const char *scopes,
+                                 const std::string &xaddrs, unsigned int metadata_version, const char *message_id,
+                                 unsigned int instance_id, const std::string &sequence_id, unsigned int message_number);
+
+/* A multicast Probe for types (NULL for everything). */
+extern std::string serialise_probe(const char *types, const char *message_id);
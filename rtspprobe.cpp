@@ -0,0 +1,235 @@
+// Copyright 2023 Morse Micro
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <sstream>
+
+#include "log.h"
+#include "rtspprobe.h"
+
+
+namespace {
+	struct Response {
+		int status;
+		std::string headers;  // Including the status line.
+		std::string body;
+
+		// Empty if it isn't there.
+		std::string header(const std::string &name) const {
+			std::istringstream lines(headers);
+			std::string line;
+			while (std::getline(lines, line)) {
+				size_t colon = line.find(':');
+				if (colon == name.size() && strncasecmp(line.c_str(), name.c_str(), colon) == 0) {
+					size_t start = line.find_first_not_of(' ', colon + 1);
+					size_t end = line.find_last_not_of("\r ");
+					return start == std::string::npos || end < start ? "" : line.substr(start, end + 1 - start);
+				}
+			}
+			return "";
+		}
+	};
+
+	class Connection {
+		private:
+			int fd;
+			std::chrono::steady_clock::time_point deadline;
+			std::string buffer;
+			int cseq;
+
+			int remaining_ms() {
+				auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+				return left.count() > 0 ? static_cast<int>(left.count()) : 0;
+			}
+
+			bool wait(short events) {
+				struct pollfd pfd = {fd, events, 0};
+				int result;
+				do {
+					result = poll(&pfd, 1, remaining_ms());
+				} while (result == -1 && errno == EINTR);
+				return result == 1;
+			}
+
+			bool fill() {
+				char data[4096];
+				if (!wait(POLLIN)) {
+					return false;
+				}
+				ssize_t count = recv(fd, data, sizeof(data), 0);
+				if (count <= 0) {
+					return false;
+				}
+				buffer.append(data, count);
+				return true;
+			}
+
+		public:
+			explicit Connection(std::chrono::steady_clock::time_point deadline) : fd(-1), deadline(deadline), cseq(0) {}
+
+			~Connection() {
+				if (fd != -1) {
+					close(fd);
+				}
+			}
+
+			bool open(const std::string &host, const std::string &port) {
+				struct addrinfo hints = {};
+				hints.ai_family = AF_UNSPEC;
+				hints.ai_socktype = SOCK_STREAM;
+				struct addrinfo *addresses;
+				if (getaddrinfo(host.c_str(), port.c_str(), &hints, &addresses) != 0) {
+					return false;
+				}
+				fd = socket(addresses->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+				bool connected = fd != -1
+					&& (connect(fd, addresses->ai_addr, addresses->ai_addrlen) == 0
+						|| (errno == EINPROGRESS && wait(POLLOUT)));
+				freeaddrinfo(addresses);
+
+				int error = 0;
+				socklen_t length = sizeof(error);
+				return connected && getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length) == 0 && error == 0;
+			}
+
+			bool request(const std::string &method, const std::string &url, const std::string &headers) {
+				std::ostringstream message;
+				message << method << " " << url << " RTSP/1.0\r\nCSeq: " << ++cseq << "\r\n" << headers << "\r\n";
+				std::string data = message.str();
+				while (!data.empty()) {
+					ssize_t count = send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+					if (count == -1 && errno == EAGAIN && wait(POLLOUT)) {
+						continue;
+					} else if (count <= 0) {
+						return false;
+					}
+					data.erase(0, count);
+				}
+				return true;
+			}
+
+			// Whether the next thing the server sends is an RTP (or RTCP) packet, rather than
+			// a response (which goes in response).
+			bool next(Response *response, bool *rtp) {
+				while (true) {
+					if (!buffer.empty() && buffer[0] == '$') {
+						*rtp = true;
+						return true;
+					}
+					size_t end = buffer.find("\r\n\r\n");
+					if (end != std::string::npos) {
+						response->headers = buffer.substr(0, end + 2);
+						size_t length = std::strtoul(response->header("Content-Length").c_str(), nullptr, 10);
+						if (buffer.size() >= end + 4 + length) {
+							response->body = buffer.substr(end + 4, length);
+							buffer.erase(0, end + 4 + length);
+							// e.g. "RTSP/1.0 200 OK"
+							response->status = std::atoi(response->headers.c_str() + response->headers.find(' ') + 1);
+							*rtp = false;
+							return true;
+						}
+					}
+					if (!fill()) {
+						return false;
+					}
+				}
+			}
+
+			// The response to the last request.
+			bool response(Response *response) {
+				bool rtp;
+				return next(response, &rtp) && !rtp && response->status == 200;
+			}
+	};
+}
+
+
+// The video stream's control URL from the SDP (or the first stream's, if there's no video).
+static std::string track_url(const std::string &base, const std::string &sdp) {
+	std::istringstream lines(sdp);
+	std::string line;
+	std::string first, video;
+	bool in_media = false, in_video = false;
+	while (std::getline(lines, line)) {
+		if (!line.empty() && line.back() == '\r') {
+			line.pop_back();
+		}
+		if (line.compare(0, 2, "m=") == 0) {
+			in_media = true;
+			in_video = line.compare(0, 8, "m=video ") == 0;
+		} else if (in_media && line.compare(0, 10, "a=control:") == 0) {
+			if (first.empty()) {
+				first = line.substr(10);
+			}
+			if (in_video && video.empty()) {
+				video = line.substr(10);
+			}
+		}
+	}
+	std::string control = video.empty() ? first : video;
+
+	if (control.empty() || control == "*") {
+		return base;
+	} else if (control.compare(0, 7, "rtsp://") == 0) {
+		return control;
+	}
+	return (base.back() == '/' ? base : base + "/") + control;
+}
+
+
+long rtsp_time_to_first_frame(const std::string &url, int timeout_ms) {
+	auto start = std::chrono::steady_clock::now();
+
+	// rtsp://host[:port]/path
+	if (url.compare(0, 7, "rtsp://") != 0) {
+		return -1;
+	}
+	size_t path_start = url.find('/', 7);
+	std::string authority = url.substr(7, path_start == std::string::npos ? std::string::npos : path_start - 7);
+	size_t colon = authority.find(':');
+	std::string host = authority.substr(0, colon);
+	std::string port = colon == std::string::npos ? "554" : authority.substr(colon + 1);
+
+	Connection connection(start + std::chrono::milliseconds(timeout_ms));
+	Response response;
+	if (!connection.open(host, port)
+			|| !connection.request("DESCRIBE", url, "Accept: application/sdp\r\n")
+			|| !connection.response(&response)) {
+		LOG_DEBUG("RTSP probe of " << url << " failed to DESCRIBE");
+		return -1;
+	}
+	std::string base = response.header("Content-Base");
+	if (base.empty()) {
+		base = url;
+	}
+
+	if (!connection.request("SETUP", track_url(base, response.body), "Transport: RTP/AVP/TCP;unicast;interleaved=0-1\r\n")
+			|| !connection.response(&response)) {
+		LOG_DEBUG("RTSP probe of " << url << " failed to SETUP");
+		return -1;
+	}
+	std::string session = response.header("Session");
+	session = session.substr(0, session.find(';'));
+
+	if (!connection.request("PLAY", base, "Session: " + session + "\r\nRange: npt=0.000-\r\n")) {
+		return -1;
+	}
+	bool rtp = false;
+	while (!rtp) {
+		// i.e. the PLAY response, which some servers send after the first packet.
+		if (!connection.next(&response, &rtp)) {
+			LOG_DEBUG("RTSP probe of " << url << " got no RTP within " << timeout_ms << "ms");
+			return -1;
+		}
+	}
+	return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+}
@@ -0,0 +1,17 @@
+/*
+ * Copyright 2023 Morse Micro
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#pragma once
+
+#include <string>
+
+
+/* Plays url (interleaved over TCP) only until the first RTP packet arrives, and
+ * returns how many ms that took, or -1 if it didn't within timeout_ms.
+ *
+ * This is how long a viewer waits for a resumed encoder (see Camera::monitorStream),
+ * less however long it took us to notice them.
+ */
+long rtsp_time_to_first_frame(const std::string &url, int timeout_ms);
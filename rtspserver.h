@@ -7,6 +7,10 @@
 
 #include "soaplib/soapH.h"
 
+#include "log.h"
+
+#include <stdexcept>
+
 
 /* Every time we start an ONVIF server, it starts knowing about exactly one RtspServer.
  * Which RtspServer class is used is selected via the properties.xml file;
@@ -15,14 +19,74 @@
  */
 class RtspServer {
 	public:
-		/* Make sure the stream exists at the appropriate path. */
-		virtual void initialise(const tt__VideoEncoderConfiguration *, const tt__ImagingSettings20 *, const tt__VideoSourceConfiguration *) = 0;
+		struct Readers {
+			int unicast;
+			int multicast;
+		};
+
+		/* Make sure the stream exists at the appropriate path. The H265Configuration is null
+		 * unless the encoder configuration is to be encoded as H.265 (see supportsH265).
+		 */
+		virtual void initialise(const tt__VideoEncoderConfiguration *, const tt__H265Configuration *, const tt__ImagingSettings20 *, const tt__VideoSourceConfiguration *) = 0;
 
-		virtual void setVideoEncoderConfiguration(const tt__VideoEncoderConfiguration *) = 0;
+		virtual void setVideoEncoderConfiguration(const tt__VideoEncoderConfiguration *, const tt__H265Configuration *) = 0;
 
 		virtual void setImagingSettings(const tt__ImagingSettings20 *) = 0;
 
 		virtual void setVideoSourceConfiguration(const tt__VideoSourceConfiguration *) = 0;
+
+		virtual bool supportsH265() {
+			return false;
+		}
+
+		virtual bool supportsMulticast() {
+			return false;
+		}
+
+		/* Also sends the stream to multicast's group (and only there if only_multicast,
+		 * so that new viewers have to join it), or stops doing so if it's null.
+		 * Throws std::runtime_error if that doesn't work.
+		 */
+		virtual void setMulticast(const tt__MulticastConfiguration *multicast, bool only_multicast) {
+			throw std::runtime_error("This RTSP server doesn't support multicast");
+		}
+
+		/* Who's watching the stream, if we can tell. */
+		virtual bool getReaders(Readers *readers) {
+			return false;
+		}
+
+		/* Stops encoding while nobody's watching, but still accepts viewers, returning whether
+		 * it's suspended (or will suspend itself). Calling it again while suspended is harmless.
+		 */
+		virtual bool suspend() {
+			return false;
+		}
+
+		/* Starts encoding again, returning false if it wasn't suspended (so nothing changed). */
+		virtual bool resume() {
+			return false;
+		}
+
+		/* Whether it resumes by itself for a new viewer, so resume() needn't be called. */
+		virtual bool resumesItself() {
+			return false;
+		}
+
+		/* Whether setBitrate can work at all (it can still fail now and then). */
+		virtual bool supportsSetBitrate() {
+			return false;
+		}
+
+		/* Changes just the bitrate (kbit/s), without restarting the stream, or returns false
+		 * if that didn't work. The next setVideoEncoderConfiguration replaces it.
+		 */
+		virtual bool setBitrate(int bitrate) {
+			return false;
+		}
+
+		/* We're shutting down (by default the stream is someone else's to stop). */
+		virtual void stop() {}
 };
 
 
@@ -30,19 +94,50 @@ class RtspServerDummy : public RtspServer {
 	public:
 		RtspServerDummy() {}
 
-		virtual void initialise(const tt__VideoEncoderConfiguration *, const tt__ImagingSettings20 *, const tt__VideoSourceConfiguration *) {
-			std::cout << "Initialising the rtsp server!" << std::endl;
+		virtual void initialise(const tt__VideoEncoderConfiguration *, const tt__H265Configuration *, const tt__ImagingSettings20 *, const tt__VideoSourceConfiguration *) {
+			LOG_INFO("Initialising the rtsp server!");
 		}
 
-		virtual void setVideoEncoderConfiguration(const tt__VideoEncoderConfiguration *) {
-			std::cout << "Setting the video encoder config!" << std::endl;
+		virtual void setVideoEncoderConfiguration(const tt__VideoEncoderConfiguration *, const tt__H265Configuration *h265) {
+			LOG_INFO("Setting the video encoder config" << (h265 != nullptr ? " (H.265)" : "") << "!");
 		}
 
 		virtual void setImagingSettings(const tt__ImagingSettings20 *) {
-			std::cout << "Setting the imaging settings!" << std::endl;
+			LOG_INFO("Setting the imaging settings!");
 		}
 
 		virtual void setVideoSourceConfiguration(const tt__VideoSourceConfiguration *) {
-			std::cout << "Setting the video source config!" << std::endl;
+			LOG_INFO("Setting the video source config!");
+		}
+
+		virtual bool supportsH265() {
+			return true;
+		}
+
+		virtual bool supportsMulticast() {
+			return true;
+		}
+
+		virtual void setMulticast(const tt__MulticastConfiguration *multicast, bool only_multicast) {
+			LOG_INFO("Setting multicast " << (multicast == nullptr ? "off" : only_multicast ? "on (only)" : "on") << "!");
+		}
+
+		virtual bool supportsSetBitrate() {
+			return true;
+		}
+
+		virtual bool setBitrate(int bitrate) {
+			LOG_INFO("Setting the bitrate to " << bitrate << "kbit/s!");
+			return true;
+		}
+
+		virtual bool suspend() {
+			LOG_INFO("Suspending the encoder!");
+			return true;
+		}
+
+		virtual bool resume() {
+			LOG_INFO("Resuming the encoder!");
+			return false;
 		}
 };
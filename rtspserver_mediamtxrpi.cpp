@@ -2,6 +2,7 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 
 #include "rtspserver_mediamtxrpi.h"
+#include "log.h"
 #include "utils.h"
 
 #include "soaplib/json.h"
@@ -9,6 +10,10 @@
 #include <map>
 
 
+// The API is on localhost, so this is only reached if MediaMTX is wedged (and we hold the camera lock).
+static const int API_TIMEOUT_SECONDS = 5;
+
+
 static const std::map<tt__H264Profile, std::string> profileMap = {
 	{tt__H264Profile::Baseline, "baseline"},
 	{tt__H264Profile::Main, "main"},
@@ -44,6 +49,13 @@ static int json_call_method(struct soap *soap, const char *endpoint, soap_http_c
 }
 
 
+static soap *new_api_soap() {
+	soap *soap = soap_new1(SOAP_C_UTFSTRING);
+	soap->connect_timeout = soap->recv_timeout = soap->send_timeout = API_TIMEOUT_SECONDS;
+	return soap;
+}
+
+
 static void videoEncoderConfigurationToJson(json::value *v, const tt__VideoEncoderConfiguration *vec) {
 	(*v)["rpiCameraWidth"] = vec->Resolution->Width;
 	(*v)["rpiCameraHeight"] = vec->Resolution->Height;
@@ -79,22 +91,26 @@ static void videoSourceConfigurationToJson(json::value *v, const tt__VideoSource
 }
 
 
-void RtspServerMediaMtxRpi::initialise(const tt__VideoEncoderConfiguration *vec, const tt__ImagingSettings20 *imaging_settings, const tt__VideoSourceConfiguration *vsc) {
+void RtspServerMediaMtxRpi::initialise(const tt__VideoEncoderConfiguration *vec, const tt__H265Configuration *, const tt__ImagingSettings20 *imaging_settings, const tt__VideoSourceConfiguration *vsc) {
 	// The MediaMTX API is very 'RPC-y', and confusingly use http verbs AND the path to
 	// indicate the actions. There's also nothing even close to an idempotent PUT, so we
 	// first add the configuration, and if that fails, PATCH it.
-	soap *soap = soap_new1(SOAP_C_UTFSTRING);
+	soap *soap = new_api_soap();
 	json::value request(soap);
 
 	// Build the request JSON.
 	request["source"] = "rpiCamera";
 	request["sourceOnDemand"] = true;
+	if (idleSeconds >= 0) {
+		request["sourceOnDemandCloseAfter"] = std::to_string(idleSeconds) + "s";
+	}
 	videoEncoderConfigurationToJson(&request, vec);
 	imagingSettingsToJson(&request, imaging_settings);
 	videoSourceConfigurationToJson(&request, vsc);
 
 	// WARNING: this will fail (400) if the RPI camera is already configured on a different
-	// path, and will end up aborting (see SoapError below).
+	// path, in which case (as when MediaMTX isn't up yet) we throw a SoapError and the
+	// caller retries.
 	const std::string endpoint = url + "/v3/config/paths/add/" + streamPath;
 
 	if (json_call_method(soap, endpoint.c_str(), SOAP_POST_FILE, &request, nullptr)) {
@@ -110,16 +126,15 @@ void RtspServerMediaMtxRpi::initialise(const tt__VideoEncoderConfiguration *vec,
 }
 
 
-void RtspServerMediaMtxRpi::setVideoEncoderConfiguration(const tt__VideoEncoderConfiguration *vec) {
-	soap *soap = soap_new1(SOAP_C_UTFSTRING);
+void RtspServerMediaMtxRpi::setVideoEncoderConfiguration(const tt__VideoEncoderConfiguration *vec, const tt__H265Configuration *) {
+	soap *soap = new_api_soap();
 	json::value request(soap);
 	videoEncoderConfigurationToJson(&request, vec);
 
 	const std::string endpoint = url + "/v3/config/paths/patch/" + streamPath;
 
 	if (json_call_method(soap, endpoint.c_str(), SOAP_PATCH, &request, nullptr)) {
-		std::cerr << "Error when updating video encoder configuration via " << endpoint << ":" << std::endl;
-		soap_print_fault(soap, stderr);
+		LOG_ERROR("Error when updating video encoder configuration via " << endpoint << ":\n" << soap_fault_string(soap));
 	}
 
 	soap_destroy(soap);
@@ -129,15 +144,14 @@ void RtspServerMediaMtxRpi::setVideoEncoderConfiguration(const tt__VideoEncoderC
 
 
 void RtspServerMediaMtxRpi::setImagingSettings(const tt__ImagingSettings20 *imaging_settings) {
-	soap *soap = soap_new1(SOAP_C_UTFSTRING);
+	soap *soap = new_api_soap();
 	json::value request(soap);
 	imagingSettingsToJson(&request, imaging_settings);
 
 	const std::string endpoint = url + "/v3/config/paths/patch/" + streamPath;
 
 	if (json_call_method(soap, endpoint.c_str(), SOAP_PATCH, &request, nullptr)) {
-		std::cerr << "Error when updating imaging settings via " << endpoint << ":" << std::endl;
-		soap_print_fault(soap, stderr);
+		LOG_ERROR("Error when updating imaging settings via " << endpoint << ":\n" << soap_fault_string(soap));
 	}
 
 	soap_destroy(soap);
@@ -147,18 +161,105 @@ void RtspServerMediaMtxRpi::setImagingSettings(const tt__ImagingSettings20 *imag
 
 
 void RtspServerMediaMtxRpi::setVideoSourceConfiguration(const tt__VideoSourceConfiguration *vsc) {
-	soap *soap = soap_new1(SOAP_C_UTFSTRING);
+	soap *soap = new_api_soap();
 	json::value request(soap);
 	videoSourceConfigurationToJson(&request, vsc);
 
 	const std::string endpoint = url + "/v3/config/paths/patch/" + streamPath;
 
 	if (json_call_method(soap, endpoint.c_str(), SOAP_PATCH, &request, nullptr)) {
-		std::cerr << "Error when updating video source configuration via " << endpoint << ":" << std::endl;
-		soap_print_fault(soap, stderr);
+		LOG_ERROR("Error when updating video source configuration via " << endpoint << ":\n" << soap_fault_string(soap));
+	}
+
+	soap_destroy(soap);
+	soap_end(soap);
+	soap_free(soap);
+}
+
+
+// Multicast is a server-wide setting in MediaMTX (rather than per path), and there's
+// no TTL setting, so the TTL is left to the OS default.
+void RtspServerMediaMtxRpi::setMulticast(const tt__MulticastConfiguration *multicast, bool only_multicast) {
+	soap *soap = new_api_soap();
+	json::value request(soap);
+
+	// Clients pick the first of these they can use when they SETUP.
+	json::value &transports = request["rtspTransports"];
+	int i = 0;
+	if (multicast != nullptr) {
+		transports[i++] = "multicast";
+		request["multicastIPRange"] = *multicast->Address->IPv4Address + "/32";
+		request["multicastRTPPort"] = multicast->Port;
+		request["multicastRTCPPort"] = multicast->Port + 1;
+	}
+	if (multicast == nullptr || !only_multicast) {
+		transports[i++] = "udp";
+		transports[i++] = "tcp";
+	}
+
+	const std::string endpoint = url + "/v3/config/global/patch";
+	int status = json_call_method(soap, endpoint.c_str(), SOAP_PATCH, &request, nullptr);
+	std::string error = status == SOAP_OK ? "" : soap_fault_string(soap);
+
+	soap_destroy(soap);
+	soap_end(soap);
+	soap_free(soap);
+
+	if (!error.empty()) {
+		throw SoapError("Setting multicast via " + endpoint + ": " + error);
+	}
+}
+
+
+bool RtspServerMediaMtxRpi::getReaders(Readers *readers) {
+	soap *soap = new_api_soap();
+	json::value response(soap);
+
+	const std::string endpoint = url + "/v3/rtspsessions/list?itemsPerPage=1000";
+	bool ok = json_call(soap, endpoint.c_str(), nullptr, &response) == SOAP_OK;
+	if (ok) {
+		readers->unicast = readers->multicast = 0;
+		json::value &items = response["items"];
+		for (int i = 0; i < items.size(); ++i) {
+			json::value &session = items[i];
+			if (!session["path"].is_string() || std::string(session["path"]) != streamPath
+					|| !session["state"].is_string() || std::string(session["state"]) != "read") {
+				continue;
+			}
+			// e.g. UDP, TCP or UDP-multicast.
+			std::string transport = session["transport"].is_string() ? std::string(session["transport"]) : "";
+			if (transport.find("multicast") != std::string::npos) {
+				++readers->multicast;
+			} else {
+				++readers->unicast;
+			}
+		}
+	} else {
+		LOG_WARNING("Unable to list RTSP sessions via " << endpoint << ":\n" << soap_fault_string(soap));
+	}
+
+	soap_destroy(soap);
+	soap_end(soap);
+	soap_free(soap);
+	return ok;
+}
+
+
+// MediaMTX passes this on to the running camera, rather than restarting it as it does for (e.g.) the resolution.
+bool RtspServerMediaMtxRpi::setBitrate(int bitrate) {
+	soap *soap = new_api_soap();
+	json::value request(soap);
+	request["rpiCameraBitrate"] = bitrate * 1000;
+
+	const std::string endpoint = url + "/v3/config/paths/patch/" + streamPath;
+
+	bool ok = json_call_method(soap, endpoint.c_str(), SOAP_PATCH, &request, nullptr) == SOAP_OK;
+	if (!ok) {
+		LOG_ERROR("Error when updating the bitrate via " << endpoint << ":\n" << soap_fault_string(soap));
 	}
 
 	soap_destroy(soap);
 	soap_end(soap);
 	soap_free(soap);
+	return ok;
 }
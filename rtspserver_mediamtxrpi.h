@@ -14,17 +14,44 @@ class RtspServerMediaMtxRpi : public RtspServer {
 	private:
 		std::string url;
 		std::string streamPath;
+		int idleSeconds;  // Negative for MediaMTX's default.
 
 	public:
-		explicit RtspServerMediaMtxRpi(std::string url, std::string streamPath)
-			: url(url), streamPath(streamPath) {}
+		explicit RtspServerMediaMtxRpi(std::string url, std::string streamPath, int idleSeconds = -1)
+			: url(url), streamPath(streamPath), idleSeconds(idleSeconds) {}
 
 		/* Make sure the stream exists at the appropriate path. */
-		virtual void initialise(const tt__VideoEncoderConfiguration *, const tt__ImagingSettings20 *, const tt__VideoSourceConfiguration *);
+		/* The H265Configuration is always null, as rpiCamera only encodes H.264. */
+		virtual void initialise(const tt__VideoEncoderConfiguration *, const tt__H265Configuration *, const tt__ImagingSettings20 *, const tt__VideoSourceConfiguration *);
 
-		virtual void setVideoEncoderConfiguration(const tt__VideoEncoderConfiguration *);
+		virtual void setVideoEncoderConfiguration(const tt__VideoEncoderConfiguration *, const tt__H265Configuration *);
 
 		virtual void setImagingSettings(const tt__ImagingSettings20 *);
 
 		virtual void setVideoSourceConfiguration(const tt__VideoSourceConfiguration *);
+
+		virtual bool supportsMulticast() {
+			return true;
+		}
+
+		virtual void setMulticast(const tt__MulticastConfiguration *multicast, bool only_multicast);
+
+		virtual bool getReaders(Readers *readers);
+
+		virtual bool supportsSetBitrate() {
+			return true;
+		}
+
+		virtual bool setBitrate(int bitrate);
+
+		/* MediaMTX already closes the camera once nobody's read the stream for idleSeconds
+		 * (sourceOnDemand), and opens it for the next reader.
+		 */
+		virtual bool suspend() {
+			return true;
+		}
+
+		virtual bool resumesItself() {
+			return true;
+		}
 };
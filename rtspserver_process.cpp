@@ -7,36 +7,111 @@
 
 #include "soaplib/soapH.h"
 
+#include "log.h"
 #include "utils.h"
 #include "rtspserver_process.h"
 
+#include <signal.h>
+
+#include <cstdlib>
+#include <fstream>
 #include <vector>
 #include <string>
+#include <iterator>
 #include <map>
-#include <iostream>
 #include <sstream>
 #include <algorithm>
 
 
 void RtspServerProcess::start() {
-	if (rtsp_server_pid != 0) {
-		std::cout << "Stopping RTSP server (" << rtsp_server_pid << ")" << std::endl;
-		stop_child_process(rtsp_server_pid);
-		rtsp_server_pid = 0;
-	}
+	// Whether or not it was suspended, the new one isn't (until the next suspend).
+	stop();
 
 	auto args = buildArguments();
 	std::ostringstream string_args;
 	std::copy(args.begin(), args.end(), std::ostream_iterator<std::string>(string_args, " "));
-	std::cout << "Starting RTSP server: " << string_args.str() << std::endl;
+	LOG_INFO("Starting RTSP server: " << string_args.str());
 	rtsp_server_pid = start_child_process(executable_path, args);
 }
 
 
-void RtspServerProcess::setVideoEncoderConfiguration(const tt__VideoEncoderConfiguration *vec) {
+void RtspServerProcess::stop() {
+	if (rtsp_server_pid != 0) {
+		// A stopped process wouldn't act on the SIGTERM.
+		resume();
+		LOG_INFO("Stopping RTSP server (" << rtsp_server_pid << ")");
+		stop_child_process(rtsp_server_pid);
+		rtsp_server_pid = 0;
+	}
+}
+
+
+bool RtspServerProcess::suspend() {
+	if (rtsp_server_pid == 0 || (!suspended && kill(rtsp_server_pid, SIGSTOP) == -1)) {
+		return false;
+	}
+	suspended = true;
+	return true;
+}
+
+
+bool RtspServerProcess::resume() {
+	if (!suspended) {
+		return false;
+	}
+	kill(rtsp_server_pid, SIGCONT);
+	suspended = false;
+	return true;
+}
+
+
+// The connections in /proc/net/tcp (or tcp6) that are ESTABLISHED to port, or -1 if it can't be read.
+static int count_connections(const char *path, int port) {
+	std::ifstream in(path);
+	if (!in) {
+		return -1;
+	}
+	std::string line;
+	// "  sl  local_address rem_address   st ..."
+	std::getline(in, line);
+	int count = 0;
+	while (std::getline(in, line)) {
+		// e.g. "   0: 0100007F:022A 0100007F:D431 01 ..."
+		std::istringstream fields(line);
+		std::string slot, local, remote, state;
+		if (!(fields >> slot >> local >> remote >> state)) {
+			continue;
+		}
+		size_t colon = local.rfind(':');
+		if (colon != std::string::npos && std::strtol(local.c_str() + colon + 1, nullptr, 16) == port && state == "01") {
+			++count;
+		}
+	}
+	return count;
+}
+
+
+bool RtspServerProcess::getReaders(Readers *readers) {
+	int tcp = count_connections("/proc/net/tcp", std::atoi(port.c_str()));
+	int tcp6 = count_connections("/proc/net/tcp6", std::atoi(port.c_str()));
+	if (tcp == -1 && tcp6 == -1) {
+		return false;
+	}
+	readers->unicast = std::max(tcp, 0) + std::max(tcp6, 0);
+	readers->multicast = 0;
+	return true;
+}
+
+
+void RtspServerProcess::setVideoEncoderConfiguration(const tt__VideoEncoderConfiguration *vec, const tt__H265Configuration *h265) {
 	this->video_encoder_configuration->soap_del();
 	delete this->video_encoder_configuration;
 	this->video_encoder_configuration = vec->soap_dup();
+	if (this->h265_configuration) {
+		this->h265_configuration->soap_del();
+		delete this->h265_configuration;
+	}
+	this->h265_configuration = h265 != nullptr ? h265->soap_dup() : nullptr;
 	start();
 }
 
@@ -57,8 +132,9 @@ void RtspServerProcess::setVideoSourceConfiguration(const tt__VideoSourceConfigu
 }
 
 
-void RtspServerProcess::initialise(const tt__VideoEncoderConfiguration *vec, const tt__ImagingSettings20 *imaging_settings, const tt__VideoSourceConfiguration *vsc) {
+void RtspServerProcess::initialise(const tt__VideoEncoderConfiguration *vec, const tt__H265Configuration *h265, const tt__ImagingSettings20 *imaging_settings, const tt__VideoSourceConfiguration *vsc) {
 	this->video_encoder_configuration = vec->soap_dup();
+	this->h265_configuration = h265 != nullptr ? h265->soap_dup() : nullptr;
 	this->imaging_settings = imaging_settings->soap_dup();
 	this->video_source_configuration = vsc->soap_dup();
 	start();
@@ -127,7 +203,7 @@ std::vector<std::string> RtspServerNvtrtspd::buildArguments() {
 		executable_path,
 		"1", // 3DNR
 		"0", // shdr
-		"1", // H264
+		this->h265_configuration != nullptr ? "0" : "1", // enc_type
 		std::to_string(bitrate_mbps), // Mbps
 		"0", // data_mode
 		"0", // data_mode
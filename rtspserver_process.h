@@ -16,6 +16,7 @@
 class RtspServerProcess : public RtspServer {
 	private:
 		pid_t rtsp_server_pid;
+		bool suspended;
 
 		void start();
 
@@ -24,17 +25,23 @@ class RtspServerProcess : public RtspServer {
 		std::string port;
 		std::string stream_path;
 		tt__VideoEncoderConfiguration *video_encoder_configuration;
+		tt__H265Configuration *h265_configuration;  // Null for H.264.
 		tt__ImagingSettings20 *imaging_settings;
 		tt__VideoSourceConfiguration *video_source_configuration;
 
 	public:
 		explicit RtspServerProcess(const std::string executable_path, const std::string port, const std::string stream_path)
-			: rtsp_server_pid(0), executable_path(executable_path), port(port), stream_path(stream_path) {}
+			: rtsp_server_pid(0), suspended(false), executable_path(executable_path), port(port), stream_path(stream_path),
+			  video_encoder_configuration(nullptr), h265_configuration(nullptr), imaging_settings(nullptr), video_source_configuration(nullptr) {}
 		~RtspServerProcess() {
 			if (this->video_encoder_configuration) {
 				this->video_encoder_configuration->soap_del();
 				delete this->video_encoder_configuration;
 			}
+			if (this->h265_configuration) {
+				this->h265_configuration->soap_del();
+				delete this->h265_configuration;
+			}
 			if (this->imaging_settings) {
 				this->imaging_settings->soap_del();
 				delete this->imaging_settings;
@@ -46,15 +53,32 @@ class RtspServerProcess : public RtspServer {
 		}
 
 		/* Make sure the stream exists at the appropriate path. */
-		virtual void initialise(const tt__VideoEncoderConfiguration *, const tt__ImagingSettings20 *, const tt__VideoSourceConfiguration *);
+		virtual void initialise(const tt__VideoEncoderConfiguration *, const tt__H265Configuration *, const tt__ImagingSettings20 *, const tt__VideoSourceConfiguration *);
+
 
+		virtual void setVideoEncoderConfiguration(const tt__VideoEncoderConfiguration *, const tt__H265Configuration *);
 
-		virtual void setVideoEncoderConfiguration(const tt__VideoEncoderConfiguration *);
+		/* nvtrtspd's enc_type can be H.265 (see its usage in buildArguments). */
+		virtual bool supportsH265() {
+			return true;
+		}
 
 		virtual void setImagingSettings(const tt__ImagingSettings20 *);
 
 		virtual void setVideoSourceConfiguration(const tt__VideoSourceConfiguration *);
 
+		virtual void stop();
+
+		/* Viewers are the established TCP connections to port (which can't tell multicast apart). */
+		virtual bool getReaders(Readers *readers);
+
+		/* SIGSTOPs the daemon: the kernel still accepts connections to it, so a new viewer
+		 * shows up in getReaders, and their requests are answered once it's SIGCONTed.
+		 */
+		virtual bool suspend();
+
+		virtual bool resume();
+
 		virtual std::vector<std::string> buildArguments() = 0;
 };
 
@@ -63,6 +87,11 @@ class RtspServerT31rtspd : public RtspServerProcess {
 	using RtspServerProcess::RtspServerProcess;
 
 	public:
+		/* Not until we know how to ask t31rtspd for it (its options above are all H.264). */
+		virtual bool supportsH265() {
+			return false;
+		}
+
 		virtual std::vector<std::string> buildArguments();
 };
 
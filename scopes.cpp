@@ -0,0 +1,175 @@
+// Copyright 2023 Morse Micro
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <ctype.h>
+#include <string.h>
+
+#include <algorithm>
+#include <sstream>
+
+#include "soaplib/stdsoap2.h"
+
+#include "scopes.h"
+
+
+static const char *HEX_DIGITS = "0123456789ABCDEF";
+
+
+std::vector<std::string> split_list(const char *list) {
+	std::vector<std::string> items;
+	std::istringstream ss(list == nullptr ? "" : list);
+	std::string item;
+	while (ss >> item) {
+		items.push_back(item);
+	}
+	return items;
+}
+
+
+static bool ends_with(const std::string &s, const std::string &suffix) {
+	return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+
+static int hex_value(char c) {
+	const char *p = strchr(HEX_DIGITS, toupper(static_cast<unsigned char>(c)));
+	return c == '\0' || p == nullptr ? -1 : p - HEX_DIGITS;
+}
+
+
+static bool percent_decode(const std::string &s, std::string *decoded) {
+	decoded->clear();
+	for (size_t i = 0; i < s.size(); ++i) {
+		if (s[i] != '%') {
+			decoded->push_back(s[i]);
+			continue;
+		}
+		if (i + 2 >= s.size()) {
+			return false;
+		}
+		int high = hex_value(s[i + 1]), low = hex_value(s[i + 2]);
+		if (high < 0 || low < 0) {
+			return false;
+		}
+		decoded->push_back(static_cast<char>(high * 16 + low));
+		i += 2;
+	}
+	return true;
+}
+
+
+bool DiscoveryMatcher::parseScope(const std::string &scope, ParsedScope *parsed) {
+	size_t colon = scope.find(':');
+	if (colon == 0 || colon == std::string::npos || scope.find_first_of("/?#") < colon) {
+		return false;  // Relative.
+	}
+
+	// Query and fragment don't take part in the comparison.
+	std::string uri = scope.substr(0, scope.find_first_of("?#"));
+
+	size_t path_start = colon + 1;
+	if (uri.compare(path_start, 2, "//") == 0) {
+		path_start = uri.find('/', path_start + 2);
+		if (path_start == std::string::npos) {
+			path_start = uri.size();
+		}
+	}
+	parsed->scheme_and_authority = uri.substr(0, path_start);
+	std::transform(parsed->scheme_and_authority.begin(), parsed->scheme_and_authority.end(),
+	               parsed->scheme_and_authority.begin(), ::tolower);
+
+	parsed->segments.clear();
+	std::istringstream path(uri.substr(path_start));
+	std::string segment, decoded;
+	while (std::getline(path, segment, '/')) {
+		if (segment.empty()) {
+			continue;  // i.e. the leading (or a trailing) slash.
+		}
+		if (segment == "." || segment == ".." || !percent_decode(segment, &decoded)) {
+			return false;
+		}
+		parsed->segments.push_back(decoded);
+	}
+	return true;
+}
+
+
+DiscoveryMatcher::DiscoveryMatcher(const std::string &types, const std::vector<std::string> &scopes, const struct Namespace *namespaces)
+	: scopes(scopes)
+{
+	for (auto &type : split_list(types.c_str())) {
+		this->types.insert(type);
+		types_list += (types_list.empty() ? "" : " ") + type;
+
+		// gsoap normalises the QNames in a probe to our prefixes, but leaves
+		// any namespace it doesn't know as "uri":name.
+		size_t colon = type.find(':');
+		for (auto *ns = namespaces; ns != nullptr && ns->id != nullptr; ++ns) {
+			if (colon != std::string::npos && type.compare(0, colon, ns->id) == 0 && strlen(ns->id) == colon) {
+				this->types.insert(std::string("\"") + ns->ns + "\"" + type.substr(colon));
+			}
+		}
+	}
+
+	for (auto &scope : scopes) {
+		ParsedScope parsed;
+		if (parseScope(scope, &parsed)) {
+			parsed_scopes.push_back(parsed);
+		}
+		scopes_list += (scopes_list.empty() ? "" : " ") + scope;
+	}
+}
+
+
+bool DiscoveryMatcher::matches(const char *probe_types, const char *probe_scopes, const char *match_by) const {
+	for (auto &type : split_list(probe_types)) {
+		if (types.count(type) == 0) {
+			return false;
+		}
+	}
+
+	auto requested = split_list(probe_scopes);
+	if (requested.empty()) {
+		return true;
+	}
+
+	std::string rule = match_by == nullptr ? "" : match_by;
+	if (rule.empty() || ends_with(rule, "/rfc3986") || ends_with(rule, "/rfc2396")) {
+		for (auto &scope : requested) {
+			ParsedScope parsed;
+			if (!parseScope(scope, &parsed)) {
+				return false;
+			}
+			bool found = std::any_of(parsed_scopes.begin(), parsed_scopes.end(), [&parsed] (const ParsedScope &ours) {
+				return ours.scheme_and_authority == parsed.scheme_and_authority
+					&& parsed.segments.size() <= ours.segments.size()
+					&& std::equal(parsed.segments.begin(), parsed.segments.end(), ours.segments.begin());
+			});
+			if (!found) {
+				return false;
+			}
+		}
+		return true;
+	} else if (ends_with(rule, "/strcmp0")) {
+		return std::all_of(requested.begin(), requested.end(), [this] (const std::string &scope) {
+			return std::find(scopes.begin(), scopes.end(), scope) != scopes.end();
+		});
+	}
+
+	return false;
+}
+
+
+std::string scope_encode(const std::string &s) {
+	std::string encoded;
+	for (unsigned char c : s) {
+		if (isalnum(c) || (c != '\0' && strchr("-._~", c) != nullptr)) {
+			encoded.push_back(c);
+		} else {
+			encoded.push_back('%');
+			encoded.push_back(HEX_DIGITS[c >> 4]);
+			encoded.push_back(HEX_DIGITS[c & 0xf]);
+		}
+	}
+	return encoded;
+}
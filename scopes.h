@@ -0,0 +1,61 @@
+/*
+ * Copyright 2023 Morse Micro
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#pragma once
+
+#include <set>
+#include <string>
+#include <vector>
+
+
+struct Namespace;
+
+
+/* Decides whether a WS-Discovery Probe (or Resolve) is for us.
+ *
+ * Our types and scopes are parsed once up front, so a probe only costs
+ * splitting its own lists. A probe matches if every type it asks for is
+ * one of ours and every scope it asks for matches one of ours under its
+ * MatchBy rule:
+ *   - rfc3986 (the default; rfc2396 in the 2005/04 spec): scheme and authority
+ *     are compared case-insensitively and the probe's path must be a
+ *     segment-wise prefix of ours; query and fragment are ignored.
+ *   - strcmp0: exact string comparison.
+ * Any other rule matches nothing.
+ */
+class DiscoveryMatcher {
+	public:
+		struct ParsedScope {
+			std::string scheme_and_authority;  // Lower case.
+			std::vector<std::string> segments;  // Percent-decoded.
+		};
+
+	private:
+		std::set<std::string> types;  // Both prefix:name and "uri":name forms.
+		std::vector<std::string> scopes;
+		std::vector<ParsedScope> parsed_scopes;
+		std::string types_list;
+		std::string scopes_list;
+
+	public:
+		/* namespaces resolves the prefixes in types (i.e. soap->namespaces). */
+		DiscoveryMatcher(const std::string &types, const std::vector<std::string> &scopes, const struct Namespace *namespaces);
+
+		bool matches(const char *probe_types, const char *probe_scopes, const char *match_by) const;
+
+		/* Space separated, as they go in a ProbeMatch or Hello. */
+		const std::string &getTypes() const { return types_list; }
+		const std::string &getScopes() const { return scopes_list; }
+
+		/* False if scope isn't something we could ever match against (i.e. not an absolute URI). */
+		static bool parseScope(const std::string &scope, ParsedScope *parsed);
+};
+
+
+/* Splits a space separated list of QNames or URIs (as in Types and Scopes); NULL is empty. */
+extern std::vector<std::string> split_list(const char *list);
+
+/* Percent-encodes anything that isn't an RFC 3986 unreserved character (e.g. for a model name in a scope). */
+extern std::string scope_encode(const std::string &s);
@@ -1,59 +1,414 @@
 // Copyright 2023 Morse Micro
 // SPDX-License-Identifier: GPL-2.0-or-later
 
-#include <iostream>
+#include <poll.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include "soaplib/soapH.h"
 #include "soaplib/httpget.h"
+#include "camera.h"
 #include "httpgethandler.h"
+#include "log.h"
+#include "server.h"
+#include "utils.h"
+
+// authorise needs the header's wsse:Security, which is only there once soaplib's been
+// regenerated from an onvif.h that imports wsse.h.
+#ifndef SOAP_TYPE__wsse__Security
+#error "soaplib predates onvif.h's #import \"wsse.h\": run make -C soaplib"
+#endif
+
+
+// Bounds how long a slow (or idle keep-alive) client can hold a listener, and so shutdown.
+static const int IO_TIMEOUT_SECONDS = 10;
+// How long a kept-alive connection can sit idle between requests. A listener serves one
+// connection at a time, so this is how long it can keep the next client waiting.
+static const int KEEP_ALIVE_IDLE_MS = 1000;
+
+// What stop_server needs to stop the listeners started by start_server.
+static std::vector<struct soap *> listener_soaps;
+static std::vector<std::thread> listener_threads;
+static std::vector<std::future<void>> listener_done;
+static std::atomic<bool> server_stopping(false);
+static std::atomic<bool> server_failed(false);
+// For the startup timeline.
+static std::atomic<bool> first_request_served(false);
+
+
+// HTTP Digest needs the Authorization header (which gsoap only parses for Basic and Bearer),
+// and to send our challenge in place of gsoap's Basic one. A plugin, so that soap_copy
+// (e.g. a parked PullMessages) gets its own.
+static const char AUTH_PLUGIN_ID[] = "onvif-auth";
 
+struct AuthPluginData {
+	int (*fparsehdr)(struct soap *, const char *, const char *);
+	int (*fposthdr)(struct soap *, const char *, const char *);
+	std::string digest;  // The request's Authorization: Digest parameters, if any.
+	std::string challenge;  // For WWW-Authenticate, if we're sending a 401.
+};
 
-static int fignore(struct soap *, const char *tag) {
-	// We don't currently have any auth, so we don't care what auth you
-	// present (as we're going to pass it).
-	// This is naughty, as it ignores the 'mustUnderstand' attribute;
-	// the right fix would be to not pass the mustUnderstand attribute in the
-	// client.
-	if (std::string("wsse:Security") == tag) {
+static AuthPluginData *auth_data(struct soap *soap) {
+	return static_cast<AuthPluginData *>(soap_lookup_plugin(soap, AUTH_PLUGIN_ID));
+}
+
+static int auth_parse_header(struct soap *soap, const char *key, const char *val) {
+	auto *data = auth_data(soap);
+	if (!soap_tag_cmp(key, "Authorization") && !soap_tag_cmp(val, "Digest *")) {
+		data->digest = val + 7;
 		return SOAP_OK;
 	}
+	return data->fparsehdr(soap, key, val);
+}
 
-	return SOAP_TAG_MISMATCH;
+static int auth_post_header(struct soap *soap, const char *key, const char *val) {
+	auto *data = auth_data(soap);
+	if (key != nullptr && !strcmp(key, "WWW-Authenticate") && !data->challenge.empty()) {
+		val = data->challenge.c_str();
+	}
+	return data->fposthdr(soap, key, val);
 }
 
+static int auth_plugin_copy(struct soap *soap, struct soap_plugin *dst, struct soap_plugin *src) {
+	dst->data = new AuthPluginData(*static_cast<AuthPluginData *>(src->data));
+	return SOAP_OK;
+}
 
-void start_server(int port, void *soap_user)
-{
-	struct soap *soap = soap_new();
-	soap_register_plugin_arg(soap, http_get, (void *)http_get_handler);
+static void auth_plugin_delete(struct soap *soap, struct soap_plugin *p) {
+	delete static_cast<AuthPluginData *>(p->data);
+}
 
-	soap->user = soap_user;
-	soap->bind_flags |= SO_REUSEADDR;
+static int auth_plugin(struct soap *soap, struct soap_plugin *p, void *arg) {
+	auto *data = new AuthPluginData();
+	data->fparsehdr = soap->fparsehdr;
+	data->fposthdr = soap->fposthdr;
+	soap->fparsehdr = auth_parse_header;
+	soap->fposthdr = auth_post_header;
 
-	soap->fignore = fignore;
+	p->id = AUTH_PLUGIN_ID;
+	p->data = data;
+	p->fcopy = auth_plugin_copy;
+	p->fdelete = auth_plugin_delete;
+	return SOAP_OK;
+}
 
-	if (!soap_valid_socket(soap_bind(soap, NULL, port, 100)))
-	{
-		soap_print_fault(soap, stderr);
-		soap_destroy(soap);
-		soap_end(soap);
-		soap_free(soap);
-		return;
+
+// Once soap_begin_serve has read the header, whether the request's credentials (a WS-UsernameToken,
+// or failing that HTTP Digest) allow the operation in the body. SOAP_OK if so, otherwise the
+// fault (or 401 with a challenge) to send instead. With no users, anything goes.
+static int authorise(struct soap *soap, Camera *camera) {
+	auto *security = soap->header != nullptr ? soap->header->wsse__Security : nullptr;
+	if (soap->header != nullptr) {
+		// Otherwise it'd be echoed back in the response, password digest and all.
+		soap->header->wsse__Security = nullptr;
+	}
+	auto &authenticator = camera->getAuthenticator();
+	if (!authenticator.hasUsers()) {
+		return SOAP_OK;
 	}
 
+	// soap_serve_request peeks at the same element.
+	if (soap_peek_element(soap) != SOAP_OK) {
+		return soap->error;
+	}
+	const char *colon = strchr(soap->tag, ':');
+	std::string operation = colon != nullptr ? colon + 1 : soap->tag;
+	std::string service;
+	const char *ns = soap_current_namespace_tag(soap, soap->tag);
+	for (const struct Namespace *entry = soap->namespaces; ns != nullptr && entry->id != nullptr; ++entry) {
+		if (entry->ns != nullptr && !strcmp(entry->ns, ns)) {
+			service = entry->id;
+			break;
+		}
+	}
+	soap->error = SOAP_OK;
+	auto required = Authenticator::requiredLevel(service, operation);
+	if (required == Authenticator::Level::Anonymous) {
+		return SOAP_OK;
+	}
+
+	time_t now = time(nullptr);
+	if (security != nullptr && security->UsernameToken != nullptr) {
+		auto *token = security->UsernameToken;
+		time_t created = 0;
+		// Only PasswordDigest; PasswordText would be the password in the clear.
+		bool verified = token->Username != nullptr && token->Password != nullptr && token->Password->__item != nullptr
+			&& token->Password->Type != nullptr && strstr(token->Password->Type, "#PasswordDigest") != nullptr
+			&& token->Nonce != nullptr && token->Nonce->__item != nullptr && token->wsu__Created != nullptr
+			&& soap_s2dateTime(soap, token->wsu__Created, &created) == SOAP_OK
+			&& authenticator.verifyUsernameToken(token->Username, token->Password->__item, token->Nonce->__item,
+			                                     token->wsu__Created, created, now) >= required;
+		soap->error = SOAP_OK;
+		if (!verified) {
+			return soap_sender_fault_subcode(soap, "ter:NotAuthorized", "Sender not authorized", nullptr);
+		}
+		return SOAP_OK;
+	}
+
+	bool stale = false;
+	auto *data = auth_data(soap);
+	if (!data->digest.empty()) {
+		auto level = authenticator.verifyDigest(data->digest, soap->path, now, &stale);
+		if (level >= required) {
+			return SOAP_OK;
+		} else if (level != Authenticator::Level::Anonymous) {
+			// Who they say they are, but not allowed to do that.
+			return soap_sender_fault_subcode(soap, "ter:NotAuthorized", "Sender not authorized", nullptr);
+		}
+	}
+	data->challenge = authenticator.digestChallenge(now, stale);
+	return soap->error = 401;
+}
+
+
+#ifdef WITH_OPENSSL
+static int (*default_fclose)(struct soap *) = nullptr;
+
+// gsoap's disconnect waits (for up to 5s) for the client's close_notify, holding up the
+// listener. We send ours and don't wait: HTTP says where the response ends, so it can't be
+// cut short unnoticed, and without ours the client wouldn't resume the session.
+static int tls_disconnect(struct soap *soap) {
+	if (soap->ssl != nullptr && soap_valid_socket(soap->socket)) {
+		SSL_shutdown(soap->ssl);
+		SSL_set_shutdown(soap->ssl, SSL_SENT_SHUTDOWN | SSL_RECEIVED_SHUTDOWN);
+	}
+	return default_fclose(soap);
+}
+
+// Gives soap the TLS context shared by every listener, setting it up on the first.
+static bool setup_tls(struct soap *soap, const TlsOptions &tls) {
+	default_fclose = soap->fclose;
+	soap->fclose = tls_disconnect;
+	if (!listener_soaps.empty()) {
+		auto *first = listener_soaps.front();
+		// Each soap frees its ctx in soap_done.
+		SSL_CTX_up_ref(first->ctx);
+		soap->ctx = first->ctx;
+		soap->ssl_flags = first->ssl_flags;
+		return true;
+	}
+
+	// No session ID context, as configure_tls_context sets up the session cache.
+	if (soap_ssl_server_context(soap, SOAP_SSL_NO_AUTHENTICATION | SOAP_SSL_NO_DEFAULT_CA_PATH | SOAP_TLSv1_2 | SOAP_TLSv1_3,
+	                            tls.keyfile.c_str(), nullptr, nullptr, nullptr, nullptr, nullptr, nullptr) != SOAP_OK) {
+		LOG_ERROR("Unable to set up TLS with " << tls.keyfile << ":\n" << soap_fault_string(soap));
+		return false;
+	}
+	if (!configure_tls_context(soap->ctx, tls.ciphers)) {
+		LOG_ERROR("No usable TLS ciphers in: " << tls.ciphers);
+		return false;
+	}
+	return true;
+}
+#endif
+
+
+// Whether the client sends another request on a kept-alive connection before KEEP_ALIVE_IDLE_MS.
+static bool next_request_ready(struct soap *soap) {
+	if (!soap_valid_socket(soap->socket)) {
+		return false;
+	}
+	// i.e. pipelined.
+	if (soap->bufidx < soap->buflen) {
+		return true;
+	}
+#ifdef WITH_OPENSSL
+	if (soap->ssl != nullptr && SSL_pending(soap->ssl) > 0) {
+		return true;
+	}
+#endif
+	struct pollfd pfd = {soap->socket, POLLIN, 0};
+	return poll(&pfd, 1, KEEP_ALIVE_IDLE_MS) > 0;
+}
+
+
+// The http_get plugin calls this while parsing the request (i.e. before we take
+// the camera lock in serve below), so it needs its own locking.
+static int locked_http_get_handler(struct soap *soap) {
+	auto *camera = static_cast<Camera *>(soap->user);
+	std::lock_guard<std::mutex> lock(camera->getMutex());
+	return http_get_handler(soap);
+}
+
+
+// This is soap_serve from soapServer.cpp, except that the actual dispatch
+// (which reads and writes the Camera, and serialises responses that point
+// into the Camera's configuration) happens under the camera lock.
+// Accepting and reading the request headers can happen concurrently
+// on each listener.
+static int serve(struct soap *soap) {
+	auto *camera = static_cast<Camera *>(soap->user);
+
+	soap->keep_alive = soap->max_keep_alive + 1;
+	bool first = true;
+	do {
+		if (soap->keep_alive > 0 && soap->max_keep_alive > 0) {
+			soap->keep_alive--;
+		}
+		auto *auth = auth_data(soap);
+		auth->digest.clear();
+		auth->challenge.clear();
+		if (soap_begin_serve(soap)) {
+			if (soap->error >= SOAP_STOP) {
+				continue;
+			}
+			// A kept-alive connection that the client closed rather than reused.
+			if (!first && soap->error == SOAP_EOF) {
+				return SOAP_OK;
+			}
+			return soap->error;
+		}
+		first = false;
+
+		std::lock_guard<std::mutex> lock(camera->getMutex());
+		if (authorise(soap, camera) != SOAP_OK) {
+			return soap_send_fault(soap);
+		}
+		if ((soap_serve_request(soap) || (soap->fserveloop && soap->fserveloop(soap))) && soap->error && soap->error < SOAP_STOP) {
+			return soap_send_fault(soap);
+		}
+		// Finish the request we're on as we shut down, but take no more.
+	} while (soap->keep_alive && !server_stopping && next_request_ready(soap));
+
+	// If we're still keeping it alive, nobody else is going to close it.
+	soap->keep_alive = 0;
+	soap_closesock(soap);
+	return SOAP_OK;
+}
+
+
+static void free_soap(struct soap *soap) {
+	soap_destroy(soap);
+	soap_end(soap);
+	soap_free(soap);
+}
+
+
+static void serve_listener(struct soap *soap) {
 	while (soap_valid_socket(soap_accept(soap))) {
-		int result = soap_serve(soap);
+#ifdef WITH_OPENSSL
+		if (soap->ctx != nullptr) {
+			if (soap_ssl_accept(soap) != SOAP_OK) {
+				// It's closed the connection.
+				LOG_RATELIMITED(LogLevel::Warning, 1000, "TLS handshake with " << soap->host << " failed:\n" << soap_fault_string(soap));
+				soap_end(soap);
+				continue;
+			}
+			LOG_DEBUG("TLS handshake with " << soap->host << (SSL_session_reused(soap->ssl) ? " (resumed)" : "") << ": "
+				<< SSL_get_version(soap->ssl) << " " << SSL_get_cipher_name(soap->ssl));
+		}
+#endif
+		int result = serve(soap);
 		// result is overloaded - either a SOAP code (<100) or an HTTP code.
-		if (result != SOAP_OK && (result <= SOAP_ERR || result >= 400)) {
-			soap_print_fault(soap, stderr);
-			soap_print_fault_location(soap, stderr);
+		if (result == 401) {
+			// i.e. the first half of HTTP Digest.
+			LOG_DEBUG("Challenged " << soap->host << " for " << soap->path);
+		} else if (result != SOAP_OK && (result <= SOAP_ERR || result >= 400)) {
+			LOG_RATELIMITED(LogLevel::Error, 1000, "Error serving request from " << soap->host << ":\n" << soap_fault_string(soap));
+		} else {
+			LOG_DEBUG("Served " << soap->path << " for " << soap->host << " (" << result << ")");
+			if (!first_request_served.exchange(true)) {
+				LOG_INFO("First ONVIF request served " << uptime_ms() << "ms after startup");
+			}
 		}
 		soap_destroy(soap);
 		soap_end(soap);
 	}
 
-	soap_print_fault(soap, stderr);
-	soap_destroy(soap);
-	soap_end(soap);
-	soap_free(soap);
+	if (!server_stopping) {
+		LOG_ERROR("ONVIF listener stopped accepting connections:\n" << soap_fault_string(soap));
+		// We're no use to anyone like this, so shut down the same way as if we'd been asked to.
+		server_failed = true;
+		kill(getpid(), SIGTERM);
+	}
+}
+
+
+bool start_server(int port, Camera *camera, int listeners, const TlsOptions *tls)
+{
+	for (int i = 0; i < listeners; ++i) {
+		// Keep-alive saves a VMS's run of requests a connection (and handshake) each.
+		struct soap *soap = soap_new1(SOAP_IO_KEEPALIVE);
+		soap_register_plugin_arg(soap, http_get, (void *)locked_http_get_handler);
+		soap_register_plugin(soap, auth_plugin);
+
+		soap->user = camera;
+		// bind_flags is a single SOL_SOCKET option rather than a set of flags.
+		// On Linux SO_REUSEPORT also lets us rebind over TIME_WAIT sockets
+		// (which is all we wanted SO_REUSEADDR for), and has the kernel spread
+		// incoming connections across every listener bound to the port.
+		soap->bind_flags = listeners > 1 ? SO_REUSEPORT : SO_REUSEADDR;
+		soap->recv_timeout = soap->send_timeout = IO_TIMEOUT_SECONDS;
+
+		bool ready = true;
+		if (tls != nullptr) {
+#ifdef WITH_OPENSSL
+			ready = setup_tls(soap, *tls);
+#else
+			LOG_ERROR("Can't serve HTTPS: built without TLS support");
+			ready = false;
+#endif
+		}
+		// Bind every listener before we start accepting so that the kernel
+		// has the complete group to balance across.
+		if (ready && !soap_valid_socket(soap_bind(soap, NULL, port, 100)))
+		{
+			LOG_ERROR("Unable to bind ONVIF port " << port << ":\n" << soap_fault_string(soap));
+			ready = false;
+		}
+		if (!ready) {
+			free_soap(soap);
+			for (auto *s : listener_soaps) {
+				free_soap(s);
+			}
+			listener_soaps.clear();
+			return false;
+		}
+
+		listener_soaps.push_back(soap);
+	}
+
+	for (auto *soap : listener_soaps) {
+		std::promise<void> done;
+		listener_done.push_back(done.get_future());
+		listener_threads.emplace_back([soap] (std::promise<void> done) {
+			serve_listener(soap);
+			done.set_value();
+		}, std::move(done));
+	}
+	return true;
+}
+
+
+bool stop_server(std::chrono::milliseconds deadline)
+{
+	server_stopping = true;
+	// This wakes up anything blocked in accept (which then fails).
+	for (auto *soap : listener_soaps) {
+		shutdown(soap->master, SHUT_RDWR);
+	}
+
+	auto until = std::chrono::steady_clock::now() + deadline;
+	bool drained = true;
+	for (size_t i = 0; i < listener_threads.size(); ++i) {
+		if (listener_done[i].wait_until(until) == std::future_status::ready) {
+			listener_threads[i].join();
+			free_soap(listener_soaps[i]);
+		} else {
+			// Most likely an idle keep-alive connection; its soap is still in use, so leave it be.
+			listener_threads[i].detach();
+			drained = false;
+		}
+	}
+	return drained && !server_failed;
 }
@@ -5,4 +5,26 @@
 
 #pragma once
 
-extern void start_server(int port, void *soap_user);
+#include <chrono>
+
+#include "tls.h"
+
+class Camera;
+
+/* Serves ONVIF requests on port (on background threads) until stop_server.
+ * Returns false if it couldn't bind. If a listener fails, it raises SIGTERM so
+ * that main shuts everything down.
+ *
+ * If listeners > 1, each listener gets its own SO_REUSEPORT socket, gsoap context
+ * and thread, and the kernel distributes incoming connections between them.
+ *
+ * With tls, it serves HTTPS instead, and all the listeners share one TLS context
+ * (so a session can be resumed on any of them). Returns false if that can't be set up.
+ */
+extern bool start_server(int port, Camera *camera, int listeners = 1, const TlsOptions *tls = nullptr);
+
+/* Stops accepting connections and waits up to deadline for requests in progress
+ * (idle keep-alive connections are just dropped). Returns false if that didn't
+ * finish in time or a listener had already failed.
+ */
+extern bool stop_server(std::chrono::milliseconds deadline);
@@ -1438,6 +1438,8 @@ class tt__LocalOrientation;
 
 class tt__LocationEntity;
 
+class tt__EncoderBudget;
+
 class tt__MediaServiceProperties;
 
 class tt__ImagingVideoSourceOptions;
@@ -1452,6 +1454,8 @@ class tt__RTSPServerExecutable;
 
 class tt__RTSPServerAPI;
 
+class tt__AdaptiveBitrate;
+
 class tt__RTSPStream;
 
 class tt__DeviceHomePage;
@@ -1460,12 +1464,16 @@ class tt__HTMLWebServer;
 
 class tt__MinimumProfile;
 
+class tt__H265Configuration;
+
 class tt__ImagingVideoSource;
 
 class tt__ImagingServiceConfiguration;
 
 class tt__MediaServiceConfiguration;
 
+class tt__DeviceManagementServiceConfiguration;
+
 class _tt__StringItems;
 
 class _tt__Message;
@@ -2172,7 +2180,26 @@ class tt__H264Profile__ : public xsd__anyType
 
 // Optimization: simpleType "http://www.onvif.org/ver10/schema":VideoEncodingMimeNames is not used and was removed
 
-// Optimization: simpleType "http://www.onvif.org/ver10/schema":VideoEncodingProfiles is not used and was removed
+/// @brief "http://www.onvif.org/ver10/schema":VideoEncodingProfiles is a simpleType restriction of type xs:string.
+///
+enum class tt__VideoEncodingProfiles
+{
+	Simple,	///< xs:string value="Simple"
+	AdvancedSimple,	///< xs:string value="AdvancedSimple"
+	Baseline,	///< xs:string value="Baseline"
+	Main,	///< xs:string value="Main"
+	Main10,	///< xs:string value="Main10"
+	Extended,	///< xs:string value="Extended"
+	High,	///< xs:string value="High"
+};
+
+/// @brief Class wrapper for type tt__VideoEncodingProfiles derived from xsd__anyType.
+///
+/// @note Use option -P to remove this class.
+class tt__VideoEncodingProfiles__ : public xsd__anyType
+{ public:
+    tt__VideoEncodingProfiles            __item;                       
+};
 
 /// @brief "http://www.onvif.org/ver10/schema":AudioEncoding is a simpleType restriction of type xs:string.
 ///
@@ -18734,6 +18761,29 @@ class tt__LocationEntity : public xsd__anyType
   @ bool*                                AutoGeo                        0;	///< Optional attribute.
 };
 
+/// @brief "http://www.onvif.org/ver10/schema":EncoderBudget is a complexType.
+///
+/// @note class tt__EncoderBudget operations:
+/// - tt__EncoderBudget* soap_new_tt__EncoderBudget(soap*) allocate and default initialize
+/// - tt__EncoderBudget* soap_new_tt__EncoderBudget(soap*, int num) allocate and default initialize an array
+/// - tt__EncoderBudget* soap_new_req_tt__EncoderBudget(soap*, ...) allocate, set required members
+/// - tt__EncoderBudget* soap_new_set_tt__EncoderBudget(soap*, ...) allocate, set all public members
+/// - tt__EncoderBudget::soap_default(soap*) default initialize members
+/// - int soap_read_tt__EncoderBudget(soap*, tt__EncoderBudget*) deserialize from a stream
+/// - int soap_write_tt__EncoderBudget(soap*, tt__EncoderBudget*) serialize to a stream
+/// - tt__EncoderBudget* tt__EncoderBudget::soap_dup(soap*) returns deep copy of tt__EncoderBudget, copies the (cyclic) graph structure when a context is provided, or (cycle-pruned) tree structure with soap_set_mode(soap, SOAP_XML_TREE) (use soapcpp2 -Ec)
+/// - tt__EncoderBudget::soap_del() deep deletes tt__EncoderBudget data members, use only after tt__EncoderBudget::soap_dup(NULL) (use soapcpp2 -Ed)
+/// - int tt__EncoderBudget::soap_type() returns SOAP_TYPE_tt__EncoderBudget or derived type identifier
+class tt__EncoderBudget : public xsd__anyType
+{ public:
+/// Element "MaxPixelRate" of type xs:int.
+    int                                  MaxPixelRate                   1;	///< Required element.
+/// Element "MaxBitrate" of type xs:int.
+    int                                  MaxBitrate                     1;	///< Required element.
+/// Element "MaxProfiles" of type xs:int.
+    int*                                 MaxProfiles                    0;	///< Optional element.
+};
+
 /// @brief "http://www.onvif.org/ver10/schema":MediaServiceProperties is a complexType.
 ///
 /// @note class tt__MediaServiceProperties operations:
@@ -18755,6 +18805,10 @@ class tt__MediaServiceProperties : public xsd__anyType
     tt__VideoSourceConfigurationOptions*  VideoSourceConfigurationOptions 1;	///< Required element.
 /// Element "VideoEncoderConfigurationOptions" of type "http://www.onvif.org/ver10/schema":VideoEncoderConfigurationOptions.
     tt__VideoEncoderConfigurationOptions*  VideoEncoderConfigurationOptions 1;	///< Required element.
+/// Element "EncoderBudget" of type "http://www.onvif.org/ver10/schema":EncoderBudget.
+    tt__EncoderBudget*                   EncoderBudget                  0;	///< Optional element.
+/// Vector of tt__VideoEncodingProfiles of length 0..unbounded.
+    std::vector<tt__VideoEncodingProfiles> H265ProfilesSupported          0;	///< Multiple elements.
 };
 
 /// @brief "http://www.onvif.org/ver10/schema":ImagingVideoSourceOptions is a complexType.
@@ -18881,6 +18935,31 @@ class tt__RTSPServerAPI : public xsd__anyType
     xsd__integer                         Port                           1;	///< Required element.
 };
 
+/// @brief "http://www.onvif.org/ver10/schema":AdaptiveBitrate is a complexType.
+///
+/// @note class tt__AdaptiveBitrate operations:
+/// - tt__AdaptiveBitrate* soap_new_tt__AdaptiveBitrate(soap*) allocate and default initialize
+/// - tt__AdaptiveBitrate* soap_new_tt__AdaptiveBitrate(soap*, int num) allocate and default initialize an array
+/// - tt__AdaptiveBitrate* soap_new_req_tt__AdaptiveBitrate(soap*, ...) allocate, set required members
+/// - tt__AdaptiveBitrate* soap_new_set_tt__AdaptiveBitrate(soap*, ...) allocate, set all public members
+/// - tt__AdaptiveBitrate::soap_default(soap*) default initialize members
+/// - int soap_read_tt__AdaptiveBitrate(soap*, tt__AdaptiveBitrate*) deserialize from a stream
+/// - int soap_write_tt__AdaptiveBitrate(soap*, tt__AdaptiveBitrate*) serialize to a stream
+/// - tt__AdaptiveBitrate* tt__AdaptiveBitrate::soap_dup(soap*) returns deep copy of tt__AdaptiveBitrate, copies the (cyclic) graph structure when a context is provided, or (cycle-pruned) tree structure with soap_set_mode(soap, SOAP_XML_TREE) (use soapcpp2 -Ec)
+/// - tt__AdaptiveBitrate::soap_del() deep deletes tt__AdaptiveBitrate data members, use only after tt__AdaptiveBitrate::soap_dup(NULL) (use soapcpp2 -Ed)
+/// - int tt__AdaptiveBitrate::soap_type() returns SOAP_TYPE_tt__AdaptiveBitrate or derived type identifier
+class tt__AdaptiveBitrate : public xsd__anyType
+{ public:
+/// Element "Interface" of type xs:string.
+    std::string                          Interface                      1;	///< Required element.
+/// Element "Statistics" of type xs:string.
+    std::string*                         Statistics                     0;	///< Optional element.
+/// Element "MinBitrate" of type xs:int.
+    int                                  MinBitrate                     1;	///< Required element.
+/// Element "Interval" of type xs:int.
+    int*                                 Interval                       0;	///< Optional element.
+};
+
 /// @brief "http://www.onvif.org/ver10/schema":RTSPStream is a complexType.
 ///
 /// @note class tt__RTSPStream operations:
@@ -18906,6 +18985,12 @@ class tt__RTSPStream : public xsd__anyType
     tt__RTSPServerExecutable*            Executable                     0;	///< Optional element.
 /// Element "API" of type "http://www.onvif.org/ver10/schema":RTSPServerAPI.
     tt__RTSPServerAPI*                   API                            0;	///< Optional element.
+/// Element "MulticastAboveViewers" of type xs:int.
+    int*                                 MulticastAboveViewers          0;	///< Optional element.
+/// Element "AdaptiveBitrate" of type "http://www.onvif.org/ver10/schema":AdaptiveBitrate.
+    tt__AdaptiveBitrate*                 AdaptiveBitrate                0;	///< Optional element.
+/// Element "SuspendAfterIdle" of type xs:int.
+    int*                                 SuspendAfterIdle               0;	///< Optional element.
 };
 
 /// @brief "http://www.onvif.org/ver10/schema":DeviceHomePage is a complexType.
@@ -18979,6 +19064,27 @@ class tt__MinimumProfile : public xsd__anyType
     tt__ReferenceToken*                  VideoSourceConfigurationToken  0;	///< Optional element.
 };
 
+/// @brief "http://www.onvif.org/ver10/schema":H265Configuration is a complexType.
+///
+/// @note class tt__H265Configuration operations:
+/// - tt__H265Configuration* soap_new_tt__H265Configuration(soap*) allocate and default initialize
+/// - tt__H265Configuration* soap_new_tt__H265Configuration(soap*, int num) allocate and default initialize an array
+/// - tt__H265Configuration* soap_new_req_tt__H265Configuration(soap*, ...) allocate, set required members
+/// - tt__H265Configuration* soap_new_set_tt__H265Configuration(soap*, ...) allocate, set all public members
+/// - tt__H265Configuration::soap_default(soap*) default initialize members
+/// - int soap_read_tt__H265Configuration(soap*, tt__H265Configuration*) deserialize from a stream
+/// - int soap_write_tt__H265Configuration(soap*, tt__H265Configuration*) serialize to a stream
+/// - tt__H265Configuration* tt__H265Configuration::soap_dup(soap*) returns deep copy of tt__H265Configuration, copies the (cyclic) graph structure when a context is provided, or (cycle-pruned) tree structure with soap_set_mode(soap, SOAP_XML_TREE) (use soapcpp2 -Ec)
+/// - tt__H265Configuration::soap_del() deep deletes tt__H265Configuration data members, use only after tt__H265Configuration::soap_dup(NULL) (use soapcpp2 -Ed)
+/// - int tt__H265Configuration::soap_type() returns SOAP_TYPE_tt__H265Configuration or derived type identifier
+class tt__H265Configuration : public xsd__anyType
+{ public:
+/// Element "H265Profile" of type "http://www.onvif.org/ver10/schema":VideoEncodingProfiles.
+    tt__VideoEncodingProfiles            H265Profile                    1;	///< Required element.
+/// Attribute "token" of type "http://www.onvif.org/ver10/schema":ReferenceToken.
+  @ tt__ReferenceToken                   token                          1;	///< Required attribute.
+};
+
 /// @brief "http://www.onvif.org/ver10/schema":ImagingVideoSource is a complexType.
 ///
 /// @note class tt__ImagingVideoSource operations:
@@ -19042,6 +19148,29 @@ class tt__MediaServiceConfiguration : public xsd__anyType
     std::vector<tt__MinimumProfile*    > Profile                        0;	///< Multiple elements.
 /// Element "CurrentProfile" of type "http://www.onvif.org/ver10/schema":ReferenceToken.
     tt__ReferenceToken                   CurrentProfile                 1;	///< Required element.
+/// Vector of tt__H265Configuration* of length 0..unbounded.
+    std::vector<tt__H265Configuration* > H265Configuration              0;	///< Multiple elements.
+};
+
+/// @brief "http://www.onvif.org/ver10/schema":DeviceManagementServiceConfiguration is a complexType.
+///
+/// @note class tt__DeviceManagementServiceConfiguration operations:
+/// - tt__DeviceManagementServiceConfiguration* soap_new_tt__DeviceManagementServiceConfiguration(soap*) allocate and default initialize
+/// - tt__DeviceManagementServiceConfiguration* soap_new_tt__DeviceManagementServiceConfiguration(soap*, int num) allocate and default initialize an array
+/// - tt__DeviceManagementServiceConfiguration* soap_new_req_tt__DeviceManagementServiceConfiguration(soap*, ...) allocate, set required members
+/// - tt__DeviceManagementServiceConfiguration* soap_new_set_tt__DeviceManagementServiceConfiguration(soap*, ...) allocate, set all public members
+/// - tt__DeviceManagementServiceConfiguration::soap_default(soap*) default initialize members
+/// - int soap_read_tt__DeviceManagementServiceConfiguration(soap*, tt__DeviceManagementServiceConfiguration*) deserialize from a stream
+/// - int soap_write_tt__DeviceManagementServiceConfiguration(soap*, tt__DeviceManagementServiceConfiguration*) serialize to a stream
+/// - tt__DeviceManagementServiceConfiguration* tt__DeviceManagementServiceConfiguration::soap_dup(soap*) returns deep copy of tt__DeviceManagementServiceConfiguration, copies the (cyclic) graph structure when a context is provided, or (cycle-pruned) tree structure with soap_set_mode(soap, SOAP_XML_TREE) (use soapcpp2 -Ec)
+/// - tt__DeviceManagementServiceConfiguration::soap_del() deep deletes tt__DeviceManagementServiceConfiguration data members, use only after tt__DeviceManagementServiceConfiguration::soap_dup(NULL) (use soapcpp2 -Ed)
+/// - int tt__DeviceManagementServiceConfiguration::soap_type() returns SOAP_TYPE_tt__DeviceManagementServiceConfiguration or derived type identifier
+class tt__DeviceManagementServiceConfiguration : public xsd__anyType
+{ public:
+/// Vector of xsd__anyURI of length 0..unbounded.
+    std::vector<xsd__anyURI            > Scope                          0;	///< Multiple elements.
+/// Vector of tt__User* of length 0..unbounded.
+    std::vector<tt__User*              > User                           0;	///< Multiple elements.
 };
 
 /// @brief Top-level root element "http://www.onvif.org/ver10/schema":StringItems
@@ -19157,6 +19286,8 @@ class _tt__CameraConfiguration
     tt__MediaServiceConfiguration*       MediaService                   1;	///< Required element.
 /// Element "ImagingService" of type "http://www.onvif.org/ver10/schema":ImagingServiceConfiguration.
     tt__ImagingServiceConfiguration*     ImagingService                 1;	///< Required element.
+/// Element "DeviceManagementService" of type "http://www.onvif.org/ver10/schema":DeviceManagementServiceConfiguration.
+    tt__DeviceManagementServiceConfiguration*  DeviceManagementService        0;	///< Optional element.
 /// Pointer to soap context that manages this instance.
     struct soap                         *soap                          ;
 };
@@ -49524,3 +49655,4 @@ generated .h file in your code.
 */
 
 /* End of onvif.h */
+#import "wsse.h"
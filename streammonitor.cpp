@@ -0,0 +1,43 @@
+// Copyright 2023 Morse Micro
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include "streammonitor.h"
+
+
+StreamMonitor::StreamMonitor(Poll poll, int interval_ms)
+		: poll(std::move(poll)), interval(interval_ms), stopping(false) {
+}
+
+
+StreamMonitor::~StreamMonitor() {
+	stop();
+}
+
+
+void StreamMonitor::start() {
+	stopping = false;
+	thread = std::thread(&StreamMonitor::run, this);
+}
+
+
+void StreamMonitor::stop() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	if (thread.joinable()) {
+		thread.join();
+	}
+}
+
+
+void StreamMonitor::run() {
+	std::unique_lock<std::mutex> lock(mutex);
+	while (!wake.wait_for(lock, interval, [this] { return stopping; })) {
+		// Not under our lock, so stop() isn't held up by a slow poll any longer than it has to be.
+		lock.unlock();
+		poll();
+		lock.lock();
+	}
+}
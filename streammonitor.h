@@ -0,0 +1,44 @@
+/*
+ * Copyright 2023 Morse Micro
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+
+/* Calls back every interval_ms (on a background thread), for whatever depends on
+ * how the stream is being watched and so has to ask the RTSP server now and then
+ * (e.g. switching to multicast once there are enough viewers).
+ */
+class StreamMonitor {
+	public:
+		using Poll = std::function<void()>;
+
+	private:
+		Poll poll;
+		std::chrono::milliseconds interval;
+		std::mutex mutex;
+		std::condition_variable wake;
+		bool stopping;
+		std::thread thread;
+
+		void run();
+
+	public:
+		explicit StreamMonitor(Poll poll, int interval_ms = 5000);
+		~StreamMonitor();
+
+		StreamMonitor(const StreamMonitor &) = delete;
+		StreamMonitor &operator=(const StreamMonitor &) = delete;
+
+		void start();
+
+		/* Stops the background thread (so poll won't be called again). */
+		void stop();
+};
@@ -21,21 +21,11 @@ SOAP_FMAC5 int SOAP_FMAC6 __tdn__Probe(struct soap*, struct wsdd__ProbeType tdn_
 	return SOAP_OK;
 }
 
-/** Web service operation '__tds__GetServiceCapabilities' implementation, should return SOAP_OK or error code */
-SOAP_FMAC5 int SOAP_FMAC6 __tds__GetServiceCapabilities(struct soap*, _tds__GetServiceCapabilities *tds__GetServiceCapabilities, _tds__GetServiceCapabilitiesResponse &tds__GetServiceCapabilitiesResponse) {
-	return SOAP_OK;
-}
-
 /** Web service operation '__tds__SetSystemDateAndTime' implementation, should return SOAP_OK or error code */
 SOAP_FMAC5 int SOAP_FMAC6 __tds__SetSystemDateAndTime(struct soap*, _tds__SetSystemDateAndTime *tds__SetSystemDateAndTime, _tds__SetSystemDateAndTimeResponse &tds__SetSystemDateAndTimeResponse) {
 	return SOAP_OK;
 }
 
-/** Web service operation '__tds__GetSystemDateAndTime' implementation, should return SOAP_OK or error code */
-SOAP_FMAC5 int SOAP_FMAC6 __tds__GetSystemDateAndTime(struct soap*, _tds__GetSystemDateAndTime *tds__GetSystemDateAndTime, _tds__GetSystemDateAndTimeResponse &tds__GetSystemDateAndTimeResponse) {
-	return SOAP_OK;
-}
-
 /** Web service operation '__tds__SetSystemFactoryDefault' implementation, should return SOAP_OK or error code */
 SOAP_FMAC5 int SOAP_FMAC6 __tds__SetSystemFactoryDefault(struct soap*, _tds__SetSystemFactoryDefault *tds__SetSystemFactoryDefault, _tds__SetSystemFactoryDefaultResponse &tds__SetSystemFactoryDefaultResponse) {
 	return SOAP_OK;
@@ -71,26 +61,6 @@ SOAP_FMAC5 int SOAP_FMAC6 __tds__GetSystemSupportInformation(struct soap*, _tds_
 	return SOAP_OK;
 }
 
-/** Web service operation '__tds__GetScopes' implementation, should return SOAP_OK or error code */
-SOAP_FMAC5 int SOAP_FMAC6 __tds__GetScopes(struct soap*, _tds__GetScopes *tds__GetScopes, _tds__GetScopesResponse &tds__GetScopesResponse) {
-	return SOAP_OK;
-}
-
-/** Web service operation '__tds__SetScopes' implementation, should return SOAP_OK or error code */
-SOAP_FMAC5 int SOAP_FMAC6 __tds__SetScopes(struct soap*, _tds__SetScopes *tds__SetScopes, _tds__SetScopesResponse &tds__SetScopesResponse) {
-	return SOAP_OK;
-}
-
-/** Web service operation '__tds__AddScopes' implementation, should return SOAP_OK or error code */
-SOAP_FMAC5 int SOAP_FMAC6 __tds__AddScopes(struct soap*, _tds__AddScopes *tds__AddScopes, _tds__AddScopesResponse &tds__AddScopesResponse) {
-	return SOAP_OK;
-}
-
-/** Web service operation '__tds__RemoveScopes' implementation, should return SOAP_OK or error code */
-SOAP_FMAC5 int SOAP_FMAC6 __tds__RemoveScopes(struct soap*, _tds__RemoveScopes *tds__RemoveScopes, _tds__RemoveScopesResponse &tds__RemoveScopesResponse) {
-	return SOAP_OK;
-}
-
 /** Web service operation '__tds__GetDiscoveryMode' implementation, should return SOAP_OK or error code */
 SOAP_FMAC5 int SOAP_FMAC6 __tds__GetDiscoveryMode(struct soap*, _tds__GetDiscoveryMode *tds__GetDiscoveryMode, _tds__GetDiscoveryModeResponse &tds__GetDiscoveryModeResponse) {
 	return SOAP_OK;
@@ -131,26 +101,6 @@ SOAP_FMAC5 int SOAP_FMAC6 __tds__SetRemoteUser(struct soap*, _tds__SetRemoteUser
 	return SOAP_OK;
 }
 
-/** Web service operation '__tds__GetUsers' implementation, should return SOAP_OK or error code */
-SOAP_FMAC5 int SOAP_FMAC6 __tds__GetUsers(struct soap*, _tds__GetUsers *tds__GetUsers, _tds__GetUsersResponse &tds__GetUsersResponse) {
-	return SOAP_OK;
-}
-
-/** Web service operation '__tds__CreateUsers' implementation, should return SOAP_OK or error code */
-SOAP_FMAC5 int SOAP_FMAC6 __tds__CreateUsers(struct soap*, _tds__CreateUsers *tds__CreateUsers, _tds__CreateUsersResponse &tds__CreateUsersResponse) {
-	return SOAP_OK;
-}
-
-/** Web service operation '__tds__DeleteUsers' implementation, should return SOAP_OK or error code */
-SOAP_FMAC5 int SOAP_FMAC6 __tds__DeleteUsers(struct soap*, _tds__DeleteUsers *tds__DeleteUsers, _tds__DeleteUsersResponse &tds__DeleteUsersResponse) {
-	return SOAP_OK;
-}
-
-/** Web service operation '__tds__SetUser' implementation, should return SOAP_OK or error code */
-SOAP_FMAC5 int SOAP_FMAC6 __tds__SetUser(struct soap*, _tds__SetUser *tds__SetUser, _tds__SetUserResponse &tds__SetUserResponse) {
-	return SOAP_OK;
-}
-
 /** Web service operation '__tds__GetWsdlUrl' implementation, should return SOAP_OK or error code */
 SOAP_FMAC5 int SOAP_FMAC6 __tds__GetWsdlUrl(struct soap*, _tds__GetWsdlUrl *tds__GetWsdlUrl, _tds__GetWsdlUrlResponse &tds__GetWsdlUrlResponse) {
 	return SOAP_OK;
@@ -211,11 +161,6 @@ SOAP_FMAC5 int SOAP_FMAC6 __tds__SetHostnameFromDHCP(struct soap*, _tds__SetHost
 	return SOAP_OK;
 }
 
-/** Web service operation '__tds__GetDNS' implementation, should return SOAP_OK or error code */
-SOAP_FMAC5 int SOAP_FMAC6 __tds__GetDNS(struct soap*, _tds__GetDNS *tds__GetDNS, _tds__GetDNSResponse &tds__GetDNSResponse) {
-	return SOAP_OK;
-}
-
 /** Web service operation '__tds__SetDNS' implementation, should return SOAP_OK or error code */
 SOAP_FMAC5 int SOAP_FMAC6 __tds__SetDNS(struct soap*, _tds__SetDNS *tds__SetDNS, _tds__SetDNSResponse &tds__SetDNSResponse) {
 	return SOAP_OK;
@@ -241,11 +186,6 @@ SOAP_FMAC5 int SOAP_FMAC6 __tds__SetDynamicDNS(struct soap*, _tds__SetDynamicDNS
 	return SOAP_OK;
 }
 
-/** Web service operation '__tds__GetNetworkInterfaces' implementation, should return SOAP_OK or error code */
-SOAP_FMAC5 int SOAP_FMAC6 __tds__GetNetworkInterfaces(struct soap*, _tds__GetNetworkInterfaces *tds__GetNetworkInterfaces, _tds__GetNetworkInterfacesResponse &tds__GetNetworkInterfacesResponse) {
-	return SOAP_OK;
-}
-
 /** Web service operation '__tds__SetNetworkInterfaces' implementation, should return SOAP_OK or error code */
 SOAP_FMAC5 int SOAP_FMAC6 __tds__SetNetworkInterfaces(struct soap*, _tds__SetNetworkInterfaces *tds__SetNetworkInterfaces, _tds__SetNetworkInterfacesResponse &tds__SetNetworkInterfacesResponse) {
 	return SOAP_OK;
@@ -261,11 +201,6 @@ SOAP_FMAC5 int SOAP_FMAC6 __tds__SetNetworkProtocols(struct soap*, _tds__SetNetw
 	return SOAP_OK;
 }
 
-/** Web service operation '__tds__GetNetworkDefaultGateway' implementation, should return SOAP_OK or error code */
-SOAP_FMAC5 int SOAP_FMAC6 __tds__GetNetworkDefaultGateway(struct soap*, _tds__GetNetworkDefaultGateway *tds__GetNetworkDefaultGateway, _tds__GetNetworkDefaultGatewayResponse &tds__GetNetworkDefaultGatewayResponse) {
-	return SOAP_OK;
-}
-
 /** Web service operation '__tds__SetNetworkDefaultGateway' implementation, should return SOAP_OK or error code */
 SOAP_FMAC5 int SOAP_FMAC6 __tds__SetNetworkDefaultGateway(struct soap*, _tds__SetNetworkDefaultGateway *tds__SetNetworkDefaultGateway, _tds__SetNetworkDefaultGatewayResponse &tds__SetNetworkDefaultGatewayResponse) {
 	return SOAP_OK;
@@ -551,26 +486,6 @@ SOAP_FMAC5 int SOAP_FMAC6 __trt__GetAudioOutputs(struct soap*, _trt__GetAudioOut
 	return SOAP_OK;
 }
 
-/** Web service operation '__trt__CreateProfile' implementation, should return SOAP_OK or error code */
-SOAP_FMAC5 int SOAP_FMAC6 __trt__CreateProfile(struct soap*, _trt__CreateProfile *trt__CreateProfile, _trt__CreateProfileResponse &trt__CreateProfileResponse) {
-	return SOAP_OK;
-}
-
-/** Web service operation '__trt__GetProfile' implementation, should return SOAP_OK or error code */
-SOAP_FMAC5 int SOAP_FMAC6 __trt__GetProfile(struct soap*, _trt__GetProfile *trt__GetProfile, _trt__GetProfileResponse &trt__GetProfileResponse) {
-	return SOAP_OK;
-}
-
-/** Web service operation '__trt__AddVideoEncoderConfiguration' implementation, should return SOAP_OK or error code */
-SOAP_FMAC5 int SOAP_FMAC6 __trt__AddVideoEncoderConfiguration(struct soap*, _trt__AddVideoEncoderConfiguration *trt__AddVideoEncoderConfiguration, _trt__AddVideoEncoderConfigurationResponse &trt__AddVideoEncoderConfigurationResponse) {
-	return SOAP_OK;
-}
-
-/** Web service operation '__trt__AddVideoSourceConfiguration' implementation, should return SOAP_OK or error code */
-SOAP_FMAC5 int SOAP_FMAC6 __trt__AddVideoSourceConfiguration(struct soap*, _trt__AddVideoSourceConfiguration *trt__AddVideoSourceConfiguration, _trt__AddVideoSourceConfigurationResponse &trt__AddVideoSourceConfigurationResponse) {
-	return SOAP_OK;
-}
-
 /** Web service operation '__trt__AddAudioEncoderConfiguration' implementation, should return SOAP_OK or error code */
 SOAP_FMAC5 int SOAP_FMAC6 __trt__AddAudioEncoderConfiguration(struct soap*, _trt__AddAudioEncoderConfiguration *trt__AddAudioEncoderConfiguration, _trt__AddAudioEncoderConfigurationResponse &trt__AddAudioEncoderConfigurationResponse) {
 	return SOAP_OK;
@@ -606,16 +521,6 @@ SOAP_FMAC5 int SOAP_FMAC6 __trt__AddAudioDecoderConfiguration(struct soap*, _trt
 	return SOAP_OK;
 }
 
-/** Web service operation '__trt__RemoveVideoEncoderConfiguration' implementation, should return SOAP_OK or error code */
-SOAP_FMAC5 int SOAP_FMAC6 __trt__RemoveVideoEncoderConfiguration(struct soap*, _trt__RemoveVideoEncoderConfiguration *trt__RemoveVideoEncoderConfiguration, _trt__RemoveVideoEncoderConfigurationResponse &trt__RemoveVideoEncoderConfigurationResponse) {
-	return SOAP_OK;
-}
-
-/** Web service operation '__trt__RemoveVideoSourceConfiguration' implementation, should return SOAP_OK or error code */
-SOAP_FMAC5 int SOAP_FMAC6 __trt__RemoveVideoSourceConfiguration(struct soap*, _trt__RemoveVideoSourceConfiguration *trt__RemoveVideoSourceConfiguration, _trt__RemoveVideoSourceConfigurationResponse &trt__RemoveVideoSourceConfigurationResponse) {
-	return SOAP_OK;
-}
-
 /** Web service operation '__trt__RemoveAudioEncoderConfiguration' implementation, should return SOAP_OK or error code */
 SOAP_FMAC5 int SOAP_FMAC6 __trt__RemoveAudioEncoderConfiguration(struct soap*, _trt__RemoveAudioEncoderConfiguration *trt__RemoveAudioEncoderConfiguration, _trt__RemoveAudioEncoderConfigurationResponse &trt__RemoveAudioEncoderConfigurationResponse) {
 	return SOAP_OK;
@@ -651,11 +556,6 @@ SOAP_FMAC5 int SOAP_FMAC6 __trt__RemoveAudioDecoderConfiguration(struct soap*, _
 	return SOAP_OK;
 }
 
-/** Web service operation '__trt__DeleteProfile' implementation, should return SOAP_OK or error code */
-SOAP_FMAC5 int SOAP_FMAC6 __trt__DeleteProfile(struct soap*, _trt__DeleteProfile *trt__DeleteProfile, _trt__DeleteProfileResponse &trt__DeleteProfileResponse) {
-	return SOAP_OK;
-}
-
 /** Web service operation '__trt__GetAudioSourceConfigurations' implementation, should return SOAP_OK or error code */
 SOAP_FMAC5 int SOAP_FMAC6 __trt__GetAudioSourceConfigurations(struct soap*, _trt__GetAudioSourceConfigurations *trt__GetAudioSourceConfigurations, _trt__GetAudioSourceConfigurationsResponse &trt__GetAudioSourceConfigurationsResponse) {
 	return SOAP_OK;
@@ -816,21 +716,6 @@ SOAP_FMAC5 int SOAP_FMAC6 __trt__GetAudioDecoderConfigurationOptions(struct soap
 	return SOAP_OK;
 }
 
-/** Web service operation '__trt__GetGuaranteedNumberOfVideoEncoderInstances' implementation, should return SOAP_OK or error code */
-SOAP_FMAC5 int SOAP_FMAC6 __trt__GetGuaranteedNumberOfVideoEncoderInstances(struct soap*, _trt__GetGuaranteedNumberOfVideoEncoderInstances *trt__GetGuaranteedNumberOfVideoEncoderInstances, _trt__GetGuaranteedNumberOfVideoEncoderInstancesResponse &trt__GetGuaranteedNumberOfVideoEncoderInstancesResponse) {
-	return SOAP_OK;
-}
-
-/** Web service operation '__trt__StartMulticastStreaming' implementation, should return SOAP_OK or error code */
-SOAP_FMAC5 int SOAP_FMAC6 __trt__StartMulticastStreaming(struct soap*, _trt__StartMulticastStreaming *trt__StartMulticastStreaming, _trt__StartMulticastStreamingResponse &trt__StartMulticastStreamingResponse) {
-	return SOAP_OK;
-}
-
-/** Web service operation '__trt__StopMulticastStreaming' implementation, should return SOAP_OK or error code */
-SOAP_FMAC5 int SOAP_FMAC6 __trt__StopMulticastStreaming(struct soap*, _trt__StopMulticastStreaming *trt__StopMulticastStreaming, _trt__StopMulticastStreamingResponse &trt__StopMulticastStreamingResponse) {
-	return SOAP_OK;
-}
-
 /** Web service operation '__trt__SetSynchronizationPoint' implementation, should return SOAP_OK or error code */
 SOAP_FMAC5 int SOAP_FMAC6 __trt__SetSynchronizationPoint(struct soap*, _trt__SetSynchronizationPoint *trt__SetSynchronizationPoint, _trt__SetSynchronizationPointResponse &trt__SetSynchronizationPointResponse) {
 	return SOAP_OK;
@@ -881,20 +766,247 @@ SOAP_FMAC5 int SOAP_FMAC6 __trt__DeleteOSD(struct soap*, _trt__DeleteOSD *trt__D
 	return SOAP_OK;
 }
 
-/** WSDD events */
-void wsdd_event_Hello(struct soap *soap, unsigned int InstanceId, const char *SequenceId, unsigned int MessageNumber, const char *MessageID, const char *RelatesTo, const char *EndpointReference, const char *Types, const char *Scopes, const char *MatchBy, const char *XAddrs, unsigned int MetadataVersion)
-{ }
+/** Web service operation '__tr2__GetAudioSourceConfigurations' implementation, should return SOAP_OK or error code */
+SOAP_FMAC5 int SOAP_FMAC6 __tr2__GetAudioSourceConfigurations(struct soap*, tr2__GetConfiguration *tr2__GetAudioSourceConfigurations, _tr2__GetAudioSourceConfigurationsResponse &tr2__GetAudioSourceConfigurationsResponse) {
+	return SOAP_OK;
+}
+
+/** Web service operation '__tr2__GetAudioEncoderConfigurations' implementation, should return SOAP_OK or error code */
+SOAP_FMAC5 int SOAP_FMAC6 __tr2__GetAudioEncoderConfigurations(struct soap*, tr2__GetConfiguration *tr2__GetAudioEncoderConfigurations, _tr2__GetAudioEncoderConfigurationsResponse &tr2__GetAudioEncoderConfigurationsResponse) {
+	return SOAP_OK;
+}
+
+/** Web service operation '__tr2__GetAnalyticsConfigurations' implementation, should return SOAP_OK or error code */
+SOAP_FMAC5 int SOAP_FMAC6 __tr2__GetAnalyticsConfigurations(struct soap*, tr2__GetConfiguration *tr2__GetAnalyticsConfigurations, _tr2__GetAnalyticsConfigurationsResponse &tr2__GetAnalyticsConfigurationsResponse) {
+	return SOAP_OK;
+}
+
+/** Web service operation '__tr2__GetMetadataConfigurations' implementation, should return SOAP_OK or error code */
+SOAP_FMAC5 int SOAP_FMAC6 __tr2__GetMetadataConfigurations(struct soap*, tr2__GetConfiguration *tr2__GetMetadataConfigurations, _tr2__GetMetadataConfigurationsResponse &tr2__GetMetadataConfigurationsResponse) {
+	return SOAP_OK;
+}
+
+/** Web service operation '__tr2__GetAudioOutputConfigurations' implementation, should return SOAP_OK or error code */
+SOAP_FMAC5 int SOAP_FMAC6 __tr2__GetAudioOutputConfigurations(struct soap*, tr2__GetConfiguration *tr2__GetAudioOutputConfigurations, _tr2__GetAudioOutputConfigurationsResponse &tr2__GetAudioOutputConfigurationsResponse) {
+	return SOAP_OK;
+}
+
+/** Web service operation '__tr2__GetAudioDecoderConfigurations' implementation, should return SOAP_OK or error code */
+SOAP_FMAC5 int SOAP_FMAC6 __tr2__GetAudioDecoderConfigurations(struct soap*, tr2__GetConfiguration *tr2__GetAudioDecoderConfigurations, _tr2__GetAudioDecoderConfigurationsResponse &tr2__GetAudioDecoderConfigurationsResponse) {
+	return SOAP_OK;
+}
+
+/** Web service operation '__tr2__SetAudioSourceConfiguration' implementation, should return SOAP_OK or error code */
+SOAP_FMAC5 int SOAP_FMAC6 __tr2__SetAudioSourceConfiguration(struct soap*, _tr2__SetAudioSourceConfiguration *tr2__SetAudioSourceConfiguration, tr2__SetConfigurationResponse &tr2__SetAudioSourceConfigurationResponse) {
+	return SOAP_OK;
+}
+
+/** Web service operation '__tr2__SetAudioEncoderConfiguration' implementation, should return SOAP_OK or error code */
+SOAP_FMAC5 int SOAP_FMAC6 __tr2__SetAudioEncoderConfiguration(struct soap*, _tr2__SetAudioEncoderConfiguration *tr2__SetAudioEncoderConfiguration, tr2__SetConfigurationResponse &tr2__SetAudioEncoderConfigurationResponse) {
+	return SOAP_OK;
+}
+
+/** Web service operation '__tr2__SetMetadataConfiguration' implementation, should return SOAP_OK or error code */
+SOAP_FMAC5 int SOAP_FMAC6 __tr2__SetMetadataConfiguration(struct soap*, _tr2__SetMetadataConfiguration *tr2__SetMetadataConfiguration, tr2__SetConfigurationResponse &tr2__SetMetadataConfigurationResponse) {
+	return SOAP_OK;
+}
+
+/** Web service operation '__tr2__SetAudioOutputConfiguration' implementation, should return SOAP_OK or error code */
+SOAP_FMAC5 int SOAP_FMAC6 __tr2__SetAudioOutputConfiguration(struct soap*, _tr2__SetAudioOutputConfiguration *tr2__SetAudioOutputConfiguration, tr2__SetConfigurationResponse &tr2__SetAudioOutputConfigurationResponse) {
+	return SOAP_OK;
+}
+
+/** Web service operation '__tr2__SetAudioDecoderConfiguration' implementation, should return SOAP_OK or error code */
+SOAP_FMAC5 int SOAP_FMAC6 __tr2__SetAudioDecoderConfiguration(struct soap*, _tr2__SetAudioDecoderConfiguration *tr2__SetAudioDecoderConfiguration, tr2__SetConfigurationResponse &tr2__SetAudioDecoderConfigurationResponse) {
+	return SOAP_OK;
+}
+
+/** Web service operation '__tr2__GetAudioSourceConfigurationOptions' implementation, should return SOAP_OK or error code */
+SOAP_FMAC5 int SOAP_FMAC6 __tr2__GetAudioSourceConfigurationOptions(struct soap*, tr2__GetConfiguration *tr2__GetAudioSourceConfigurationOptions, _tr2__GetAudioSourceConfigurationOptionsResponse &tr2__GetAudioSourceConfigurationOptionsResponse) {
+	return SOAP_OK;
+}
+
+/** Web service operation '__tr2__GetAudioEncoderConfigurationOptions' implementation, should return SOAP_OK or error code */
+SOAP_FMAC5 int SOAP_FMAC6 __tr2__GetAudioEncoderConfigurationOptions(struct soap*, tr2__GetConfiguration *tr2__GetAudioEncoderConfigurationOptions, _tr2__GetAudioEncoderConfigurationOptionsResponse &tr2__GetAudioEncoderConfigurationOptionsResponse) {
+	return SOAP_OK;
+}
+
+/** Web service operation '__tr2__GetMetadataConfigurationOptions' implementation, should return SOAP_OK or error code */
+SOAP_FMAC5 int SOAP_FMAC6 __tr2__GetMetadataConfigurationOptions(struct soap*, tr2__GetConfiguration *tr2__GetMetadataConfigurationOptions, _tr2__GetMetadataConfigurationOptionsResponse &tr2__GetMetadataConfigurationOptionsResponse) {
+	return SOAP_OK;
+}
+
+/** Web service operation '__tr2__GetAudioOutputConfigurationOptions' implementation, should return SOAP_OK or error code */
+SOAP_FMAC5 int SOAP_FMAC6 __tr2__GetAudioOutputConfigurationOptions(struct soap*, tr2__GetConfiguration *tr2__GetAudioOutputConfigurationOptions, _tr2__GetAudioOutputConfigurationOptionsResponse &tr2__GetAudioOutputConfigurationOptionsResponse) {
+	return SOAP_OK;
+}
 
-void wsdd_event_Bye(struct soap *soap, unsigned int InstanceId, const char *SequenceId, unsigned int MessageNumber, const char *MessageID, const char *RelatesTo, const char *EndpointReference, const char *Types, const char *Scopes, const char *MatchBy, const char *XAddrs, unsigned int *MetadataVersion)
-{ }
+/** Web service operation '__tr2__GetAudioDecoderConfigurationOptions' implementation, should return SOAP_OK or error code */
+SOAP_FMAC5 int SOAP_FMAC6 __tr2__GetAudioDecoderConfigurationOptions(struct soap*, tr2__GetConfiguration *tr2__GetAudioDecoderConfigurationOptions, _tr2__GetAudioDecoderConfigurationOptionsResponse &tr2__GetAudioDecoderConfigurationOptionsResponse) {
+	return SOAP_OK;
+}
 
-void wsdd_event_ProbeMatches(struct soap *soap, unsigned int InstanceId, const char *SequenceId, unsigned int MessageNumber, const char *MessageID, const char *RelatesTo, struct wsdd__ProbeMatchesType *ProbeMatches)
-{ }
+/** Web service operation '__tr2__GetVideoEncoderInstances' implementation, should return SOAP_OK or error code */
+SOAP_FMAC5 int SOAP_FMAC6 __tr2__GetVideoEncoderInstances(struct soap*, _tr2__GetVideoEncoderInstances *tr2__GetVideoEncoderInstances, _tr2__GetVideoEncoderInstancesResponse &tr2__GetVideoEncoderInstancesResponse) {
+	return SOAP_OK;
+}
 
-soap_wsdd_mode wsdd_event_Resolve(struct soap *soap, const char *MessageID, const char *ReplyTo, const char *EndpointReference, struct wsdd__ResolveMatchType *match)
-{
-	return SOAP_WSDD_ADHOC;
+/** Web service operation '__tr2__StartMulticastStreaming' implementation, should return SOAP_OK or error code */
+SOAP_FMAC5 int SOAP_FMAC6 __tr2__StartMulticastStreaming(struct soap*, tr2__StartStopMulticastStreaming *tr2__StartMulticastStreaming, tr2__SetConfigurationResponse &tr2__StartMulticastStreamingResponse) {
+	return SOAP_OK;
 }
 
-void wsdd_event_ResolveMatches(struct soap *soap, unsigned int InstanceId, const char * SequenceId, unsigned int MessageNumber, const char *MessageID, const char *RelatesTo, struct wsdd__ResolveMatchType *match)
-{ }
+/** Web service operation '__tr2__StopMulticastStreaming' implementation, should return SOAP_OK or error code */
+SOAP_FMAC5 int SOAP_FMAC6 __tr2__StopMulticastStreaming(struct soap*, tr2__StartStopMulticastStreaming *tr2__StopMulticastStreaming, tr2__SetConfigurationResponse &tr2__StopMulticastStreamingResponse) {
+	return SOAP_OK;
+}
+
+/** Web service operation '__tr2__SetSynchronizationPoint' implementation, should return SOAP_OK or error code */
+SOAP_FMAC5 int SOAP_FMAC6 __tr2__SetSynchronizationPoint(struct soap*, _tr2__SetSynchronizationPoint *tr2__SetSynchronizationPoint, _tr2__SetSynchronizationPointResponse &tr2__SetSynchronizationPointResponse) {
+	return SOAP_OK;
+}
+
+/** Web service operation '__tr2__GetSnapshotUri' implementation, should return SOAP_OK or error code */
+SOAP_FMAC5 int SOAP_FMAC6 __tr2__GetSnapshotUri(struct soap*, _tr2__GetSnapshotUri *tr2__GetSnapshotUri, _tr2__GetSnapshotUriResponse &tr2__GetSnapshotUriResponse) {
+	return SOAP_OK;
+}
+
+/** Web service operation '__tr2__GetVideoSourceModes' implementation, should return SOAP_OK or error code */
+SOAP_FMAC5 int SOAP_FMAC6 __tr2__GetVideoSourceModes(struct soap*, _tr2__GetVideoSourceModes *tr2__GetVideoSourceModes, _tr2__GetVideoSourceModesResponse &tr2__GetVideoSourceModesResponse) {
+	return SOAP_OK;
+}
+
+/** Web service operation '__tr2__SetVideoSourceMode' implementation, should return SOAP_OK or error code */
+SOAP_FMAC5 int SOAP_FMAC6 __tr2__SetVideoSourceMode(struct soap*, _tr2__SetVideoSourceMode *tr2__SetVideoSourceMode, _tr2__SetVideoSourceModeResponse &tr2__SetVideoSourceModeResponse) {
+	return SOAP_OK;
+}
+
+/** Web service operation '__tr2__GetOSDs' implementation, should return SOAP_OK or error code */
+SOAP_FMAC5 int SOAP_FMAC6 __tr2__GetOSDs(struct soap*, _tr2__GetOSDs *tr2__GetOSDs, _tr2__GetOSDsResponse &tr2__GetOSDsResponse) {
+	return SOAP_OK;
+}
+
+/** Web service operation '__tr2__GetOSDOptions' implementation, should return SOAP_OK or error code */
+SOAP_FMAC5 int SOAP_FMAC6 __tr2__GetOSDOptions(struct soap*, _tr2__GetOSDOptions *tr2__GetOSDOptions, _tr2__GetOSDOptionsResponse &tr2__GetOSDOptionsResponse) {
+	return SOAP_OK;
+}
+
+/** Web service operation '__tr2__SetOSD' implementation, should return SOAP_OK or error code */
+SOAP_FMAC5 int SOAP_FMAC6 __tr2__SetOSD(struct soap*, _tr2__SetOSD *tr2__SetOSD, tr2__SetConfigurationResponse &tr2__SetOSDResponse) {
+	return SOAP_OK;
+}
+
+/** Web service operation '__tr2__CreateOSD' implementation, should return SOAP_OK or error code */
+SOAP_FMAC5 int SOAP_FMAC6 __tr2__CreateOSD(struct soap*, _tr2__CreateOSD *tr2__CreateOSD, _tr2__CreateOSDResponse &tr2__CreateOSDResponse) {
+	return SOAP_OK;
+}
+
+/** Web service operation '__tr2__DeleteOSD' implementation, should return SOAP_OK or error code */
+SOAP_FMAC5 int SOAP_FMAC6 __tr2__DeleteOSD(struct soap*, _tr2__DeleteOSD *tr2__DeleteOSD, tr2__SetConfigurationResponse &tr2__DeleteOSDResponse) {
+	return SOAP_OK;
+}
+
+/** Web service operation '__tr2__GetMasks' implementation, should return SOAP_OK or error code */
+SOAP_FMAC5 int SOAP_FMAC6 __tr2__GetMasks(struct soap*, _tr2__GetMasks *tr2__GetMasks, _tr2__GetMasksResponse &tr2__GetMasksResponse) {
+	return SOAP_OK;
+}
+
+/** Web service operation '__tr2__SetMask' implementation, should return SOAP_OK or error code */
+SOAP_FMAC5 int SOAP_FMAC6 __tr2__SetMask(struct soap*, _tr2__SetMask *tr2__SetMask, tr2__SetConfigurationResponse &tr2__SetMaskResponse) {
+	return SOAP_OK;
+}
+
+/** Web service operation '__tr2__CreateMask' implementation, should return SOAP_OK or error code */
+SOAP_FMAC5 int SOAP_FMAC6 __tr2__CreateMask(struct soap*, _tr2__CreateMask *tr2__CreateMask, _tr2__CreateMaskResponse &tr2__CreateMaskResponse) {
+	return SOAP_OK;
+}
+
+/** Web service operation '__tr2__DeleteMask' implementation, should return SOAP_OK or error code */
+SOAP_FMAC5 int SOAP_FMAC6 __tr2__DeleteMask(struct soap*, _tr2__DeleteMask *tr2__DeleteMask, tr2__SetConfigurationResponse &tr2__DeleteMaskResponse) {
+	return SOAP_OK;
+}
+
+/** Web service operation '__tr2__GetMaskOptions' implementation, should return SOAP_OK or error code */
+SOAP_FMAC5 int SOAP_FMAC6 __tr2__GetMaskOptions(struct soap*, _tr2__GetMaskOptions *tr2__GetMaskOptions, _tr2__GetMaskOptionsResponse &tr2__GetMaskOptionsResponse) {
+	return SOAP_OK;
+}
+
+/** Web service operation '__tev__Seek' implementation, should return SOAP_OK or error code */
+SOAP_FMAC5 int SOAP_FMAC6 __tev__Seek(struct soap*, _tev__Seek *tev__Seek, _tev__SeekResponse &tev__SeekResponse) {
+	return SOAP_OK;
+}
+
+/** Web service operation '__tev__AddEventBroker' implementation, should return SOAP_OK or error code */
+SOAP_FMAC5 int SOAP_FMAC6 __tev__AddEventBroker(struct soap*, _tev__AddEventBroker *tev__AddEventBroker, _tev__AddEventBrokerResponse &tev__AddEventBrokerResponse) {
+	return SOAP_OK;
+}
+
+/** Web service operation '__tev__DeleteEventBroker' implementation, should return SOAP_OK or error code */
+SOAP_FMAC5 int SOAP_FMAC6 __tev__DeleteEventBroker(struct soap*, _tev__DeleteEventBroker *tev__DeleteEventBroker, _tev__DeleteEventBrokerResponse &tev__DeleteEventBrokerResponse) {
+	return SOAP_OK;
+}
+
+/** Web service operation '__tev__GetEventBrokers' implementation, should return SOAP_OK or error code */
+SOAP_FMAC5 int SOAP_FMAC6 __tev__GetEventBrokers(struct soap*, _tev__GetEventBrokers *tev__GetEventBrokers, _tev__GetEventBrokersResponse &tev__GetEventBrokersResponse) {
+	return SOAP_OK;
+}
+
+/** Web service operation '__tev__Unsubscribe_' implementation, should return SOAP_OK or error code */
+SOAP_FMAC5 int SOAP_FMAC6 __tev__Unsubscribe_(struct soap*, _wsnt__Unsubscribe *wsnt__Unsubscribe, _wsnt__UnsubscribeResponse &wsnt__UnsubscribeResponse) {
+	return SOAP_OK;
+}
+
+/** Web service operation '__tev__Subscribe' implementation, should return SOAP_OK or error code */
+SOAP_FMAC5 int SOAP_FMAC6 __tev__Subscribe(struct soap*, _wsnt__Subscribe *wsnt__Subscribe, _wsnt__SubscribeResponse &wsnt__SubscribeResponse) {
+	return SOAP_OK;
+}
+
+/** Web service operation '__tev__GetCurrentMessage' implementation, should return SOAP_OK or error code */
+SOAP_FMAC5 int SOAP_FMAC6 __tev__GetCurrentMessage(struct soap*, _wsnt__GetCurrentMessage *wsnt__GetCurrentMessage, _wsnt__GetCurrentMessageResponse &wsnt__GetCurrentMessageResponse) {
+	return SOAP_OK;
+}
+
+/** Web service one-way operation '__tev__Notify' implementation, should return value of soap_send_empty_response() to send HTTP Accept acknowledgment, or return an error code, or return SOAP_OK to immediately return without sending an HTTP response message */
+SOAP_FMAC5 int SOAP_FMAC6 __tev__Notify(struct soap*, _wsnt__Notify *wsnt__Notify) {
+	return SOAP_OK;
+}
+
+/** Web service operation '__tev__GetMessages' implementation, should return SOAP_OK or error code */
+SOAP_FMAC5 int SOAP_FMAC6 __tev__GetMessages(struct soap*, _wsnt__GetMessages *wsnt__GetMessages, _wsnt__GetMessagesResponse &wsnt__GetMessagesResponse) {
+	return SOAP_OK;
+}
+
+/** Web service operation '__tev__DestroyPullPoint' implementation, should return SOAP_OK or error code */
+SOAP_FMAC5 int SOAP_FMAC6 __tev__DestroyPullPoint(struct soap*, _wsnt__DestroyPullPoint *wsnt__DestroyPullPoint, _wsnt__DestroyPullPointResponse &wsnt__DestroyPullPointResponse) {
+	return SOAP_OK;
+}
+
+/** Web service one-way operation '__tev__Notify_' implementation, should return value of soap_send_empty_response() to send HTTP Accept acknowledgment, or return an error code, or return SOAP_OK to immediately return without sending an HTTP response message */
+SOAP_FMAC5 int SOAP_FMAC6 __tev__Notify_(struct soap*, _wsnt__Notify *wsnt__Notify) {
+	return SOAP_OK;
+}
+
+/** Web service operation '__tev__CreatePullPoint' implementation, should return SOAP_OK or error code */
+SOAP_FMAC5 int SOAP_FMAC6 __tev__CreatePullPoint(struct soap*, _wsnt__CreatePullPoint *wsnt__CreatePullPoint, _wsnt__CreatePullPointResponse &wsnt__CreatePullPointResponse) {
+	return SOAP_OK;
+}
+
+/** Web service operation '__tev__Renew_' implementation, should return SOAP_OK or error code */
+SOAP_FMAC5 int SOAP_FMAC6 __tev__Renew_(struct soap*, _wsnt__Renew *wsnt__Renew, _wsnt__RenewResponse &wsnt__RenewResponse) {
+	return SOAP_OK;
+}
+
+/** Web service operation '__tev__Unsubscribe__' implementation, should return SOAP_OK or error code */
+SOAP_FMAC5 int SOAP_FMAC6 __tev__Unsubscribe__(struct soap*, _wsnt__Unsubscribe *wsnt__Unsubscribe, _wsnt__UnsubscribeResponse &wsnt__UnsubscribeResponse) {
+	return SOAP_OK;
+}
+
+/** Web service operation '__tev__PauseSubscription' implementation, should return SOAP_OK or error code */
+SOAP_FMAC5 int SOAP_FMAC6 __tev__PauseSubscription(struct soap*, _wsnt__PauseSubscription *wsnt__PauseSubscription, _wsnt__PauseSubscriptionResponse &wsnt__PauseSubscriptionResponse) {
+	return SOAP_OK;
+}
+
+/** Web service operation '__tev__ResumeSubscription' implementation, should return SOAP_OK or error code */
+SOAP_FMAC5 int SOAP_FMAC6 __tev__ResumeSubscription(struct soap*, _wsnt__ResumeSubscription *wsnt__ResumeSubscription, _wsnt__ResumeSubscriptionResponse &wsnt__ResumeSubscriptionResponse) {
+	return SOAP_OK;
+}
@@ -0,0 +1,211 @@
+// Copyright 2023 Morse Micro
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <time.h>
+
+#include <string>
+#include <vector>
+
+#include "catch.hpp"
+#include "../authenticator.h"
+#include "../hashes.h"
+
+
+using Level = Authenticator::Level;
+
+
+static const time_t NOW = 1700000000;
+
+
+static Authenticator some_authenticator(size_t replay_slots = ReplayCache::DEFAULT_SLOTS) {
+	Authenticator authenticator(replay_slots);
+	authenticator.setUsers({{"admin", "secret", Level::Administrator}, {"viewer", "password", Level::User}});
+	return authenticator;
+}
+
+
+// As a client would make it.
+struct UsernameToken {
+	std::string username;
+	std::string digest;
+	std::string nonce;
+	std::string created;
+	time_t created_time;
+};
+
+static UsernameToken username_token(const std::string &username, const std::string &password, time_t created_time, int nonce) {
+	char created[32];
+	struct tm tm;
+	gmtime_r(&created_time, &tm);
+	strftime(created, sizeof(created), "%Y-%m-%dT%H:%M:%SZ", &tm);
+	std::string nonce_bytes = std::to_string(nonce);
+	auto digest = Sha1().update(nonce_bytes).update(created).update(password).finish();
+	return {username, base64_encode(digest.data(), digest.size()),
+		base64_encode(reinterpret_cast<const uint8_t *>(nonce_bytes.data()), nonce_bytes.size()), created, created_time};
+}
+
+static Level verify(Authenticator &authenticator, const UsernameToken &token, time_t now = NOW) {
+	return authenticator.verifyUsernameToken(token.username, token.digest, token.nonce, token.created, token.created_time, now);
+}
+
+// The Authorization header for a challenge from the authenticator.
+static std::string digest_authorization(const std::string &challenge, const std::string &username, const std::string &password,
+                                        const std::string &uri, int nc) {
+	size_t start = challenge.find("nonce=\"") + 7;
+	std::string nonce = challenge.substr(start, challenge.find('"', start) - start);
+	char nc_hex[9];
+	snprintf(nc_hex, sizeof(nc_hex), "%08x", nc);
+	auto ha1 = to_hex(Md5().update(username + ":ONVIF:" + password).finish());
+	auto ha2 = to_hex(Md5().update("POST:" + uri).finish());
+	auto response = to_hex(Md5().update(ha1 + ":" + nonce + ":" + nc_hex + ":0a4f113b:auth:" + ha2).finish());
+	return "username=\"" + username + "\", realm=\"ONVIF\", nonce=\"" + nonce + "\", uri=\"" + uri
+		+ "\", qop=auth, nc=" + nc_hex + ", cnonce=\"0a4f113b\", response=\"" + response + "\"";
+}
+
+
+TEST_CASE( "UsernameToken matches the ONVIF programmer's guide", "[authenticator]" ) {
+	Authenticator authenticator;
+	authenticator.setUsers({{"user", "userpassword", Level::Operator}});
+	struct tm created = {};
+	created.tm_year = 2010 - 1900;
+	created.tm_mon = 8;
+	created.tm_mday = 16;
+	created.tm_hour = 7;
+	created.tm_min = 50;
+	created.tm_sec = 45;
+	time_t created_time = timegm(&created);
+
+	REQUIRE(authenticator.verifyUsernameToken("user", "tuOSpGlFlIXsozq4HFNeeGeFLEI=", "LKqI6G/AikKCQrN0zqZFlg==",
+		"2010-09-16T07:50:45Z", created_time, created_time + 1) == Level::Operator);
+}
+
+TEST_CASE( "UsernameToken is only accepted once, while it's fresh", "[authenticator]" ) {
+	auto authenticator = some_authenticator();
+
+	auto token = username_token("admin", "secret", NOW - 10, 1);
+	REQUIRE(verify(authenticator, token) == Level::Administrator);
+	REQUIRE(verify(authenticator, token) == Level::Anonymous);
+	REQUIRE(verify(authenticator, username_token("viewer", "password", NOW, 1)) == Level::User);
+
+	REQUIRE(verify(authenticator, username_token("admin", "wrong", NOW, 2)) == Level::Anonymous);
+	REQUIRE(verify(authenticator, username_token("nobody", "secret", NOW, 3)) == Level::Anonymous);
+	REQUIRE(verify(authenticator, username_token("admin", "secret", NOW - Authenticator::WINDOW_SECONDS - 1, 4)) == Level::Anonymous);
+	REQUIRE(verify(authenticator, username_token("admin", "secret", NOW + Authenticator::WINDOW_SECONDS + 1, 5)) == Level::Anonymous);
+
+	// Without users, there's nobody to be.
+	authenticator.setUsers({});
+	REQUIRE(!authenticator.hasUsers());
+	REQUIRE(verify(authenticator, username_token("admin", "secret", NOW, 6)) == Level::Anonymous);
+}
+
+TEST_CASE( "ReplayCache refuses what it might have forgotten", "[authenticator]" ) {
+	ReplayCache cache(ReplayCache::PROBES);
+
+	for (uint64_t key = 1; key <= ReplayCache::PROBES; ++key) {
+		REQUIRE(cache.insert(key, NOW + 100 + key, NOW));
+	}
+	REQUIRE(!cache.insert(3, NOW + 200, NOW));
+
+	// Full, so the soonest to expire (key 1) goes, and anything expiring by then is refused.
+	REQUIRE(cache.insert(100, NOW + 200, NOW));
+	REQUIRE(!cache.insert(1, NOW + 101, NOW));
+	REQUIRE(!cache.insert(101, NOW + 101, NOW));
+	REQUIRE(!cache.insert(2, NOW + 102, NOW));
+
+	// Once they've expired, the slots are reused.
+	REQUIRE(cache.insert(102, NOW + 1000, NOW + 300));
+}
+
+TEST_CASE( "HTTP Digest answers our challenge once", "[authenticator]" ) {
+	auto authenticator = some_authenticator();
+	bool stale;
+
+	auto challenge = authenticator.digestChallenge(NOW, false);
+	REQUIRE(challenge.find("Digest realm=\"ONVIF\", qop=\"auth\"") == 0);
+
+	auto authorization = digest_authorization(challenge, "admin", "secret", "/onvif/device_service", 1);
+	REQUIRE(authenticator.verifyDigest(authorization, "/onvif/device_service", NOW + 1, &stale) == Level::Administrator);
+	REQUIRE(authenticator.verifyDigest(authorization, "/onvif/device_service", NOW + 1, &stale) == Level::Anonymous);
+	REQUIRE(!stale);
+
+	// The next nc is fine.
+	authorization = digest_authorization(challenge, "admin", "secret", "/onvif/device_service", 2);
+	REQUIRE(authenticator.verifyDigest(authorization, "/onvif/device_service", NOW + 2, &stale) == Level::Administrator);
+
+	SECTION( "but not with the wrong password" ) {
+		authorization = digest_authorization(challenge, "admin", "wrong", "/onvif/device_service", 3);
+		REQUIRE(authenticator.verifyDigest(authorization, "/onvif/device_service", NOW + 2, &stale) == Level::Anonymous);
+		REQUIRE(!stale);
+	}
+
+	SECTION( "or for somewhere else" ) {
+		authorization = digest_authorization(challenge, "admin", "secret", "/onvif/device_service", 3);
+		REQUIRE(authenticator.verifyDigest(authorization, "/onvif/media_service", NOW + 2, &stale) == Level::Anonymous);
+	}
+
+	SECTION( "or a nonce we didn't make" ) {
+		auto forged = challenge;
+		forged[forged.find("nonce=\"") + 7 + 16] ^= 1;
+		authorization = digest_authorization(forged, "admin", "secret", "/onvif/device_service", 3);
+		REQUIRE(authenticator.verifyDigest(authorization, "/onvif/device_service", NOW + 2, &stale) == Level::Anonymous);
+		REQUIRE(!stale);
+	}
+
+	SECTION( "or once the nonce is stale" ) {
+		authorization = digest_authorization(challenge, "admin", "secret", "/onvif/device_service", 3);
+		REQUIRE(authenticator.verifyDigest(authorization, "/onvif/device_service", NOW + Authenticator::WINDOW_SECONDS + 1, &stale) == Level::Anonymous);
+		REQUIRE(stale);
+	}
+}
+
+TEST_CASE( "Operations need ONVIF's access classes", "[authenticator]" ) {
+	REQUIRE(Authenticator::requiredLevel("tds", "GetSystemDateAndTime") == Level::Anonymous);
+	REQUIRE(Authenticator::requiredLevel("tds", "GetServices") == Level::Anonymous);
+	REQUIRE(Authenticator::requiredLevel("trt", "GetServiceCapabilities") == Level::Anonymous);
+	REQUIRE(Authenticator::requiredLevel("tds", "GetDeviceInformation") == Level::User);
+	REQUIRE(Authenticator::requiredLevel("trt", "GetStreamUri") == Level::User);
+	REQUIRE(Authenticator::requiredLevel("tev", "PullMessages") == Level::User);
+	REQUIRE(Authenticator::requiredLevel("wsnt", "Unsubscribe") == Level::User);
+	REQUIRE(Authenticator::requiredLevel("trt", "SetVideoEncoderConfiguration") == Level::Operator);
+	REQUIRE(Authenticator::requiredLevel("timg", "SetImagingSettings") == Level::Operator);
+	REQUIRE(Authenticator::requiredLevel("tds", "SetScopes") == Level::Administrator);
+	REQUIRE(Authenticator::requiredLevel("tds", "GetUsers") == Level::Administrator);
+}
+
+// Run with: ./test-runner "[benchmark]"
+TEST_CASE( "Authentication overhead per request", "[.][benchmark]" ) {
+	auto authenticator = some_authenticator();
+
+	BENCHMARK_ADVANCED("UsernameToken")(Catch::Benchmark::Chronometer meter) {
+		// Fresh tokens, so that none are refused as replays (and the cache fills as it would).
+		static int nonce = 0;
+		std::vector<UsernameToken> tokens;
+		for (int i = 0; i < meter.runs(); ++i) {
+			tokens.push_back(username_token("admin", "secret", NOW, ++nonce));
+		}
+		meter.measure([&authenticator, &tokens] (int i) {
+			return verify(authenticator, tokens[i]);
+		});
+	};
+
+	BENCHMARK_ADVANCED("HTTP Digest")(Catch::Benchmark::Chronometer meter) {
+		static int nc = 0;
+		auto challenge = authenticator.digestChallenge(NOW, false);
+		std::vector<std::string> authorizations;
+		for (int i = 0; i < meter.runs(); ++i) {
+			authorizations.push_back(digest_authorization(challenge, "admin", "secret", "/onvif/device_service", ++nc));
+		}
+		meter.measure([&authenticator, &authorizations] (int i) {
+			bool stale;
+			return authenticator.verifyDigest(authorizations[i], "/onvif/device_service", NOW, &stale);
+		});
+	};
+
+	BENCHMARK_ADVANCED("refusing a replay")(Catch::Benchmark::Chronometer meter) {
+		auto token = username_token("admin", "secret", NOW, -1);
+		verify(authenticator, token);
+		meter.measure([&authenticator, &token] {
+			return verify(authenticator, token);
+		});
+	};
+}
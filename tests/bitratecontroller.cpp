@@ -0,0 +1,224 @@
+// Copyright 2023 Morse Micro
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <stdlib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+#include "catch.hpp"
+#include "fakeit.hpp"
+#include "../bitratecontroller.h"
+#include "../camera.h"
+#include "../soaplib/soapStub.h"
+#include "scratch.h"
+
+
+static std::vector<int> read_trace(const std::string &path) {
+	std::ifstream in(path);
+	std::vector<int> trace;
+	std::string line;
+	while (std::getline(in, line)) {
+		if (!line.empty() && line[0] != '#') {
+			trace.push_back(std::stoi(line));
+		}
+	}
+	return trace;
+}
+
+
+struct SimulationReport {
+	int stall_seconds;
+	double mean_bitrate;
+};
+
+
+// Replays a trace of what the link could carry each second, with the encoder sending whatever
+// controller targets (or fixed_bitrate without one) and anything the link can't take queueing up.
+// Viewers stall while it'd take more than a second to get through the queue.
+static SimulationReport simulate(const std::vector<int> &trace, BitrateController *controller, int fixed_bitrate) {
+	SimulationReport report = {0, 0};
+	double backlog = 0;
+	for (int capacity : trace) {
+		int bitrate = controller != nullptr ? controller->getTarget() : fixed_bitrate;
+		report.mean_bitrate += bitrate;
+		backlog += bitrate;
+		double sent = std::min<double>(capacity, backlog);
+		backlog -= sent;
+		if (backlog > capacity) {
+			++report.stall_seconds;
+		}
+		if (controller != nullptr) {
+			controller->update(sent);
+		}
+	}
+	report.mean_bitrate /= trace.size();
+	return report;
+}
+
+
+TEST_CASE( "Bitrate controller backs off at once, and probes back up slowly", "[bitratecontroller]" ) {
+	BitrateController controller(200, 1000);
+	REQUIRE(controller.getTarget() == 1000);
+
+	// Close enough to the target either way isn't a change.
+	REQUIRE(controller.update(850) == 1000);
+	REQUIRE(controller.update(600) == 510);
+	REQUIRE(controller.update(100) == 200);
+
+	// Keeping up once or twice isn't enough, nor is a sample that doesn't.
+	REQUIRE(controller.update(200) == 200);
+	REQUIRE(controller.update(200) == 200);
+	REQUIRE(controller.update(180) == 200);
+	REQUIRE(controller.update(200) == 200);
+	REQUIRE(controller.update(200) == 200);
+	REQUIRE(controller.update(200) == 230);
+
+	controller.reset(800);
+	REQUIRE(controller.getTarget() == 800);
+	for (int i = 0; i < 10; ++i) {
+		REQUIRE(controller.update(900) == 800);
+	}
+
+	// Undone, the same sample gets the same answer again, even at the end of a probe.
+	REQUIRE(controller.update(300) == 255);
+	controller.undo();
+	REQUIRE(controller.getTarget() == 800);
+	REQUIRE(controller.update(300) == 255);
+	REQUIRE(controller.update(255) == 255);
+	REQUIRE(controller.update(255) == 255);
+	REQUIRE(controller.update(255) == 294);
+	controller.undo();
+	REQUIRE(controller.update(255) == 294);
+}
+
+
+TEST_CASE( "Bitrate controller stalls less than a fixed bitrate on a HaLow trace", "[bitratecontroller]" ) {
+	auto trace = read_trace("tests/halow_throughput_trace.txt");
+	REQUIRE(trace.size() > 100);
+
+	BitrateController controller(200, 1000);
+	auto adaptive = simulate(trace, &controller, 0);
+	auto fixed = simulate(trace, nullptr, 1000);
+	INFO("Stalled for " << adaptive.stall_seconds << "s (at " << adaptive.mean_bitrate << "kbit/s on average) rather than " << fixed.stall_seconds << "s");
+	REQUIRE(adaptive.stall_seconds * 5 < fixed.stall_seconds);
+	// Without giving up more bitrate than the link did.
+	REQUIRE(adaptive.mean_bitrate > 500);
+}
+
+
+// Reports on any trace, e.g. BITRATE_TRACE=trace.txt ./test-runner [simulation]
+TEST_CASE( "Bitrate controller simulation", "[.][simulation]" ) {
+	const char *path = getenv("BITRATE_TRACE");
+	auto trace = read_trace(path != nullptr ? path : "tests/halow_throughput_trace.txt");
+	REQUIRE(!trace.empty());
+	int max_bitrate = *std::max_element(trace.begin(), trace.end());
+
+	BitrateController controller(max_bitrate / 10, max_bitrate);
+	auto adaptive = simulate(trace, &controller, 0);
+	auto fixed = simulate(trace, nullptr, max_bitrate);
+	std::cout << "Over " << trace.size() << "s, adaptive stalled for " << adaptive.stall_seconds << "s at "
+	          << adaptive.mean_bitrate << "kbit/s on average; fixed at " << max_bitrate << "kbit/s, "
+	          << fixed.stall_seconds << "s" << std::endl;
+}
+
+
+// What /proc/net/dev would say if the interface had sent tx_bytes.
+static void write_net_dev(const std::string &path, const std::string &interface, uint64_t tx_bytes) {
+	std::ofstream(path)
+		<< "Inter-|   Receive                                                |  Transmit\n"
+		<< " face |bytes    packets errs drop fifo frame compressed multicast|bytes    packets errs drop fifo colls carrier compressed\n"
+		<< "    lo:    1234      10    0    0    0     0          0         0     1234      10    0    0    0     0       0          0\n"
+		<< interface << ": 5678 20 0 0 0 0 0 0 " << tx_bytes << " 30 0 0 0 0 0 0\n";
+}
+
+
+TEST_CASE( "Throughput is read from an interface's transmit counter", "[bitratecontroller]" ) {
+	ScratchDir scratch;
+	std::string net_dev = scratch.path("net_dev");
+	write_net_dev(net_dev, "halow0", 987654321);
+
+	uint64_t bytes;
+	REQUIRE(NetDevThroughputSource("halow0", net_dev).getSentBytes(&bytes));
+	REQUIRE(bytes == 987654321);
+	REQUIRE(!NetDevThroughputSource("halow", net_dev).getSentBytes(&bytes));
+	REQUIRE(!NetDevThroughputSource("halow0", "/nonexistent").getSentBytes(&bytes));
+}
+
+
+TEST_CASE( "Camera adapts the bitrate to the link, without changing its config", "[bitratecontroller][camera]" ) {
+	ScratchConfig scratch("tests/camera_properties.xml");
+	std::string net_dev = scratch.path("net_dev");
+	ScratchConfig::edit(scratch.properties, "</RTSPStream>", "<AdaptiveBitrate><Interface>halow0</Interface><Statistics>" + net_dev
+		+ "</Statistics><MinBitrate>200</MinBitrate></AdaptiveBitrate></RTSPStream>");
+
+	RtspServer::Readers readers = {1, 0};
+	bool set_bitrate_works = true;
+	fakeit::Mock<RtspServer> rtspServerMock;
+	fakeit::Fake(Method(rtspServerMock, initialise));
+	fakeit::Fake(Method(rtspServerMock, setVideoEncoderConfiguration));
+	fakeit::When(Method(rtspServerMock, supportsSetBitrate)).AlwaysReturn(true);
+	fakeit::When(Method(rtspServerMock, setBitrate)).AlwaysDo([&set_bitrate_works] (int) {
+		return set_bitrate_works;
+	});
+	fakeit::When(Method(rtspServerMock, getReaders)).AlwaysDo([&readers] (RtspServer::Readers *out) {
+		*out = readers;
+		return true;
+	});
+	Camera c("localhost", "localhost", scratch.properties, scratch.config, &(rtspServerMock.get()));
+	REQUIRE(c.hasAdaptiveBitrate());
+	REQUIRE(c.getAdaptiveBitrateInterval() == 2000);
+	REQUIRE(c.initialiseRtspServer());
+
+	write_net_dev(net_dev, "halow0", 1000000);
+	c.adaptBitrate();
+	// Whatever the timing, 8kbit is far short of 1000kbit/s.
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	write_net_dev(net_dev, "halow0", 1001000);
+
+	SECTION( "when someone's watching" ) {
+		c.adaptBitrate();
+		fakeit::Verify(Method(rtspServerMock, setBitrate).Using(200)).Once();
+		REQUIRE(c.getCurrentVideoEncoderConfiguration()->RateControl->BitrateLimit == 1000);
+
+		// And starts again from whatever's configured next.
+		auto *vec = c.getCurrentVideoEncoderConfiguration()->soap_dup();
+		vec->RateControl->BitrateLimit = 800;
+		REQUIRE(c.setVideoEncoderConfiguration(vec));
+		vec->soap_del();
+		delete vec;
+		write_net_dev(net_dev, "halow0", 1100000);
+		c.adaptBitrate();
+		fakeit::Verify(Method(rtspServerMock, setBitrate)).Once();
+	}
+
+	SECTION( "but not when nobody is" ) {
+		readers = {0, 0};
+		c.adaptBitrate();
+		fakeit::Verify(Method(rtspServerMock, setBitrate)).Never();
+	}
+
+	SECTION( "trying again next time if the RTSP server couldn't" ) {
+		set_bitrate_works = false;
+		c.adaptBitrate();
+		REQUIRE(c.hasAdaptiveBitrate());
+		set_bitrate_works = true;
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		write_net_dev(net_dev, "halow0", 1002000);
+		c.adaptBitrate();
+		fakeit::Verify(Method(rtspServerMock, setBitrate).Using(200)).Twice();
+	}
+}
+
+TEST_CASE( "Camera doesn't adapt the bitrate if the RTSP server can't change it", "[bitratecontroller][camera]" ) {
+	ScratchConfig scratch("tests/camera_properties.xml");
+	ScratchConfig::edit(scratch.properties, "</RTSPStream>", "<AdaptiveBitrate><Interface>halow0</Interface>"
+		"<MinBitrate>200</MinBitrate></AdaptiveBitrate></RTSPStream>");
+	fakeit::Mock<RtspServer> rtspServerMock;
+	fakeit::When(Method(rtspServerMock, supportsSetBitrate)).AlwaysReturn(false);
+	Camera c("localhost", "localhost", scratch.properties, scratch.config, &(rtspServerMock.get()));
+	REQUIRE(!c.hasAdaptiveBitrate());
+}
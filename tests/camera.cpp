@@ -33,4 +33,110 @@ TEST_CASE( "Fails with missing executable if t31rtspd or nvtrtspd type", "[camer
 	// whether it's an API or not.
 	REQUIRE_THROWS_AS(new Camera("http://localhost:8080", "localhost", "tests/camera_properties_nvtrtspd_noexec.xml", "tests/camera_configuration.xml"), InvalidConfigError);
 	REQUIRE_THROWS_AS(new Camera("http://localhost:8080", "localhost", "tests/camera_properties_t31rtspd_noexec.xml", "tests/camera_configuration.xml"), InvalidConfigError);
-}
\ No newline at end of file
+}
+
+TEST_CASE( "Changes wait until the RTSP server is initialised", "[camera]" ) {
+	fakeit::Mock<RtspServer> rtspServerMock;
+	fakeit::Fake(Method(rtspServerMock, setVideoEncoderConfiguration));
+	fakeit::When(Method(rtspServerMock, initialise))
+		.Throw(std::runtime_error("MediaMTX isn't up yet"))
+		.Do([] (const tt__VideoEncoderConfiguration *, const tt__H265Configuration *, const tt__ImagingSettings20 *, const tt__VideoSourceConfiguration *) {});
+	Camera c("http://localhost:8080", "localhost", "tests/camera_properties.xml", "tests/camera_configuration.xml", &(rtspServerMock.get()));
+
+	REQUIRE(!c.initialiseRtspServer());
+	REQUIRE(!c.isRtspReady());
+
+	// Saved, and picked up when the RTSP server is initialised.
+	auto *vec = c.getVideoEncoderConfiguration("video_encoder_configuration_token")->soap_dup();
+	vec->Resolution->Height = 999;
+	REQUIRE(c.setVideoEncoderConfiguration(vec));
+	fakeit::Verify(Method(rtspServerMock, setVideoEncoderConfiguration)).Never();
+
+	REQUIRE(c.initialiseRtspServer());
+	REQUIRE(c.isRtspReady());
+	REQUIRE(c.getCurrentVideoEncoderConfiguration()->Resolution->Height == 999);
+	fakeit::Verify(Method(rtspServerMock, initialise)).Exactly(2);
+
+	vec->soap_del();
+	delete vec;
+}
+
+
+TEST_CASE( "Camera suspends the encoder while nobody's watching", "[camera]" ) {
+	RtspServer::Readers readers = {0, 0};
+	bool resumes_itself = false;
+	fakeit::Mock<RtspServer> rtspServerMock;
+	fakeit::Fake(Method(rtspServerMock, initialise));
+	fakeit::When(Method(rtspServerMock, resume)).AlwaysReturn(true);
+	fakeit::When(Method(rtspServerMock, resumesItself)).AlwaysDo([&resumes_itself] { return resumes_itself; });
+	Camera c("http://localhost:8080", "localhost", "tests/camera_properties_idle.xml", "tests/camera_configuration.xml", &(rtspServerMock.get()));
+	REQUIRE(c.hasIdlePolicy());
+	REQUIRE(!c.getReaders(&readers));
+	REQUIRE(!c.monitorStream(readers));
+	REQUIRE(c.initialiseRtspServer());
+
+	SECTION( "and resumes it for the next viewer, without delay" ) {
+		REQUIRE(c.needsPromptMonitoring());
+		fakeit::When(Method(rtspServerMock, suspend)).AlwaysReturn(true);
+		REQUIRE(!c.monitorStream(readers));
+		fakeit::Verify(Method(rtspServerMock, suspend)).Once();
+
+		readers.unicast = 1;
+		REQUIRE(c.monitorStream(readers));
+		fakeit::Verify(Method(rtspServerMock, resume)).Once();
+	}
+
+	SECTION( "or lets the RTSP server, if it does that itself" ) {
+		resumes_itself = true;
+		REQUIRE(!c.needsPromptMonitoring());
+		fakeit::When(Method(rtspServerMock, suspend)).AlwaysReturn(true);
+		REQUIRE(!c.monitorStream(readers));
+
+		// Just the once, so the first frame is timed once.
+		readers.unicast = 1;
+		REQUIRE(c.monitorStream(readers));
+		REQUIRE(!c.monitorStream(readers));
+		fakeit::Verify(Method(rtspServerMock, resume)).Never();
+	}
+
+	SECTION( "unless the RTSP server can't" ) {
+		fakeit::When(Method(rtspServerMock, suspend)).AlwaysReturn(false);
+		REQUIRE(!c.monitorStream(readers));
+		REQUIRE(!c.monitorStream(readers));
+		fakeit::Verify(Method(rtspServerMock, suspend)).Once();
+	}
+}
+
+
+TEST_CASE( "Camera streams a configuration as H.265 if the RTSP server can", "[camera]" ) {
+	fakeit::Mock<RtspServer> rtspServerMock;
+	fakeit::Fake(Method(rtspServerMock, initialise));
+	fakeit::Fake(Method(rtspServerMock, setVideoEncoderConfiguration));
+	Camera c("http://localhost:8080", "localhost", "tests/camera_properties.xml", "tests/camera_configuration.xml", &(rtspServerMock.get()));
+	REQUIRE(c.initialiseRtspServer());
+	std::string token = c.getCurrentVideoEncoderConfiguration()->token;
+	tt__H265Configuration h265;
+	h265.H265Profile = tt__VideoEncodingProfiles::Main;
+
+	SECTION( "and back again" ) {
+		fakeit::When(Method(rtspServerMock, supportsH265)).AlwaysReturn(true);
+		REQUIRE(c.setH265Configuration(token, &h265));
+		REQUIRE(c.getH265Configuration(token)->token == token);
+		fakeit::Verify(Method(rtspServerMock, setVideoEncoderConfiguration).Matching([] (const tt__VideoEncoderConfiguration *, const tt__H265Configuration *h265) {
+			return h265 != nullptr && h265->H265Profile == tt__VideoEncodingProfiles::Main;
+		})).Once();
+
+		REQUIRE(c.setH265Configuration(token, nullptr));
+		REQUIRE(c.getH265Configuration(token) == nullptr);
+		fakeit::Verify(Method(rtspServerMock, setVideoEncoderConfiguration).Matching([] (const tt__VideoEncoderConfiguration *, const tt__H265Configuration *h265) {
+			return h265 == nullptr;
+		})).Once();
+	}
+
+	SECTION( "but not if it can't" ) {
+		fakeit::When(Method(rtspServerMock, supportsH265)).AlwaysReturn(false);
+		REQUIRE(!c.setH265Configuration(token, &h265));
+		REQUIRE(c.getH265Configuration(token) == nullptr);
+		fakeit::Verify(Method(rtspServerMock, setVideoEncoderConfiguration)).Never();
+	}
+}
@@ -0,0 +1,188 @@
+// Copyright 2023 Morse Micro
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <sys/stat.h>
+
+#include <fstream>
+
+#include "catch.hpp"
+#include "fakeit.hpp"
+#include "../camera.h"
+#include "../configjournal.h"
+#include "../soaplib/soapStub.h"
+#include "scratch.h"
+
+
+static off_t file_size(const std::string &path) {
+	struct stat st;
+	return stat(path.c_str(), &st) == 0 ? st.st_size : -1;
+}
+
+
+TEST_CASE( "Config journal records round trip, and torn ones are dropped", "[configjournal]" ) {
+	ConfigJournal::Record record = {ConfigJournal::Operation::SetImagingSettings, "video_source_token", "<tt:ImagingSettings/>"};
+	std::string encoded = ConfigJournal::encode(record);
+
+	ConfigJournal::Record decoded;
+	REQUIRE(ConfigJournal::decode(encoded.data(), encoded.size(), &decoded) == encoded.size());
+	REQUIRE(decoded.operation == record.operation);
+	REQUIRE(decoded.token == record.token);
+	REQUIRE(decoded.value == record.value);
+
+	REQUIRE(ConfigJournal::decode(encoded.data(), encoded.size() - 1, &decoded) == 0);
+	encoded[encoded.size() - 2] = 'X';
+	REQUIRE(ConfigJournal::decode(encoded.data(), encoded.size(), &decoded) == 0);
+
+	ScratchConfig scratch;
+	std::string journal_path = scratch.config + ".journal";
+	{
+		ConfigJournal journal(journal_path);
+		REQUIRE(journal.append(record));
+	}
+	off_t intact_size = file_size(journal_path);
+	std::ofstream(journal_path, std::ios::app | std::ios::binary) << ConfigJournal::encode(record).substr(0, 10);
+
+	ConfigJournal journal(journal_path);
+	bool interrupted;
+	REQUIRE(journal.replay(&interrupted).size() == 1);
+	REQUIRE(!interrupted);
+	REQUIRE(file_size(journal_path) == intact_size);
+
+	// And appends carry on after the intact ones.
+	REQUIRE(journal.append(record));
+	REQUIRE(ConfigJournal(journal_path).replay(&interrupted).size() == 2);
+
+	// It can have passwords in it.
+	struct stat st;
+	REQUIRE(stat(journal_path.c_str(), &st) == 0);
+	REQUIRE((st.st_mode & 0777) == 0600);
+}
+
+
+TEST_CASE( "Config journal replays an unfinished compaction first", "[configjournal]" ) {
+	ScratchConfig scratch;
+	std::string journal_path = scratch.config + ".journal";
+	ConfigJournal journal(journal_path);
+	REQUIRE(journal.append({ConfigJournal::Operation::SetCurrentProfile, "first", ""}));
+	REQUIRE(journal.rotate());
+	REQUIRE(journal.isCompacting());
+	REQUIRE(!journal.rotate());
+	REQUIRE(journal.append({ConfigJournal::Operation::SetCurrentProfile, "second", ""}));
+
+	bool interrupted;
+	auto records = ConfigJournal(journal_path).replay(&interrupted);
+	REQUIRE(interrupted);
+	REQUIRE(records.size() == 2);
+	REQUIRE(records[0].token == "first");
+	REQUIRE(records[1].token == "second");
+
+	journal.finishCompaction();
+	records = ConfigJournal(journal_path).replay(&interrupted);
+	REQUIRE(!interrupted);
+	REQUIRE(records.size() == 1);
+	REQUIRE(records[0].token == "second");
+}
+
+
+TEST_CASE( "Camera journals changes rather than rewriting its config", "[configjournal][camera]" ) {
+	ScratchConfig scratch;
+	std::string journal_path = scratch.config + ".journal";
+	std::string original_config = ScratchConfig::read(scratch.config);
+	fakeit::Mock<RtspServer> rtspServerMock;
+	{
+		Camera c("http://localhost:8080", "localhost", scratch.properties, scratch.config, &(rtspServerMock.get()));
+		auto *vec = c.getVideoEncoderConfiguration("video_encoder_configuration_token")->soap_dup();
+		vec->Quality = 3;
+		REQUIRE(c.setVideoEncoderConfiguration(vec));
+		vec->soap_del();
+		delete vec;
+		c.setConfigurableScopes({"onvif://www.onvif.org/name/Journalled"});
+		tt__MinimumProfile profile;
+		profile.Name = "Substream";
+		profile.ProfileToken = "sub";
+		REQUIRE(c.setProfile(&profile));
+	}
+	REQUIRE(ScratchConfig::read(scratch.config) == original_config);
+	REQUIRE(file_size(journal_path) > 0);
+
+	Camera c("http://localhost:8080", "localhost", scratch.properties, scratch.config, &(rtspServerMock.get()));
+	REQUIRE(c.getCurrentVideoEncoderConfiguration()->Quality == 3);
+	REQUIRE(c.getConfigurableScopes() == std::vector<std::string>{"onvif://www.onvif.org/name/Journalled"});
+	REQUIRE(c.getMinimumProfiles().size() == 2);
+
+	SECTION( "until it's saved" ) {
+		c.saveConfiguration();
+		REQUIRE(file_size(journal_path) == 0);
+		REQUIRE(ScratchConfig::read(scratch.config) != original_config);
+		Camera saved("http://localhost:8080", "localhost", scratch.properties, scratch.config, &(rtspServerMock.get()));
+		REQUIRE(saved.getCurrentVideoEncoderConfiguration()->Quality == 3);
+	}
+
+	SECTION( "or has grown enough to compact" ) {
+		auto *vec = c.getVideoEncoderConfiguration("video_encoder_configuration_token")->soap_dup();
+		bool rotated = false;
+		for (int i = 0; !rotated && i < 1000; ++i) {
+			off_t before = file_size(journal_path);
+			vec->Quality = i % 5;
+			REQUIRE(c.setVideoEncoderConfiguration(vec));
+			rotated = file_size(journal_path) < before;
+		}
+		vec->soap_del();
+		delete vec;
+		REQUIRE(rotated);
+
+		// Waits for the compaction.
+		c.saveConfiguration();
+		REQUIRE(file_size(journal_path + ".compacting") == -1);
+		REQUIRE(ScratchConfig::read(scratch.config) != original_config);
+	}
+}
+
+
+TEST_CASE( "Camera journals a configuration's switch to H.265, and back", "[configjournal][camera]" ) {
+	ScratchConfig scratch;
+	fakeit::Mock<RtspServer> rtspServerMock;
+	fakeit::When(Method(rtspServerMock, supportsH265)).AlwaysReturn(true);
+	tt__H265Configuration h265;
+	h265.H265Profile = tt__VideoEncodingProfiles::Main;
+	{
+		Camera c("http://localhost:8080", "localhost", scratch.properties, scratch.config, &(rtspServerMock.get()));
+		REQUIRE(c.setH265Configuration("video_encoder_configuration_token", &h265));
+		REQUIRE(!c.setH265Configuration("no_such_token", &h265));
+	}
+	{
+		Camera c("http://localhost:8080", "localhost", scratch.properties, scratch.config, &(rtspServerMock.get()));
+		auto *replayed = c.getH265Configuration("video_encoder_configuration_token");
+		REQUIRE(replayed != nullptr);
+		REQUIRE(replayed->H265Profile == tt__VideoEncodingProfiles::Main);
+		REQUIRE(c.setH265Configuration("video_encoder_configuration_token", nullptr));
+	}
+	Camera c("http://localhost:8080", "localhost", scratch.properties, scratch.config, &(rtspServerMock.get()));
+	REQUIRE(c.getH265Configuration("video_encoder_configuration_token") == nullptr);
+}
+
+
+TEST_CASE( "Camera journals a Media2 encoder change as one record", "[configjournal][camera]" ) {
+	ScratchConfig scratch;
+	std::string journal_path = scratch.config + ".journal";
+	fakeit::Mock<RtspServer> rtspServerMock;
+	fakeit::When(Method(rtspServerMock, supportsH265)).AlwaysReturn(true);
+	tt__H265Configuration h265;
+	h265.H265Profile = tt__VideoEncodingProfiles::Main;
+	{
+		Camera c("http://localhost:8080", "localhost", scratch.properties, scratch.config, &(rtspServerMock.get()));
+		auto *vec = c.getVideoEncoderConfiguration("video_encoder_configuration_token")->soap_dup();
+		vec->Quality = 3;
+		REQUIRE(c.setVideoEncoder(vec, &h265));
+		vec->token = "no_such_token";
+		REQUIRE(!c.setVideoEncoder(vec, &h265));
+		vec->soap_del();
+		delete vec;
+	}
+	bool interrupted;
+	REQUIRE(ConfigJournal(journal_path).replay(&interrupted).size() == 1);
+
+	Camera c("http://localhost:8080", "localhost", scratch.properties, scratch.config, &(rtspServerMock.get()));
+	REQUIRE(c.getVideoEncoderConfiguration("video_encoder_configuration_token")->Quality == 3);
+	REQUIRE(c.getH265Configuration("video_encoder_configuration_token") != nullptr);
+}
@@ -0,0 +1,56 @@
+// Copyright 2023 Morse Micro
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include "catch.hpp"
+#include "fakeit.hpp"
+#include "../camera.h"
+#include "../configvalidator.h"
+#include "../soaplib/soapStub.h"
+
+
+TEST_CASE( "Config validator checks changes against the Options", "[configvalidator]" ) {
+	fakeit::Mock<RtspServer> rtspServerMock;
+	Camera c("localhost", "localhost", "tests/camera_properties.xml", "tests/camera_configuration.xml", &(rtspServerMock.get()));
+	const ConfigValidator &validator = c.getValidator();
+
+	SECTION( "video encoder" ) {
+		auto *current = c.getVideoEncoderConfiguration("video_encoder_configuration_token");
+		auto *vec = current->soap_dup();
+		REQUIRE(validator.check(vec, current) == "");
+
+		vec->Quality = 0;
+		REQUIRE(validator.check(vec, current) == "");
+		vec->Quality = 2;
+		REQUIRE(validator.check(vec, current) != "");
+		vec->Quality = current->Quality;
+
+		vec->Resolution->Width = 999;
+		REQUIRE(validator.check(vec, current) != "");
+		// Even when it's new, there's nothing to compare it to.
+		REQUIRE(validator.check(vec, nullptr) != "");
+
+		vec->soap_del();
+		delete vec;
+	}
+
+	SECTION( "H.265" ) {
+		tt__H265Configuration h265;
+		h265.token = "video_encoder_configuration_token";
+		h265.H265Profile = tt__VideoEncodingProfiles::Main;
+		REQUIRE(validator.check(&h265, nullptr) == "");
+		h265.H265Profile = tt__VideoEncodingProfiles::Main10;
+		REQUIRE(validator.check(&h265, nullptr) != "");
+	}
+
+	SECTION( "imaging" ) {
+		auto *current = c.getImagingSettings("video_source_token");
+		auto *imaging_settings = current->soap_dup();
+		*(imaging_settings->Brightness) = 1.0;
+		REQUIRE(validator.check("video_source_token", imaging_settings, current) == "");
+		*(imaging_settings->Brightness) = 2.0;
+		REQUIRE(validator.check("video_source_token", imaging_settings, current) != "");
+
+		imaging_settings->soap_del();
+		delete imaging_settings;
+	}
+}
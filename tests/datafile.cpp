@@ -0,0 +1,28 @@
+// Copyright 2023 Morse Micro
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include "catch.hpp"
+#include "fakeit.hpp"
+#include "../camera.h"
+#include "../datafile.h"
+#include "../soaplib/soapStub.h"
+
+
+TEST_CASE( "Config values compare and hash by content", "[datafile]" ) {
+	fakeit::Mock<RtspServer> rtspServerMock;
+	Camera c("http://localhost:8080", "localhost", "tests/camera_properties.xml", "tests/camera_configuration.xml", &(rtspServerMock.get()));
+	auto *stored = c.getVideoEncoderConfiguration("video_encoder_configuration_token");
+	auto *copy = stored->soap_dup();
+
+	REQUIRE(deep_equal<tt__VideoEncoderConfiguration>(stored, copy));
+	REQUIRE(deep_hash<tt__VideoEncoderConfiguration>(stored) == deep_hash<tt__VideoEncoderConfiguration>(copy));
+	REQUIRE(!deep_equal<tt__VideoEncoderConfiguration>(stored, nullptr));
+	REQUIRE(deep_equal<tt__VideoEncoderConfiguration>(nullptr, nullptr));
+
+	copy->Resolution->Height += 1;
+	REQUIRE(!deep_equal<tt__VideoEncoderConfiguration>(stored, copy));
+	REQUIRE(deep_hash<tt__VideoEncoderConfiguration>(stored) != deep_hash<tt__VideoEncoderConfiguration>(copy));
+
+	copy->soap_del();
+	delete copy;
+}
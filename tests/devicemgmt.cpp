@@ -40,12 +40,24 @@ TEST_CASE( "GetServices returns correct info", "[devicemgmt]" ) {
 	REQUIRE(__tds__GetServices(soap, req, *resp) == SOAP_OK);
 	// We rely on returning these in a particular order. Not a valid
 	// test, but also easy to fix if we break.
+	REQUIRE(!resp->Service.empty());
+	tds__Service *events_service = resp->Service.back();
+	REQUIRE(events_service->Namespace == SOAP_NAMESPACE_OF_tev);
+	REQUIRE(events_service->XAddr == "http://localhost:8080");
+	resp->Service.pop_back();
+
 	REQUIRE(!resp->Service.empty());
 	tds__Service *imaging_service = resp->Service.back();
 	REQUIRE(imaging_service->Namespace == SOAP_NAMESPACE_OF_timg);
 	REQUIRE(imaging_service->XAddr == "http://localhost:8080");
 	resp->Service.pop_back();
 
+	REQUIRE(!resp->Service.empty());
+	tds__Service *media2_service = resp->Service.back();
+	REQUIRE(media2_service->Namespace == SOAP_NAMESPACE_OF_tr2);
+	REQUIRE(media2_service->XAddr == "http://localhost:8080");
+	resp->Service.pop_back();
+
 	REQUIRE(!resp->Service.empty());
 	tds__Service *media_service = resp->Service.back();
 	REQUIRE(media_service->Namespace == SOAP_NAMESPACE_OF_trt);
@@ -78,4 +90,214 @@ TEST_CASE( "GetHostname returns correct info", "[devicemgmt]" ) {
 	soap_destroy(soap);
 	soap_end(soap);
 	soap_free(soap);
-}
\ No newline at end of file
+}
+
+TEST_CASE( "GetScopes returns fixed and configurable scopes", "[devicemgmt]" ) {
+	fakeit::Mock<RtspServer> rtspServerMock;
+	Camera c("http://localhost:8080", "localhost", "tests/camera_properties.xml", "tests/camera_configuration.xml", &(rtspServerMock.get()));
+
+	auto soap = soap_new1(SOAP_XML_STRICT|SOAP_XML_INDENT);
+	soap->user = &c;
+	auto *req = soap_new__tds__GetScopes(soap);
+	auto *resp = soap_new__tds__GetScopesResponse(soap);
+
+	REQUIRE(__tds__GetScopes(soap, req, *resp) == SOAP_OK);
+	REQUIRE(resp->Scopes.size() == 3);
+	REQUIRE(resp->Scopes[0]->ScopeDef == tt__ScopeDefinition::Fixed);
+	REQUIRE(resp->Scopes[0]->ScopeItem == "onvif://www.onvif.org/type/video_encoder");
+	REQUIRE(resp->Scopes[1]->ScopeDef == tt__ScopeDefinition::Fixed);
+	REQUIRE(resp->Scopes[1]->ScopeItem == "onvif://www.onvif.org/hardware/RD02");
+	REQUIRE(resp->Scopes[2]->ScopeDef == tt__ScopeDefinition::Configurable);
+	REQUIRE(resp->Scopes[2]->ScopeItem == "onvif://www.onvif.org/name/Test");
+
+	soap_destroy(soap);
+	soap_end(soap);
+	soap_free(soap);
+}
+
+TEST_CASE( "Set/Add/RemoveScopes change the configurable scopes", "[devicemgmt]" ) {
+	fakeit::Mock<RtspServer> rtspServerMock;
+	Camera c("http://localhost:8080", "localhost", "tests/camera_properties.xml", "tests/camera_configuration.xml", &(rtspServerMock.get()));
+	unsigned int version = c.getDiscoveryVersion();
+
+	auto soap = soap_new1(SOAP_XML_STRICT|SOAP_XML_INDENT);
+	soap->user = &c;
+
+	auto *add_req = soap_new__tds__AddScopes(soap);
+	auto *add_resp = soap_new__tds__AddScopesResponse(soap);
+	add_req->ScopeItem = {"onvif://www.onvif.org/location/lab", "onvif://www.onvif.org/name/Test"};
+	REQUIRE(__tds__AddScopes(soap, add_req, *add_resp) == SOAP_OK);
+	REQUIRE(c.getConfigurableScopes() == std::vector<std::string>{"onvif://www.onvif.org/name/Test", "onvif://www.onvif.org/location/lab"});
+	REQUIRE(c.getDiscoveryVersion() > version);
+
+	auto *remove_req = soap_new__tds__RemoveScopes(soap);
+	auto *remove_resp = soap_new__tds__RemoveScopesResponse(soap);
+	remove_req->ScopeItem = {"onvif://www.onvif.org/name/Test"};
+	REQUIRE(__tds__RemoveScopes(soap, remove_req, *remove_resp) == SOAP_OK);
+	REQUIRE(c.getConfigurableScopes() == std::vector<std::string>{"onvif://www.onvif.org/location/lab"});
+	REQUIRE(remove_resp->ScopeItem == remove_req->ScopeItem);
+
+	auto *set_req = soap_new__tds__SetScopes(soap);
+	auto *set_resp = soap_new__tds__SetScopesResponse(soap);
+	set_req->Scopes = {"onvif://www.onvif.org/name/Other"};
+	REQUIRE(__tds__SetScopes(soap, set_req, *set_resp) == SOAP_OK);
+	REQUIRE(c.getConfigurableScopes() == std::vector<std::string>{"onvif://www.onvif.org/name/Other"});
+
+	soap_destroy(soap);
+	soap_end(soap);
+	soap_free(soap);
+}
+
+TEST_CASE( "Fixed scopes can't be changed", "[devicemgmt]" ) {
+	fakeit::Mock<RtspServer> rtspServerMock;
+	Camera c("http://localhost:8080", "localhost", "tests/camera_properties.xml", "tests/camera_configuration.xml", &(rtspServerMock.get()));
+
+	auto soap = soap_new1(SOAP_XML_STRICT|SOAP_XML_INDENT);
+	soap->user = &c;
+
+	auto *remove_req = soap_new__tds__RemoveScopes(soap);
+	auto *remove_resp = soap_new__tds__RemoveScopesResponse(soap);
+	remove_req->ScopeItem = {"onvif://www.onvif.org/name/Test", "onvif://www.onvif.org/type/video_encoder"};
+	REQUIRE(__tds__RemoveScopes(soap, remove_req, *remove_resp) == SOAP_FAULT);
+	REQUIRE(std::string(*soap_faultsubcode(soap)) == "ter:OperationProhibited");
+	remove_req->ScopeItem = {"onvif://www.onvif.org/name/Test", "onvif://www.onvif.org/name/Missing"};
+	REQUIRE(__tds__RemoveScopes(soap, remove_req, *remove_resp) == SOAP_FAULT);
+	REQUIRE(std::string(*soap_faultsubcode(soap)) == "ter:InvalidArgVal");
+
+	auto *set_req = soap_new__tds__SetScopes(soap);
+	auto *set_resp = soap_new__tds__SetScopesResponse(soap);
+	set_req->Scopes = {"onvif://www.onvif.org/hardware/RD02"};
+	REQUIRE(__tds__SetScopes(soap, set_req, *set_resp) == SOAP_FAULT);
+	REQUIRE(std::string(*soap_faultsubcode(soap)) == "ter:OperationProhibited");
+
+	auto *add_req = soap_new__tds__AddScopes(soap);
+	auto *add_resp = soap_new__tds__AddScopesResponse(soap);
+	add_req->ScopeItem = {"not a uri"};
+	REQUIRE(__tds__AddScopes(soap, add_req, *add_resp) == SOAP_FAULT);
+	REQUIRE(std::string(*soap_faultsubcode(soap)) == "ter:InvalidArgs");
+
+	// Each one's in every ProbeMatches.
+	add_req->ScopeItem.clear();
+	for (int i = 0; i < 16; ++i) {
+		add_req->ScopeItem.push_back("onvif://www.onvif.org/location/room" + std::to_string(i));
+	}
+	REQUIRE(__tds__AddScopes(soap, add_req, *add_resp) == SOAP_FAULT);
+	REQUIRE(std::string(*soap_faultsubcode(soap)) == "ter:InvalidArgVal");
+
+	REQUIRE(c.getConfigurableScopes() == std::vector<std::string>{"onvif://www.onvif.org/name/Test"});
+
+	soap_destroy(soap);
+	soap_end(soap);
+	soap_free(soap);
+}
+
+static tt__User *new_user(struct soap *soap, const std::string &username, const std::string &password, tt__UserLevel level) {
+	auto *user = soap_new_tt__User(soap);
+	user->Username = username;
+	if (!password.empty()) {
+		user->Password = soap_new_std__string(soap);
+		*user->Password = password;
+	}
+	user->UserLevel = level;
+	return user;
+}
+
+TEST_CASE( "Users can be created, changed and deleted", "[devicemgmt]" ) {
+	fakeit::Mock<RtspServer> rtspServerMock;
+	Camera c("http://localhost:8080", "localhost", "tests/camera_properties.xml", "tests/camera_configuration.xml", &(rtspServerMock.get()));
+	REQUIRE(!c.getAuthenticator().hasUsers());
+
+	auto soap = soap_new1(SOAP_XML_STRICT|SOAP_XML_INDENT);
+	soap->user = &c;
+
+	auto *create_req = soap_new__tds__CreateUsers(soap);
+	auto *create_resp = soap_new__tds__CreateUsersResponse(soap);
+	create_req->User = {new_user(soap, "admin", "secret", tt__UserLevel::Administrator), new_user(soap, "viewer", "password", tt__UserLevel::User)};
+	REQUIRE(__tds__CreateUsers(soap, create_req, *create_resp) == SOAP_OK);
+	REQUIRE(c.getAuthenticator().hasUsers());
+
+	auto *get_req = soap_new__tds__GetUsers(soap);
+	auto *get_resp = soap_new__tds__GetUsersResponse(soap);
+	REQUIRE(__tds__GetUsers(soap, get_req, *get_resp) == SOAP_OK);
+	REQUIRE(get_resp->User.size() == 2);
+	REQUIRE(get_resp->User[0]->Username == "admin");
+	REQUIRE(get_resp->User[0]->UserLevel == tt__UserLevel::Administrator);
+	REQUIRE(get_resp->User[0]->Password == nullptr);
+	REQUIRE(get_resp->User[1]->Username == "viewer");
+
+	// Without a password, they keep theirs.
+	auto *set_req = soap_new__tds__SetUser(soap);
+	auto *set_resp = soap_new__tds__SetUserResponse(soap);
+	set_req->User = {new_user(soap, "viewer", "", tt__UserLevel::Operator)};
+	REQUIRE(__tds__SetUser(soap, set_req, *set_resp) == SOAP_OK);
+	REQUIRE(c.getUser("viewer")->UserLevel == tt__UserLevel::Operator);
+	REQUIRE(*c.getUser("viewer")->Password == "password");
+
+	auto *delete_req = soap_new__tds__DeleteUsers(soap);
+	auto *delete_resp = soap_new__tds__DeleteUsersResponse(soap);
+	delete_req->Username = {"viewer", "admin"};
+	REQUIRE(__tds__DeleteUsers(soap, delete_req, *delete_resp) == SOAP_OK);
+	REQUIRE(c.getUsers().empty());
+	REQUIRE(!c.getAuthenticator().hasUsers());
+
+	soap_destroy(soap);
+	soap_end(soap);
+	soap_free(soap);
+}
+
+TEST_CASE( "Invalid user changes are refused, all or nothing", "[devicemgmt]" ) {
+	fakeit::Mock<RtspServer> rtspServerMock;
+	Camera c("http://localhost:8080", "localhost", "tests/camera_properties.xml", "tests/camera_configuration.xml", &(rtspServerMock.get()));
+
+	auto soap = soap_new1(SOAP_XML_STRICT|SOAP_XML_INDENT);
+	soap->user = &c;
+
+	auto *create_req = soap_new__tds__CreateUsers(soap);
+	auto *create_resp = soap_new__tds__CreateUsersResponse(soap);
+	create_req->User = {new_user(soap, "admin", "secret", tt__UserLevel::Administrator)};
+	REQUIRE(__tds__CreateUsers(soap, create_req, *create_resp) == SOAP_OK);
+
+	SECTION( "CreateUsers" ) {
+		create_req->User = {new_user(soap, "operator", "secret", tt__UserLevel::Operator), new_user(soap, "admin", "other", tt__UserLevel::User)};
+		REQUIRE(__tds__CreateUsers(soap, create_req, *create_resp) != SOAP_OK);
+		REQUIRE(std::string(*soap_faultsubcode(soap)) == "ter:OperationProhibited");
+
+		create_req->User = {new_user(soap, "operator", "", tt__UserLevel::Operator)};
+		REQUIRE(__tds__CreateUsers(soap, create_req, *create_resp) != SOAP_OK);
+		create_req->User = {new_user(soap, "guest", "secret", tt__UserLevel::Anonymous)};
+		REQUIRE(__tds__CreateUsers(soap, create_req, *create_resp) != SOAP_OK);
+		create_req->User = {new_user(soap, std::string(33, 'a'), "secret", tt__UserLevel::User)};
+		REQUIRE(__tds__CreateUsers(soap, create_req, *create_resp) != SOAP_OK);
+		create_req->User = {new_user(soap, "operator", std::string(65, 'a'), tt__UserLevel::Operator)};
+		REQUIRE(__tds__CreateUsers(soap, create_req, *create_resp) != SOAP_OK);
+
+		create_req->User.clear();
+		for (int i = 0; i < 16; ++i) {
+			create_req->User.push_back(new_user(soap, "user" + std::to_string(i), "secret", tt__UserLevel::User));
+		}
+		REQUIRE(__tds__CreateUsers(soap, create_req, *create_resp) != SOAP_OK);
+		REQUIRE(std::string(*soap_faultsubcode(soap)) == "ter:Action");
+	}
+
+	SECTION( "SetUser and DeleteUsers" ) {
+		auto *set_req = soap_new__tds__SetUser(soap);
+		auto *set_resp = soap_new__tds__SetUserResponse(soap);
+		set_req->User = {new_user(soap, "nobody", "secret", tt__UserLevel::User)};
+		REQUIRE(__tds__SetUser(soap, set_req, *set_resp) != SOAP_OK);
+		REQUIRE(std::string(*soap_faultsubcode(soap)) == "ter:InvalidArgVal");
+
+		auto *delete_req = soap_new__tds__DeleteUsers(soap);
+		auto *delete_resp = soap_new__tds__DeleteUsersResponse(soap);
+		delete_req->Username = {"admin", "nobody"};
+		REQUIRE(__tds__DeleteUsers(soap, delete_req, *delete_resp) != SOAP_OK);
+		REQUIRE(std::string(*soap_faultsubcode(soap)) == "ter:InvalidArgVal");
+	}
+
+	REQUIRE(c.getUsers().size() == 1);
+	REQUIRE(c.getUser("admin")->UserLevel == tt__UserLevel::Administrator);
+	REQUIRE(*c.getUser("admin")->Password == "secret");
+
+	soap_destroy(soap);
+	soap_end(soap);
+	soap_free(soap);
+}
@@ -0,0 +1,168 @@
+// Copyright 2023 Morse Micro
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <sstream>
+#include <string>
+
+#include "catch.hpp"
+#include "../probematches.h"
+#include "../soaplib/wsddapi.h"
+
+
+static const char *XADDRS = "http://192.168.1.2:8000/onvif/device_service";
+
+
+static ProbeMatchesTemplate make_template() {
+	return ProbeMatchesTemplate("urn:uuid:endpoint", "tdn:NetworkVideoTransmitter",
+	                            "onvif://www.onvif.org/type/video_encoder", XADDRS, 3, 42, "urn:uuid:sequence");
+}
+
+
+TEST_CASE( "ProbeMatches template renders a message gsoap can read", "[discovery]" ) {
+	ProbeMatchesTemplate probe_matches = make_template();
+	std::string datagram;
+	probe_matches.render(&datagram, "urn:uuid:reply", "urn:uuid:<probe>&", 7);
+
+	struct soap *soap = soap_new();
+	std::istringstream in(datagram);
+	soap->is = &in;
+	struct __wsdd__ProbeMatches message;
+	REQUIRE(soap_recv___wsdd__ProbeMatches(soap, &message) == SOAP_OK);
+
+	REQUIRE(soap->header != NULL);
+	REQUIRE(std::string(soap->header->wsa5__MessageID) == "urn:uuid:reply");
+	REQUIRE(std::string(soap->header->wsa5__RelatesTo->__item) == "urn:uuid:<probe>&");
+	REQUIRE(soap->header->wsdd__AppSequence->InstanceId == 42);
+	REQUIRE(std::string(soap->header->wsdd__AppSequence->SequenceId) == "urn:uuid:sequence");
+	REQUIRE(soap->header->wsdd__AppSequence->MessageNumber == 7);
+
+	REQUIRE(message.wsdd__ProbeMatches->__sizeProbeMatch == 1);
+	auto &match = message.wsdd__ProbeMatches->ProbeMatch[0];
+	REQUIRE(std::string(match.wsa5__EndpointReference.Address) == "urn:uuid:endpoint");
+	REQUIRE(std::string(match.Types) == "tdn:NetworkVideoTransmitter");
+	REQUIRE(std::string(match.XAddrs) == XADDRS);
+	REQUIRE(match.MetadataVersion == 3);
+
+	soap_destroy(soap);
+	soap_end(soap);
+	soap_free(soap);
+}
+
+
+TEST_CASE( "ProbeMatches template can be re-rendered", "[discovery]" ) {
+	ProbeMatchesTemplate probe_matches = make_template();
+	std::string first, second;
+	probe_matches.render(&first, "urn:uuid:a", "urn:uuid:b", 1);
+	probe_matches.render(&second, "urn:uuid:a", "urn:uuid:b", 1);
+	REQUIRE(first == second);
+
+	probe_matches.render(&second, "urn:uuid:a", "urn:uuid:b", 1000000);
+	REQUIRE(second.size() == first.size() + 6);
+	REQUIRE(probe_matches.getXAddrs() == XADDRS);
+}
+
+
+TEST_CASE( "ProbeMatches template doesn't mind scopes that look like its placeholders", "[discovery]" ) {
+	// Clients can set whatever scopes they like.
+	ProbeMatchesTemplate probe_matches("urn:uuid:endpoint", "tdn:NetworkVideoTransmitter",
+	                                   "onvif://www.onvif.org/name/3735928559 onvif://www.onvif.org/name/urn:uuid:@@MessageID@@",
+	                                   XADDRS, 3, 42, "urn:uuid:sequence");
+	std::string datagram;
+	probe_matches.render(&datagram, "urn:uuid:reply", "urn:uuid:probe", 7);
+
+	struct soap *soap = soap_new();
+	std::istringstream in(datagram);
+	soap->is = &in;
+	struct __wsdd__ProbeMatches message;
+	REQUIRE(soap_recv___wsdd__ProbeMatches(soap, &message) == SOAP_OK);
+	REQUIRE(std::string(soap->header->wsa5__MessageID) == "urn:uuid:reply");
+	REQUIRE(soap->header->wsdd__AppSequence->MessageNumber == 7);
+	REQUIRE(std::string(message.wsdd__ProbeMatches->ProbeMatch[0].Scopes->__item)
+		== "onvif://www.onvif.org/name/3735928559 onvif://www.onvif.org/name/urn:uuid:@@MessageID@@");
+
+	soap_destroy(soap);
+	soap_end(soap);
+	soap_free(soap);
+}
+
+
+TEST_CASE( "Hello is a message gsoap can read", "[discovery]" ) {
+	std::string datagram = serialise_hello("urn:uuid:endpoint", "tdn:NetworkVideoTransmitter",
+	                                       "onvif://www.onvif.org/type/video_encoder", XADDRS, 3,
+	                                       "urn:uuid:hello", NULL, 42, "urn:uuid:sequence", 9);
+
+	struct soap *soap = soap_new();
+	std::istringstream in(datagram);
+	soap->is = &in;
+	struct __wsdd__Hello message;
+	REQUIRE(soap_recv___wsdd__Hello(soap, &message) == SOAP_OK);
+
+	REQUIRE(std::string(soap->header->wsa5__MessageID) == "urn:uuid:hello");
+	REQUIRE(std::string(soap->header->wsa5__To) == "urn:schemas-xmlsoap-org:ws:2005:04:discovery");
+	REQUIRE(soap->header->wsdd__AppSequence->InstanceId == 42);
+	REQUIRE(soap->header->wsdd__AppSequence->MessageNumber == 9);
+	REQUIRE(std::string(message.wsdd__Hello->wsa5__EndpointReference.Address) == "urn:uuid:endpoint");
+	REQUIRE(std::string(message.wsdd__Hello->XAddrs) == XADDRS);
+	REQUIRE(message.wsdd__Hello->MetadataVersion == 3);
+
+	soap_destroy(soap);
+	soap_end(soap);
+	soap_free(soap);
+}
+
+
+TEST_CASE( "Bye is a message gsoap can read", "[discovery]" ) {
+	std::string datagram = serialise_bye("urn:uuid:endpoint", "tdn:NetworkVideoTransmitter", NULL, XADDRS, 3,
+	                                     "urn:uuid:bye", 42, "urn:uuid:sequence", 10);
+
+	struct soap *soap = soap_new();
+	std::istringstream in(datagram);
+	soap->is = &in;
+	struct __wsdd__Bye message;
+	REQUIRE(soap_recv___wsdd__Bye(soap, &message) == SOAP_OK);
+
+	REQUIRE(std::string(soap->header->wsa5__MessageID) == "urn:uuid:bye");
+	REQUIRE(soap->header->wsdd__AppSequence->MessageNumber == 10);
+	REQUIRE(std::string(message.wsdd__Bye->wsa5__EndpointReference.Address) == "urn:uuid:endpoint");
+	REQUIRE(message.wsdd__Bye->Scopes == NULL);
+	REQUIRE(*message.wsdd__Bye->MetadataVersion == 3);
+
+	soap_destroy(soap);
+	soap_end(soap);
+	soap_free(soap);
+}
+
+
+TEST_CASE( "Probe is a message gsoap can read", "[discovery]" ) {
+	std::string datagram = serialise_probe("tdn:NetworkVideoTransmitter", "urn:uuid:probe");
+
+	struct soap *soap = soap_new();
+	std::istringstream in(datagram);
+	soap->is = &in;
+	struct __wsdd__Probe message;
+	REQUIRE(soap_recv___wsdd__Probe(soap, &message) == SOAP_OK);
+
+	REQUIRE(std::string(soap->header->wsa5__MessageID) == "urn:uuid:probe");
+	REQUIRE(std::string(message.wsdd__Probe->Types) == "tdn:NetworkVideoTransmitter");
+	REQUIRE(message.wsdd__Probe->Scopes == NULL);
+
+	soap_destroy(soap);
+	soap_end(soap);
+	soap_free(soap);
+}
+
+
+// Run with: ./test-runner "[benchmark]"
+TEST_CASE( "ProbeMatches: template vs gsoap", "[.][benchmark]" ) {
+	ProbeMatchesTemplate probe_matches = make_template();
+	std::string datagram;
+
+	BENCHMARK("template") {
+		probe_matches.render(&datagram, "urn:uuid:reply", "urn:uuid:probe", 7);
+		return datagram.size();
+	};
+
+	BENCHMARK("gsoap, whole envelope") {
+		return make_template().getXAddrs().size();
+	};
+}
@@ -0,0 +1,71 @@
+// Copyright 2023 Morse Micro
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include "catch.hpp"
+#include "../discoveryproxy.h"
+#include "../soaplib/stdsoap2.h"
+
+
+static DiscoveryProxyTable::Announcement camera(const std::string &name, unsigned int instance_id, unsigned int message_number) {
+	return {"urn:uuid:" + name, "tdn:NetworkVideoTransmitter tds:Device",
+	        "onvif://www.onvif.org/type/video_encoder onvif://www.onvif.org/name/" + name,
+	        "http://" + name + "/onvif/device_service", 1, instance_id, "urn:uuid:sequence", message_number};
+}
+
+
+TEST_CASE( "Proxy answers probes from what it has heard", "[discoveryproxy]" ) {
+	DiscoveryProxyTable table(10, namespaces);
+	REQUIRE(table.hello(camera("a", 1, 1)));
+	REQUIRE(table.hello(camera("b", 1, 1)));
+
+	REQUIRE(table.probe(nullptr, nullptr, nullptr).size() == 2);
+	REQUIRE(table.probe("tdn:NetworkVideoTransmitter", nullptr, nullptr).size() == 2);
+	REQUIRE(table.probe("tdn:Printer", nullptr, nullptr).empty());
+
+	auto matches = table.probe(nullptr, "onvif://www.onvif.org/name/b", nullptr);
+	REQUIRE(matches.size() == 1);
+	REQUIRE(matches[0].endpoint_reference == "urn:uuid:b");
+	REQUIRE(matches[0].xaddrs == "http://b/onvif/device_service");
+
+	DiscoveryProxyTable::Announcement found;
+	REQUIRE(table.resolve("urn:uuid:a", &found));
+	REQUIRE(found.scopes == "onvif://www.onvif.org/type/video_encoder onvif://www.onvif.org/name/a");
+	REQUIRE(!table.resolve("urn:uuid:c", &found));
+}
+
+
+TEST_CASE( "Proxy ignores stale announcements", "[discoveryproxy]" ) {
+	DiscoveryProxyTable table(10, namespaces);
+	REQUIRE(table.hello(camera("a", 2, 5)));
+
+	auto old = camera("a", 2, 4);
+	old.xaddrs = "http://old";
+	REQUIRE(!table.hello(old));
+	REQUIRE(!table.hello(camera("a", 1, 10)));  // Before a restart.
+	REQUIRE(!table.bye("urn:uuid:a", 2, "urn:uuid:sequence", 3));
+
+	DiscoveryProxyTable::Announcement found;
+	REQUIRE(table.resolve("urn:uuid:a", &found));
+	REQUIRE(found.xaddrs == "http://a/onvif/device_service");
+
+	// A restart, and then leaving.
+	REQUIRE(table.hello(camera("a", 3, 1)));
+	REQUIRE(table.bye("urn:uuid:a", 3, "urn:uuid:sequence", 2));
+	REQUIRE(table.size() == 0);
+	REQUIRE(!table.bye("urn:uuid:a", 3, "urn:uuid:sequence", 3));
+}
+
+
+TEST_CASE( "Proxy drops the least recently announced when full", "[discoveryproxy]" ) {
+	DiscoveryProxyTable table(2, namespaces);
+	table.hello(camera("a", 1, 1));
+	table.hello(camera("b", 1, 1));
+	table.hello(camera("a", 1, 2));
+	table.hello(camera("c", 1, 1));
+
+	DiscoveryProxyTable::Announcement found;
+	REQUIRE(table.size() == 2);
+	REQUIRE(table.resolve("urn:uuid:a", &found));
+	REQUIRE(!table.resolve("urn:uuid:b", &found));
+	REQUIRE(table.resolve("urn:uuid:c", &found));
+}
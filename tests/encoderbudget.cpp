@@ -0,0 +1,37 @@
+// Copyright 2023 Morse Micro
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include "catch.hpp"
+#include "fakeit.hpp"
+#include "../camera.h"
+#include "../encoderbudget.h"
+#include "../soaplib/soapStub.h"
+
+
+TEST_CASE( "Encoder budget admits what fits and says how much does", "[encoderbudget]" ) {
+	fakeit::Mock<RtspServer> rtspServerMock;
+	Camera c("localhost", "localhost", "tests/camera_properties.xml", "tests/camera_configuration.xml", &(rtspServerMock.get()));
+	const EncoderBudget &budget = c.getEncoderBudget();
+	auto *vec = c.getVideoEncoderConfiguration("video_encoder_configuration_token")->soap_dup();
+
+	REQUIRE(budget.cost(vec).pixel_rate == 1280 * 720 * 30);
+	REQUIRE(budget.cost(vec).bitrate == 1000);
+	REQUIRE(budget.admit({vec}) == "");
+	REQUIRE(budget.admit({vec, vec}) != "");
+
+	vec->RateControl->BitrateLimit = 3000;
+	REQUIRE(budget.admit({vec}) != "");
+	REQUIRE(c.checkEncoderBudget(vec) != "");
+	// Only what's in a profile counts.
+	vec->token = "not_in_a_profile";
+	REQUIRE(c.checkEncoderBudget(vec) == "");
+
+	REQUIRE(budget.guaranteed(tt__VideoEncoding::H264) == 1);
+	REQUIRE(budget.guaranteed(tt__VideoEncoding::JPEG) == 0);
+	REQUIRE(budget.guaranteedTotal() == 1);
+	REQUIRE(budget.allowsProfiles(2));
+	REQUIRE(!budget.allowsProfiles(3));
+
+	vec->soap_del();
+	delete vec;
+}
@@ -0,0 +1,178 @@
+// Copyright 2023 Morse Micro
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "catch.hpp"
+#include "../eventbroker.h"
+
+
+using std::chrono::milliseconds;
+
+
+static Event some_event(const std::string &token) {
+	return {time(nullptr), "tns1:Media/ProfileChanged", {{"Token", token}}, {}};
+}
+
+
+// Records what a parked pull was completed with, and lets the test wait for it.
+struct Completed {
+	std::mutex mutex;
+	std::condition_variable done;
+	bool completed = false;
+	std::vector<Event> events;
+	time_t termination_time = 0;
+
+	EventBroker::Completion completion() {
+		return [this] (std::vector<Event> events, time_t termination_time) {
+			std::lock_guard<std::mutex> lock(mutex);
+			this->events = std::move(events);
+			this->termination_time = termination_time;
+			completed = true;
+			done.notify_all();
+		};
+	}
+
+	bool wait(milliseconds timeout) {
+		std::unique_lock<std::mutex> lock(mutex);
+		return done.wait_for(lock, timeout, [this] { return completed; });
+	}
+};
+
+
+TEST_CASE( "EventRing keeps the newest events", "[eventbroker]" ) {
+	EventRing ring(3);
+
+	for (int i = 0; i < 5; ++i) {
+		ring.push(some_event(std::to_string(i)));
+	}
+	REQUIRE(ring.size() == 3);
+	REQUIRE(ring.droppedCount() == 2);
+
+	auto taken = ring.take(2);
+	REQUIRE(taken.size() == 2);
+	REQUIRE(taken.at(0).source.at(0).second == "2");
+	REQUIRE(taken.at(1).source.at(0).second == "3");
+	REQUIRE(ring.size() == 1);
+
+	ring.push(some_event("5"));
+	taken = ring.take(10);
+	REQUIRE(taken.size() == 2);
+	REQUIRE(taken.at(0).source.at(0).second == "4");
+	REQUIRE(taken.at(1).source.at(0).second == "5");
+	REQUIRE(ring.take(10).empty());
+}
+
+TEST_CASE( "EventBroker delivers to each subscription separately", "[eventbroker]" ) {
+	EventBroker broker(4, 2);
+	time_t later = time(nullptr) + 60;
+
+	int a = broker.subscribe(later);
+	broker.publish(some_event("first"));
+	int b = broker.subscribe(later);
+	REQUIRE(a > 0);
+	REQUIRE(b > 0);
+	REQUIRE(a != b);
+	broker.publish(some_event("second"));
+
+	std::vector<Event> events;
+	REQUIRE(broker.pull(a, 10, &events));
+	REQUIRE(events.size() == 2);
+	REQUIRE(broker.pull(b, 10, &events));
+	REQUIRE(events.size() == 1);
+	REQUIRE(events.at(0).source.at(0).second == "second");
+
+	SECTION( "up to the maximum" ) {
+		REQUIRE(broker.subscribe(later) == -1);
+		REQUIRE(broker.unsubscribe(a));
+		REQUIRE(broker.subscribe(later) > 0);
+	}
+
+	SECTION( "until they're unsubscribed" ) {
+		REQUIRE(broker.unsubscribe(a));
+		REQUIRE(!broker.unsubscribe(a));
+		REQUIRE(!broker.pull(a, 10, &events));
+		REQUIRE(broker.getTerminationTime(a) == 0);
+	}
+
+	SECTION( "or expire" ) {
+		REQUIRE(broker.renew(a, time(nullptr) - 1));
+		REQUIRE(!broker.pull(a, 10, &events));
+		REQUIRE(broker.getTerminationTime(b) == later);
+	}
+}
+
+TEST_CASE( "EventBroker completes a parked pull when there's an event", "[eventbroker]" ) {
+	EventBroker broker;
+	time_t later = time(nullptr) + 60;
+	int id = broker.subscribe(later);
+
+	Completed pull;
+	REQUIRE(broker.park(id, 10, milliseconds(10000), pull.completion()));
+	REQUIRE(!pull.wait(milliseconds(20)));
+
+	broker.publish(some_event("token"));
+	REQUIRE(pull.wait(milliseconds(1000)));
+	REQUIRE(pull.events.size() == 1);
+	REQUIRE(pull.termination_time == later);
+
+	// It was all taken.
+	std::vector<Event> events;
+	REQUIRE(broker.pull(id, 10, &events));
+	REQUIRE(events.empty());
+}
+
+TEST_CASE( "EventBroker completes a parked pull with nothing", "[eventbroker]" ) {
+	EventBroker broker;
+	time_t later = time(nullptr) + 60;
+	int id = broker.subscribe(later);
+	Completed pull;
+
+	SECTION( "after its timeout" ) {
+		auto start = EventBroker::Clock::now();
+		REQUIRE(broker.park(id, 10, milliseconds(50), pull.completion()));
+		REQUIRE(pull.wait(milliseconds(1000)));
+		REQUIRE(EventBroker::Clock::now() - start >= milliseconds(50));
+		REQUIRE(pull.termination_time == later);
+	}
+
+	SECTION( "when another pull replaces it" ) {
+		Completed next;
+		REQUIRE(broker.park(id, 10, milliseconds(10000), pull.completion()));
+		REQUIRE(broker.park(id, 10, milliseconds(10000), next.completion()));
+		REQUIRE(pull.wait(milliseconds(1000)));
+		REQUIRE(!next.wait(milliseconds(20)));
+		broker.publish(some_event("token"));
+		REQUIRE(next.wait(milliseconds(1000)));
+		REQUIRE(next.events.size() == 1);
+	}
+
+	SECTION( "when it's unsubscribed" ) {
+		REQUIRE(broker.park(id, 10, milliseconds(10000), pull.completion()));
+		REQUIRE(broker.unsubscribe(id));
+		REQUIRE(pull.wait(milliseconds(1000)));
+		REQUIRE(pull.termination_time == 0);
+	}
+
+	SECTION( "when it stops" ) {
+		REQUIRE(broker.park(id, 10, milliseconds(10000), pull.completion()));
+		broker.stop();
+		REQUIRE(pull.completed);
+		REQUIRE(pull.events.empty());
+		// And won't take any more.
+		REQUIRE(!broker.park(id, 10, milliseconds(10000), pull.completion()));
+	}
+
+	REQUIRE(pull.events.empty());
+}
+
+TEST_CASE( "EventBroker doesn't park on a subscription that doesn't exist", "[eventbroker]" ) {
+	EventBroker broker;
+	Completed pull;
+	REQUIRE(!broker.park(1, 10, milliseconds(10), pull.completion()));
+	REQUIRE(!pull.wait(milliseconds(20)));
+}
@@ -0,0 +1,192 @@
+// Copyright 2023 Morse Micro
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <cstring>
+#include <string>
+
+#include "catch.hpp"
+#include "fakeit.hpp"
+#include "../camera.h"
+#include "../soaplib/soapStub.h"
+
+
+// Where the requests for the subscription at address go.
+static void post_to(struct soap *soap, const std::string &address) {
+	std::string path = address.substr(address.find("/onvif/"));
+	strncpy(soap->path, path.c_str(), sizeof(soap->path) - 1);
+}
+
+static std::string create_subscription(struct soap *soap, const char *initial_termination_time = nullptr) {
+	auto *req = soap_new__tev__CreatePullPointSubscription(soap);
+	auto *resp = soap_new__tev__CreatePullPointSubscriptionResponse(soap);
+	if (initial_termination_time != nullptr) {
+		req->InitialTerminationTime = soap_new_std__string(soap);
+		*req->InitialTerminationTime = initial_termination_time;
+	}
+	REQUIRE(__tev__CreatePullPointSubscription(soap, req, *resp) == SOAP_OK);
+	REQUIRE(resp->wsnt__TerminationTime > resp->wsnt__CurrentTime);
+	return resp->SubscriptionReference.Address;
+}
+
+static _tev__PullMessagesResponse *pull_messages(struct soap *soap) {
+	auto *req = soap_new__tev__PullMessages(soap);
+	auto *resp = soap_new__tev__PullMessagesResponse(soap);
+	req->Timeout = "PT10S";
+	req->MessageLimit = 10;
+	// No socket, so this answers straight away rather than parking.
+	REQUIRE(__tev__PullMessages(soap, req, *resp) == SOAP_OK);
+	return resp;
+}
+
+
+TEST_CASE( "CreatePullPointSubscription gives each subscription an address", "[events]" ) {
+	fakeit::Mock<RtspServer> rtspServerMock;
+	Camera c("http://localhost:8080", "localhost", "tests/camera_properties.xml", "tests/camera_configuration.xml", &(rtspServerMock.get()));
+
+	auto soap = soap_new1(SOAP_XML_STRICT|SOAP_XML_INDENT);
+	soap->user = &c;
+
+	std::string first = create_subscription(soap);
+	std::string second = create_subscription(soap, "PT1M");
+	REQUIRE(first.find("http://localhost:8080/onvif/subscription/") == 0);
+	REQUIRE(second.find("http://localhost:8080/onvif/subscription/") == 0);
+	REQUIRE(first != second);
+
+	SECTION( "but not with a termination time in the past" ) {
+		auto *req = soap_new__tev__CreatePullPointSubscription(soap);
+		auto *resp = soap_new__tev__CreatePullPointSubscriptionResponse(soap);
+		req->InitialTerminationTime = soap_new_std__string(soap);
+		*req->InitialTerminationTime = "2001-01-01T00:00:00Z";
+		REQUIRE(__tev__CreatePullPointSubscription(soap, req, *resp) == SOAP_FAULT);
+		REQUIRE(std::string(*soap_faultsubcode(soap)) == "ter:InvalidArgVal");
+	}
+
+	SECTION( "or once there are too many" ) {
+		for (size_t i = 2; i < c.getEventBroker().getMaxSubscriptions(); ++i) {
+			create_subscription(soap);
+		}
+		auto *req = soap_new__tev__CreatePullPointSubscription(soap);
+		auto *resp = soap_new__tev__CreatePullPointSubscriptionResponse(soap);
+		REQUIRE(__tev__CreatePullPointSubscription(soap, req, *resp) == SOAP_FAULT);
+		REQUIRE(std::string(*soap_faultsubcode(soap)) == "ter:Action");
+	}
+
+	soap_destroy(soap);
+	soap_end(soap);
+	soap_free(soap);
+}
+
+TEST_CASE( "PullMessages returns the Camera's changes", "[events]" ) {
+	fakeit::Mock<RtspServer> rtspServerMock;
+	fakeit::Fake(Method(rtspServerMock, initialise));
+	fakeit::Fake(Method(rtspServerMock, setVideoEncoderConfiguration));
+	Camera c("http://localhost:8080", "localhost", "tests/camera_properties.xml", "tests/camera_configuration.xml", &(rtspServerMock.get()));
+
+	auto soap = soap_new1(SOAP_XML_STRICT|SOAP_XML_INDENT);
+	soap->user = &c;
+	post_to(soap, create_subscription(soap));
+
+	REQUIRE(pull_messages(soap)->wsnt__NotificationMessage.empty());
+
+	REQUIRE(c.initialiseRtspServer());
+	auto *vec = c.getVideoEncoderConfiguration("video_encoder_configuration_token")->soap_dup();
+	vec->Resolution->Height = 999;
+	REQUIRE(c.setVideoEncoderConfiguration(vec));
+	// Unchanged, so nothing's published.
+	REQUIRE(c.setVideoEncoderConfiguration(vec));
+	vec->soap_del();
+	delete vec;
+
+	auto *resp = pull_messages(soap);
+	REQUIRE(resp->TerminationTime > resp->CurrentTime);
+	REQUIRE(resp->wsnt__NotificationMessage.size() == 3);
+	auto *started = resp->wsnt__NotificationMessage.at(0);
+	REQUIRE(std::string(started->Topic->__mixed) == "tns1:Media/StreamRestarted");
+	auto *changed = resp->wsnt__NotificationMessage.at(1);
+	REQUIRE(std::string(changed->Topic->__mixed) == "tns1:Media/ConfigurationChanged");
+	REQUIRE(changed->Topic->Dialect == "http://www.onvif.org/ver10/tev/topicExpression/ConcreteSet");
+	auto *message = changed->Message.tt__Message;
+	REQUIRE(message->Source->SimpleItem.at(0).Name == "Token");
+	REQUIRE(message->Source->SimpleItem.at(0).Value == "video_encoder_configuration_token");
+	REQUIRE(message->Data->SimpleItem.at(0).Value == "VideoEncoder");
+	auto *restarted = resp->wsnt__NotificationMessage.at(2);
+	REQUIRE(std::string(restarted->Topic->__mixed) == "tns1:Media/StreamRestarted");
+	REQUIRE(restarted->Message.tt__Message->Source->SimpleItem.at(0).Value == "profile_token");
+
+	// They've been taken.
+	REQUIRE(pull_messages(soap)->wsnt__NotificationMessage.empty());
+
+	soap_destroy(soap);
+	soap_end(soap);
+	soap_free(soap);
+}
+
+TEST_CASE( "Subscriptions can be renewed and unsubscribed", "[events]" ) {
+	fakeit::Mock<RtspServer> rtspServerMock;
+	Camera c("http://localhost:8080", "localhost", "tests/camera_properties.xml", "tests/camera_configuration.xml", &(rtspServerMock.get()));
+
+	auto soap = soap_new1(SOAP_XML_STRICT|SOAP_XML_INDENT);
+	soap->user = &c;
+	post_to(soap, create_subscription(soap));
+
+	SECTION( "renewed" ) {
+		auto *req = soap_new__wsnt__Renew(soap);
+		auto *resp = soap_new__wsnt__RenewResponse(soap);
+		req->TerminationTime = soap_new_std__string(soap);
+		*req->TerminationTime = "PT10M";
+		REQUIRE(__tev__Renew(soap, req, *resp) == SOAP_OK);
+		REQUIRE(resp->TerminationTime - *resp->CurrentTime == 600);
+		REQUIRE(pull_messages(soap)->TerminationTime == resp->TerminationTime);
+	}
+
+	SECTION( "unsubscribed" ) {
+		auto *req = soap_new__wsnt__Unsubscribe(soap);
+		auto *resp = soap_new__wsnt__UnsubscribeResponse(soap);
+		REQUIRE(__tev__Unsubscribe(soap, req, *resp) == SOAP_OK);
+		REQUIRE(__tev__Unsubscribe(soap, req, *resp) == SOAP_FAULT);
+
+		auto *pull = soap_new__tev__PullMessages(soap);
+		auto *pulled = soap_new__tev__PullMessagesResponse(soap);
+		pull->Timeout = "PT1S";
+		pull->MessageLimit = 1;
+		REQUIRE(__tev__PullMessages(soap, pull, *pulled) == SOAP_FAULT);
+		REQUIRE(std::string(*soap_faultsubcode(soap)) == "ter:InvalidArgVal");
+	}
+
+	SECTION( "but not somewhere else" ) {
+		post_to(soap, "http://localhost:8080/onvif/subscription/999");
+		auto *req = soap_new__tev__SetSynchronizationPoint(soap);
+		auto *resp = soap_new__tev__SetSynchronizationPointResponse(soap);
+		REQUIRE(__tev__SetSynchronizationPoint(soap, req, *resp) == SOAP_FAULT);
+	}
+
+	soap_destroy(soap);
+	soap_end(soap);
+	soap_free(soap);
+}
+
+TEST_CASE( "Events describes what it publishes", "[events]" ) {
+	fakeit::Mock<RtspServer> rtspServerMock;
+	Camera c("http://localhost:8080", "localhost", "tests/camera_properties.xml", "tests/camera_configuration.xml", &(rtspServerMock.get()));
+
+	auto soap = soap_new1(SOAP_XML_STRICT|SOAP_XML_INDENT);
+	soap->user = &c;
+
+	auto *capabilities_req = soap_new__tev__GetServiceCapabilities(soap);
+	auto *capabilities_resp = soap_new__tev__GetServiceCapabilitiesResponse(soap);
+	REQUIRE(__tev__GetServiceCapabilities(soap, capabilities_req, *capabilities_resp) == SOAP_OK);
+	REQUIRE(*capabilities_resp->Capabilities->MaxPullPoints == static_cast<int>(c.getEventBroker().getMaxSubscriptions()));
+	REQUIRE(!*capabilities_resp->Capabilities->WSSubscriptionPolicySupport);
+
+	auto *properties_req = soap_new__tev__GetEventProperties(soap);
+	auto *properties_resp = soap_new__tev__GetEventPropertiesResponse(soap);
+	REQUIRE(__tev__GetEventProperties(soap, properties_req, *properties_resp) == SOAP_OK);
+	REQUIRE(properties_resp->wsnt__FixedTopicSet);
+	std::string topic_set = properties_resp->wstop__TopicSet->__any;
+	REQUIRE(topic_set.find("<ConfigurationChanged wstop:topic=\"true\">") != std::string::npos);
+	REQUIRE(topic_set.find("<ImagingSettingsChanged wstop:topic=\"true\">") != std::string::npos);
+
+	soap_destroy(soap);
+	soap_end(soap);
+	soap_free(soap);
+}
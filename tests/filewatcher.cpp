@@ -0,0 +1,114 @@
+// Copyright 2023 Morse Micro
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+#include "catch.hpp"
+#include "fakeit.hpp"
+#include "../camera.h"
+#include "../filewatcher.h"
+#include "../utils.h"
+#include "../soaplib/soapStub.h"
+#include "scratch.h"
+
+
+TEST_CASE( "File watcher reports writes and renames once they settle", "[filewatcher]" ) {
+	ScratchConfig scratch;
+	std::mutex mutex;
+	std::condition_variable changed;
+	std::vector<std::string> reported;
+
+	FileWatcher watcher({scratch.config}, [&] (const std::string &path) {
+		std::lock_guard<std::mutex> lock(mutex);
+		reported.push_back(path);
+		changed.notify_all();
+	}, 50);
+	watcher.start();
+
+	auto wait_for = [&] (size_t count) {
+		std::unique_lock<std::mutex> lock(mutex);
+		return changed.wait_for(lock, std::chrono::seconds(2), [&] { return reported.size() >= count; });
+	};
+
+	// Several writes in a row are one change.
+	for (int i = 0; i < 3; ++i) {
+		ScratchConfig::write(scratch.config, "<config/>");
+	}
+	REQUIRE(wait_for(1));
+
+	// As is replacing it (e.g. write_file_atomically, or most editors); other files aren't.
+	ScratchConfig::write(scratch.path("other"), "<other/>");
+	REQUIRE(write_file_atomically(scratch.config, "<config/>"));
+	REQUIRE(wait_for(2));
+
+	watcher.stop();
+	std::lock_guard<std::mutex> lock(mutex);
+	REQUIRE(reported == std::vector<std::string>{scratch.config, scratch.config});
+}
+
+
+TEST_CASE( "Camera applies only what was edited in its data files", "[filewatcher][camera]" ) {
+	ScratchConfig scratch;
+	fakeit::Mock<RtspServer> rtspServerMock;
+	fakeit::Fake(Method(rtspServerMock, initialise));
+	fakeit::Fake(Method(rtspServerMock, setVideoEncoderConfiguration));
+	fakeit::Fake(Method(rtspServerMock, setVideoSourceConfiguration));
+	fakeit::Fake(Method(rtspServerMock, setImagingSettings));
+	Camera c("http://localhost:8080", "localhost", scratch.properties, scratch.config, &(rtspServerMock.get()));
+	REQUIRE(c.initialiseRtspServer());
+	c.enableReload();
+
+	SECTION( "an encoder setting" ) {
+		ScratchConfig::edit(scratch.config, "<BitrateLimit>1000</BitrateLimit>", "<BitrateLimit>2000</BitrateLimit>");
+		c.reload(scratch.config);
+		REQUIRE(c.getCurrentVideoEncoderConfiguration()->RateControl->BitrateLimit == 2000);
+		fakeit::Verify(Method(rtspServerMock, setVideoEncoderConfiguration)).Once();
+		fakeit::Verify(Method(rtspServerMock, setVideoSourceConfiguration)).Never();
+		fakeit::Verify(Method(rtspServerMock, setImagingSettings)).Never();
+
+		// Including when it's us that wrote it.
+		c.saveConfiguration();
+		c.reload(scratch.config);
+		fakeit::Verify(Method(rtspServerMock, setVideoEncoderConfiguration)).Once();
+	}
+
+	SECTION( "without undoing changes that haven't been written yet" ) {
+		auto *vec = c.getVideoEncoderConfiguration("video_encoder_configuration_token")->soap_dup();
+		vec->Quality = 2;
+		REQUIRE(c.setVideoEncoderConfiguration(vec));
+		vec->soap_del();
+		delete vec;
+
+		ScratchConfig::edit(scratch.config, "<Scope>onvif://www.onvif.org/name/Test</Scope>", "<Scope>onvif://www.onvif.org/name/Edited</Scope>");
+		unsigned int discovery_version = c.getDiscoveryVersion();
+		c.reload(scratch.config);
+		REQUIRE(c.getConfigurableScopes() == std::vector<std::string>{"onvif://www.onvif.org/name/Edited"});
+		REQUIRE(c.getDiscoveryVersion() > discovery_version);
+		REQUIRE(c.getCurrentVideoEncoderConfiguration()->Quality == 2);
+	}
+
+	SECTION( "not if it's invalid" ) {
+		ScratchConfig::edit(scratch.config, "<Quality>1</Quality>", "<Quality>high</Quality>");
+		c.reload(scratch.config);
+		REQUIRE(c.getCurrentVideoEncoderConfiguration()->Quality == 1);
+	}
+
+	SECTION( "not if the options don't allow it" ) {
+		ScratchConfig::edit(scratch.config, "<Quality>1</Quality>", "<Quality>4</Quality>");
+		c.reload(scratch.config);
+		REQUIRE(c.getCurrentVideoEncoderConfiguration()->Quality == 1);
+		fakeit::Verify(Method(rtspServerMock, setVideoEncoderConfiguration)).Never();
+	}
+
+	SECTION( "properties, except how to run the RTSP server" ) {
+		ScratchConfig::edit(scratch.properties, "<Model>Camera</Model>", "<Model>Edited</Model>");
+		ScratchConfig::edit(scratch.properties, "<Port>554</Port>", "<Port>8554</Port>");
+		unsigned int discovery_version = c.getDiscoveryVersion();
+		c.reload(scratch.properties);
+		REQUIRE(c.getDeviceInformation()->Model == "Edited");
+		REQUIRE(c.getDiscoveryVersion() > discovery_version);
+		REQUIRE(c.getStreamUri() == "rtsp://localhost:554//");
+	}
+}
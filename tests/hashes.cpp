@@ -0,0 +1,93 @@
+// Copyright 2023 Morse Micro
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <string>
+
+#include "catch.hpp"
+#include "../hashes.h"
+
+
+// Whether it's the one here or OpenSSL's (TLS=1).
+TEST_CASE( "SHA-1 matches the RFC 3174 tests", "[hashes]" ) {
+	REQUIRE(to_hex(Sha1().finish()) == "da39a3ee5e6b4b0d3255bfef95601890afd80709");
+	REQUIRE(to_hex(Sha1().update("abc").finish()) == "a9993e364706816aba3e25717850c26c9cd0d89d");
+	REQUIRE(to_hex(Sha1().update("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq").finish())
+		== "84983e441c3bd26ebaae4aa1f95129e5e54670f1");
+	REQUIRE(to_hex(Sha1().update(std::string(1000000, 'a')).finish()) == "34aa973cd4c4daa4f61eeb2bdbad27316534016f");
+	Sha1 repeated;
+	for (int i = 0; i < 10; ++i) {
+		repeated.update("0123456701234567012345670123456701234567012345670123456701234567");
+	}
+	REQUIRE(to_hex(repeated.finish()) == "dea356a2cddd90c7a7ecedc5ebb563934f460452");
+}
+
+TEST_CASE( "MD5 matches the RFC 1321 test suite", "[hashes]" ) {
+	REQUIRE(to_hex(Md5().finish()) == "d41d8cd98f00b204e9800998ecf8427e");
+	REQUIRE(to_hex(Md5().update("a").finish()) == "0cc175b9c0f1b6a831c399e269772661");
+	REQUIRE(to_hex(Md5().update("abc").finish()) == "900150983cd24fb0d6963f7d28e17f72");
+	REQUIRE(to_hex(Md5().update("message digest").finish()) == "f96b697d7cb7938d525a2f31aaf161d0");
+	REQUIRE(to_hex(Md5().update("abcdefghijklmnopqrstuvwxyz").finish()) == "c3fcd3d76192e4007dfb496cca67e13b");
+	REQUIRE(to_hex(Md5().update("ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789").finish())
+		== "d174ab98d277d9f5a5611c2c9f419d9f");
+	REQUIRE(to_hex(Md5().update("12345678901234567890123456789012345678901234567890123456789012345678901234567890").finish())
+		== "57edf4a22be3c955ac49da2e2107b67a");
+
+	// RFC 2617's Digest example.
+	auto ha1 = to_hex(Md5().update("Mufasa:testrealm@host.com:Circle Of Life").finish());
+	auto ha2 = to_hex(Md5().update("GET:/dir/index.html").finish());
+	auto response = Md5().update(ha1 + ":dcd98b7102dd2f0e8b11d0f600bfb0c093:00000001:0a4f113b:auth:" + ha2).finish();
+	REQUIRE(to_hex(response) == "6629fae49393a05397450978507c4ef1");
+}
+
+TEST_CASE( "SHA-1 and MD5 pad right around block boundaries", "[hashes]" ) {
+	// Up to 55 bytes, the length fits in the last block; from 56 it needs another one.
+	struct {
+		size_t length;
+		const char *sha1;
+		const char *md5;
+	} lengths[] = {
+		{55, "c1c8bbdc22796e28c0e15163d20899b65621d65a", "ef1772b6dff9a122358552954ad0df65"},
+		{56, "c2db330f6083854c99d4b5bfb6e8f29f201be699", "3b0c8ac703f828b04c6c197006d17218"},
+		{57, "f08f24908d682555111be7ff6f004e78283d989a", "652b906d60af96844ebd21b674f35e93"},
+		{63, "03f09f5b158a7a8cdad920bddc29b81c18a551f5", "b06521f39153d618550606be297466d5"},
+		{64, "0098ba824b5c16427bd7a1122a5a442a25ec644d", "014842d480b571495a4a0363793f7367"},
+		{65, "11655326c708d70319be2610e8a57d9a5b959d3b", "c743a45e0d2e6a95cb859adae0248435"},
+		{119, "ee971065aaa017e0632a8ca6c77bb3bf8b1dfc56", "8a7bd0732ed6a28ce75f6dabc90e1613"},
+		{120, "f34c1488385346a55709ba056ddd08280dd4c6d6", "5f61c0ccad4cac44c75ff505e1f1e537"},
+		{127, "89d95fa32ed44a7c610b7ee38517ddf57e0bb975", "020406e1d05cdc2aa287641f7ae2cc39"},
+		{128, "ad5b3fdbcb526778c2839d2f151ea753995e26a0", "e510683b3f5ffe4093d021808bc6ff70"},
+	};
+	for (auto &expected : lengths) {
+		INFO( expected.length << " bytes" );
+		std::string data(expected.length, 'a');
+		REQUIRE(to_hex(Sha1().update(data).finish()) == expected.sha1);
+		REQUIRE(to_hex(Md5().update(data).finish()) == expected.md5);
+
+		// However it's split up.
+		for (size_t split : {size_t(1), size_t(7), size_t(64)}) {
+			Sha1 sha1;
+			Md5 md5;
+			for (size_t i = 0; i < data.size(); i += split) {
+				sha1.update(data.substr(i, split));
+				md5.update(data.substr(i, split));
+			}
+			REQUIRE(to_hex(sha1.finish()) == expected.sha1);
+			REQUIRE(to_hex(md5.finish()) == expected.md5);
+		}
+	}
+}
+
+TEST_CASE( "base64 round trips", "[hashes]" ) {
+	std::string decoded;
+	REQUIRE(base64_encode(reinterpret_cast<const uint8_t *>("foobar"), 6) == "Zm9vYmFy");
+	REQUIRE(base64_encode(reinterpret_cast<const uint8_t *>("fooba"), 5) == "Zm9vYmE=");
+	REQUIRE(base64_encode(reinterpret_cast<const uint8_t *>("foob"), 4) == "Zm9vYg==");
+
+	REQUIRE(base64_decode("Zm9vYg==", &decoded));
+	REQUIRE(decoded == "foob");
+	REQUIRE(base64_decode("Zm9v\r\nYmE=", &decoded));
+	REQUIRE(decoded == "fooba");
+
+	REQUIRE(!base64_decode("Zm9v!mE=", &decoded));
+	REQUIRE(!base64_decode("Zm=9v", &decoded));
+}
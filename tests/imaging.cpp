@@ -64,7 +64,9 @@ TEST_CASE( "GetOptions returns correct info", "[imaging]" ) {
 TEST_CASE( "SetImagingSettings returns correct info", "[imaging]" ) {
 	fakeit::Mock<RtspServer> rtspServerMock;
 	fakeit::Fake(Method(rtspServerMock, setImagingSettings));
+	fakeit::Fake(Method(rtspServerMock, initialise));
 	Camera c("localhost", "localhost", "tests/camera_properties.xml", "tests/camera_configuration.xml", &(rtspServerMock.get()));
+	REQUIRE(c.initialiseRtspServer());
 
 	auto soap = soap_new1(SOAP_XML_STRICT|SOAP_XML_INDENT);
 	soap->user = &c;
@@ -87,13 +89,31 @@ TEST_CASE( "SetImagingSettings returns correct info", "[imaging]" ) {
 		REQUIRE(*(c.getImagingSettings("video_source_token")->Brightness) != 1.0);
 	}
 
+	SECTION( "refuses what the options don't allow, and nothing changes" ) {
+		req->ImagingSettings = imaging_settings;
+		req->VideoSourceToken = "video_source_token";
+		*(imaging_settings->Brightness) = 5.0;
+		REQUIRE(__timg__SetImagingSettings(soap, req, *resp) == SOAP_FAULT);
+		REQUIRE(std::string(*soap_faultsubcode(soap)) == "ter:InvalidArgVal");
+		REQUIRE(*(c.getImagingSettings("video_source_token")->Brightness) != 5.0);
+		fakeit::Verify(Method(rtspServerMock, setImagingSettings)).Never();
+	}
+
 	SECTION( "calls out to RtspServer" ) {
 		req->ImagingSettings = imaging_settings;
 		req->VideoSourceToken = "video_source_token";
+		*(imaging_settings->Brightness) = 1.0;
 		REQUIRE(__timg__SetImagingSettings(soap, req, *resp) == SOAP_OK);
 		fakeit::Verify(Method(rtspServerMock, setImagingSettings).Using(imaging_settings)).Once();
 	}
 
+	SECTION( "but not if nothing changed" ) {
+		req->ImagingSettings = imaging_settings;
+		req->VideoSourceToken = "video_source_token";
+		REQUIRE(__timg__SetImagingSettings(soap, req, *resp) == SOAP_OK);
+		fakeit::Verify(Method(rtspServerMock, setImagingSettings)).Never();
+	}
+
 	imaging_settings->soap_del();
 	soap_destroy(soap);
 	soap_end(soap);
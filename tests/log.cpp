@@ -0,0 +1,38 @@
+// Copyright 2023 Morse Micro
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <chrono>
+#include <thread>
+
+#include "catch.hpp"
+#include "../log.h"
+
+
+TEST_CASE( "LogRateLimit lets one message through per interval", "[log]" ) {
+	LogRateLimit limit(std::chrono::milliseconds(50));
+	unsigned suppressed = 1234;
+
+	REQUIRE(limit.allow(&suppressed));
+	REQUIRE(suppressed == 0);
+	REQUIRE_FALSE(limit.allow(&suppressed));
+	REQUIRE_FALSE(limit.allow(&suppressed));
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(60));
+	REQUIRE(limit.allow(&suppressed));
+	REQUIRE(suppressed == 2);
+}
+
+
+TEST_CASE( "Log levels parse and filter", "[log]" ) {
+	LogLevel level;
+	REQUIRE(log_parse_level("debug", &level));
+	REQUIRE(level == LogLevel::Debug);
+	REQUIRE_FALSE(log_parse_level("verbose", &level));
+
+	log_set_level(LogLevel::Warning);
+	REQUIRE(log_enabled(LogLevel::Error));
+	REQUIRE(log_enabled(LogLevel::Warning));
+	REQUIRE_FALSE(log_enabled(LogLevel::Info));
+
+	log_set_level(LogLevel::Info);
+}
@@ -186,7 +186,9 @@ TEST_CASE( "GetStreamUri returns correct info", "[media]" ) {
 TEST_CASE( "SetVideoEncoderConfiguration correctly mutates config", "[media]" ) {
 	fakeit::Mock<RtspServer> rtspServerMock;
 	fakeit::Fake(Method(rtspServerMock, setVideoEncoderConfiguration));
+	fakeit::Fake(Method(rtspServerMock, initialise));
 	Camera c("localhost", "localhost", "tests/camera_properties.xml", "tests/camera_configuration.xml", &(rtspServerMock.get()));
+	REQUIRE(c.initialiseRtspServer());
 
 	auto soap = soap_new1(SOAP_XML_STRICT|SOAP_XML_INDENT);
 	soap->user = &c;
@@ -196,13 +198,22 @@ TEST_CASE( "SetVideoEncoderConfiguration correctly mutates config", "[media]" )
 
 	SECTION( "can mutate video encoder config" ) {
 		req->Configuration = vce;
-		vce->Resolution->Height = 999;
+		vce->RateControl->BitrateLimit = 2000;
 		REQUIRE(__trt__SetVideoEncoderConfiguration(soap, req, *resp) == SOAP_OK);
 		auto *new_vce = c.getVideoEncoderConfiguration("video_encoder_configuration_token");
-		REQUIRE(new_vce->Resolution->Height == 999);
+		REQUIRE(new_vce->RateControl->BitrateLimit == 2000);
 		REQUIRE(new_vce->Resolution->Width == vce->Resolution->Width);
 	}
 
+	SECTION( "refuses what the options don't allow, before changing anything" ) {
+		req->Configuration = vce;
+		vce->Resolution->Height = 999;
+		REQUIRE(__trt__SetVideoEncoderConfiguration(soap, req, *resp) == SOAP_FAULT);
+		REQUIRE(std::string(*soap_faultsubcode(soap)) == "ter:InvalidArgVal");
+		REQUIRE(c.getVideoEncoderConfiguration("video_encoder_configuration_token")->Resolution->Height != 999);
+		fakeit::Verify(Method(rtspServerMock, setVideoEncoderConfiguration)).Never();
+	}
+
 	SECTION( "fails if token doesn't exist" ) {
 		req->Configuration = vce;
 		vce->token = "foo";
@@ -214,9 +225,15 @@ TEST_CASE( "SetVideoEncoderConfiguration correctly mutates config", "[media]" )
 
 	SECTION( "calls out to RtspServer" ) {
 		req->Configuration = vce;
-		vce->Resolution->Height = 999;
+		vce->RateControl->BitrateLimit = 2000;
+		REQUIRE(__trt__SetVideoEncoderConfiguration(soap, req, *resp) == SOAP_OK);
+		fakeit::Verify(Method(rtspServerMock, setVideoEncoderConfiguration).Using(vce, nullptr)).Once();
+	}
+
+	SECTION( "but not if nothing changed" ) {
+		req->Configuration = vce;
 		REQUIRE(__trt__SetVideoEncoderConfiguration(soap, req, *resp) == SOAP_OK);
-		fakeit::Verify(Method(rtspServerMock, setVideoEncoderConfiguration).Using(vce)).Once();
+		fakeit::Verify(Method(rtspServerMock, setVideoEncoderConfiguration)).Never();
 	}
 
 	vce->soap_del();
@@ -228,7 +245,9 @@ TEST_CASE( "SetVideoEncoderConfiguration correctly mutates config", "[media]" )
 TEST_CASE( "SetVideoSourceConfiguration correctly mutates config", "[media]" ) {
 	fakeit::Mock<RtspServer> rtspServerMock;
 	fakeit::Fake(Method(rtspServerMock, setVideoSourceConfiguration));
+	fakeit::Fake(Method(rtspServerMock, initialise));
 	Camera c("localhost", "localhost", "tests/camera_properties.xml", "tests/camera_configuration.xml", &(rtspServerMock.get()));
+	REQUIRE(c.initialiseRtspServer());
 
 	auto soap = soap_new1(SOAP_XML_STRICT|SOAP_XML_INDENT);
 	soap->user = &c;
@@ -263,8 +282,198 @@ TEST_CASE( "SetVideoSourceConfiguration correctly mutates config", "[media]" ) {
 		fakeit::Verify(Method(rtspServerMock, setVideoSourceConfiguration).Using(vsc)).Once();
 	}
 
+	SECTION( "but not if nothing it keeps changed" ) {
+		req->Configuration = vsc;
+		vsc->UseCount = 99;
+		REQUIRE(__trt__SetVideoSourceConfiguration(soap, req, *resp) == SOAP_OK);
+		fakeit::Verify(Method(rtspServerMock, setVideoSourceConfiguration)).Never();
+	}
+
 	vsc->soap_del();
 	soap_destroy(soap);
 	soap_end(soap);
 	soap_free(soap);
-}
\ No newline at end of file
+}
+TEST_CASE( "Profiles can be created and deleted within the encoder budget", "[media]" ) {
+	fakeit::Mock<RtspServer> rtspServerMock;
+	fakeit::Fake(Method(rtspServerMock, setVideoEncoderConfiguration));
+	fakeit::Fake(Method(rtspServerMock, initialise));
+	Camera c("localhost", "localhost", "tests/camera_properties.xml", "tests/camera_configuration.xml", &(rtspServerMock.get()));
+	REQUIRE(c.initialiseRtspServer());
+
+	auto soap = soap_new1(SOAP_XML_STRICT|SOAP_XML_INDENT);
+	soap->user = &c;
+	auto *create = soap_new__trt__CreateProfile(soap);
+	auto *create_resp = soap_new__trt__CreateProfileResponse(soap);
+	create->Name = "Substream";
+	create->Token = soap_new_std__string(soap);
+	*create->Token = "sub";
+	REQUIRE(__trt__CreateProfile(soap, create, *create_resp) == SOAP_OK);
+	REQUIRE(create_resp->Profile->token == "sub");
+	REQUIRE(create_resp->Profile->VideoEncoderConfiguration == nullptr);
+	REQUIRE(c.getMinimumProfiles().size() == 2);
+
+	SECTION( "but not twice, or more than the budget allows" ) {
+		REQUIRE(__trt__CreateProfile(soap, create, *create_resp) == SOAP_FAULT);
+		REQUIRE(std::string(*soap_faultsubcode(soap)) == "ter:InvalidArgVal");
+		create->Token = nullptr;
+		REQUIRE(__trt__CreateProfile(soap, create, *create_resp) == SOAP_FAULT);
+		REQUIRE(std::string(*soap_faultsubcode(soap)) == "ter:Action");
+		REQUIRE(c.getMinimumProfiles().size() == 2);
+	}
+
+	SECTION( "and streamed once it has both configurations" ) {
+		std::string token = "sub";
+		REQUIRE(!c.setCurrentProfile(token));
+
+		auto *add_vec = soap_new__trt__AddVideoEncoderConfiguration(soap);
+		add_vec->ProfileToken = "sub";
+		add_vec->ConfigurationToken = "video_encoder_configuration_token";
+		// The same encoder as the other profile, so it costs nothing more.
+		REQUIRE(__trt__AddVideoEncoderConfiguration(soap, add_vec, *soap_new__trt__AddVideoEncoderConfigurationResponse(soap)) == SOAP_OK);
+		auto *add_vsc = soap_new__trt__AddVideoSourceConfiguration(soap);
+		add_vsc->ProfileToken = "sub";
+		add_vsc->ConfigurationToken = "video_source_configuration_token";
+		REQUIRE(__trt__AddVideoSourceConfiguration(soap, add_vsc, *soap_new__trt__AddVideoSourceConfigurationResponse(soap)) == SOAP_OK);
+		REQUIRE(c.setCurrentProfile(token));
+
+		auto *remove_vec = soap_new__trt__RemoveVideoEncoderConfiguration(soap);
+		remove_vec->ProfileToken = "sub";
+		REQUIRE(__trt__RemoveVideoEncoderConfiguration(soap, remove_vec, *soap_new__trt__RemoveVideoEncoderConfigurationResponse(soap)) == SOAP_FAULT);
+
+		auto *del = soap_new__trt__DeleteProfile(soap);
+		del->ProfileToken = "sub";
+		REQUIRE(__trt__DeleteProfile(soap, del, *soap_new__trt__DeleteProfileResponse(soap)) == SOAP_FAULT);
+		REQUIRE(std::string(*soap_faultsubcode(soap)) == "ter:Action");
+		del->ProfileToken = "profile_token";
+		REQUIRE(__trt__DeleteProfile(soap, del, *soap_new__trt__DeleteProfileResponse(soap)) == SOAP_OK);
+		REQUIRE(c.getMinimumProfiles().size() == 1);
+	}
+
+	SECTION( "which Sets are held to as well" ) {
+		auto *set = soap_new__trt__SetVideoEncoderConfiguration(soap);
+		set->Configuration = c.getVideoEncoderConfiguration("video_encoder_configuration_token")->soap_dup(soap);
+		set->Configuration->RateControl->BitrateLimit = 3000;
+		REQUIRE(__trt__SetVideoEncoderConfiguration(soap, set, *soap_new__trt__SetVideoEncoderConfigurationResponse(soap)) == SOAP_FAULT);
+		REQUIRE(std::string(*soap_faultsubcode(soap)) == "ter:Action");
+		REQUIRE(c.getVideoEncoderConfiguration("video_encoder_configuration_token")->RateControl->BitrateLimit == 1000);
+		fakeit::Verify(Method(rtspServerMock, setVideoEncoderConfiguration)).Never();
+	}
+
+	SECTION( "and say how many encoders are guaranteed" ) {
+		auto *req = soap_new__trt__GetGuaranteedNumberOfVideoEncoderInstances(soap);
+		auto *resp = soap_new__trt__GetGuaranteedNumberOfVideoEncoderInstancesResponse(soap);
+		req->ConfigurationToken = "video_source_configuration_token";
+		REQUIRE(__trt__GetGuaranteedNumberOfVideoEncoderInstances(soap, req, *resp) == SOAP_OK);
+		REQUIRE(resp->TotalNumber == 1);
+		REQUIRE(*resp->H264 == 1);
+		REQUIRE(resp->JPEG == nullptr);
+	}
+
+	soap_destroy(soap);
+	soap_end(soap);
+	soap_free(soap);
+}
+
+TEST_CASE( "Multicast streaming needs a group, and takes over above enough viewers", "[media]" ) {
+	RtspServer::Readers readers = {0, 0};
+	fakeit::Mock<RtspServer> rtspServerMock;
+	fakeit::Fake(Method(rtspServerMock, setVideoEncoderConfiguration));
+	fakeit::Fake(Method(rtspServerMock, initialise));
+	fakeit::Fake(Method(rtspServerMock, setMulticast));
+	fakeit::When(Method(rtspServerMock, supportsMulticast)).AlwaysReturn(true);
+	Camera c("localhost", "localhost", "tests/camera_properties.xml", "tests/camera_configuration.xml", &(rtspServerMock.get()));
+	REQUIRE(c.initialiseRtspServer());
+	REQUIRE(c.hasMulticastPolicy());
+
+	auto soap = soap_new1(SOAP_XML_STRICT|SOAP_XML_INDENT);
+	soap->user = &c;
+	auto *start = soap_new__trt__StartMulticastStreaming(soap);
+	auto *start_resp = soap_new__trt__StartMulticastStreamingResponse(soap);
+	start->ProfileToken = "profile_token";
+
+	SECTION( "which the test config hasn't" ) {
+		REQUIRE(__trt__StartMulticastStreaming(soap, start, *start_resp) == SOAP_FAULT);
+		REQUIRE(std::string(*soap_faultsubcode(soap)) == "ter:Action");
+		readers.unicast = 3;
+		c.monitorStream(readers);
+		REQUIRE(!c.isMulticasting());
+		fakeit::Verify(Method(rtspServerMock, setMulticast)).Never();
+	}
+
+	SECTION( "nor a profile that doesn't exist" ) {
+		start->ProfileToken = "foo";
+		REQUIRE(__trt__StartMulticastStreaming(soap, start, *start_resp) == SOAP_FAULT);
+		REQUIRE(std::string(*soap_faultsubcode(soap)) == "ter:InvalidArgVal");
+	}
+
+	auto *vec = c.getCurrentVideoEncoderConfiguration()->soap_dup(soap);
+	vec->Multicast->Address->IPv4Address = soap_new_std__string(soap);
+	*vec->Multicast->Address->IPv4Address = "239.0.0.1";
+	vec->Multicast->Port = 5004;
+	REQUIRE(c.setVideoEncoderConfiguration(vec));
+
+	SECTION( "when asked" ) {
+		REQUIRE(__trt__StartMulticastStreaming(soap, start, *start_resp) == SOAP_OK);
+		REQUIRE(c.isMulticasting());
+		fakeit::Verify(Method(rtspServerMock, setMulticast).Matching([] (const tt__MulticastConfiguration *multicast, bool only) {
+			return multicast != nullptr && multicast->Port == 5004 && !only;
+		})).Once();
+
+		auto *stop = soap_new__trt__StopMulticastStreaming(soap);
+		stop->ProfileToken = "profile_token";
+		REQUIRE(__trt__StopMulticastStreaming(soap, stop, *soap_new__trt__StopMulticastStreamingResponse(soap)) == SOAP_OK);
+		REQUIRE(!c.isMulticasting());
+		fakeit::Verify(Method(rtspServerMock, setMulticast).Matching([] (const tt__MulticastConfiguration *multicast, bool only) {
+			return multicast == nullptr;
+		})).Once();
+	}
+
+	SECTION( "or by itself, until nobody's watching" ) {
+		readers.unicast = 2;
+		c.monitorStream(readers);
+		REQUIRE(!c.isMulticasting());
+		readers.unicast = 3;
+		c.monitorStream(readers);
+		REQUIRE(c.isMulticasting());
+		fakeit::Verify(Method(rtspServerMock, setMulticast).Matching([] (const tt__MulticastConfiguration *multicast, bool only) {
+			return multicast != nullptr && only;
+		})).Once();
+
+		readers = {1, 4};
+		c.monitorStream(readers);
+		REQUIRE(c.isMulticasting());
+		readers = {0, 0};
+		c.monitorStream(readers);
+		REQUIRE(!c.isMulticasting());
+	}
+
+	std::string current_token = "profile_token";
+	std::string other_token = "other";
+	auto *other = c.getMinimumProfile(current_token)->soap_dup(soap);
+	other->ProfileToken = other_token;
+	REQUIRE(c.setProfile(other));
+
+	SECTION( "but a request doesn't follow the stream to another profile" ) {
+		REQUIRE(__trt__StartMulticastStreaming(soap, start, *start_resp) == SOAP_OK);
+		REQUIRE(c.setCurrentProfile(other_token));
+		REQUIRE(!c.isMulticasting());
+		fakeit::Verify(Method(rtspServerMock, setMulticast).Matching([] (const tt__MulticastConfiguration *multicast, bool only) {
+			return multicast == nullptr;
+		})).Once();
+	}
+
+	SECTION( "whereas the policy does, with the new profile's group" ) {
+		readers.unicast = 3;
+		c.monitorStream(readers);
+		REQUIRE(c.setCurrentProfile(other_token));
+		REQUIRE(c.isMulticasting());
+		fakeit::Verify(Method(rtspServerMock, setMulticast).Matching([] (const tt__MulticastConfiguration *multicast, bool only) {
+			return multicast != nullptr && only;
+		})).Twice();
+	}
+
+	soap_destroy(soap);
+	soap_end(soap);
+	soap_free(soap);
+}
@@ -0,0 +1,256 @@
+// Copyright 2023 Morse Micro
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include "catch.hpp"
+#include "fakeit.hpp"
+#include "../camera.h"
+#include "../soaplib/soapStub.h"
+
+
+TEST_CASE( "Media2 GetProfiles returns every configuration at once with Type=All", "[media2]" ) {
+	fakeit::Mock<RtspServer> rtspServerMock;
+	Camera c("localhost", "localhost", "tests/camera_properties.xml", "tests/camera_configuration.xml", &(rtspServerMock.get()));
+
+	auto soap = soap_new1(SOAP_XML_STRICT|SOAP_XML_INDENT);
+	soap->user = &c;
+	auto *req = soap_new__tr2__GetProfiles(soap);
+	auto *resp = soap_new__tr2__GetProfilesResponse(soap);
+
+	SECTION( "with Type=All" ) {
+		req->Type.push_back("All");
+		REQUIRE(__tr2__GetProfiles(soap, req, *resp) == SOAP_OK);
+		REQUIRE(resp->Profiles.size() == 1);
+		auto *profile = resp->Profiles.at(0);
+		REQUIRE(profile->Name == "Default profile");
+		REQUIRE(profile->token == "profile_token");
+		REQUIRE(*profile->fixed);
+		REQUIRE(profile->Configurations->VideoSource->token == "video_source_configuration_token");
+		auto *vec2 = profile->Configurations->VideoEncoder;
+		REQUIRE(vec2->token == "video_encoder_configuration_token");
+		REQUIRE(vec2->Encoding == "H264");
+		REQUIRE(*vec2->Profile == "High");
+		REQUIRE(*vec2->GovLength == 60);
+		REQUIRE(vec2->Resolution->Width == 1280);
+		REQUIRE(vec2->RateControl->FrameRateLimit == 30);
+		REQUIRE(vec2->RateControl->BitrateLimit == 1000);
+	}
+
+	SECTION( "with only some types" ) {
+		req->Type.push_back("VideoEncoder");
+		REQUIRE(__tr2__GetProfiles(soap, req, *resp) == SOAP_OK);
+		REQUIRE(resp->Profiles.at(0)->Configurations->VideoSource == nullptr);
+		REQUIRE(resp->Profiles.at(0)->Configurations->VideoEncoder != nullptr);
+	}
+
+	SECTION( "or none" ) {
+		REQUIRE(__tr2__GetProfiles(soap, req, *resp) == SOAP_OK);
+		REQUIRE(resp->Profiles.at(0)->Configurations == nullptr);
+	}
+
+	SECTION( "but not of a profile that doesn't exist" ) {
+		req->Token = soap_new_std__string(soap);
+		*req->Token = "no_such_profile";
+		REQUIRE(__tr2__GetProfiles(soap, req, *resp) == SOAP_FAULT);
+		REQUIRE(std::string(*soap_faultsubcode(soap)) == "ter:InvalidArgVal");
+	}
+
+	soap_destroy(soap);
+	soap_end(soap);
+	soap_free(soap);
+}
+
+TEST_CASE( "Media2 GetVideoEncoderConfigurationOptions includes H.265 if the RTSP server can", "[media2]" ) {
+	fakeit::Mock<RtspServer> rtspServerMock;
+	Camera c("localhost", "localhost", "tests/camera_properties.xml", "tests/camera_configuration.xml", &(rtspServerMock.get()));
+
+	auto soap = soap_new1(SOAP_XML_STRICT|SOAP_XML_INDENT);
+	soap->user = &c;
+	auto *req = soap_new_tr2__GetConfiguration(soap);
+	auto *resp = soap_new__tr2__GetVideoEncoderConfigurationOptionsResponse(soap);
+
+	SECTION( "when it can" ) {
+		fakeit::When(Method(rtspServerMock, supportsH265)).AlwaysReturn(true);
+		REQUIRE(__tr2__GetVideoEncoderConfigurationOptions(soap, req, *resp) == SOAP_OK);
+		REQUIRE(resp->Options.size() == 2);
+		auto *h264 = resp->Options.at(0);
+		REQUIRE(h264->Encoding == "H264");
+		REQUIRE(*h264->ProfilesSupported == "High");
+		REQUIRE(*h264->GovLengthRange == "60 60");
+		REQUIRE(*h264->FrameRatesSupported == "30");
+		REQUIRE(h264->ResolutionsAvailable.at(0)->Height == 720);
+		auto *h265 = resp->Options.at(1);
+		REQUIRE(h265->Encoding == "H265");
+		REQUIRE(*h265->ProfilesSupported == "Main");
+	}
+
+	SECTION( "when it can't" ) {
+		fakeit::When(Method(rtspServerMock, supportsH265)).AlwaysReturn(false);
+		REQUIRE(__tr2__GetVideoEncoderConfigurationOptions(soap, req, *resp) == SOAP_OK);
+		REQUIRE(resp->Options.size() == 1);
+	}
+
+	soap_destroy(soap);
+	soap_end(soap);
+	soap_free(soap);
+}
+
+TEST_CASE( "Media2 SetVideoEncoderConfiguration switches between H.264 and H.265", "[media2]" ) {
+	fakeit::Mock<RtspServer> rtspServerMock;
+	fakeit::Fake(Method(rtspServerMock, initialise));
+	fakeit::Fake(Method(rtspServerMock, setVideoEncoderConfiguration));
+	fakeit::When(Method(rtspServerMock, supportsH265)).AlwaysReturn(true);
+	Camera c("localhost", "localhost", "tests/camera_properties.xml", "tests/camera_configuration.xml", &(rtspServerMock.get()));
+	REQUIRE(c.initialiseRtspServer());
+
+	auto soap = soap_new1(SOAP_XML_STRICT|SOAP_XML_INDENT);
+	soap->user = &c;
+	auto *get = soap_new_tr2__GetConfiguration(soap);
+	auto *get_resp = soap_new__tr2__GetVideoEncoderConfigurationsResponse(soap);
+	REQUIRE(__tr2__GetVideoEncoderConfigurations(soap, get, *get_resp) == SOAP_OK);
+	REQUIRE(get_resp->Configurations.size() == 1);
+	auto *vec2 = get_resp->Configurations.at(0)->soap_dup(soap);
+	std::string token = vec2->token;
+
+	auto *req = soap_new__tr2__SetVideoEncoderConfiguration(soap);
+	auto *resp = soap_new_tr2__SetConfigurationResponse(soap);
+	req->Configuration = vec2;
+
+	SECTION( "to H.265 and back" ) {
+		vec2->Encoding = "H265";
+		*vec2->Profile = "Main";
+		REQUIRE(__tr2__SetVideoEncoderConfiguration(soap, req, *resp) == SOAP_OK);
+		REQUIRE(c.getH265Configuration(token)->H265Profile == tt__VideoEncodingProfiles::Main);
+		REQUIRE(c.getVideoEncoderConfiguration(token)->Encoding == tt__VideoEncoding::H264);
+		fakeit::Verify(Method(rtspServerMock, setVideoEncoderConfiguration)).Once();
+
+		get_resp = soap_new__tr2__GetVideoEncoderConfigurationsResponse(soap);
+		REQUIRE(__tr2__GetVideoEncoderConfigurations(soap, get, *get_resp) == SOAP_OK);
+		REQUIRE(get_resp->Configurations.at(0)->Encoding == "H265");
+
+		vec2->Encoding = "H264";
+		*vec2->Profile = "High";
+		REQUIRE(__tr2__SetVideoEncoderConfiguration(soap, req, *resp) == SOAP_OK);
+		REQUIRE(c.getH265Configuration(token) == nullptr);
+		fakeit::Verify(Method(rtspServerMock, setVideoEncoderConfiguration)).Twice();
+	}
+
+	SECTION( "restarting the stream once, whatever else changes with it" ) {
+		vec2->Encoding = "H265";
+		*vec2->Profile = "Main";
+		vec2->RateControl->BitrateLimit = 2000;
+		REQUIRE(__tr2__SetVideoEncoderConfiguration(soap, req, *resp) == SOAP_OK);
+		REQUIRE(c.getVideoEncoderConfiguration(token)->RateControl->BitrateLimit == 2000);
+		REQUIRE(c.getH265Configuration(token) != nullptr);
+		fakeit::Verify(Method(rtspServerMock, setVideoEncoderConfiguration).Matching([] (const tt__VideoEncoderConfiguration *, const tt__H265Configuration *h265) {
+			return h265 != nullptr;
+		})).Once();
+	}
+
+	SECTION( "changing the rest as Media1 would" ) {
+		vec2->RateControl->BitrateLimit = 2000;
+		REQUIRE(__tr2__SetVideoEncoderConfiguration(soap, req, *resp) == SOAP_OK);
+		auto *vec = c.getVideoEncoderConfiguration(token);
+		REQUIRE(vec->RateControl->BitrateLimit == 2000);
+		REQUIRE(vec->RateControl->EncodingInterval == 1);
+		REQUIRE(vec->H264->H264Profile == tt__H264Profile::High);
+	}
+
+	SECTION( "but not to what the options don't allow" ) {
+		vec2->Encoding = "H265";
+		*vec2->Profile = "Main10";
+		REQUIRE(__tr2__SetVideoEncoderConfiguration(soap, req, *resp) == SOAP_FAULT);
+		REQUIRE(std::string(*soap_faultsubcode(soap)) == "ter:InvalidArgVal");
+		*vec2->Profile = "NotAProfile";
+		REQUIRE(__tr2__SetVideoEncoderConfiguration(soap, req, *resp) == SOAP_FAULT);
+		vec2->Encoding = "AV1";
+		REQUIRE(__tr2__SetVideoEncoderConfiguration(soap, req, *resp) == SOAP_FAULT);
+		REQUIRE(c.getH265Configuration(token) == nullptr);
+		fakeit::Verify(Method(rtspServerMock, setVideoEncoderConfiguration)).Never();
+	}
+
+	soap_destroy(soap);
+	soap_end(soap);
+	soap_free(soap);
+}
+
+TEST_CASE( "Media2 profiles can be created with their configurations", "[media2]" ) {
+	fakeit::Mock<RtspServer> rtspServerMock;
+	fakeit::Fake(Method(rtspServerMock, initialise));
+	fakeit::Fake(Method(rtspServerMock, setVideoEncoderConfiguration));
+	fakeit::Fake(Method(rtspServerMock, setVideoSourceConfiguration));
+	Camera c("localhost", "localhost", "tests/camera_properties.xml", "tests/camera_configuration.xml", &(rtspServerMock.get()));
+	REQUIRE(c.initialiseRtspServer());
+
+	auto soap = soap_new1(SOAP_XML_STRICT|SOAP_XML_INDENT);
+	soap->user = &c;
+	auto *create = soap_new__tr2__CreateProfile(soap);
+	auto *create_resp = soap_new__tr2__CreateProfileResponse(soap);
+	create->Name = "Substream";
+	for (const char *type : {"VideoSource", "VideoEncoder"}) {
+		auto *ref = soap_new_tr2__ConfigurationRef(soap);
+		ref->Type = type;
+		create->Configuration.push_back(ref);
+	}
+	REQUIRE(__tr2__CreateProfile(soap, create, *create_resp) == SOAP_OK);
+	std::string token = create_resp->Token;
+	auto *mp = c.getMinimumProfile(token);
+	REQUIRE(mp->Name == "Substream");
+	REQUIRE(*mp->VideoSourceConfigurationToken == "video_source_configuration_token");
+	REQUIRE(*mp->VideoEncoderConfigurationToken == "video_encoder_configuration_token");
+
+	SECTION( "and streamed" ) {
+		auto *uri = soap_new__tr2__GetStreamUri(soap);
+		uri->Protocol = "RtspUnicast";
+		uri->ProfileToken = token;
+		auto *uri_resp = soap_new__tr2__GetStreamUriResponse(soap);
+		REQUIRE(__tr2__GetStreamUri(soap, uri, *uri_resp) == SOAP_OK);
+		REQUIRE(uri_resp->Uri == "rtsp://localhost:8554/stream");
+		REQUIRE(c.getCurrentMinimumProfile()->ProfileToken == token);
+	}
+
+	SECTION( "and emptied again" ) {
+		auto *remove = soap_new__tr2__RemoveConfiguration(soap);
+		remove->ProfileToken = token;
+		remove->Configuration.push_back(soap_new_tr2__ConfigurationRef(soap));
+		remove->Configuration.back()->Type = "All";
+		REQUIRE(__tr2__RemoveConfiguration(soap, remove, *soap_new__tr2__RemoveConfigurationResponse(soap)) == SOAP_OK);
+		mp = c.getMinimumProfile(token);
+		REQUIRE(mp->VideoSourceConfigurationToken == nullptr);
+		REQUIRE(mp->VideoEncoderConfigurationToken == nullptr);
+
+		// But not the one being streamed.
+		remove->ProfileToken = "profile_token";
+		REQUIRE(__tr2__RemoveConfiguration(soap, remove, *soap_new__tr2__RemoveConfigurationResponse(soap)) == SOAP_FAULT);
+		REQUIRE(std::string(*soap_faultsubcode(soap)) == "ter:Action");
+	}
+
+	SECTION( "but not given configurations that don't exist" ) {
+		auto *add = soap_new__tr2__AddConfiguration(soap);
+		add->ProfileToken = token;
+		add->Configuration.push_back(soap_new_tr2__ConfigurationRef(soap));
+		add->Configuration.back()->Type = "VideoEncoder";
+		add->Configuration.back()->Token = soap_new_std__string(soap);
+		*add->Configuration.back()->Token = "no_such_configuration";
+		add->Name = soap_new_std__string(soap);
+		*add->Name = "Renamed";
+		REQUIRE(__tr2__AddConfiguration(soap, add, *soap_new__tr2__AddConfigurationResponse(soap)) == SOAP_FAULT);
+		REQUIRE(std::string(*soap_faultsubcode(soap)) == "ter:InvalidArgVal");
+		REQUIRE(*c.getMinimumProfile(token)->VideoEncoderConfigurationToken == "video_encoder_configuration_token");
+		REQUIRE(c.getMinimumProfile(token)->Name == "Substream");
+
+		add->Configuration.back()->Token = nullptr;
+		REQUIRE(__tr2__AddConfiguration(soap, add, *soap_new__tr2__AddConfigurationResponse(soap)) == SOAP_OK);
+		REQUIRE(c.getMinimumProfile(token)->Name == "Renamed");
+	}
+
+	auto *del = soap_new__tr2__DeleteProfile(soap);
+	del->Token = token;
+	std::string default_token = "profile_token";
+	REQUIRE(c.setCurrentProfile(default_token));
+	REQUIRE(__tr2__DeleteProfile(soap, del, *soap_new__tr2__DeleteProfileResponse(soap)) == SOAP_OK);
+	REQUIRE(c.getMinimumProfiles().size() == 1);
+
+	soap_destroy(soap);
+	soap_end(soap);
+	soap_free(soap);
+}
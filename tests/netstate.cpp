@@ -0,0 +1,220 @@
+// Copyright 2023 Morse Micro
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <arpa/inet.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <net/if.h>
+#include <string.h>
+
+#include <sstream>
+
+#include "catch.hpp"
+#include "fakeit.hpp"
+#include "../camera.h"
+#include "../netstate.h"
+#include "../soaplib/soapStub.h"
+
+
+// Builds netlink messages as the kernel would send them.
+class NetlinkBuffer {
+	private:
+		std::vector<char> buffer;
+		size_t message_start;
+
+		template <typename T>
+		void begin(uint16_t type, const T &body) {
+			message_start = buffer.size();
+			buffer.resize(message_start + NLMSG_SPACE(sizeof(T)));
+			auto *header = reinterpret_cast<nlmsghdr *>(&buffer[message_start]);
+			header->nlmsg_type = type;
+			memcpy(NLMSG_DATA(header), &body, sizeof(T));
+		}
+
+		void attr(uint16_t type, const void *data, size_t length) {
+			size_t start = buffer.size();
+			buffer.resize(start + RTA_SPACE(length));
+			auto *rta = reinterpret_cast<rtattr *>(&buffer[start]);
+			rta->rta_type = type;
+			rta->rta_len = RTA_LENGTH(length);
+			memcpy(RTA_DATA(rta), data, length);
+		}
+
+		void end() {
+			reinterpret_cast<nlmsghdr *>(&buffer[message_start])->nlmsg_len = buffer.size() - message_start;
+		}
+
+		void ipv4Attr(uint16_t type, const char *address) {
+			in_addr parsed;
+			inet_pton(AF_INET, address, &parsed);
+			attr(type, &parsed, sizeof(parsed));
+		}
+
+	public:
+		NetlinkBuffer &link(uint16_t type, int index, const char *name, unsigned int flags) {
+			ifinfomsg info = {};
+			info.ifi_index = index;
+			info.ifi_flags = flags;
+			begin(type, info);
+			attr(IFLA_IFNAME, name, strlen(name) + 1);
+			unsigned char hw_address[] = {0x02, 0x00, 0x00, 0x00, 0x00, static_cast<unsigned char>(index)};
+			attr(IFLA_ADDRESS, hw_address, sizeof(hw_address));
+			uint32_t mtu = 1500;
+			attr(IFLA_MTU, &mtu, sizeof(mtu));
+			end();
+			return *this;
+		}
+
+		NetlinkBuffer &address(uint16_t type, int index, const char *address, int prefix_length, bool permanent) {
+			ifaddrmsg info = {};
+			info.ifa_family = AF_INET;
+			info.ifa_index = index;
+			info.ifa_prefixlen = prefix_length;
+			info.ifa_flags = permanent ? IFA_F_PERMANENT : 0;
+			begin(type, info);
+			ipv4Attr(IFA_ADDRESS, address);
+			ipv4Attr(IFA_LOCAL, address);
+			end();
+			return *this;
+		}
+
+		NetlinkBuffer &defaultRoute(uint16_t type, int index, const char *gateway) {
+			rtmsg info = {};
+			info.rtm_family = AF_INET;
+			info.rtm_table = RT_TABLE_MAIN;
+			info.rtm_type = RTN_UNICAST;
+			begin(type, info);
+			ipv4Attr(RTA_GATEWAY, gateway);
+			attr(RTA_OIF, &index, sizeof(index));
+			end();
+			return *this;
+		}
+
+		const void *data() const { return buffer.data(); }
+		size_t size() const { return buffer.size(); }
+};
+
+
+TEST_CASE( "NetworkState follows links, addresses and routes", "[netstate]" ) {
+	NetworkState state("");
+	NetlinkBuffer initial;
+	initial.link(RTM_NEWLINK, 1, "lo", IFF_UP | IFF_LOOPBACK)
+	       .link(RTM_NEWLINK, 2, "wlan0", IFF_UP)
+	       .address(RTM_NEWADDR, 1, "127.0.0.1", 8, true)
+	       .address(RTM_NEWADDR, 2, "192.168.1.10", 24, false)
+	       .defaultRoute(RTM_NEWROUTE, 2, "192.168.1.1");
+	REQUIRE(state.apply(initial.data(), initial.size()));
+
+	auto snapshot = state.get();
+	REQUIRE(snapshot->interfaces.size() == 2);
+	auto &wlan0 = snapshot->interfaces.at(2);
+	REQUIRE(wlan0.name == "wlan0");
+	REQUIRE(wlan0.hw_address == "02:00:00:00:00:02");
+	REQUIRE(wlan0.mtu == 1500);
+	REQUIRE(wlan0.up);
+	REQUIRE(!wlan0.loopback);
+	REQUIRE(wlan0.ipv4.size() == 1);
+	REQUIRE(wlan0.ipv4[0].prefix_length == 24);
+	REQUIRE(wlan0.ipv4[0].dynamic);
+	REQUIRE(snapshot->interfaces.at(1).loopback);
+	REQUIRE(snapshot->primaryIPv4("wlan0") == "192.168.1.10");
+	REQUIRE(snapshot->ipv4_gateways.size() == 1);
+	REQUIRE(snapshot->ipv4_gateways[0].address == "192.168.1.1");
+	REQUIRE(snapshot->ipv4_gateways[0].interface_index == 2);
+
+	// Repeats change nothing, so don't publish.
+	REQUIRE(!state.apply(initial.data(), initial.size()));
+	REQUIRE(state.get() == snapshot);
+
+	// A DHCP renewal with a new address.
+	NetlinkBuffer renewal;
+	renewal.address(RTM_DELADDR, 2, "192.168.1.10", 24, false)
+	       .address(RTM_NEWADDR, 2, "192.168.1.20", 24, false);
+	REQUIRE(state.apply(renewal.data(), renewal.size()));
+	REQUIRE(state.get()->primaryIPv4("wlan0") == "192.168.1.20");
+	REQUIRE(state.get()->version > snapshot->version);
+	// The old snapshot is untouched for anyone still using it.
+	REQUIRE(snapshot->primaryIPv4("wlan0") == "192.168.1.10");
+
+	NetlinkBuffer removal;
+	removal.link(RTM_DELLINK, 2, "wlan0", 0);
+	REQUIRE(state.apply(removal.data(), removal.size()));
+	REQUIRE(state.get()->primaryIPv4("wlan0") == "");
+	REQUIRE(state.get()->ipv4_gateways.empty());
+}
+
+
+TEST_CASE( "NetworkState tells listeners about changes", "[netstate]" ) {
+	NetworkState state("");
+	std::vector<std::string> seen;
+	state.onChange([&seen] (const NetworkState::Snapshot &snapshot) {
+		seen.push_back(snapshot.primaryIPv4("eth0"));
+	});
+
+	NetlinkBuffer messages;
+	messages.link(RTM_NEWLINK, 3, "eth0", IFF_UP)
+	        .address(RTM_NEWADDR, 3, "10.0.0.2", 8, true);
+	state.apply(messages.data(), messages.size());
+	state.apply(messages.data(), messages.size());
+
+	REQUIRE(seen == std::vector<std::string>{"10.0.0.2"});
+	REQUIRE(!state.get()->interfaces.at(3).ipv4[0].dynamic);
+}
+
+
+TEST_CASE( "NetworkState parses resolv.conf", "[netstate]" ) {
+	std::istringstream resolv_conf(
+		"# Generated by dhcpcd\n"
+		"domain example.com\n"
+		"search lan example.com  # trailing comment\n"
+		"nameserver 192.168.1.1\n"
+		"nameserver fe80::1\n"
+		"options edns0\n"
+		"nameserver 8.8.8.8\n");
+	std::vector<std::string> nameservers, search_domains;
+	NetworkState::parseResolvConf(resolv_conf, &nameservers, &search_domains);
+
+	REQUIRE(nameservers == std::vector<std::string>{"192.168.1.1", "8.8.8.8"});
+	REQUIRE(search_domains == std::vector<std::string>{"lan", "example.com"});
+}
+
+
+TEST_CASE( "Network configuration is reported from NetworkState", "[netstate][devicemgmt]" ) {
+	fakeit::Mock<RtspServer> rtspServerMock;
+	Camera c("http://192.168.1.10:8080", "192.168.1.10", "tests/camera_properties.xml", "tests/camera_configuration.xml", &(rtspServerMock.get()));
+	NetworkState state("");
+	NetlinkBuffer messages;
+	messages.link(RTM_NEWLINK, 1, "lo", IFF_UP | IFF_LOOPBACK)
+	        .link(RTM_NEWLINK, 2, "wlan0", IFF_UP)
+	        .address(RTM_NEWADDR, 2, "192.168.1.10", 24, false)
+	        .defaultRoute(RTM_NEWROUTE, 2, "192.168.1.1");
+	state.apply(messages.data(), messages.size());
+	c.setNetworkState(&state);
+
+	auto soap = soap_new1(SOAP_XML_STRICT|SOAP_XML_INDENT);
+	soap->user = &c;
+
+	auto *interfaces = soap_new__tds__GetNetworkInterfacesResponse(soap);
+	REQUIRE(__tds__GetNetworkInterfaces(soap, soap_new__tds__GetNetworkInterfaces(soap), *interfaces) == SOAP_OK);
+	REQUIRE(interfaces->NetworkInterfaces.size() == 1);
+	auto *wlan0 = interfaces->NetworkInterfaces[0];
+	REQUIRE(wlan0->token == "wlan0");
+	REQUIRE(wlan0->Info->HwAddress == "02:00:00:00:00:02");
+	REQUIRE(*wlan0->Info->MTU == 1500);
+	REQUIRE(wlan0->IPv4->Config->DHCP);
+	REQUIRE(wlan0->IPv4->Config->FromDHCP->Address == "192.168.1.10");
+	REQUIRE(wlan0->IPv4->Config->FromDHCP->PrefixLength == 24);
+	REQUIRE(wlan0->IPv4->Config->Manual.empty());
+
+	auto *gateway = soap_new__tds__GetNetworkDefaultGatewayResponse(soap);
+	REQUIRE(__tds__GetNetworkDefaultGateway(soap, soap_new__tds__GetNetworkDefaultGateway(soap), *gateway) == SOAP_OK);
+	REQUIRE(gateway->NetworkGateway->IPv4Address == std::vector<std::string>{"192.168.1.1"});
+
+	auto *dns = soap_new__tds__GetDNSResponse(soap);
+	REQUIRE(__tds__GetDNS(soap, soap_new__tds__GetDNS(soap), *dns) == SOAP_OK);
+	REQUIRE(dns->DNSInformation->FromDHCP);
+
+	soap_destroy(soap);
+	soap_end(soap);
+	soap_free(soap);
+}
@@ -0,0 +1,127 @@
+// Copyright 2023 Morse Micro
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "catch.hpp"
+#include "../rtspprobe.h"
+#include "../rtspserver_process.h"
+
+
+// Listens on an ephemeral port on localhost.
+static int listen_locally(int *port) {
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	struct sockaddr_in address = {};
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	socklen_t length = sizeof(address);
+	REQUIRE(bind(fd, reinterpret_cast<struct sockaddr *>(&address), length) == 0);
+	REQUIRE(listen(fd, 1) == 0);
+	getsockname(fd, reinterpret_cast<struct sockaddr *>(&address), &length);
+	*port = ntohs(address.sin_port);
+	return fd;
+}
+
+
+// Answers DESCRIBE, SETUP and PLAY (keeping the requests), and (if rtp_delay_ms >= 0) sends an
+// interleaved packet that long after PLAY.
+static void serve_rtsp(int listener, int rtp_delay_ms, std::vector<std::string> *requests) {
+	int fd = accept(listener, nullptr, nullptr);
+	std::string received;
+	char data[1024];
+	for (int cseq = 1; cseq <= 3; ++cseq) {
+		while (received.find("\r\n\r\n") == std::string::npos) {
+			ssize_t count = recv(fd, data, sizeof(data), 0);
+			if (count <= 0) {
+				close(fd);
+				return;
+			}
+			received.append(data, count);
+		}
+		std::string request = received.substr(0, received.find("\r\n\r\n"));
+		received.erase(0, request.size() + 4);
+		requests->push_back(request);
+
+		std::string response = "RTSP/1.0 200 OK\r\nCSeq: " + std::to_string(cseq) + "\r\n";
+		if (request.compare(0, 8, "DESCRIBE") == 0) {
+			std::string sdp = "v=0\r\nm=audio 0 RTP/AVP 0\r\na=control:trackID=0\r\nm=video 0 RTP/AVP 96\r\na=control:trackID=1\r\n";
+			response += "Content-Type: application/sdp\r\nContent-Length: " + std::to_string(sdp.size()) + "\r\n\r\n" + sdp;
+		} else if (request.compare(0, 5, "SETUP") == 0) {
+			response += "Session: 1234;timeout=60\r\n\r\n";
+		} else {
+			response += "\r\n";
+		}
+		send(fd, response.data(), response.size(), 0);
+	}
+	if (rtp_delay_ms >= 0) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(rtp_delay_ms));
+		send(fd, "$\0\0\4abcd", 8, 0);
+	}
+	recv(fd, data, sizeof(data), 0);
+	close(fd);
+}
+
+
+TEST_CASE( "RTSP probe times how long the first frame takes", "[rtspprobe]" ) {
+	int port;
+	int listener = listen_locally(&port);
+	std::string url = "rtsp://127.0.0.1:" + std::to_string(port) + "/stream";
+
+	std::vector<std::string> requests;
+
+	SECTION( "when there is one" ) {
+		std::thread server(serve_rtsp, listener, 100, &requests);
+		long latency = rtsp_time_to_first_frame(url, 2000);
+		server.join();
+		REQUIRE(latency >= 100);
+		REQUIRE(latency < 2000);
+
+		// Of the video track.
+		REQUIRE(requests.size() == 3);
+		REQUIRE(requests[1].find("SETUP " + url + "/trackID=1 ") == 0);
+		REQUIRE(requests[2].find("Session: 1234\r\n") != std::string::npos);
+	}
+
+	SECTION( "or gives up" ) {
+		std::thread server(serve_rtsp, listener, -1, &requests);
+		REQUIRE(rtsp_time_to_first_frame(url, 200) == -1);
+		server.join();
+	}
+
+	close(listener);
+}
+
+
+TEST_CASE( "Process RTSP servers count connections as viewers", "[rtspprobe][rtspserver]" ) {
+	int port;
+	int listener = listen_locally(&port);
+	RtspServerT31rtspd server("t31rtspd", std::to_string(port), "stream");
+
+	RtspServer::Readers readers;
+	REQUIRE(server.getReaders(&readers));
+	REQUIRE(readers.unicast == 0);
+
+	// Before it's accepted, as when the server's suspended.
+	int client = socket(AF_INET, SOCK_STREAM, 0);
+	struct sockaddr_in address = {};
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	address.sin_port = htons(port);
+	REQUIRE(connect(client, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)) == 0);
+	REQUIRE(server.getReaders(&readers));
+	REQUIRE(readers.unicast == 1);
+
+	// Not running, so there's nothing to suspend.
+	REQUIRE(!server.suspend());
+	REQUIRE(!server.resume());
+
+	close(client);
+	close(listener);
+}
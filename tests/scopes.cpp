@@ -0,0 +1,83 @@
+// Copyright 2023 Morse Micro
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include "catch.hpp"
+#include "../scopes.h"
+#include "../soaplib/stdsoap2.h"
+
+
+static const char *RFC3986 = "http://schemas.xmlsoap.org/ws/2005/04/discovery/rfc3986";
+static const char *STRCMP0 = "http://schemas.xmlsoap.org/ws/2005/04/discovery/strcmp0";
+
+
+static DiscoveryMatcher make_matcher() {
+	return DiscoveryMatcher("tdn:NetworkVideoTransmitter tds:Device", {
+		"onvif://www.onvif.org/type/video_encoder",
+		"onvif://www.onvif.org/hardware/RD02",
+		"onvif://www.onvif.org/location/building%201/floor2",
+	}, namespaces);
+}
+
+
+TEST_CASE( "Probes without types or scopes match", "[scopes]" ) {
+	auto matcher = make_matcher();
+	REQUIRE(matcher.matches(nullptr, nullptr, nullptr));
+	REQUIRE(matcher.matches("", "", nullptr));
+}
+
+
+TEST_CASE( "Probe types must all be ours", "[scopes]" ) {
+	auto matcher = make_matcher();
+	REQUIRE(matcher.matches("tdn:NetworkVideoTransmitter", nullptr, nullptr));
+	REQUIRE(matcher.matches("tds:Device tdn:NetworkVideoTransmitter", nullptr, nullptr));
+	REQUIRE(matcher.matches("\"http://www.onvif.org/ver10/network/wsdl\":NetworkVideoTransmitter", nullptr, nullptr));
+	REQUIRE(!matcher.matches("tdn:NetworkVideoTransmitter tdn:Printer", nullptr, nullptr));
+	REQUIRE(!matcher.matches("\"http://example.com/other\":NetworkVideoTransmitter", nullptr, nullptr));
+}
+
+
+TEST_CASE( "rfc3986 matching is a segment-wise prefix match", "[scopes]" ) {
+	auto matcher = make_matcher();
+	for (const char *match_by : {static_cast<const char *>(nullptr), RFC3986}) {
+		REQUIRE(matcher.matches(nullptr, "onvif://www.onvif.org/type/video_encoder", match_by));
+		REQUIRE(matcher.matches(nullptr, "onvif://www.onvif.org/type", match_by));
+		REQUIRE(matcher.matches(nullptr, "onvif://www.onvif.org/type/", match_by));
+		REQUIRE(matcher.matches(nullptr, "ONVIF://WWW.ONVIF.ORG/hardware/RD02", match_by));
+		REQUIRE(matcher.matches(nullptr, "onvif://www.onvif.org/location/building 1", match_by) == false);
+		REQUIRE(matcher.matches(nullptr, "onvif://www.onvif.org/location/building%201", match_by));
+		REQUIRE(matcher.matches(nullptr, "onvif://www.onvif.org/hardware/RD02?q=1#f", match_by));
+		REQUIRE(matcher.matches(nullptr, "onvif://www.onvif.org/type onvif://www.onvif.org/hardware", match_by));
+
+		REQUIRE(!matcher.matches(nullptr, "onvif://www.onvif.org/hardware/rd02", match_by));
+		REQUIRE(!matcher.matches(nullptr, "onvif://www.onvif.org/hard", match_by));
+		REQUIRE(!matcher.matches(nullptr, "onvif://www.onvif.org/type/video_encoder/more", match_by));
+		REQUIRE(!matcher.matches(nullptr, "onvif://www.onvif.org/type/../hardware", match_by));
+		REQUIRE(!matcher.matches(nullptr, "onvif://www.onvif.org/type onvif://www.onvif.org/name", match_by));
+		REQUIRE(!matcher.matches(nullptr, "relative/path", match_by));
+	}
+}
+
+
+TEST_CASE( "strcmp0 matching is exact", "[scopes]" ) {
+	auto matcher = make_matcher();
+	REQUIRE(matcher.matches(nullptr, "onvif://www.onvif.org/hardware/RD02", STRCMP0));
+	REQUIRE(!matcher.matches(nullptr, "onvif://www.onvif.org/hardware", STRCMP0));
+	REQUIRE(!matcher.matches(nullptr, "ONVIF://www.onvif.org/hardware/RD02", STRCMP0));
+}
+
+
+TEST_CASE( "Unknown matching rules match nothing", "[scopes]" ) {
+	auto matcher = make_matcher();
+	REQUIRE(!matcher.matches(nullptr, "onvif://www.onvif.org/type", "http://schemas.xmlsoap.org/ws/2005/04/discovery/ldap"));
+	// ... unless there's nothing to match.
+	REQUIRE(matcher.matches(nullptr, nullptr, "http://schemas.xmlsoap.org/ws/2005/04/discovery/ldap"));
+}
+
+
+TEST_CASE( "Types and scopes lists", "[scopes]" ) {
+	auto matcher = make_matcher();
+	REQUIRE(matcher.getTypes() == "tdn:NetworkVideoTransmitter tds:Device");
+	REQUIRE(matcher.getScopes() == "onvif://www.onvif.org/type/video_encoder onvif://www.onvif.org/hardware/RD02 "
+	                               "onvif://www.onvif.org/location/building%201/floor2");
+	REQUIRE(scope_encode("Camera 2/b") == "Camera%202%2Fb");
+}
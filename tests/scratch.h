@@ -0,0 +1,86 @@
+/*
+ * Copyright 2023 Morse Micro
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#pragma once
+
+#include <dirent.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <iterator>
+#include <string>
+
+#include "catch.hpp"
+
+
+/* A temporary directory, removed with whatever's in it when this goes out of scope
+ * (so also when a REQUIRE fails).
+ */
+class ScratchDir {
+	public:
+		std::string dir;
+
+		ScratchDir() {
+			char dir_template[] = "/tmp/onvif-test-XXXXXX";
+			dir = mkdtemp(dir_template);
+		}
+
+		~ScratchDir() {
+			if (DIR *d = opendir(dir.c_str())) {
+				while (struct dirent *entry = readdir(d)) {
+					std::string name = entry->d_name;
+					if (name != "." && name != "..") {
+						unlink(path(name).c_str());
+					}
+				}
+				closedir(d);
+			}
+			rmdir(dir.c_str());
+		}
+
+		ScratchDir(const ScratchDir &) = delete;
+		ScratchDir &operator=(const ScratchDir &) = delete;
+
+		std::string path(const std::string &name) const {
+			return dir + "/" + name;
+		}
+
+		static std::string read(const std::string &path) {
+			std::ifstream in(path, std::ios::binary);
+			return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+		}
+
+		static void write(const std::string &path, const std::string &data) {
+			std::ofstream(path, std::ios::binary) << data;
+		}
+
+		static void copy(const std::string &from, const std::string &to) {
+			write(to, read(from));
+		}
+
+		// Replaces the first from in path's contents.
+		static void edit(const std::string &path, const std::string &from, const std::string &to) {
+			std::string data = read(path);
+			size_t at = data.find(from);
+			REQUIRE(at != std::string::npos);
+			write(path, data.replace(at, from.size(), to));
+		}
+};
+
+/* A scratch directory with copies of a properties file (by default a non-dummy one,
+ * so the camera saves) and the test config.
+ */
+class ScratchConfig : public ScratchDir {
+	public:
+		std::string properties;
+		std::string config;
+
+		explicit ScratchConfig(const std::string &properties_source = "tests/camera_properties_nvtrtspd_noexec.xml")
+				: properties(path("properties.xml")), config(path("config.xml")) {
+			copy(properties_source, properties);
+			copy("tests/camera_configuration.xml", config);
+		}
+};
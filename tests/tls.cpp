@@ -0,0 +1,239 @@
+// Copyright 2023 Morse Micro
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+// Only built with TLS=1.
+#ifdef WITH_OPENSSL
+
+#include <openssl/evp.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "catch.hpp"
+#include "../tls.h"
+
+
+using ContextPtr = std::unique_ptr<SSL_CTX, decltype(&SSL_CTX_free)>;
+using SessionPtr = std::unique_ptr<SSL_SESSION, decltype(&SSL_SESSION_free)>;
+
+
+static EVP_PKEY *generate_key(int type) {
+	EVP_PKEY *key = nullptr;
+	EVP_PKEY_CTX *ctx = EVP_PKEY_CTX_new_id(type, nullptr);
+	EVP_PKEY_keygen_init(ctx);
+	if (type == EVP_PKEY_RSA) {
+		EVP_PKEY_CTX_set_rsa_keygen_bits(ctx, 2048);
+	} else {
+		EVP_PKEY_CTX_set_ec_paramgen_curve_nid(ctx, NID_X9_62_prime256v1);
+	}
+	EVP_PKEY_keygen(ctx, &key);
+	EVP_PKEY_CTX_free(ctx);
+	return key;
+}
+
+// As start_server would set it up, with a self-signed certificate for a new key of type.
+static ContextPtr server_context(int type, const std::string &ciphers = "") {
+	EVP_PKEY *key = generate_key(type);
+	X509 *cert = X509_new();
+	X509_set_version(cert, 2);
+	ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+	X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+	X509_gmtime_adj(X509_getm_notAfter(cert), 24 * 60 * 60);
+	X509_set_pubkey(cert, key);
+	X509_NAME *name = X509_get_subject_name(cert);
+	X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, reinterpret_cast<const unsigned char *>("camera"), -1, -1, 0);
+	X509_set_issuer_name(cert, name);
+	X509_sign(cert, key, EVP_sha256());
+
+	ContextPtr ctx(SSL_CTX_new(TLS_server_method()), SSL_CTX_free);
+	SSL_CTX_use_certificate(ctx.get(), cert);
+	SSL_CTX_use_PrivateKey(ctx.get(), key);
+	SSL_CTX_set_min_proto_version(ctx.get(), TLS1_2_VERSION);
+	// gsoap's default.
+	SSL_CTX_set_options(ctx.get(), SSL_OP_NO_TICKET);
+	REQUIRE(configure_tls_context(ctx.get(), ciphers));
+	X509_free(cert);
+	EVP_PKEY_free(key);
+	return ctx;
+}
+
+static ContextPtr client_context(int max_version = 0) {
+	ContextPtr ctx(SSL_CTX_new(TLS_client_method()), SSL_CTX_free);
+	SSL_CTX_set_verify(ctx.get(), SSL_VERIFY_NONE, nullptr);
+	SSL_CTX_set_max_proto_version(ctx.get(), max_version);
+	return ctx;
+}
+
+
+// A client and server connected by memory BIOs.
+struct Connection {
+	SSL *client;
+	SSL *server;
+
+	Connection(SSL_CTX *server_ctx, SSL_CTX *client_ctx, SSL_SESSION *session = nullptr) {
+		client = SSL_new(client_ctx);
+		server = SSL_new(server_ctx);
+		BIO *client_bio, *server_bio;
+		BIO_new_bio_pair(&client_bio, 0, &server_bio, 0);
+		SSL_set_bio(client, client_bio, client_bio);
+		SSL_set_bio(server, server_bio, server_bio);
+		SSL_set_connect_state(client);
+		SSL_set_accept_state(server);
+		if (session != nullptr) {
+			SSL_set_session(client, session);
+		}
+	}
+
+	~Connection() {
+		// Without a close_notify, OpenSSL won't resume the session (in case it was cut short).
+		SSL_shutdown(client);
+		SSL_shutdown(server);
+		SSL_free(client);
+		SSL_free(server);
+	}
+
+	bool handshake() {
+		for (int i = 0; i < 10; ++i) {
+			int client_result = SSL_do_handshake(client);
+			int server_result = SSL_do_handshake(server);
+			if (client_result == 1 && server_result == 1) {
+				return true;
+			}
+			for (auto &side : {std::make_pair(client, client_result), std::make_pair(server, server_result)}) {
+				int error = side.second == 1 ? SSL_ERROR_NONE : SSL_get_error(side.first, side.second);
+				if (error != SSL_ERROR_NONE && error != SSL_ERROR_WANT_READ && error != SSL_ERROR_WANT_WRITE) {
+					return false;
+				}
+			}
+		}
+		return false;
+	}
+
+	// What the client can resume with next time. With TLS 1.3, that's in a ticket that
+	// comes after the handshake, so the client has to read something first.
+	SessionPtr session() {
+		char byte = 0;
+		SSL_write(server, &byte, 1);
+		SSL_read(client, &byte, 1);
+		return SessionPtr(SSL_get1_session(client), SSL_SESSION_free);
+	}
+
+	bool resumed() {
+		return SSL_session_reused(server) == 1;
+	}
+
+	std::string cipher() {
+		return SSL_get_cipher_name(server);
+	}
+};
+
+// A full handshake, then one resuming its session.
+static bool resumes(SSL_CTX *server_ctx, SSL_CTX *client_ctx) {
+	Connection first(server_ctx, client_ctx);
+	REQUIRE(first.handshake());
+	REQUIRE(!first.resumed());
+	auto session = first.session();
+
+	Connection second(server_ctx, client_ctx, session.get());
+	REQUIRE(second.handshake());
+	return second.resumed();
+}
+
+static std::string negotiated_cipher(SSL_CTX *server_ctx, const std::string &client_ciphersuites) {
+	auto client_ctx = client_context();
+	SSL_CTX_set_ciphersuites(client_ctx.get(), client_ciphersuites.c_str());
+	Connection connection(server_ctx, client_ctx.get());
+	REQUIRE(connection.handshake());
+	return connection.cipher();
+}
+
+
+TEST_CASE( "TLS sessions can be resumed", "[tls]" ) {
+	auto server_ctx = server_context(EVP_PKEY_EC);
+
+	SECTION( "with a TLS 1.3 ticket" ) {
+		REQUIRE(resumes(server_ctx.get(), client_context().get()));
+	}
+
+	SECTION( "with a TLS 1.2 ticket" ) {
+		REQUIRE(resumes(server_ctx.get(), client_context(TLS1_2_VERSION).get()));
+	}
+
+	SECTION( "with a TLS 1.2 session ID" ) {
+		auto client_ctx = client_context(TLS1_2_VERSION);
+		SSL_CTX_set_options(client_ctx.get(), SSL_OP_NO_TICKET);
+		REQUIRE(resumes(server_ctx.get(), client_ctx.get()));
+	}
+
+	SECTION( "but not by another server" ) {
+		auto client_ctx = client_context();
+		Connection first(server_ctx.get(), client_ctx.get());
+		REQUIRE(first.handshake());
+		auto session = first.session();
+
+		auto other_ctx = server_context(EVP_PKEY_EC);
+		Connection second(other_ctx.get(), client_ctx.get(), session.get());
+		REQUIRE(second.handshake());
+		REQUIRE(!second.resumed());
+	}
+}
+
+TEST_CASE( "TLS ciphers are in our order of preference", "[tls]" ) {
+	SECTION( "ChaCha20 by default" ) {
+		auto server_ctx = server_context(EVP_PKEY_EC);
+		REQUIRE(negotiated_cipher(server_ctx.get(), "TLS_AES_128_GCM_SHA256:TLS_CHACHA20_POLY1305_SHA256") == "TLS_CHACHA20_POLY1305_SHA256");
+	}
+
+	SECTION( "AES if we'd rather, unless the client wants ChaCha20 most" ) {
+		auto server_ctx = server_context(EVP_PKEY_EC, "TLS_AES_128_GCM_SHA256:TLS_CHACHA20_POLY1305_SHA256:ECDHE-ECDSA-AES128-GCM-SHA256");
+		REQUIRE(negotiated_cipher(server_ctx.get(), "TLS_AES_256_GCM_SHA384:TLS_CHACHA20_POLY1305_SHA256:TLS_AES_128_GCM_SHA256") == "TLS_AES_128_GCM_SHA256");
+		REQUIRE(negotiated_cipher(server_ctx.get(), "TLS_CHACHA20_POLY1305_SHA256:TLS_AES_128_GCM_SHA256") == "TLS_CHACHA20_POLY1305_SHA256");
+	}
+
+	SECTION( "and there has to be one we know" ) {
+		ContextPtr ctx(SSL_CTX_new(TLS_server_method()), SSL_CTX_free);
+		REQUIRE(!configure_tls_context(ctx.get(), "NOT-A-CIPHER"));
+		REQUIRE(!configure_tls_context(ctx.get(), ":"));
+	}
+}
+
+// Run with: ./test-runner "[benchmark]"
+TEST_CASE( "TLS handshake cost, full and resumed", "[.][benchmark]" ) {
+	auto rsa_ctx = server_context(EVP_PKEY_RSA);
+	auto ec_ctx = server_context(EVP_PKEY_EC);
+	auto client_ctx = client_context();
+	auto tls12_client_ctx = client_context(TLS1_2_VERSION);
+	auto session_id_client_ctx = client_context(TLS1_2_VERSION);
+	SSL_CTX_set_options(session_id_client_ctx.get(), SSL_OP_NO_TICKET);
+
+	// Both ends' work, as they're in the same thread.
+	BENCHMARK( "full (RSA 2048)" ) {
+		Connection connection(rsa_ctx.get(), client_ctx.get());
+		return connection.handshake();
+	};
+
+	BENCHMARK( "full (ECDSA P-256)" ) {
+		Connection connection(ec_ctx.get(), client_ctx.get());
+		return connection.handshake();
+	};
+
+	std::pair<const char *, SSL_CTX *> resumptions[] = {
+		{"resumed (TLS 1.3 ticket)", client_ctx.get()},
+		{"resumed (TLS 1.2 ticket)", tls12_client_ctx.get()},
+		{"resumed (TLS 1.2 session ID)", session_id_client_ctx.get()},
+	};
+	for (auto &resumption : resumptions) {
+		Connection first(rsa_ctx.get(), resumption.second);
+		REQUIRE(first.handshake());
+		auto session = first.session();
+		BENCHMARK( std::string(resumption.first) ) {
+			Connection connection(rsa_ctx.get(), resumption.second, session.get());
+			return connection.handshake() && connection.resumed();
+		};
+	}
+}
+
+#endif
@@ -0,0 +1,168 @@
+// Copyright 2023 Morse Micro
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <netinet/in.h>
+
+#include <algorithm>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "catch.hpp"
+#include "../udpsendqueue.h"
+
+
+using Clock = UdpSendQueue::Clock;
+using std::chrono::milliseconds;
+
+
+static struct sockaddr_in some_address() {
+	struct sockaddr_in to = {};
+	to.sin_family = AF_INET;
+	to.sin_port = htons(3702);
+	return to;
+}
+
+
+// Everything the queue would send from start onwards, as offsets from start.
+static std::vector<Clock::duration> drain(UdpSendQueue *queue, Clock::time_point start) {
+	std::vector<Clock::duration> sent;
+	queue->sendDue(start + std::chrono::hours(1), [&sent, start] (const UdpSendQueue::Datagram &datagram) {
+		sent.push_back(datagram.due - start);
+	});
+	return sent;
+}
+
+
+TEST_CASE( "UdpSendQueue delays the first send by up to the maximum", "[udpsendqueue]" ) {
+	UdpSendQueue queue(1);
+	auto to = some_address();
+	auto start = Clock::now();
+
+	for (int i = 0; i < 100; ++i) {
+		queue.add(start, "hello", reinterpret_cast<struct sockaddr *>(&to), sizeof(to), milliseconds(500), 0);
+	}
+	REQUIRE(queue.timeUntilNext(start, milliseconds(1000)) <= milliseconds(500));
+
+	auto sent = drain(&queue, start);
+	REQUIRE(sent.size() == 100);
+	REQUIRE(std::is_sorted(sent.begin(), sent.end()));
+	REQUIRE(sent.front() >= Clock::duration::zero());
+	REQUIRE(sent.back() <= milliseconds(500));
+	REQUIRE(sent.back() - sent.front() > milliseconds(100));  // i.e. not all at once.
+	REQUIRE(queue.empty());
+}
+
+
+TEST_CASE( "UdpSendQueue repeats with a doubling interval", "[udpsendqueue]" ) {
+	UdpSendQueue queue(2);
+	auto to = some_address();
+	auto start = Clock::now();
+
+	queue.add(start, "hello", reinterpret_cast<struct sockaddr *>(&to), sizeof(to), Clock::duration::zero(), 3);
+	auto sent = drain(&queue, start);
+	REQUIRE(sent.size() == 4);
+	REQUIRE(sent[0] == Clock::duration::zero());
+
+	auto first_interval = sent[1] - sent[0];
+	REQUIRE(first_interval >= UdpSendQueue::UDP_MIN_DELAY);
+	REQUIRE(first_interval <= UdpSendQueue::UDP_MAX_DELAY);
+	REQUIRE(sent[2] - sent[1] == std::min<Clock::duration>(first_interval * 2, UdpSendQueue::UDP_UPPER_DELAY));
+	REQUIRE(sent[3] - sent[2] == std::min<Clock::duration>(first_interval * 4, UdpSendQueue::UDP_UPPER_DELAY));
+}
+
+
+TEST_CASE( "UdpSendQueue only sends what's due", "[udpsendqueue]" ) {
+	UdpSendQueue queue(3);
+	auto to = some_address();
+	auto start = Clock::now();
+
+	REQUIRE(queue.timeUntilNext(start, milliseconds(1000)) == milliseconds(1000));
+	queue.add(start, "hello", reinterpret_cast<struct sockaddr *>(&to), sizeof(to), Clock::duration::zero(), 1);
+
+	int sends = 0;
+	auto count = [&sends] (const UdpSendQueue::Datagram &datagram) {
+		REQUIRE(datagram.data == "hello");
+		REQUIRE(datagram.to_length == sizeof(struct sockaddr_in));
+		++sends;
+	};
+	queue.sendDue(start, count);
+	REQUIRE(sends == 1);
+	queue.sendDue(start + UdpSendQueue::UDP_MIN_DELAY - milliseconds(1), count);
+	REQUIRE(sends == 1);
+	REQUIRE(queue.timeUntilNext(start, milliseconds(1000)) >= UdpSendQueue::UDP_MIN_DELAY);
+	queue.sendDue(start + UdpSendQueue::UDP_MAX_DELAY, count);
+	REQUIRE(sends == 2);
+	REQUIRE(queue.empty());
+}
+
+
+TEST_CASE( "RecentMessageIds spots repeats until they age out", "[udpsendqueue]" ) {
+	RecentMessageIds recent(2);
+	REQUIRE(!recent.checkAndAdd("urn:uuid:1"));
+	REQUIRE(recent.checkAndAdd("urn:uuid:1"));
+	REQUIRE(!recent.checkAndAdd("urn:uuid:2"));
+	REQUIRE(!recent.checkAndAdd("urn:uuid:3"));
+	REQUIRE(!recent.checkAndAdd("urn:uuid:1"));
+}
+
+
+// How many cameras got at least one reply through: a reply is lost if another
+// starts within airtime of it (there's no carrier sense in this model).
+using Reply = std::pair<Clock::duration, int>;
+static size_t count_heard(std::vector<Reply> sent, Clock::duration airtime) {
+	std::sort(sent.begin(), sent.end());
+	std::set<int> heard;
+	for (size_t i = 0; i < sent.size(); ++i) {
+		bool before = i > 0 && sent[i].first - sent[i - 1].first < airtime;
+		bool after = i + 1 < sent.size() && sent[i + 1].first - sent[i].first < airtime;
+		if (!before && !after) {
+			heard.insert(sent[i].second);
+		}
+	}
+	return heard.size();
+}
+
+
+// A site full of cameras all hearing the same probe (and the client's retransmission
+// of it 100ms later), with each reply taking ~2ms of a shared channel (about 1.2KB at 6Mbps).
+// Much past 50 cameras APP_MAX_DELAY is too short a window for this model to fit
+// them all in without overlap, whatever the jitter.
+// Run with: ./test-runner "[simulation]"
+TEST_CASE( "Simulated ProbeMatches collisions", "[.][simulation]" ) {
+	const auto airtime = milliseconds(2);
+	const auto probe_repeat = milliseconds(100);
+	auto to = some_address();
+	auto start = Clock::now();
+
+	for (int cameras : {10, 25, 50}) {
+		// What we used to do: every camera answers every copy of the probe straight away.
+		std::vector<Reply> naive;
+		for (int i = 0; i < cameras; ++i) {
+			naive.emplace_back(Clock::duration::zero(), i);
+			naive.emplace_back(probe_repeat, i);
+		}
+
+		// Now: drop the repeated probe, delay by up to APP_MAX_DELAY and repeat the reply once.
+		std::vector<Reply> jittered;
+		for (int i = 0; i < cameras; ++i) {
+			UdpSendQueue queue(i + 1);
+			RecentMessageIds recent(64);
+			for (auto received : {Clock::duration::zero(), Clock::duration(probe_repeat)}) {
+				if (!recent.checkAndAdd("urn:uuid:probe")) {
+					queue.add(start + received, "reply", reinterpret_cast<struct sockaddr *>(&to), sizeof(to), milliseconds(500), 1);
+				}
+			}
+			for (auto sent : drain(&queue, start)) {
+				jittered.emplace_back(sent, i);
+			}
+		}
+
+		size_t naive_heard = count_heard(naive, airtime);
+		size_t jittered_heard = count_heard(jittered, airtime);
+		WARN(cameras << " cameras: " << naive_heard << " heard from " << naive.size() << " immediate replies, "
+		     << jittered_heard << " from " << jittered.size() << " jittered replies");
+		REQUIRE(jittered_heard > naive_heard);
+	}
+}
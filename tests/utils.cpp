@@ -0,0 +1,107 @@
+// Copyright 2023 Morse Micro
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <errno.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "catch.hpp"
+#include "../utils.h"
+#include "scratch.h"
+
+
+TEST_CASE( "start_child_process starts a process that stop_child_process stops", "[utils]" ) {
+	pid_t pid = start_child_process("/bin/sleep", {"/bin/sleep", "10"});
+	REQUIRE(pid > 0);
+	REQUIRE(kill(pid, 0) == 0);
+
+	stop_child_process(pid);
+	REQUIRE(kill(pid, 0) == -1);
+	REQUIRE(errno == ESRCH);
+}
+
+
+TEST_CASE( "stop_child_process doesn't wait longer than it has to", "[utils]" ) {
+	pid_t pid = start_child_process("/bin/sleep", {"/bin/sleep", "10"});
+	auto start = std::chrono::steady_clock::now();
+	stop_child_process(pid, std::chrono::seconds(5));
+	REQUIRE(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(500));
+}
+
+
+TEST_CASE( "stop_child_process kills a child that ignores SIGTERM", "[utils]" ) {
+	pid_t pid = start_child_process("/bin/sh", {"/bin/sh", "-c", "trap '' TERM; exec sleep 10"});
+	// Let it set up the trap.
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+	auto start = std::chrono::steady_clock::now();
+	stop_child_process(pid, std::chrono::milliseconds(200));
+	auto elapsed = std::chrono::steady_clock::now() - start;
+	REQUIRE(elapsed >= std::chrono::milliseconds(200));
+	REQUIRE(elapsed < std::chrono::milliseconds(1000));
+	REQUIRE(kill(pid, 0) == -1);
+}
+
+
+TEST_CASE( "start_child_process survives a bad executable", "[utils]" ) {
+	pid_t pid = start_child_process("/no/such/rtsp-server", {"/no/such/rtsp-server"});
+	REQUIRE(pid > 0);
+
+	int wstatus;
+	REQUIRE(waitpid(pid, &wstatus, 0) == pid);
+	REQUIRE(WIFEXITED(wstatus));
+	REQUIRE(WEXITSTATUS(wstatus) == 127);
+}
+
+TEST_CASE( "write_file_atomically leaves a file only we can read", "[utils]" ) {
+	ScratchDir scratch;
+	std::string path = scratch.path("config.xml");
+	// Even if the last attempt left a temporary file readable by others.
+	ScratchDir::write(path + ".tmp", "");
+	chmod((path + ".tmp").c_str(), 0644);
+	REQUIRE(write_file_atomically(path, "<config/>"));
+	REQUIRE(ScratchDir::read(path) == "<config/>");
+
+	struct stat st;
+	REQUIRE(stat(path.c_str(), &st) == 0);
+	REQUIRE((st.st_mode & 0777) == 0600);
+}
+
+
+// What start_child_process used to do.
+static pid_t fork_child_process(const char *path) {
+	pid_t pid = fork();
+	if (pid == 0) {
+		execl(path, path, nullptr);
+		_exit(127);
+	}
+	return pid;
+}
+
+
+// Run with: ./test-runner "[benchmark]"
+TEST_CASE( "Spawn latency vs heap size", "[.][benchmark]" ) {
+	for (size_t heap_mb : {0, 16, 64, 256}) {
+		// Touch every page so it actually counts towards what fork has to copy-on-write map.
+		std::vector<char> heap(heap_mb * 1024 * 1024);
+		memset(heap.data(), 1, heap.size());
+
+		BENCHMARK("fork+exec, " + std::to_string(heap_mb) + "MB heap") {
+			int wstatus;
+			return waitpid(fork_child_process("/bin/true"), &wstatus, 0);
+		};
+
+		BENCHMARK("start_child_process, " + std::to_string(heap_mb) + "MB heap") {
+			int wstatus;
+			return waitpid(start_child_process("/bin/true", {"/bin/true"}), &wstatus, 0);
+		};
+	}
+}
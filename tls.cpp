@@ -0,0 +1,67 @@
+// Copyright 2023 Morse Micro
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include "tls.h"
+
+#include <string>
+
+
+const char DEFAULT_TLS_CIPHERS[] =
+	"TLS_CHACHA20_POLY1305_SHA256:TLS_AES_128_GCM_SHA256:TLS_AES_256_GCM_SHA384:"
+	"ECDHE-ECDSA-CHACHA20-POLY1305:ECDHE-RSA-CHACHA20-POLY1305:"
+	"ECDHE-ECDSA-AES128-GCM-SHA256:ECDHE-RSA-AES128-GCM-SHA256:"
+	"ECDHE-ECDSA-AES256-GCM-SHA384:ECDHE-RSA-AES256-GCM-SHA384";
+
+// A VMS polls every few seconds to minutes, so an hour is plenty.
+const long TLS_SESSION_SECONDS = 3600;
+const long TLS_SESSION_CACHE_SIZE = 128;
+
+
+#ifdef WITH_OPENSSL
+
+// Anything will do, as long as it's the same on every listener.
+static const unsigned char SESSION_ID_CONTEXT[] = "camera-onvif-server";
+
+
+bool configure_tls_context(SSL_CTX *ctx, const std::string &ciphers) {
+	std::string tls13;
+	std::string tls12;
+	std::string all = ciphers.empty() ? DEFAULT_TLS_CIPHERS : ciphers;
+	size_t start = 0;
+	while (start <= all.size()) {
+		size_t end = all.find(':', start);
+		if (end == std::string::npos) {
+			end = all.size();
+		}
+		std::string name = all.substr(start, end - start);
+		if (!name.empty()) {
+			std::string &list = name.compare(0, 4, "TLS_") == 0 ? tls13 : tls12;
+			list += (list.empty() ? "" : ":") + name;
+		}
+		start = end + 1;
+	}
+	// Either can be left at OpenSSL's default, but not both.
+	if (tls13.empty() && tls12.empty()) {
+		return false;
+	}
+	if (!tls13.empty() && SSL_CTX_set_ciphersuites(ctx, tls13.c_str()) != 1) {
+		return false;
+	}
+	if (!tls12.empty() && SSL_CTX_set_cipher_list(ctx, tls12.c_str()) != 1) {
+		return false;
+	}
+	// PRIORITIZE_CHACHA: if we prefer AES but the client puts ChaCha20 first (i.e. it has no
+	// AES instructions either), it gets ChaCha20.
+	SSL_CTX_set_options(ctx, SSL_OP_CIPHER_SERVER_PREFERENCE | SSL_OP_PRIORITIZE_CHACHA);
+
+	// gsoap turns tickets off. They're encrypted with a key in ctx, so any listener sharing
+	// it can resume a session from any other.
+	SSL_CTX_clear_options(ctx, SSL_OP_NO_TICKET);
+	SSL_CTX_set_session_id_context(ctx, SESSION_ID_CONTEXT, sizeof(SESSION_ID_CONTEXT) - 1);
+	SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER);
+	SSL_CTX_sess_set_cache_size(ctx, TLS_SESSION_CACHE_SIZE);
+	SSL_CTX_set_timeout(ctx, TLS_SESSION_SECONDS);
+	return true;
+}
+
+#endif
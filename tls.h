@@ -0,0 +1,43 @@
+/*
+ * Copyright 2023 Morse Micro
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#pragma once
+
+#include <string>
+
+#ifdef WITH_OPENSSL
+#include <openssl/ssl.h>
+#endif
+
+
+/* HTTPS settings for start_server (which can only use them if built with TLS=1). */
+struct TlsOptions {
+	// PEM file with the certificate (chain) followed by its private key.
+	std::string keyfile;
+	// Most preferred first, separated by colons: TLS_* names are TLS 1.3 ciphersuites,
+	// anything else is an OpenSSL cipher list entry for TLS 1.2. Empty for DEFAULT_TLS_CIPHERS.
+	std::string ciphers;
+};
+
+/* ChaCha20-Poly1305 first: without AES instructions (i.e. most low-end ARM cores) it's
+ * several times cheaper than AES-GCM. Put AES first on cores that have them.
+ */
+extern const char DEFAULT_TLS_CIPHERS[];
+
+/* How long a client can resume a session for, and how many (TLS 1.2 session ID)
+ * sessions we remember. Tickets don't need remembering.
+ */
+extern const long TLS_SESSION_SECONDS;
+extern const long TLS_SESSION_CACHE_SIZE;
+
+#ifdef WITH_OPENSSL
+/* Sets up a server context (which already has its certificate) so that repeat
+ * connections are cheap: session tickets and a session cache, so that a client can
+ * resume rather than redo the certificate signature (and for TLS 1.2, the key exchange),
+ * and our cipher preference (see TlsOptions) rather than the client's.
+ * Returns false if ciphers has nothing usable.
+ */
+extern bool configure_tls_context(SSL_CTX *ctx, const std::string &ciphers);
+#endif
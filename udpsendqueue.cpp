@@ -0,0 +1,71 @@
+// Copyright 2023 Morse Micro
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "udpsendqueue.h"
+
+
+constexpr std::chrono::milliseconds UdpSendQueue::UDP_MIN_DELAY;
+constexpr std::chrono::milliseconds UdpSendQueue::UDP_MAX_DELAY;
+constexpr std::chrono::milliseconds UdpSendQueue::UDP_UPPER_DELAY;
+
+
+UdpSendQueue::Clock::duration UdpSendQueue::randomDelay(Clock::duration min, Clock::duration max) {
+	if (max <= min) {
+		return min;
+	}
+	std::uniform_int_distribution<Clock::rep> distribution(min.count(), max.count());
+	return Clock::duration(distribution(random));
+}
+
+
+void UdpSendQueue::add(Clock::time_point now, std::string data, const struct sockaddr *to, socklen_t to_length,
+                       Clock::duration max_initial_delay, int repeats) {
+	Datagram datagram;
+	datagram.due = now + randomDelay(Clock::duration::zero(), max_initial_delay);
+	datagram.data = std::move(data);
+	memset(&datagram.to, 0, sizeof(datagram.to));
+	datagram.to_length = std::min<socklen_t>(to_length, sizeof(datagram.to));
+	memcpy(&datagram.to, to, datagram.to_length);
+	datagram.repeats_left = repeats;
+	datagram.repeat_interval = randomDelay(UDP_MIN_DELAY, UDP_MAX_DELAY);
+	queue.push(std::move(datagram));
+}
+
+
+void UdpSendQueue::sendDue(Clock::time_point now, const Sender &send) {
+	while (!queue.empty() && queue.top().due <= now) {
+		Datagram datagram = queue.top();
+		queue.pop();
+		send(datagram);
+
+		if (datagram.repeats_left > 0) {
+			--datagram.repeats_left;
+			datagram.due += datagram.repeat_interval;
+			datagram.repeat_interval = std::min<Clock::duration>(datagram.repeat_interval * 2, UDP_UPPER_DELAY);
+			queue.push(std::move(datagram));
+		}
+	}
+}
+
+
+UdpSendQueue::Clock::duration UdpSendQueue::timeUntilNext(Clock::time_point now, Clock::duration max) const {
+	if (queue.empty()) {
+		return max;
+	}
+	return std::max(Clock::duration::zero(), std::min(max, queue.top().due - now));
+}
+
+
+bool RecentMessageIds::checkAndAdd(const char *message_id) {
+	size_t hash = std::hash<std::string>()(message_id);
+	if (std::find(hashes.begin(), hashes.end(), hash) != hashes.end()) {
+		return true;
+	}
+	hashes[next] = hash;
+	next = (next + 1) % hashes.size();
+	return false;
+}
@@ -0,0 +1,89 @@
+/*
+ * Copyright 2023 Morse Micro
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#pragma once
+
+#include <sys/socket.h>
+
+#include <chrono>
+#include <functional>
+#include <queue>
+#include <random>
+#include <string>
+#include <vector>
+
+
+/* Datagrams waiting to go out with SOAP-over-UDP's timing.
+ *
+ * Each is first sent after a random delay of up to max_initial_delay (APP_MAX_DELAY
+ * for discovery messages, so that a whole site of cameras doesn't answer the same
+ * probe at once), then repeated after a random UDP_MIN_DELAY..UDP_MAX_DELAY,
+ * doubling each time up to UDP_UPPER_DELAY.
+ *
+ * Nothing here blocks: whoever owns the socket asks how long it can wait
+ * (e.g. for incoming messages) and calls sendDue when it wakes.
+ */
+class UdpSendQueue {
+	public:
+		using Clock = std::chrono::steady_clock;
+
+		static constexpr std::chrono::milliseconds UDP_MIN_DELAY{50};
+		static constexpr std::chrono::milliseconds UDP_MAX_DELAY{250};
+		static constexpr std::chrono::milliseconds UDP_UPPER_DELAY{500};
+
+		struct Datagram {
+			Clock::time_point due;
+			std::string data;
+			struct sockaddr_storage to;
+			socklen_t to_length;
+			int repeats_left;
+			Clock::duration repeat_interval;
+		};
+
+		using Sender = std::function<void(const Datagram &datagram)>;
+
+	private:
+		struct LaterFirst {
+			bool operator()(const Datagram &a, const Datagram &b) const { return a.due > b.due; }
+		};
+
+		std::priority_queue<Datagram, std::vector<Datagram>, LaterFirst> queue;
+		std::minstd_rand random;
+
+		Clock::duration randomDelay(Clock::duration min, Clock::duration max);
+
+	public:
+		explicit UdpSendQueue(unsigned int seed) : random(seed) {}
+
+		void add(Clock::time_point now, std::string data, const struct sockaddr *to, socklen_t to_length,
+		         Clock::duration max_initial_delay, int repeats);
+
+		/* Calls send for everything due by now (rescheduling any repeats). */
+		void sendDue(Clock::time_point now, const Sender &send);
+
+		/* How long until the next datagram is due, but no more than max. */
+		Clock::duration timeUntilNext(Clock::time_point now, Clock::duration max) const;
+
+		bool empty() const { return queue.empty(); }
+
+		/* Drops everything (e.g. replies we no longer want to send as we shut down). */
+		void clear() { queue = decltype(queue)(); }
+};
+
+
+/* The last few MessageIDs we've seen, so we can ignore retransmissions
+ * (SOAP-over-UDP senders repeat every message at least once).
+ */
+class RecentMessageIds {
+	private:
+		std::vector<size_t> hashes;
+		size_t next;
+
+	public:
+		explicit RecentMessageIds(size_t capacity) : hashes(capacity, 0), next(0) {}
+
+		/* Returns true if message_id was already there. */
+		bool checkAndAdd(const char *message_id);
+};
@@ -2,20 +2,78 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 
 #include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <sched.h>
 #include <signal.h>
+#include <pthread.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <sys/prctl.h>
+#include <sys/stat.h>
 #include <unistd.h>
 #include <string.h>
 
 #include <algorithm>
-#include <iostream>
+#include <chrono>
+#include <thread>
 #include <vector>
 
+#include "log.h"
 #include "utils.h"
 
 
+static const size_t CHILD_STACK_SIZE = 64 * 1024;
+static const auto CHILD_EXIT_POLL_INTERVAL = std::chrono::milliseconds(10);
+// Near enough the start of the process, since it's initialised before main.
+static const auto PROCESS_START = std::chrono::steady_clock::now();
+
+
+namespace {
+	struct SpawnArgs {
+		const char *executable_path;
+		char *const *argv;
+		pid_t parent_pid;
+		const sigset_t *sigmask;
+		int error;
+	};
+}
+
+
+// This runs in the child, but shares the parent's memory (CLONE_VM) while the parent
+// is suspended (CLONE_VFORK), so from here on we're limited to async-signal-safe
+// calls: in particular, no allocation and no iostreams.
+static int exec_child_process(void *arg) {
+	auto *args = static_cast<SpawnArgs *>(arg);
+
+	// Don't let any of the parent's signal handlers run on our borrowed stack.
+	// Like posix_spawn, caught signals go back to their defaults and ignored ones stay ignored.
+	struct sigaction sa;
+	for (int sig = 1; sig < NSIG; ++sig) {
+		if (sigaction(sig, nullptr, &sa) == 0 && sa.sa_handler != SIG_IGN && sa.sa_handler != SIG_DFL) {
+			sa.sa_handler = SIG_DFL;
+			sa.sa_flags = 0;
+			sigaction(sig, &sa, nullptr);
+		}
+	}
+
+	// This is why we can't just use posix_spawn.
+	if (-1 == prctl(PR_SET_PDEATHSIG, SIGTERM)) {
+		args->error = errno;
+		_exit(127);
+	}
+	if (getppid() != args->parent_pid) { // In case parent already exited...
+		args->error = ESRCH;
+		_exit(127);
+	}
+
+	sigprocmask(SIG_SETMASK, args->sigmask, nullptr);
+	execv(args->executable_path, args->argv);
+	args->error = errno;
+	_exit(127);
+}
+
+
 pid_t start_child_process(std::string path, std::vector<std::string> arguments) {
 	const char *executable_path = path.c_str();
 	std::vector<const char *> argv;
@@ -23,33 +81,39 @@ pid_t start_child_process(std::string path, std::vector<std::string> arguments)
 		[] (std::string &arg) { return arg.c_str(); });
 	argv.push_back(NULL);
 
-	pid_t parent_pid = getpid();
-	pid_t pid = fork();
+	// Rather than fork (which has to copy our page tables, and can fail with ENOMEM
+	// under strict overcommit even though we're about to exec), borrow our memory
+	// for the child and sleep until it has exec'd. The child only needs a small stack.
+	std::vector<char> stack(CHILD_STACK_SIZE);
+
+	// Block everything until the child has reset its signal handlers.
+	sigset_t all_signals, old_sigmask;
+	sigfillset(&all_signals);
+	pthread_sigmask(SIG_SETMASK, &all_signals, &old_sigmask);
+
+	// The child starts with nothing blocked (main blocks the shutdown signals in
+	// every thread, and the child has to be able to hear our SIGTERM).
+	sigset_t child_sigmask;
+	sigemptyset(&child_sigmask);
+
+	// Ok, I casted away the constness, but we're about to exec so I'm ok with that.
+	SpawnArgs args = {executable_path, const_cast<char *const*>(argv.data()), getpid(), &child_sigmask, 0};
+	pid_t pid = clone(exec_child_process, stack.data() + stack.size(), CLONE_VM | CLONE_VFORK | SIGCHLD, &args);
+	int clone_errno = errno;
+
+	pthread_sigmask(SIG_SETMASK, &old_sigmask, nullptr);
 
 	if (pid == -1) {
-		throw std::runtime_error("Unable to fork to start RTSP server");
-	} else if (pid == 0) {
-		if (-1 == prctl(PR_SET_PDEATHSIG, SIGTERM)) {
-			std::cerr << "Failed to prctl(PR_SET_PDEATHSIG) for rtsp server: " << strerror(errno) << std::endl;
-			exit(1);
-		}
-		if (getppid() != parent_pid) { // In case parent already exited...
-			exit(1);
-		}
-		// Ok, I casted away the constness, but we're about to exec so I'm ok with that.
-		if (-1 == execv(executable_path, const_cast<char *const*>(argv.data()))) {
-			std::cerr << "Failed to start rtsp server at " << executable_path << ": " << strerror(errno) << std::endl;
-			exit(1);
-		};
+		throw std::runtime_error(std::string("Unable to clone to start RTSP server: ") + strerror(clone_errno));
+	} else if (args.error != 0) {
+		// As with fork, we leave the exited child for stop_child_process to reap.
+		LOG_ERROR("Failed to start rtsp server at " << executable_path << ": " << strerror(args.error));
 	}
 
 	return pid;
 }
 
-void stop_child_process(pid_t pid) {
-	// This is ugly, but without pidfd_open I don't think there's an elegant way.
-	// https://stackoverflow.com/questions/282176/waitpid-equivalent-with-timeout
-
+void stop_child_process(pid_t pid, std::chrono::milliseconds grace) {
 	if (-1 == kill(pid, SIGTERM)) {
 		if (errno == ESRCH) {
 			return;
@@ -57,8 +121,94 @@ void stop_child_process(pid_t pid) {
 			throw std::runtime_error("Unable to SIGTERM RTSP server");
 		}
 	}
-	sleep(1);
-	kill(pid, SIGKILL);
+
+	// Without pidfd_open there's no waitpid with a timeout, so poll
+	// (rather than always sleeping for the whole grace period).
+	// https://stackoverflow.com/questions/282176/waitpid-equivalent-with-timeout
 	int wstatus;
+	auto deadline = std::chrono::steady_clock::now() + grace;
+	while (std::chrono::steady_clock::now() < deadline) {
+		pid_t result = waitpid(pid, &wstatus, WNOHANG);
+		if (result == pid || (result == -1 && errno == ECHILD)) {
+			return;
+		}
+		std::this_thread::sleep_for(CHILD_EXIT_POLL_INTERVAL);
+	}
+
+	LOG_WARNING("Child process " << pid << " ignored SIGTERM; killing it");
+	kill(pid, SIGKILL);
 	waitpid(pid, &wstatus, 0);
-}
\ No newline at end of file
+}
+
+bool write_file_atomically(const std::string &path, const std::string &data) {
+	std::string temp_path = path + ".tmp";
+	int fd = open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+	// In case a crash left one behind with other permissions.
+	if (fd != -1 && fchmod(fd, 0600) != 0) {
+		close(fd);
+		fd = -1;
+	}
+	if (fd == -1) {
+		LOG_ERROR("Unable to write " << temp_path << ": " << strerror(errno));
+		return false;
+	}
+	const char *remaining = data.data();
+	const char *end = remaining + data.size();
+	while (remaining < end) {
+		ssize_t written = write(fd, remaining, end - remaining);
+		if (written == -1 && errno != EINTR) {
+			break;
+		}
+		remaining += std::max<ssize_t>(written, 0);
+	}
+	bool ok = remaining == end && fsync(fd) == 0;
+	int write_errno = errno;
+	close(fd);
+	if (!ok || rename(temp_path.c_str(), path.c_str()) != 0) {
+		LOG_ERROR("Unable to replace " << path << ": " << strerror(ok ? errno : write_errno));
+		unlink(temp_path.c_str());
+		return false;
+	}
+
+	// Make the rename itself durable.
+	std::vector<char> dir_path(path.begin(), path.end());
+	dir_path.push_back('\0');
+	int dir_fd = open(dirname(dir_path.data()), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (dir_fd != -1) {
+		fsync(dir_fd);
+		close(dir_fd);
+	}
+	return true;
+}
+
+long uptime_ms() {
+	return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - PROCESS_START).count();
+}
+
+std::string soap_fault_string(struct soap *soap) {
+	std::ostringstream ss;
+	soap_stream_fault(soap, ss);
+	soap_stream_fault_location(soap, ss);
+	return ss.str();
+}
+
+
+// gsoap only does one level of subcode.
+static int add_detail_subcode(struct soap *soap, int status, const char *detail_subcode) {
+	if (soap->version == 2 && soap->fault->SOAP_ENV__Code != nullptr && soap->fault->SOAP_ENV__Code->SOAP_ENV__Subcode != nullptr) {
+		auto *code = soap_new_SOAP_ENV__Code(soap);
+		code->SOAP_ENV__Value = soap_strdup(soap, detail_subcode);
+		soap->fault->SOAP_ENV__Code->SOAP_ENV__Subcode->SOAP_ENV__Subcode = code;
+	}
+	return status;
+}
+
+
+int onvif_sender_fault(struct soap *soap, const char *subcode, const char *detail_subcode, const std::string &reason) {
+	return add_detail_subcode(soap, soap_sender_fault_subcode(soap, subcode, soap_strdup(soap, reason.c_str()), nullptr), detail_subcode);
+}
+
+
+int onvif_receiver_fault(struct soap *soap, const char *subcode, const char *detail_subcode, const std::string &reason) {
+	return add_detail_subcode(soap, soap_receiver_fault_subcode(soap, subcode, soap_strdup(soap, reason.c_str()), nullptr), detail_subcode);
+}
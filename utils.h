@@ -9,19 +9,49 @@
 
 #include <sys/types.h>
 
+#include <chrono>
 #include <vector>
 #include <string>
 #include <sstream>
 
 
+/* Starts path without forking (the child borrows our memory until it execs).
+ * The child is sent SIGTERM when the calling thread exits (PR_SET_PDEATHSIG),
+ * so only call this from a thread that lives as long as the child should.
+ */
 extern pid_t start_child_process(std::string path, std::vector<std::string> arguments);
 
 
-extern void stop_child_process(pid_t pid);
+/* SIGTERMs pid and reaps it, SIGKILLing it if it's still there after grace. */
+extern void stop_child_process(pid_t pid, std::chrono::milliseconds grace = std::chrono::seconds(1));
+
+
+/* Replaces path with data so that after a crash it's either the old file or the new one
+ * (via path.tmp, synced before it's renamed over path). Returns false (having logged why) on failure.
+ * The new file is only readable by us (0600), as the config has passwords in it.
+ */
+extern bool write_file_atomically(const std::string &path, const std::string &data);
+
+
+/* Milliseconds since the process started (for logging how long startup took). */
+extern long uptime_ms();
+
+
+/* The fault (and its location) as soap_print_fault would show it, for logging. */
+extern std::string soap_fault_string(struct soap *soap);
+
+
+/* Sets an ONVIF fault from the client's side (env:Sender), e.g. ter:InvalidArgVal then
+ * ter:ConfigModify, and returns SOAP_FAULT for the handler to return.
+ */
+extern int onvif_sender_fault(struct soap *soap, const char *subcode, const char *detail_subcode, const std::string &reason);
+
+/* The same from the device's side (env:Receiver), e.g. ter:Action then ter:MaxNVTProfiles. */
+extern int onvif_receiver_fault(struct soap *soap, const char *subcode, const char *detail_subcode, const std::string &reason);
 
 
 /* Currently, this is primarily used on startup when 'something bad' happens which means we're
- * not going to be able to function. i.e. it will log and then blow up the program.
+ * not going to be able to function (or, for the RTSP server, not yet).
  */
 class SoapError: public std::runtime_error {
 	public: